@@ -0,0 +1,122 @@
+/*
+ Copyright (C) 2004-2007 The Minisip Team
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#ifndef _CERTIFICATECHAINCACHE_H_
+#define _CERTIFICATECHAINCACHE_H_
+
+#include <libmcrypto/config.h>
+
+#include <libmcrypto/cert.h>
+#include <libmutil/MemObject.h>
+#include <libmutil/MSingleton.h>
+#include <libmutil/Mutex.h>
+
+#include <list>
+#include <map>
+#include <string>
+#include <time.h>
+
+/* Chains remembered at most, the least recently used is dropped */
+#define CERT_CHAIN_CACHE_MAX 128
+
+/* Default time a verified chain is trusted without verifying it
+ * again, in seconds */
+#define CERT_CHAIN_CACHE_MAX_AGE 3600
+
+/* Default time a chain that failed verification is rejected
+ * without verifying it again, in seconds */
+#define CERT_CHAIN_CACHE_NEGATIVE_TTL 60
+
+/**
+ * Results of certificate chain verifications, so that a peer
+ * calling again (MIKEY-PKE, RSA-R) does not have its chain checked
+ * against the trusted certificates at every call setup.
+ *
+ * An entry is identified by the DER encoding of every certificate
+ * of the chain, leaf first, and by the revision of the set of
+ * trusted certificates it was verified against. Adding or removing
+ * a trusted certificate thus never uses a result computed before.
+ *
+ * A verified chain is trusted for the configured maximum age, but
+ * never past the notAfter time of any of its certificates. A chain
+ * that failed is rejected for a shorter time, so that a peer
+ * fixing its certificates is not locked out for long.
+ *
+ * All methods are thread safe.
+ */
+class LIBMCRYPTO_API CertificateChainCache : public MObject,
+					     public MSingleton<CertificateChainCache> {
+	public:
+		/**
+		 * Returns the result of chain->control( certDb ), from
+		 * the cache when the same chain was verified against the
+		 * same trusted certificates before.
+		 */
+		int control( MRef<CertificateChain*> chain,
+			     MRef<CertificateSet*> certDb );
+
+		/** A maximum age of zero disables the cache */
+		void setMaxAge( int seconds );
+
+		/** A ttl of zero disables caching of failures */
+		void setNegativeTtl( int seconds );
+
+		void setMaxEntries( unsigned int entries );
+
+		void clear();
+
+		/** Verifications answered from the cache, and done */
+		uint64_t getHits(){ return nHits; }
+		uint64_t getMisses(){ return nMisses; }
+
+		std::string getMemObjectType() const { return "CertificateChainCache"; }
+
+	protected:
+		CertificateChainCache();
+
+	private:
+		struct Entry{
+			int result;
+			time_t expires;
+			std::list<std::string>::iterator lru;
+		};
+
+		static bool getKey( MRef<CertificateChain*> chain,
+				    MRef<CertificateSet*> certDb,
+				    std::string &key, time_t &notAfter );
+		void store( const std::string &key, int result,
+			    time_t expires );
+		void remove( std::map<std::string, Entry>::iterator i );
+
+		std::map<std::string, Entry> entries;
+
+		/* Keys, most recently used first */
+		std::list<std::string> lru;
+
+		Mutex lock;
+		int maxAge;
+		int negativeTtl;
+		unsigned int maxEntries;
+
+		uint64_t nHits;
+		uint64_t nMisses;
+
+		friend class MSingleton<CertificateChainCache>;
+};
+
+#endif
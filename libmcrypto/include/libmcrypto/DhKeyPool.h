@@ -0,0 +1,139 @@
+/*
+ Copyright (C) 2004-2007 The Minisip Team
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#ifndef _DHKEYPOOL_H_
+#define _DHKEYPOOL_H_
+
+#include <libmcrypto/config.h>
+
+#include <libmutil/MemObject.h>
+#include <libmutil/MSingleton.h>
+#include <libmutil/Thread.h>
+#include <libmutil/CondVar.h>
+#include <libmutil/Mutex.h>
+
+#include <list>
+#include <map>
+
+class OakleyDH;
+class ZrtpDH;
+
+/* Pool identifiers. The MIKEY pools use the group numbers of
+ * OakleyDH (DH_GROUP_OAKLEY5 etc.), the ZRTP pools are keyed by
+ * the size of the prime */
+#define DH_POOL_ZRTP3072 3072
+#define DH_POOL_ZRTP4096 4096
+
+/**
+ * Notified when a pool runs low, that is when taking a key leaves
+ * fewer than the low water mark of precomputed keys. It is called
+ * once each time the pool drops below the mark, from the thread
+ * taking the key, and must not block.
+ */
+class LIBMCRYPTO_API DhKeyPoolListener : public virtual MObject {
+	public:
+		virtual void dhKeyPoolLow( int pool, int available ) = 0;
+};
+
+/**
+ * Keeps Diffie-Hellman key pairs generated in advance, so that
+ * call setup does not have to do a modular exponentiation on the
+ * signaling path. A background thread, running at a lowered
+ * priority, refills the pools whenever keys have been taken.
+ *
+ * A pool has no keys until setPoolSize() is called for it. Taking
+ * a key from an empty pool generates one in the calling thread,
+ * so the pool never changes what the caller gets, only when the
+ * work is done. Key pairs are never handed out twice.
+ */
+class LIBMCRYPTO_API DhKeyPool : public Runnable,
+				 public MSingleton<DhKeyPool> {
+	public:
+		~DhKeyPool();
+
+		/**
+		 * Sets the number of keys to keep precomputed for a
+		 * pool, and the number below which the listener is
+		 * notified. A size of zero empties the pool.
+		 */
+		void setPoolSize( int pool, int size, int lowWater = 1 );
+
+		void setListener( MRef<DhKeyPoolListener*> listener );
+
+		/**
+		 * Returns an OakleyDH object of the given group with its
+		 * key pair generated, or NULL if the group is unknown.
+		 * The caller owns the object.
+		 */
+		OakleyDH * takeOakleyDH( int group );
+
+		/**
+		 * Returns a ZrtpDH object using a prime of pkLength bits
+		 * (3072 or 4096) with its key pair generated. The caller
+		 * owns the object.
+		 */
+		ZrtpDH * takeZrtpDH( int pkLength );
+
+		/** Precomputed keys currently available in a pool */
+		int getAvailable( int pool );
+
+		/** Keys served from a pool, and keys generated inline */
+		uint64_t getHits(){ return nHits; }
+		uint64_t getMisses(){ return nMisses; }
+
+		/** Starts the refill thread */
+		void start();
+
+		/** Stops the refill thread and frees all pooled keys */
+		void stop();
+
+		virtual void run();
+
+		std::string getMemObjectType() const { return "DhKeyPool"; }
+
+	protected:
+		DhKeyPool();
+
+	private:
+		struct Pool{
+			Pool(): size(0), lowWater(0), low(false){}
+			std::list<void*> keys;
+			int size;
+			int lowWater;
+			bool low;
+		};
+
+		void * take( int pool );
+		static void * generate( int pool );
+		static void release( int pool, void * key );
+		void clear( Pool &p, int pool );
+
+		std::map<int, Pool> pools;
+		MRef<DhKeyPoolListener*> listener;
+		MRef<Thread*> thread;
+		Mutex lock;
+		CondVar refill;
+		bool quit;
+
+		uint64_t nHits;
+		uint64_t nMisses;
+
+		friend class MSingleton<DhKeyPool>;
+};
+
+#endif
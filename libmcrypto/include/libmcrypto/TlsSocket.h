@@ -38,11 +38,28 @@ class LIBMCRYPTO_API TLSSocket : public StreamSocket {
 	public:
 		virtual ~TLSSocket();
 
+		/**
+		 * Does the client handshake on a connected socket. The
+		 * session is resumed when a previous connection to the
+		 * same peer (address, port and serverName) left one in
+		 * the session cache.
+		 * @param serverName	Sent in the SNI extension if set
+		 */
 		static TLSSocket* connect( MRef<StreamSocket*> ssock,
 					   MRef<Certificate *> cert=NULL,
 					   MRef<CertificateSet *> cert_db=NULL,
 					   std::string serverName="" );
 
+		/**
+		 * Configures the client session cache. Sessions are kept
+		 * for ttl seconds, zero disables the cache.
+		 * @param tickets	Accept session tickets (RFC 5077)
+		 */
+		static void setSessionCache( int ttl, bool tickets = true );
+
+		/** Client handshakes done since startup */
+		static void getHandshakeCounts( uint64_t &full, uint64_t &resumed );
+
 	protected:
 		TLSSocket();
 };
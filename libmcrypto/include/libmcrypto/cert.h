@@ -31,6 +31,7 @@
 
 #include<string>
 #include<list>
+#include<time.h>
 #include<libmutil/Mutex.h>
 #include<libmutil/MemObject.h>
 #include<libmutil/Exception.h>
@@ -216,6 +217,13 @@ class LIBMCRYPTO_API CertificateSet: public MObject{
 
 		virtual void remove( MRef<CertificateSetItem*> removedItem );
 
+		/**
+		 * Identifies the contents of the set. It differs between
+		 * sets, and changes each time a certificate is added to or
+		 * removed from the set.
+		 */
+		uint64_t getRevision();
+
 	protected:
 		CertificateSet();
 		virtual void addItem( MRef<CertificateSetItem*> item );
@@ -227,6 +235,7 @@ class LIBMCRYPTO_API CertificateSet: public MObject{
 		std::list<MRef<CertificateSetItem*> >::iterator items_index;
 		std::list<MRef<CertificateSetItem*> > items;
                 Mutex mLock;
+		uint64_t revision;
 };
 
 class LIBMCRYPTO_API PrivateKey: public MObject{
@@ -329,6 +338,9 @@ class LIBMCRYPTO_API Certificate: public MObject{
 		virtual std::string getIssuer()=0;
 		virtual std::string getIssuerCn()=0;
 
+		/** End of the validity period, zero if unknown */
+		virtual time_t getNotAfter()=0;
+
 
 		bool verifySignedBy(MRef<Certificate*> cert);
 
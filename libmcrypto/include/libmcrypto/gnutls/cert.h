@@ -158,6 +158,7 @@ class LIBMCRYPTO_API GtlsCertificate: public Certificate{
 		std::vector<std::string> getSubjectInfoAccess();
 		std::string getIssuer();
 		std::string getIssuerCn();
+		time_t getNotAfter();
 
 		bool verifySignedBy(MRef<Certificate*> cert);
 
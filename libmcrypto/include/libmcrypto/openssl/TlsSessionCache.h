@@ -0,0 +1,102 @@
+/*
+  Copyright (C) 2005, 2004 Erik Eliasson, Johan Bilien
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef OPENSSL_TLSSESSIONCACHE_H
+#define OPENSSL_TLSSESSIONCACHE_H
+
+#include<libmcrypto/config.h>
+
+#include<openssl/ssl.h>
+
+#include<libmutil/Mutex.h>
+#include<libmutil/MemObject.h>
+#include<libmutil/MSingleton.h>
+
+#include<map>
+#include<string>
+
+/* Default lifetime of a cached client session, in seconds */
+#define TLS_SESSION_CACHE_TTL 3600
+
+/* Peers remembered at most, the oldest session is dropped first */
+#define TLS_SESSION_CACHE_MAX 256
+
+/**
+ * Client side TLS sessions, one per peer, so that reconnecting to a
+ * proxy resumes the previous session instead of doing a full
+ * handshake. A peer is identified by address, port and the server
+ * name sent in the SNI extension.
+ *
+ * All methods are thread safe. The client sockets hold a reference to
+ * the instance, so it outlives the last of them.
+ */
+class OsslSessionCache: public MObject, public MSingleton<OsslSessionCache>{
+	public:
+		virtual std::string getMemObjectType() const { return "OsslSessionCache"; }
+
+		/**
+		 * Offers the session cached for the peer, if any and not
+		 * expired, for resumption by the next SSL_connect.
+		 */
+		void resume( SSL * ssl, const std::string &peer );
+
+		/**
+		 * Remembers the session of an established connection,
+		 * replacing the one cached for the peer.
+		 */
+		void store( SSL * ssl, const std::string &peer );
+
+		void remove( const std::string &peer );
+
+		/**
+		 * Records whether the handshake of ssl was a full one or
+		 * a resumption.
+		 */
+		void countHandshake( SSL * ssl );
+
+		/** A ttl of zero disables the cache */
+		void setTtl( int seconds );
+
+		/** Whether session tickets (RFC 5077) are accepted */
+		void setTicketsEnabled( bool enabled );
+		bool getTicketsEnabled();
+
+		uint64_t getFullHandshakes(){ return nFull; }
+		uint64_t getResumedHandshakes(){ return nResumed; }
+
+	private:
+		OsslSessionCache();
+		friend class MSingleton<OsslSessionCache>;
+
+		struct Entry{
+			SSL_SESSION * session;
+			time_t expires;
+		};
+
+		void dropOldest();
+
+		std::map<std::string, Entry> sessions;
+		Mutex lock;
+		int ttl;
+		bool tickets;
+
+		uint64_t nFull;
+		uint64_t nResumed;
+};
+
+#endif
@@ -31,13 +31,18 @@
 #include<libmnetutil/StreamSocket.h>
 
 #include<libmcrypto/openssl/cert.h>
+#include<libmcrypto/openssl/TlsSessionCache.h>
 #include<libmutil/mtypes.h>
 
 #include<libmnetutil/IPAddress.h>
 
 #include<libmutil/MemObject.h>
+#include<libmutil/Mutex.h>
 #include<libmcrypto/TlsSocket.h>
 
+/* Milliseconds a client handshake, or a write, may wait for the peer */
+#define TLS_HANDSHAKE_TIMEOUT 10000
+
 
 /**
    Various lists of ciphers. It includes the default list used,
@@ -84,8 +89,14 @@ class LIBMCRYPTO_API OsslSocket : public TLSSocket {
 		OsslSocket( MRef<StreamSocket*> ssock,
 			void * &ssl_ctx,
 			MRef<OsslCertificate *> cert,
-			MRef<OsslCertificateSet *> cert_db );
+			MRef<OsslCertificateSet *> cert_db,
+			const std::string &serverName = "" );
 		
+		/**
+		 * Server side connection. The handshake is not done
+		 * here but by the first calls to read(), so that a slow
+		 * peer does not hold up the thread accepting connections.
+		 */
 		OsslSocket( MRef<StreamSocket *> sock, SSL_CTX * ssl_ctx );
 		
 		virtual ~OsslSocket();
@@ -94,9 +105,25 @@ class LIBMCRYPTO_API OsslSocket : public TLSSocket {
 
 		virtual int32_t write(std::string);
 		
+		/**
+		 * Waits, at most TLS_HANDSHAKE_TIMEOUT, for a pending
+		 * handshake to complete and for the peer to accept the
+		 * data.
+		 */
 		virtual int32_t write(const void *buf, int32_t count);
 		
+		/**
+		 * The socket is non-blocking. Continues the handshake if
+		 * it is not done, then reads what is available. Returns
+		 * -1 when no application data has arrived yet, and 0 when
+		 * the connection is closed or the handshake failed.
+		 */
 		virtual int32_t read(void *buf, int32_t count);
+
+		virtual bool wantsWrite();
+
+		virtual void close();
+
 		static int32_t setSSLCTXCiphers ( SSL_CTX *_ctx, int8_t listIdx );
 		
 		/* Must be initialized ... now at Minisip.cxx::tls_server_thread*/
@@ -107,11 +134,25 @@ class LIBMCRYPTO_API OsslSocket : public TLSSocket {
 	private:
 		void OsslSocket_init( MRef<StreamSocket*> ssock, void * &ssl_ctx,
 					 MRef<OsslCertificate *> cert,
-					 MRef<OsslCertificateSet *> cert_db );
+					 MRef<OsslCertificateSet *> cert_db,
+					 const std::string &serverName );
+
+		/** Returns the result of SSL_do_handshake */
+		int32_t doHandshake();
+
+		/**
+		 * True if the SSL call that returned ret should be
+		 * retried once the socket is readable, or writable if
+		 * waitWrite is set.
+		 */
+		bool needsRetry( int32_t ret );
 		
 		MRef<StreamSocket *> sock;
 		
 		SSL_CTX* ssl_ctx;
+
+		/** ssl_ctx is a client context shared with other connections */
+		bool sharedContext;
 		
 		void*     priv;
 		
@@ -119,6 +160,15 @@ class LIBMCRYPTO_API OsslSocket : public TLSSocket {
 		
 		/** CA db */
 		MRef<OsslCertificateSet *> cert_db;
+
+		/** Session cache entry of a client connection */
+		std::string sessionPeer;
+		MRef<OsslSessionCache *> sessionCache;
+
+		/** Serializes the use of the SSL object */
+		Mutex sslLock;
+		bool handshakeDone;
+		bool waitWrite;
 };
 
 TLSSocket& operator<<(TLSSocket& sock, std::string str);
@@ -0,0 +1,177 @@
+/*
+ Copyright (C) 2004-2007 The Minisip Team
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#include<config.h>
+
+#include<libmcrypto/CertificateChainCache.h>
+
+using namespace std;
+
+CertificateChainCache::CertificateChainCache():
+		maxAge( CERT_CHAIN_CACHE_MAX_AGE ),
+		negativeTtl( CERT_CHAIN_CACHE_NEGATIVE_TTL ),
+		maxEntries( CERT_CHAIN_CACHE_MAX ),
+		nHits( 0 ), nMisses( 0 ){
+}
+
+bool CertificateChainCache::getKey( MRef<CertificateChain*> chain,
+		MRef<CertificateSet*> certDb,
+		string &key, time_t &notAfter ){
+	uint64_t revision = certDb->getRevision();
+
+	key.assign( (const char*)&revision, sizeof( revision ) );
+	notAfter = 0;
+
+	chain->lock();
+	chain->initIndex();
+	MRef<Certificate*> cert;
+	while( ( cert = chain->getNext() ) ){
+		unsigned int length = cert->getDerLength();
+		size_t offset = key.size();
+
+		key.resize( offset + length );
+		cert->getDer( (unsigned char*)&key[ offset ], &length );
+		key.resize( offset + length );
+
+		/* The chain is valid until its first certificate expires */
+		time_t certNotAfter = cert->getNotAfter();
+		if( offset == sizeof( revision ) || certNotAfter < notAfter ){
+			notAfter = certNotAfter;
+		}
+	}
+	chain->unlock();
+
+	if( key.size() == sizeof( revision ) ){
+		/* Empty chain */
+		return false;
+	}
+
+	return true;
+}
+
+int CertificateChainCache::control( MRef<CertificateChain*> chain,
+		MRef<CertificateSet*> certDb ){
+	string key;
+	time_t notAfter;
+
+	lock.lock();
+	bool enabled = maxAge > 0;
+	lock.unlock();
+
+	if( !enabled || !getKey( chain, certDb, key, notAfter ) ){
+		return chain->control( certDb );
+	}
+
+	lock.lock();
+	map<string, Entry>::iterator i = entries.find( key );
+	if( i != entries.end() ){
+		if( i->second.expires > time( NULL ) ){
+			int result = i->second.result;
+			lru.splice( lru.begin(), lru, i->second.lru );
+			nHits++;
+			lock.unlock();
+			return result;
+		}
+		remove( i );
+	}
+	nMisses++;
+	lock.unlock();
+
+	/* Not holding the lock, verifying takes a while */
+	int result = chain->control( certDb );
+	time_t now = time( NULL );
+
+	lock.lock();
+	if( result == 1 ){
+		time_t expires = now + maxAge;
+		if( notAfter < expires ){
+			expires = notAfter;
+		}
+		store( key, result, expires );
+	}
+	else if( result == 0 && negativeTtl > 0 ){
+		store( key, result, now + negativeTtl );
+	}
+	lock.unlock();
+
+	return result;
+}
+
+void CertificateChainCache::store( const string &key, int result,
+		time_t expires ){
+	if( maxAge <= 0 || expires <= time( NULL ) ){
+		return;
+	}
+
+	map<string, Entry>::iterator i = entries.find( key );
+	if( i != entries.end() ){
+		remove( i );
+	}
+
+	while( !lru.empty() && entries.size() >= maxEntries ){
+		remove( entries.find( lru.back() ) );
+	}
+
+	if( maxEntries == 0 ){
+		return;
+	}
+
+	lru.push_front( key );
+
+	Entry &entry = entries[ key ];
+	entry.result = result;
+	entry.expires = expires;
+	entry.lru = lru.begin();
+}
+
+void CertificateChainCache::remove( map<string, Entry>::iterator i ){
+	lru.erase( i->second.lru );
+	entries.erase( i );
+}
+
+void CertificateChainCache::setMaxAge( int seconds ){
+	lock.lock();
+	maxAge = seconds;
+	if( maxAge <= 0 ){
+		entries.clear();
+		lru.clear();
+	}
+	lock.unlock();
+}
+
+void CertificateChainCache::setNegativeTtl( int seconds ){
+	lock.lock();
+	negativeTtl = seconds;
+	lock.unlock();
+}
+
+void CertificateChainCache::setMaxEntries( unsigned int n ){
+	lock.lock();
+	maxEntries = n;
+	while( !lru.empty() && entries.size() > maxEntries ){
+		remove( entries.find( lru.back() ) );
+	}
+	lock.unlock();
+}
+
+void CertificateChainCache::clear(){
+	lock.lock();
+	entries.clear();
+	lru.clear();
+	lock.unlock();
+}
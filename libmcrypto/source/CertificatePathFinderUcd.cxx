@@ -23,6 +23,7 @@
 
 #include <config.h>
 #include <libmcrypto/CertificatePathFinderUcd.h>
+#include <libmcrypto/CertificateChainCache.h>
 #include <libmutil/SipUri.h>
 #include <libmutil/dbg.h>
 
@@ -115,7 +116,7 @@ MRef<CertificateChain*> CertificatePathFinderUcd::findUcdPath(MRef<CertificateCh
 	}
 	if (curPath->length() > 1) {
 		stats->ts.save("findUcdPath:ChainVerification:Start");
-		if (!curPath->control(rootCerts)) {
+		if (!CertificateChainCache::getInstance()->control(curPath, rootCerts)) {
 			stats->ts.save("findUcdPath:ChainVerification:End");
 			mdbg("ucd") << "$$$ End of " << __FUNCTION__ << std::endl;
 			stats->ts.save("findUcdPath:Main:End");
@@ -130,7 +131,7 @@ MRef<CertificateChain*> CertificatePathFinderUcd::findUcdPath(MRef<CertificateCh
 
 	if (toCert->getIssuer() == curCert->getName()){
 		curPath->addCertificateFirst(toCert);
-		if (curPath->control(rootCerts)) {
+		if (CertificateChainCache::getInstance()->control(curPath, rootCerts)) {
 			// Bingo!
 			mdbg("ucd") << "$$$ End of " << __FUNCTION__ << std::endl;
 			stats->ts.save("findUcdPath:Main:End");
@@ -0,0 +1,278 @@
+/*
+ Copyright (C) 2004-2007 The Minisip Team
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#include<config.h>
+
+#include<libmcrypto/DhKeyPool.h>
+#include<libmcrypto/OakleyDH.h>
+#include<libmcrypto/ZrtpDH.h>
+#include<libmutil/dbg.h>
+#include<libmutil/Exception.h>
+
+#ifdef WIN32
+#include<windows.h>
+#elif defined(__linux__)
+#include<unistd.h>
+#include<sys/resource.h>
+#include<sys/syscall.h>
+#endif
+
+/* Nice value of the refill thread */
+#define DH_POOL_NICE 10
+
+/* The refill thread checks the pools at least this often, in case
+ * a wake up is lost (the Win32 CondVar does not queue them) */
+#define DH_POOL_POLL_MS 1000
+
+using namespace std;
+
+static void lowerThreadPriority(){
+#ifdef WIN32
+	SetThreadPriority( GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL );
+#elif defined(__linux__)
+	/* On Linux the nice value of a thread id only affects
+	 * that thread */
+	setpriority( PRIO_PROCESS, (id_t)syscall( SYS_gettid ), DH_POOL_NICE );
+#endif
+}
+
+DhKeyPool::DhKeyPool(): quit( false ), nHits( 0 ), nMisses( 0 ){
+}
+
+DhKeyPool::~DhKeyPool(){
+	map<int, Pool>::iterator i;
+	for( i = pools.begin(); i != pools.end(); i++ ){
+		clear( i->second, i->first );
+	}
+}
+
+void DhKeyPool::setPoolSize( int pool, int size, int lowWater ){
+	list<void*> extra;
+
+	lock.lock();
+	Pool &p = pools[ pool ];
+	p.size = size > 0 ? size : 0;
+	p.lowWater = lowWater < p.size ? lowWater : p.size;
+	while( (int)p.keys.size() > p.size ){
+		extra.push_back( p.keys.back() );
+		p.keys.pop_back();
+	}
+	refill.broadcast();
+	lock.unlock();
+
+	list<void*>::iterator i;
+	for( i = extra.begin(); i != extra.end(); i++ ){
+		release( pool, *i );
+	}
+}
+
+void DhKeyPool::setListener( MRef<DhKeyPoolListener*> l ){
+	lock.lock();
+	listener = l;
+	lock.unlock();
+}
+
+int DhKeyPool::getAvailable( int pool ){
+	int n = 0;
+
+	lock.lock();
+	map<int, Pool>::iterator i = pools.find( pool );
+	if( i != pools.end() ){
+		n = (int)i->second.keys.size();
+	}
+	lock.unlock();
+	return n;
+}
+
+OakleyDH * DhKeyPool::takeOakleyDH( int group ){
+	return (OakleyDH*)take( group );
+}
+
+ZrtpDH * DhKeyPool::takeZrtpDH( int pkLength ){
+	return (ZrtpDH*)take( pkLength );
+}
+
+void * DhKeyPool::take( int pool ){
+	void * key = NULL;
+	MRef<DhKeyPoolListener*> notify;
+	bool low = false;
+	int available = 0;
+
+	lock.lock();
+	map<int, Pool>::iterator i = pools.find( pool );
+	if( i != pools.end() && i->second.size > 0 ){
+		Pool &p = i->second;
+
+		if( !p.keys.empty() ){
+			key = p.keys.front();
+			p.keys.pop_front();
+		}
+		available = (int)p.keys.size();
+
+		if( available < p.lowWater && !p.low ){
+			p.low = low = true;
+			notify = listener;
+		}
+		refill.broadcast();
+	}
+	if( key ){
+		nHits++;
+	}
+	else{
+		nMisses++;
+	}
+	lock.unlock();
+
+	if( low ){
+		mdbg("crypto") << "DhKeyPool: pool " << pool << " is low, "
+			<< available << " keys left" << endl;
+		if( notify ){
+			notify->dhKeyPoolLow( pool, available );
+		}
+	}
+
+	if( key ){
+		return key;
+	}
+	return generate( pool );
+}
+
+void * DhKeyPool::generate( int pool ){
+	try{
+		switch( pool ){
+			case DH_GROUP_OAKLEY5:
+			case DH_GROUP_OAKLEY1:
+			case DH_GROUP_OAKLEY2:
+				/* The key pair is generated when the
+				 * group is set */
+				return new OakleyDH( pool );
+
+			case DH_POOL_ZRTP3072:
+			case DH_POOL_ZRTP4096:{
+				ZrtpDH * dh = new ZrtpDH( pool );
+				if( !dh->generateKey() ){
+					delete dh;
+					return NULL;
+				}
+				return dh;
+			}
+		}
+	}
+	catch( Exception &e ){
+		merr << "DhKeyPool: could not generate a key pair: " << e.what() << endl;
+	}
+	return NULL;
+}
+
+void DhKeyPool::release( int pool, void * key ){
+	if( pool == DH_POOL_ZRTP3072 || pool == DH_POOL_ZRTP4096 ){
+		delete (ZrtpDH*)key;
+	}
+	else{
+		delete (OakleyDH*)key;
+	}
+}
+
+void DhKeyPool::clear( Pool &p, int pool ){
+	list<void*>::iterator i;
+	for( i = p.keys.begin(); i != p.keys.end(); i++ ){
+		release( pool, *i );
+	}
+	p.keys.clear();
+}
+
+void DhKeyPool::start(){
+	lock.lock();
+	if( thread.isNull() ){
+		quit = false;
+		thread = new Thread( this );
+	}
+	lock.unlock();
+}
+
+void DhKeyPool::stop(){
+	MRef<Thread*> t;
+
+	lock.lock();
+	quit = true;
+	t = thread;
+	thread = NULL;
+	refill.broadcast();
+	lock.unlock();
+
+	if( t ){
+		t->join();
+	}
+
+	lock.lock();
+	map<int, Pool>::iterator i;
+	for( i = pools.begin(); i != pools.end(); i++ ){
+		clear( i->second, i->first );
+	}
+	lock.unlock();
+}
+
+void DhKeyPool::run(){
+	lowerThreadPriority();
+
+	lock.lock();
+	while( !quit ){
+		int pool = -1;
+		map<int, Pool>::iterator i;
+
+		for( i = pools.begin(); i != pools.end(); i++ ){
+			if( (int)i->second.keys.size() < i->second.size ){
+				pool = i->first;
+				break;
+			}
+		}
+
+		if( pool < 0 ){
+			refill.wait( lock, DH_POOL_POLL_MS );
+			continue;
+		}
+
+		/* The exponentiation is done without the lock, so
+		 * that keys can be taken meanwhile */
+		lock.unlock();
+		void * key = generate( pool );
+		lock.lock();
+
+		if( !key ){
+			/* Do not spin on a failing group */
+			pools[ pool ].size = 0;
+			continue;
+		}
+
+		Pool &p = pools[ pool ];
+		if( !quit && (int)p.keys.size() < p.size ){
+			p.keys.push_back( key );
+			if( (int)p.keys.size() >= p.lowWater ){
+				p.low = false;
+			}
+			key = NULL;
+		}
+
+		if( key ){
+			lock.unlock();
+			release( pool, key );
+			lock.lock();
+		}
+	}
+	lock.unlock();
+}
@@ -266,8 +266,21 @@ void CertificateSetItem::reindexCert() {
 	}
 }
 
+static uint64_t nextRevision(){
+	/* Never deleted, sets may be destroyed with the static objects */
+	static Mutex * revisionLock = new Mutex();
+	static uint64_t lastRevision = 0;
+	uint64_t revision;
+
+	revisionLock->lock();
+	revision = ++lastRevision;
+	revisionLock->unlock();
+	return revision;
+}
+
 CertificateSet::CertificateSet(){
 	items_index = items.begin();
+	revision = nextRevision();
 }
 
 CertificateSet::~CertificateSet(){
@@ -366,6 +379,7 @@ MRef<CertificateSetItem*> CertificateSet::addFile(std::string file) {
 void CertificateSet::addItem( MRef<CertificateSetItem*> item ){
 	items.push_back( item );
 	items_index = items.begin();
+	revision = nextRevision();
 }
 
 /*
@@ -421,6 +435,7 @@ void CertificateSet::remove( MRef<CertificateSetItem*> removedItem ){
 		if( **(*items_index) == **removedItem ){
 			items.erase( items_index );
 			initIndex();
+			revision = nextRevision();
 			return;
 		}
 		items_index ++;
@@ -428,6 +443,10 @@ void CertificateSet::remove( MRef<CertificateSetItem*> removedItem ){
 	initIndex();
 }
 
+uint64_t CertificateSet::getRevision(){
+	return revision;
+}
+
 list<MRef<CertificateSetItem*> > &CertificateSet::getItems(){
 	return items;
 }
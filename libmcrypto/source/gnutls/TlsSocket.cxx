@@ -70,6 +70,17 @@ TLSSocket* TLSSocket::connect( MRef<StreamSocket *> sock,
 	return new GnutlsSocket( sock, Gtlsdb, Gtlscert );
 }
 
+/* Sessions are not resumed by the GnuTLS backend */
+void TLSSocket::setSessionCache( int ttl, bool tickets )
+{
+}
+
+void TLSSocket::getHandshakeCounts( uint64_t &full, uint64_t &resumed )
+{
+	full = 0;
+	resumed = 0;
+}
+
 
 /*********************************************************************************/
 /* constructor*/
@@ -916,6 +916,12 @@ string GtlsCertificate::getIssuerCn(){
 	return output;
 }
 
+time_t GtlsCertificate::getNotAfter(){
+	time_t notAfter = gnutls_x509_crt_get_expiration_time( cert );
+
+	return notAfter == (time_t)-1 ? 0 : notAfter;
+}
+
 // Read PEM-encoded private key from a file
 GtlsPrivateKey::GtlsPrivateKey( const string &file ){
 	int fd;
@@ -313,8 +313,9 @@ int32_t SSLSession::recv( const void *enc_buf, int enc_len,
 	ssl->rbio = rbio;
 
 	int32_t res = 0;
+	bool handshake = !SSL_is_init_finished( ssl );
 
-	if ( !SSL_is_init_finished( ssl )) {
+	if ( handshake ) {
 		res = SSL_do_handshake( ssl );
 	} else {
 		res = SSL_read(ssl, plain_buf, plain_len);
@@ -323,6 +324,15 @@ int32_t SSLSession::recv( const void *enc_buf, int enc_len,
 	ssl->rbio = rbuf;
 // 	BIO_free( rbio );
 
+	if ( handshake && res > 0 ) {
+		// Send what was queued during the handshake, the
+		// datagram carried no application data
+		sendQueued();
+		num--;
+		mutex.unlock();
+		return -1;
+	}
+
 	if (res <= 0) {
 		int err = SSL_get_error(ssl, res);
 		printf("SSL_read failed: %d err: %d\n", res, err);
@@ -354,10 +364,6 @@ int32_t SSLSession::recv( const void *enc_buf, int enc_len,
 		return res;
 	}
 
-	if (SSL_is_init_finished(ssl)) {
-// 		dtls_send_queued(sock);
-	}
-
 	printf("dtls_recv 2 %d\n", res);
 	num--;
 	mutex.unlock();
@@ -380,6 +386,14 @@ int SSLSession::doSend(const void *buf, int buflen)
 	return res;
 }
 
+void SSLSession::sendQueued()
+{
+	while( !queued.empty() ){
+		doSend( queued.front().data(), (int)queued.front().size() );
+		queued.pop_front();
+	}
+}
+
 int32_t SSLSession::sendDgram(const void *buf, int len) {
 	printf("sendDgram %d\n", len);
 
@@ -397,29 +411,20 @@ int32_t SSLSession::send(const void *buf, int len)
   if (!SSL_is_init_finished( ssl )) {
 	  printf("in init\n");
 
-// 	  SSL_do_handshake( ssl );
-
-// 	  SSL_connect( ssl );
-
-	  // FIXME add to queue
-//       transport_message_t *msg = NULL;
-
-//       if (transport_message_create(&msg, (void*)buf, buflen))
-// 	  return -1;
-
-//       if (osip_fifo_add(sock->out_queue, msg)) {
-// 	  transport_message_free(msg);
-// 	  return -1;
-//       }
+	  // The handshake progresses in recv() as the peer answers,
+	  // keep the message until it is done
+	  if( queued.size() >= DTLS_MAX_QUEUED ){
+		  num--;
+		  mutex.unlock();
+		  return 0;
+	  }
 
+	  queued.push_back( string( (const char*)buf, len ) );
 	  num--;
 	  mutex.unlock();
-	  return 0;
+	  return len;
   }
 
-  // FIXME
-//   dtls_send_queued(sock);
-
   res = doSend( buf, len );
   num--;
   mutex.unlock();
@@ -23,13 +23,18 @@
 #ifndef ODTLSSOCKET_H
 #define ODTLSSOCKET_H
 
+#include<list>
 #include<map>
+#include<string>
 #include<libmcrypto/DtlsSocket.h>
 
 #include <openssl/ssl.h>
 
 class IPAddress;
 
+/* Messages kept while the handshake of a session is in progress */
+#define DTLS_MAX_QUEUED 16
+
 class LIBMCRYPTO_API IPSockAddr : public MObject {
 	public:
 		IPSockAddr( MRef<IPAddress *> addr, int32_t port );
@@ -78,6 +83,9 @@ class LIBMCRYPTO_API SSLSession : public MObject{
 	protected:	
 		virtual int doSend(const void *buf, int buflen);
 
+		/** Sends the messages queued during the handshake */
+		void sendQueued();
+
 	private:
 		MRef<DatagramSocket *> sock;
 		MRef<IPSockAddr *> sa;
@@ -86,6 +94,7 @@ class LIBMCRYPTO_API SSLSession : public MObject{
 		BIO *rbuf;
 		Mutex mutex;
 		int num;
+		std::list<std::string> queued;
 };
 
 class LIBMCRYPTO_API OdtlsSocket : public DTLSSocket {
@@ -0,0 +1,139 @@
+/*
+  Copyright (C) 2005, 2004 Erik Eliasson, Johan Bilien
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include<config.h>
+
+#include<libmcrypto/openssl/TlsSessionCache.h>
+
+#include<time.h>
+
+using namespace std;
+
+OsslSessionCache::OsslSessionCache(): ttl( TLS_SESSION_CACHE_TTL ),
+		tickets( true ), nFull( 0 ), nResumed( 0 ){
+}
+
+void OsslSessionCache::resume( SSL * ssl, const string &peer ){
+	lock.lock();
+	map<string, Entry>::iterator i = sessions.find( peer );
+	if( i != sessions.end() ){
+		if( i->second.expires > time( NULL ) ){
+			/* SSL_set_session takes its own reference */
+			SSL_set_session( ssl, i->second.session );
+		}
+		else{
+			SSL_SESSION_free( i->second.session );
+			sessions.erase( i );
+		}
+	}
+	lock.unlock();
+}
+
+void OsslSessionCache::store( SSL * ssl, const string &peer ){
+	SSL_SESSION * session = SSL_get1_session( ssl );
+
+	if( !session ){
+		return;
+	}
+
+	lock.lock();
+	if( ttl <= 0 ){
+		lock.unlock();
+		SSL_SESSION_free( session );
+		return;
+	}
+
+	map<string, Entry>::iterator i = sessions.find( peer );
+	if( i != sessions.end() ){
+		SSL_SESSION_free( i->second.session );
+	}
+	else if( sessions.size() >= TLS_SESSION_CACHE_MAX ){
+		dropOldest();
+	}
+
+	Entry &entry = sessions[ peer ];
+	entry.session = session;
+	entry.expires = time( NULL ) + ttl;
+	lock.unlock();
+}
+
+void OsslSessionCache::remove( const string &peer ){
+	lock.lock();
+	map<string, Entry>::iterator i = sessions.find( peer );
+	if( i != sessions.end() ){
+		SSL_SESSION_free( i->second.session );
+		sessions.erase( i );
+	}
+	lock.unlock();
+}
+
+void OsslSessionCache::dropOldest(){
+	map<string, Entry>::iterator i;
+	map<string, Entry>::iterator oldest = sessions.end();
+
+	for( i = sessions.begin(); i != sessions.end(); i++ ){
+		if( oldest == sessions.end() ||
+		    i->second.expires < oldest->second.expires ){
+			oldest = i;
+		}
+	}
+
+	if( oldest != sessions.end() ){
+		SSL_SESSION_free( oldest->second.session );
+		sessions.erase( oldest );
+	}
+}
+
+void OsslSessionCache::countHandshake( SSL * ssl ){
+	lock.lock();
+	if( SSL_session_reused( ssl ) ){
+		nResumed++;
+	}
+	else{
+		nFull++;
+	}
+	lock.unlock();
+}
+
+void OsslSessionCache::setTtl( int seconds ){
+	lock.lock();
+	ttl = seconds;
+	if( ttl <= 0 ){
+		map<string, Entry>::iterator i;
+		for( i = sessions.begin(); i != sessions.end(); i++ ){
+			SSL_SESSION_free( i->second.session );
+		}
+		sessions.clear();
+	}
+	lock.unlock();
+}
+
+void OsslSessionCache::setTicketsEnabled( bool enabled ){
+	lock.lock();
+	tickets = enabled;
+	lock.unlock();
+}
+
+bool OsslSessionCache::getTicketsEnabled(){
+	bool enabled;
+
+	lock.lock();
+	enabled = tickets;
+	lock.unlock();
+	return enabled;
+}
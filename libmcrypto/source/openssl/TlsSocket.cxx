@@ -24,6 +24,7 @@
 #include<config.h>
 
 #include<libmcrypto/openssl/TlsSocket.h>
+#include<libmcrypto/openssl/TlsSessionCache.h>
 #include<libmcrypto/openssl/cert.h>
 
 #include <openssl/crypto.h>
@@ -39,16 +40,191 @@
 #include<sys/socket.h>
 #endif
 
+#ifndef WIN32
+#include<poll.h>
+#endif
+
 #include<libmnetutil/IPAddress.h>
 
 #include<iostream>
+#include<list>
 
 #include<libmcrypto/TlsException.h>
 #include<libmcrypto/openssl/TlsException.h>
 #include<libmutil/MemObject.h>
+#include<libmutil/Mutex.h>
+#include<libmutil/CriticalSection.h>
+#include<libmutil/mtime.h>
+#include<libmutil/stringutils.h>
 
 using namespace std;
 
+/* Client contexts, shared by the connections using the same
+ * certificate and CA db. A context is freed when the last connection
+ * using it is closed */
+struct OsslClientContext{
+	MRef<OsslCertificate *> cert;
+	MRef<OsslCertificateSet *> cert_db;
+	SSL_CTX * ssl_ctx;
+	int users;
+};
+
+static Mutex clientContextsLock;
+static list<OsslClientContext> clientContexts;
+
+/* Longest single wait for the socket. Another thread may consume the
+ * input a waiting writer is interested in, so it looks again often */
+#define TLS_WAIT_SLICE 100
+
+static void waitForSocket( int32_t fd, bool write, uint64_t ms ){
+	if( ms > TLS_WAIT_SLICE )
+		ms = TLS_WAIT_SLICE;
+
+#ifdef WIN32
+	fd_set set;
+	struct timeval timeout;
+
+	FD_ZERO( &set );
+	FD_SET( fd, &set );
+	timeout.tv_sec = 0;
+	timeout.tv_usec = (long)ms * 1000;
+
+	select( fd + 1, write ? NULL : &set, write ? &set : NULL,
+		NULL, &timeout );
+#else
+	struct pollfd pfd;
+
+	pfd.fd = fd;
+	pfd.events = write ? POLLOUT : POLLIN;
+	pfd.revents = 0;
+	poll( &pfd, 1, (int)ms );
+#endif
+}
+
+static SSL_CTX * createClientContext( MRef<OsslCertificate *> ssl_cert,
+				      MRef<OsslCertificateSet *> ssl_db ){
+	const unsigned char * sid_ctx = (const unsigned char *)"Minisip TLS";
+	SSL_METHOD *meth = SSLv23_client_method();
+	SSL_CTX * ssl_ctx;
+
+#ifdef DEBUG_OUTPUT
+	cerr << "Creating new SSL_CTX" << endl;
+#endif
+	ssl_ctx = SSL_CTX_new( meth );
+	
+	if( ssl_ctx == NULL ){
+		cerr << "Could not create SSL session" << endl;
+		ERR_print_errors_fp(stderr);
+		throw TLSInitFailed();
+	}
+	
+	if( OsslSocket::sslCipherListIndex != 0 ) 
+		OsslSocket::setSSLCTXCiphers ( ssl_ctx, OsslSocket::sslCipherListIndex );
+	/* Set options: do not accept SSLv2*/
+	long options = SSL_OP_NO_SSLv2 | SSL_OP_ALL;
+	
+#if OPENSSL_VERSION_NUMBER >= 0x00908000
+	// Disable SSL_OP_TLS_BLOCK_PADDING_BUG in 0.9.8, buggy
+	options &= ~SSL_OP_TLS_BLOCK_PADDING_BUG;
+#endif
+	SSL_CTX_set_options(ssl_ctx, options);
+	
+	SSL_CTX_set_verify( ssl_ctx, SSL_VERIFY_PEER | SSL_VERIFY_CLIENT_ONCE, 0);
+	SSL_CTX_set_verify_depth( ssl_ctx, 5);
+
+	if( !ssl_cert.isNull() ){
+		/* Add a client Certificate */
+		MRef<PrivateKey*> pk = ssl_cert->getPk();
+		MRef<OsslPrivateKey*> ssl_pk =
+			dynamic_cast<OsslPrivateKey*>(*pk);
+
+		if( !ssl_pk || SSL_CTX_use_PrivateKey( ssl_ctx, 
+		ssl_pk->getOpensslPrivateKey() ) <= 0 ){
+			cerr << "SSL: Could not use private key" << endl;
+			ERR_print_errors_fp(stderr);
+			SSL_CTX_free( ssl_ctx );
+			throw TLSContextInitFailed(); 
+		}
+		if( SSL_CTX_use_certificate( ssl_ctx,
+		ssl_cert->getOpensslCertificate() ) <= 0 ){
+			cerr << "SSL: Could not use Certificate" << endl;
+			ERR_print_errors_fp(stderr);
+			SSL_CTX_free( ssl_ctx );
+			throw TLSContextInitFailed(); 
+		}
+	}
+
+	if( !ssl_db.isNull() ){
+		/* Use this database for the Certificates check */
+		SSL_CTX_set_cert_store( ssl_ctx, 
+					ssl_db->getDb());
+	}
+
+	/* Client sessions are kept per peer by OsslSessionCache,
+	 * OpenSSL never looks up its internal client cache */
+	SSL_CTX_set_session_cache_mode( ssl_ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE );
+	SSL_CTX_set_session_id_context( ssl_ctx, sid_ctx, (unsigned int)strlen( (const char *)sid_ctx ) );
+
+	return ssl_ctx;
+}
+
+/* Returns the context shared by the connections using cert and
+ * cert_db, created by the first of them. The lookup and the insertion
+ * are done under the same lock, concurrent connects share one
+ * context */
+static SSL_CTX * acquireClientContext( MRef<OsslCertificate *> cert,
+				       MRef<OsslCertificateSet *> cert_db ){
+	list<OsslClientContext>::iterator i;
+	SSL_CTX * ssl_ctx = NULL;
+
+	clientContextsLock.lock();
+	for( i = clientContexts.begin(); i != clientContexts.end(); i++ ){
+		if( *i->cert == *cert && *i->cert_db == *cert_db ){
+			i->users++;
+			ssl_ctx = i->ssl_ctx;
+			break;
+		}
+	}
+
+	if( !ssl_ctx ){
+		try{
+			ssl_ctx = createClientContext( cert, cert_db );
+		}
+		catch( ... ){
+			clientContextsLock.unlock();
+			throw;
+		}
+
+		OsslClientContext context;
+		context.cert = cert;
+		context.cert_db = cert_db;
+		context.ssl_ctx = ssl_ctx;
+		context.users = 1;
+		clientContexts.push_back( context );
+	}
+	clientContextsLock.unlock();
+
+	return ssl_ctx;
+}
+
+/* Frees the context when its last connection is closed. The SSL
+ * objects hold their own reference, SSL_CTX_free only drops ours */
+static void releaseClientContext( SSL_CTX * ssl_ctx ){
+	list<OsslClientContext>::iterator i;
+
+	clientContextsLock.lock();
+	for( i = clientContexts.begin(); i != clientContexts.end(); i++ ){
+		if( i->ssl_ctx == ssl_ctx ){
+			if( --i->users == 0 ){
+				SSL_CTX_free( ssl_ctx );
+				clientContexts.erase( i );
+			}
+			break;
+		}
+	}
+	clientContextsLock.unlock();
+}
+
 TLSSocket::TLSSocket()
 {
 }
@@ -72,7 +248,17 @@ TLSSocket* TLSSocket::connect( MRef<StreamSocket*> ssock,
 	if( cert_db )
 		ssl_db = (OsslCertificateSet*)*cert_db;
 
-	return new OsslSocket( ssock, ssl_ctx, ssl_cert, ssl_db );
+	return new OsslSocket( ssock, ssl_ctx, ssl_cert, ssl_db, serverName );
+}
+
+void TLSSocket::setSessionCache( int ttl, bool tickets ){
+	OsslSessionCache::getInstance()->setTtl( ttl );
+	OsslSessionCache::getInstance()->setTicketsEnabled( tickets );
+}
+
+void TLSSocket::getHandshakeCounts( uint64_t &full, uint64_t &resumed ){
+	full = OsslSessionCache::getInstance()->getFullHandshakes();
+	resumed = OsslSessionCache::getInstance()->getResumedHandshakes();
 }
 
 
@@ -85,12 +271,12 @@ int8_t OsslSocket::sslCipherListIndex = 0; /* Set default value ... DEFAULT ciph
 
 // When created by a TLS Server
 OsslSocket::OsslSocket( MRef<StreamSocket *> tcp_socket, SSL_CTX * ssl_ctx_ ):
-		sock(tcp_socket){
+		sock(tcp_socket), sharedContext( false ), handshakeDone( false ),
+		waitWrite( false ){
 	type = MSOCKET_TYPE_TLS;
 	peerPort = tcp_socket->getPeerPort();
 	peerAddress = tcp_socket->getPeerAddress()->clone();
 
-	int error;
 	// Copy the SSL parameters, since the server still needs them
 	// Initialize ssl in priv
 	priv = SSL_new( ssl_ctx_ );
@@ -98,30 +284,29 @@ OsslSocket::OsslSocket( MRef<StreamSocket *> tcp_socket, SSL_CTX * ssl_ctx_ ):
 
 	SSL_set_fd( ssl, tcp_socket->getFd() );
 	fd = tcp_socket->getFd();
-	
-	error = SSL_accept( ssl );
-	if( error <= 0 ){
-		cerr << "Could not establish an incoming TLS connection" << endl;
-		ERR_print_errors_fp(stderr);
-		throw TLSConnectFailed( error, ssl );
-	}
+
+	// The handshake is driven by read(), called from the
+	// SocketServer each time the peer has sent something
+	tcp_socket->setNonBlocking();
+	SSL_set_accept_state( ssl );
 }
 
 
 OsslSocket::OsslSocket( MRef<StreamSocket*> ssock, void * &ssl_ctx_,
 			      MRef<OsslCertificate *> cert, 
-			      MRef<OsslCertificateSet *> cert_db_ ){
-	OsslSocket::OsslSocket_init( ssock, ssl_ctx_, cert, cert_db_);
+			      MRef<OsslCertificateSet *> cert_db_,
+			      const string &serverName ):
+		handshakeDone( false ), waitWrite( false ){
+	OsslSocket::OsslSocket_init( ssock, ssl_ctx_, cert, cert_db_, serverName );
 }
 
 /* Helper function ... simplify the maintenance of constructors ... */
 void OsslSocket::OsslSocket_init( MRef<StreamSocket*> ssock, void * &ssl_ctx_,
 					MRef<OsslCertificate *> cert,
-					MRef<OsslCertificateSet *> cert_db_ ){
+					MRef<OsslCertificateSet *> cert_db_,
+					const string &serverName ){
 	type = MSOCKET_TYPE_TLS;
-	const unsigned char * sid_ctx = (const unsigned char *)"Minisip TLS";
 	SSLeay_add_ssl_algorithms();
-	SSL_METHOD *meth = SSLv23_client_method();
 	this->ssl_ctx = (SSL_CTX *)ssl_ctx_;
 	this->cert_db = cert_db_;
 	peerPort = ssock->getPeerPort();
@@ -134,63 +319,11 @@ void OsslSocket::OsslSocket_init( MRef<StreamSocket*> ssock, void * &ssl_ctx_,
 	if( cert_db )
 		ssl_db = (OsslCertificateSet*)*cert_db;
 
+	sharedContext = false;
 	if( this->ssl_ctx == NULL ){
-#ifdef DEBUG_OUTPUT
-		cerr << "Creating new SSL_CTX" << endl;
-#endif
-		this->ssl_ctx = SSL_CTX_new( meth );
-		
-		if( this->ssl_ctx == NULL ){
-			cerr << "Could not create SSL session" << endl;
-			ERR_print_errors_fp(stderr);
-			throw TLSInitFailed();
-		}
-		
-		if( sslCipherListIndex != 0 ) 
-			setSSLCTXCiphers ( this->ssl_ctx, sslCipherListIndex );
-		/* Set options: do not accept SSLv2*/
-		long options = SSL_OP_NO_SSLv2 | SSL_OP_ALL;
-		
-#if OPENSSL_VERSION_NUMBER >= 0x00908000
-		// Disable SSL_OP_TLS_BLOCK_PADDING_BUG in 0.9.8, buggy
-		options &= ~SSL_OP_TLS_BLOCK_PADDING_BUG;
-#endif
-		SSL_CTX_set_options(this->ssl_ctx, options);
-		
-		SSL_CTX_set_verify( this->ssl_ctx, SSL_VERIFY_PEER | SSL_VERIFY_CLIENT_ONCE, 0);
-		SSL_CTX_set_verify_depth( this->ssl_ctx, 5);
-
-		if( !cert.isNull() ){
-			/* Add a client Certificate */
-			MRef<PrivateKey*> pk = ssl_cert->getPk();
-			MRef<OsslPrivateKey*> ssl_pk =
-				dynamic_cast<OsslPrivateKey*>(*pk);
-
-			if( !ssl_pk || SSL_CTX_use_PrivateKey( this->ssl_ctx, 
-			ssl_pk->getOpensslPrivateKey() ) <= 0 ){
-				cerr << "SSL: Could not use private key" << endl;
-				ERR_print_errors_fp(stderr);
-				throw TLSContextInitFailed(); 
-			}
-			if( SSL_CTX_use_certificate( this->ssl_ctx,
-			ssl_cert->getOpensslCertificate() ) <= 0 ){
-				cerr << "SSL: Could not use Certificate" << endl;
-				ERR_print_errors_fp(stderr);
-				throw TLSContextInitFailed(); 
-			}
-		}
-
-		if( !cert_db.isNull() ){
-			/* Use this database for the Certificates check */
-			SSL_CTX_set_cert_store( this->ssl_ctx, 
-						ssl_db->getDb());
-		}
-
-		//SSL_CTX_set_session_cache_mode( this->ssl_ctx, SSL_SESS_CACHE_BOTH );
-		SSL_CTX_set_session_cache_mode( this->ssl_ctx, SSL_SESS_CACHE_SERVER );
-		SSL_CTX_set_session_id_context( this->ssl_ctx, sid_ctx, (unsigned int)strlen( (const char *)sid_ctx ) );
-		
-		ssl_ctx = this->ssl_ctx;
+		this->ssl_ctx = acquireClientContext( ssl_cert, ssl_db );
+		sharedContext = true;
+		ssl_ctx_ = this->ssl_ctx;
 	}
 	
 	sock = ssock;
@@ -198,10 +331,20 @@ void OsslSocket::OsslSocket_init( MRef<StreamSocket*> ssock, void * &ssl_ctx_,
 
 	// Initialize ssl in priv
 	priv = SSL_new( this->ssl_ctx );
-	
-	//FIXME ... this client side cache works?? only if only one host to connect to
-	if( this->ssl_ctx->session_cache_head != NULL )
-		SSL_set_session( ssl, this->ssl_ctx->session_cache_head );
+
+#ifdef SSL_set_tlsext_host_name
+	if( !serverName.empty() )
+		SSL_set_tlsext_host_name( ssl, serverName.c_str() );
+#endif
+
+	sessionCache = OsslSessionCache::getInstance();
+#ifdef SSL_OP_NO_TICKET
+	if( !sessionCache->getTicketsEnabled() )
+		SSL_set_options( ssl, SSL_OP_NO_TICKET );
+#endif
+
+	sessionPeer = peerAddress->getString() + ":" + itoa( peerPort ) + "/" + serverName;
+	sessionCache->resume( ssl, sessionPeer );
 	
 	//SSL_set_verify( this->ssl, SSL_VERIFY_PEER, NULL );
 
@@ -209,14 +352,47 @@ void OsslSocket::OsslSocket_init( MRef<StreamSocket*> ssock, void * &ssl_ctx_,
 	// FIXME
 	fd = sock->getFd();
 
-	int32_t err = SSL_connect( ssl );
+	// Non-blocking like the server side, a peer that stops
+	// answering fails the connect after TLS_HANDSHAKE_TIMEOUT
+	sock->setNonBlocking();
+	SSL_set_connect_state( ssl );
 
-	if( err <= 0 ){
-		cerr << "SSL: connect failed" << endl;
-		ERR_print_errors_fp(stderr);
-		throw TLSConnectFailed( err, ssl );
+	uint64_t start = mtime();
+	int32_t err;
+
+	while( ( err = doHandshake() ) <= 0 ){
+		uint64_t elapsed = mtime() - start;
+
+		if( !needsRetry( err ) || elapsed >= TLS_HANDSHAKE_TIMEOUT ){
+			cerr << "SSL: connect failed" << endl;
+			ERR_print_errors_fp(stderr);
+			sessionCache->remove( sessionPeer );
+			if( sharedContext )
+				releaseClientContext( this->ssl_ctx );
+			throw TLSConnectFailed( err, ssl );
+		}
+
+		waitForSocket( fd, waitWrite, TLS_HANDSHAKE_TIMEOUT - elapsed );
+	}
+}
+
+int32_t OsslSocket::doHandshake(){
+	int32_t ret = SSL_do_handshake( ssl );
+
+	if( ret <= 0 )
+		return ret;
+
+	handshakeDone = true;
+	waitWrite = false;
+
+	if( sessionPeer.empty() ){
+		// Server side
+		return ret;
 	}
 
+	sessionCache->countHandshake( ssl );
+	sessionCache->store( ssl, sessionPeer );
+
 	try{
 		peer_cert = new OsslCertificate( SSL_get_peer_certificate (ssl) );
 	}
@@ -225,7 +401,25 @@ void OsslSocket::OsslSocket_init( MRef<StreamSocket*> ssock, void * &ssl_ctx_,
 		cerr << "Could not get server Certificate" << endl;
 		peer_cert = NULL;
 	}
-	
+
+	return ret;
+}
+
+bool OsslSocket::needsRetry( int32_t ret ){
+	switch( SSL_get_error( ssl, ret ) ){
+		case SSL_ERROR_WANT_READ:
+			waitWrite = false;
+			return true;
+		case SSL_ERROR_WANT_WRITE:
+			waitWrite = true;
+			return true;
+		default:
+			return false;
+	}
+}
+
+bool OsslSocket::wantsWrite(){
+	return waitWrite;
 }
 
 
@@ -233,19 +427,71 @@ OsslSocket::~OsslSocket(){
 #ifdef DEBUG_OUTPUT
 	cerr << "TLS: Shutting down TLS Socket" << endl;
 #endif	
-	SSL_shutdown( ssl );
+	/* With TLS 1.3 the resumable session may only arrive after
+	 * the handshake */
+	if( !sessionPeer.empty() && handshakeDone )
+		sessionCache->store( ssl, sessionPeer );
+	if( handshakeDone && fd != -1 )
+		SSL_shutdown( ssl );
 	SSL_free( ssl );
-	//SSL_CTX_free( ssl_ctx );
+	if( sharedContext )
+		releaseClientContext( ssl_ctx );
+	// The descriptor is closed by sock, it may already have
+	// been reused by another connection
+	fd = -1;
 	//delete tcp_socket;
 	//delete peerAddress;
 }
 
+void OsslSocket::close(){
+	sock->close();
+	fd = -1;
+}
+
 int32_t OsslSocket::write( string data ){
-	return SSL_write( ssl, data.c_str(), (int)data.length() );
+	return write( data.c_str(), (int32_t)data.length() );
 }
 
 int32_t OsslSocket::write( const void *buf, int32_t count ){
-	return SSL_write( ssl, buf, count );
+	uint64_t start = mtime();
+
+	for(;;){
+		int32_t ret;
+		bool forWrite;
+
+		sslLock.lock();
+		if( !handshakeDone ){
+			ret = doHandshake();
+		}
+		else{
+			// Retried with the same arguments, as OpenSSL
+			// requires after WANT_WRITE
+			ret = SSL_write( ssl, buf, count );
+			if( ret > 0 ){
+				sslLock.unlock();
+				return ret;
+			}
+		}
+
+		if( ret > 0 ){
+			// Handshake done, write the data
+			sslLock.unlock();
+			continue;
+		}
+
+		if( !needsRetry( ret ) ){
+			sslLock.unlock();
+			return -1;
+		}
+		forWrite = waitWrite;
+		sslLock.unlock();
+
+		uint64_t elapsed = mtime() - start;
+		if( elapsed >= TLS_HANDSHAKE_TIMEOUT ){
+			return -1;
+		}
+		waitForSocket( fd, forWrite, TLS_HANDSHAKE_TIMEOUT - elapsed );
+	}
 }
 
 OsslSocket& operator<<(OsslSocket& sock, string str){
@@ -254,19 +500,33 @@ OsslSocket& operator<<(OsslSocket& sock, string str){
 }
 
 int32_t OsslSocket::read( void *buf, int32_t count ){
-	//if( SSL_pending( ssl ) == 0 )
-	//	return -1;
+	CriticalSection cs( sslLock );
 	int ret;
-	ret = SSL_read( ssl, buf, count );
-	if( ret == 0 )
-//		if( SSL_get_error( ssl, ret ) == SSL_ERROR_ZERO_RETURN )
-			// Connection closed
+
+	if( !handshakeDone ){
+		ret = doHandshake();
+		if( ret <= 0 ){
+			if( needsRetry( ret ) )
+				return -1;
+
+			cerr << "Could not establish an incoming TLS connection" << endl;
+			ERR_print_errors_fp(stderr);
 			return 0;
-	
-//		else
-//			return -1;
-	else 
+		}
+	}
+
+	ret = SSL_read( ssl, buf, count );
+	if( ret > 0 ){
+		waitWrite = false;
 		return ret;
+	}
+
+	if( needsRetry( ret ) )
+		// Nothing more until the peer sends again
+		return -1;
+
+	// Connection closed, or broken
+	return 0;
 }
 
 int32_t OsslSocket::setSSLCTXCiphers ( SSL_CTX *_ctx, int8_t listIdx ) {
@@ -58,6 +58,63 @@ static string NAME_to_string( X509_NAME * x509Name ){
 	return ret;
 }
 
+static bool parseDigits( const unsigned char * s, int n, int &value ){
+	value = 0;
+	for( int i = 0; i < n; i++ ){
+		if( s[i] < '0' || s[i] > '9' ){
+			return false;
+		}
+		value = value * 10 + s[i] - '0';
+	}
+	return true;
+}
+
+/* UTCTime (YYMMDDHHMMSSZ) or GeneralizedTime (YYYYMMDDHHMMSSZ), the
+ * forms allowed by RFC 5280, to seconds since the epoch */
+static time_t ASN1_TIME_to_time( ASN1_TIME * t ){
+	const unsigned char * s = ASN1_STRING_data( t );
+	int length = ASN1_STRING_length( t );
+	int year, month, day, hour, minute, second;
+
+	if( ASN1_STRING_type( t ) == V_ASN1_UTCTIME ){
+		if( length < 13 || !parseDigits( s, 2, year ) ){
+			return 0;
+		}
+		year += year < 50 ? 2000 : 1900;
+		s += 2;
+	}
+	else if( ASN1_STRING_type( t ) == V_ASN1_GENERALIZEDTIME ){
+		if( length < 15 || !parseDigits( s, 4, year ) ){
+			return 0;
+		}
+		s += 4;
+	}
+	else{
+		return 0;
+	}
+
+	if( !parseDigits( s, 2, month ) || !parseDigits( s + 2, 2, day ) ||
+	    !parseDigits( s + 4, 2, hour ) || !parseDigits( s + 6, 2, minute ) ||
+	    !parseDigits( s + 8, 2, second ) || s[10] != 'Z' ){
+		return 0;
+	}
+
+	/* Days since 1970-01-01 of the proleptic Gregorian calendar,
+	 * counting years from March so that leap days come last */
+	if( month <= 2 ){
+		year--;
+		month += 12;
+	}
+	int64_t days = 365 * (int64_t)year + year / 4 - year / 100 + year / 400 +
+		( 153 * ( month - 3 ) + 2 ) / 5 + day - 719469;
+	int64_t seconds = days * 86400 + hour * 3600 + minute * 60 + second;
+
+	if( sizeof( time_t ) < 8 && seconds > 0x7fffffff ){
+		seconds = 0x7fffffff;
+	}
+	return (time_t)seconds;
+}
+
 
 //
 // Factory methods
@@ -615,6 +672,10 @@ string OsslCertificate::getIssuerCn(){
 	return name.substr( pos + 4, pos2 - pos - 4 );
 }
 
+time_t OsslCertificate::getNotAfter(){
+	return ASN1_TIME_to_time( X509_get_notAfter( cert ) );
+}
+
 
 OsslPrivateKey::OsslPrivateKey( const string &file ){
 	FILE * fp = NULL;
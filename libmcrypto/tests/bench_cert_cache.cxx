@@ -0,0 +1,120 @@
+/*
+ * Benchmark of the certificate chain cache.
+ *
+ * Verifies the chain a MIKEY-PKE peer presents at each call setup,
+ * a leaf certificate issued by a trusted CA, 1000 times with the
+ * cache disabled and enabled. A chain from an untrusted issuer is
+ * verified the same way, to time rejected setups. Prints the setups
+ * per second and the hits and misses of the cache.
+ */
+
+#include<libmcrypto/CertificateChainCache.h>
+#include<libmcrypto/cert.h>
+#include<libmutil/mtime.h>
+
+#include<stdio.h>
+#include<stdlib.h>
+
+#define BENCH_SETUPS 1000
+
+static const char caPem[] =
+	"-----BEGIN CERTIFICATE-----\n"
+	"MIIBjDCCATGgAwIBAgIUBk/hMxmcpEUSm7Hf+iblAEDuZ0owCgYIKoZIzj0EAwIw\n"
+	"GjEYMBYGA1UEAwwPbWluaXNpcC10ZXN0LWNhMCAXDTI2MTAxOTA4NTQyOVoYDzIx\n"
+	"MjYwOTI1MDg1NDI5WjAaMRgwFgYDVQQDDA9taW5pc2lwLXRlc3QtY2EwWTATBgcq\n"
+	"hkjOPQIBBggqhkjOPQMBBwNCAASMHJ2ThD3iUi8OFncSUrSXcV1wNN/Kb4vQ+ZMN\n"
+	"DirEimgPIXGAUXdXhgT7M1q4D0WJ8aaEueiB0sMxXiWmBKEXo1MwUTAdBgNVHQ4E\n"
+	"FgQUopoehLOnYR1bD1j99qf3uTQqegIwHwYDVR0jBBgwFoAUopoehLOnYR1bD1j9\n"
+	"9qf3uTQqegIwDwYDVR0TAQH/BAUwAwEB/zAKBggqhkjOPQQDAgNJADBGAiEAmi8m\n"
+	"R8rkyx/yoCEN0nAll/o17NMru9tgtaKSFnlmG0ECIQDyvwyiSi6LwFHhi8nYdAjr\n"
+	"aDL6rsutEK7iGBsrlrvyMg==\n"
+	"-----END CERTIFICATE-----\n";
+
+static const char leafPem[] =
+	"-----BEGIN CERTIFICATE-----\n"
+	"MIIBmjCCAUCgAwIBAgIUT8rcZ2dGd8tgNiFVEk9MJMz4tQgwCgYIKoZIzj0EAwIw\n"
+	"GjEYMBYGA1UEAwwPbWluaXNpcC10ZXN0LWNhMCAXDTI2MTAxOTA4NTQzMFoYDzIx\n"
+	"MjYwOTI1MDg1NDMwWjAYMRYwFAYDVQQDDA1hbGljZS5leGFtcGxlMFkwEwYHKoZI\n"
+	"zj0CAQYIKoZIzj0DAQcDQgAEB/AnqzgNEBGOVk5czm8l2ImhLO7EPL8uMUrnMrT5\n"
+	"rZGJ0xi78LqFn6k0dSM5WyzCxJcM5A4LpW1RP5TrYNorL6NkMGIwIAYDVR0RBBkw\n"
+	"F4YVc2lwOmFsaWNlQGV4YW1wbGUuY29tMB0GA1UdDgQWBBRmTQigWbTKvilx34pv\n"
+	"gHs1WqN5ODAfBgNVHSMEGDAWgBSimh6Es6dhHVsPWP32p/e5NCp6AjAKBggqhkjO\n"
+	"PQQDAgNIADBFAiEA0Eh6vzcwfndUu4zf/X+H+Dq/o8rfBS1HuPRiLxKKRg4CIA/J\n"
+	"ZN+n+LDmE/hftsaI5lpy59lVg/PWUcjw5FluDw+9\n"
+	"-----END CERTIFICATE-----\n";
+
+static const char roguePem[] =
+	"-----BEGIN CERTIFICATE-----\n"
+	"MIIBizCCATGgAwIBAgIUEHMQFSWiafICR1poTdUNtWQTl1cwCgYIKoZIzj0EAwIw\n"
+	"GjEYMBYGA1UEAwwPbWFsbG9yeS5leGFtcGxlMCAXDTI2MTAxOTA4NTQzMFoYDzIx\n"
+	"MjYwOTI1MDg1NDMwWjAaMRgwFgYDVQQDDA9tYWxsb3J5LmV4YW1wbGUwWTATBgcq\n"
+	"hkjOPQIBBggqhkjOPQMBBwNCAAQH8CerOA0QEY5WTlzObyXYiaEs7sQ8vy4xSucy\n"
+	"tPmtkYnTGLvwuoWfqTR1IzlbLMLElwzkDgulbVE/lOtg2isvo1MwUTAdBgNVHQ4E\n"
+	"FgQUZk0IoFm0yr4pcd+Kb4B7NVqjeTgwHwYDVR0jBBgwFoAUZk0IoFm0yr4pcd+K\n"
+	"b4B7NVqjeTgwDwYDVR0TAQH/BAUwAwEB/zAKBggqhkjOPQQDAgNIADBFAiEAwZXP\n"
+	"OHxAK7oRA5D3LF8Lr7wCczwyurVFIL5Yv9LOkucCIBf25GCzvQ3vdzPkzeWDRc8w\n"
+	"VY5XQz/74VHWos+lsJAU\n"
+	"-----END CERTIFICATE-----\n";
+
+static MRef<Certificate*> load( const char *name, const char *pem ){
+	FILE *f = fopen( name, "w" );
+
+	if( !f ){
+		fprintf( stderr, "Could not write %s\n", name );
+		exit( 1 );
+	}
+	fputs( pem, f );
+	fclose( f );
+
+	MRef<Certificate*> cert = Certificate::load( name );
+	remove( name );
+	return cert;
+}
+
+static void run( const char * name, MRef<Certificate*> peer,
+		MRef<CertificateSet*> cas, int expected ){
+	MRef<CertificateChainCache*> cache = CertificateChainCache::getInstance();
+	uint64_t hits0 = cache->getHits();
+	uint64_t misses0 = cache->getMisses();
+
+	uint64_t start = mtime();
+	for( int i = 0; i < BENCH_SETUPS; i++ ){
+		/* A new chain per call, as parsed from the MIKEY message */
+		MRef<CertificateChain*> chain = CertificateChain::create();
+		chain->addCertificate( peer );
+
+		if( cache->control( chain, cas ) != expected ){
+			fprintf( stderr, "%s: unexpected verification result\n", name );
+			exit( 1 );
+		}
+	}
+	uint64_t ms = mtime() - start;
+	if( ms == 0 ){
+		ms = 1;
+	}
+
+	printf( "%-22s %10.1f setups/s   hits: %5llu  misses: %5llu\n",
+		name, BENCH_SETUPS * 1000.0 / ms,
+		(unsigned long long)( cache->getHits() - hits0 ),
+		(unsigned long long)( cache->getMisses() - misses0 ) );
+}
+
+int main( int argc, char *argv[] ){
+	MRef<Certificate*> ca = load( "bench_cert_cache.ca.pem", caPem );
+	MRef<Certificate*> leaf = load( "bench_cert_cache.leaf.pem", leafPem );
+	MRef<Certificate*> rogue = load( "bench_cert_cache.rogue.pem", roguePem );
+	MRef<CertificateSet*> cas = CertificateSet::create();
+	cas->addCertificate( ca );
+
+	MRef<CertificateChainCache*> cache = CertificateChainCache::getInstance();
+
+	cache->setMaxAge( 0 );
+	run( "trusted, no cache", leaf, cas, 1 );
+	run( "untrusted, no cache", rogue, cas, 0 );
+
+	cache->setMaxAge( CERT_CHAIN_CACHE_MAX_AGE );
+	run( "trusted, cache", leaf, cas, 1 );
+	run( "untrusted, cache", rogue, cas, 0 );
+
+	return 0;
+}
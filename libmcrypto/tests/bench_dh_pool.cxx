@@ -0,0 +1,107 @@
+/*
+ * Benchmark of the Diffie-Hellman key pool.
+ *
+ * Runs a burst of secured call setups, each doing the key agreement
+ * of both ends (a key pair per end and the shared secret), for
+ * MIKEY-DH (Oakley group 5) and ZRTP (DH3072). Prints the setups per
+ * second with key pairs generated inline and taken from a filled pool.
+ */
+
+#include<libmcrypto/DhKeyPool.h>
+#include<libmcrypto/OakleyDH.h>
+#include<libmcrypto/ZrtpDH.h>
+#include<libmutil/Thread.h>
+#include<libmutil/mtime.h>
+
+#include<stdio.h>
+#include<stdlib.h>
+
+#define BENCH_SETUPS 20
+
+static bool mikeySetup( MRef<DhKeyPool*> pool ){
+	OakleyDH * a = pool->takeOakleyDH( DH_GROUP_OAKLEY5 );
+	OakleyDH * b = pool->takeOakleyDH( DH_GROUP_OAKLEY5 );
+	bool ok = false;
+
+	if( a && b ){
+		uint8_t pubA[512], pubB[512];
+		uint8_t secretA[512], secretB[512];
+		uint32_t lenA = a->getPublicKey( pubA, sizeof( pubA ) );
+		uint32_t lenB = b->getPublicKey( pubB, sizeof( pubB ) );
+
+		ok = a->computeSecret( pubB, lenB, secretA, sizeof( secretA ) ) == 0 &&
+			b->computeSecret( pubA, lenA, secretB, sizeof( secretB ) ) == 0;
+	}
+	delete a;
+	delete b;
+	return ok;
+}
+
+static bool zrtpSetup( MRef<DhKeyPool*> pool ){
+	ZrtpDH * a = pool->takeZrtpDH( DH_POOL_ZRTP3072 );
+	ZrtpDH * b = pool->takeZrtpDH( DH_POOL_ZRTP3072 );
+	bool ok = false;
+
+	if( a && b ){
+		uint8_t pubA[512], pubB[512];
+		uint8_t secretA[512], secretB[512];
+		int32_t lenA = a->getPubKeyBytes( pubA );
+		int32_t lenB = b->getPubKeyBytes( pubB );
+
+		ok = a->computeKey( pubB, lenB, secretA ) > 0 &&
+			b->computeKey( pubA, lenA, secretB ) > 0;
+	}
+	delete a;
+	delete b;
+	return ok;
+}
+
+static double bench( MRef<DhKeyPool*> pool,
+		bool (*setup)( MRef<DhKeyPool*> ) ){
+	uint64_t start = mtime();
+	for( int i = 0; i < BENCH_SETUPS; i++ ){
+		if( !setup( pool ) ){
+			fprintf( stderr, "Key agreement failed\n" );
+			exit( 1 );
+		}
+	}
+	uint64_t ms = mtime() - start;
+	if( ms == 0 ){
+		ms = 1;
+	}
+	return BENCH_SETUPS * 1000.0 / ms;
+}
+
+static void run( const char * name, int poolId,
+		bool (*setup)( MRef<DhKeyPool*> ) ){
+	MRef<DhKeyPool*> pool = DhKeyPool::getInstance();
+
+	pool->setPoolSize( poolId, 0 );
+	double inlineRate = bench( pool, setup );
+
+	/* Two key pairs per setup, wait for the whole burst */
+	pool->setPoolSize( poolId, 2 * BENCH_SETUPS );
+	while( pool->getAvailable( poolId ) < 2 * BENCH_SETUPS ){
+		Thread::msleep( 10 );
+	}
+	double pooledRate = bench( pool, setup );
+	pool->setPoolSize( poolId, 0 );
+
+	printf( "%-10s inline: %8.1f setups/s   pooled: %8.1f setups/s\n",
+		name, inlineRate, pooledRate );
+}
+
+int main( int argc, char *argv[] ){
+	MRef<DhKeyPool*> pool = DhKeyPool::getInstance();
+	pool->start();
+
+	run( "MIKEY-DH", DH_GROUP_OAKLEY5, mikeySetup );
+	run( "ZRTP", DH_POOL_ZRTP3072, zrtpSetup );
+
+	printf( "%llu keys from the pool, %llu generated inline\n",
+		(unsigned long long)pool->getHits(),
+		(unsigned long long)pool->getMisses() );
+
+	pool->stop();
+	return 0;
+}
@@ -0,0 +1,145 @@
+/*
+ * Benchmark of the TLS client session cache.
+ *
+ * Sends 1000 sequential requests to a local TLS server: with a new
+ * connection per request and no session cache, with a new connection
+ * per request resuming the cached session, and over one reused
+ * connection. Prints the full and resumed handshakes done and the
+ * mean time to set up a connection.
+ *
+ * Usage: bench_tls_session <certificate.pem> <private_key.pem>
+ */
+
+#include<libmcrypto/TlsSocket.h>
+#include<libmcrypto/TlsServerSocket.h>
+#include<libmcrypto/cert.h>
+#include<libmnetutil/TcpServerSocket.h>
+#include<libmnetutil/TCPSocket.h>
+#include<libmnetutil/IPAddress.h>
+#include<libmutil/Thread.h>
+#include<libmutil/mtime.h>
+
+#include<stdio.h>
+#include<stdlib.h>
+
+#ifdef WIN32
+#include<winsock2.h>
+#else
+#include<sys/select.h>
+#endif
+
+#define BENCH_REQUESTS 1000
+
+static const char request[] = "OPTIONS sip:bench@127.0.0.1 SIP/2.0\r\n\r\n";
+
+static MRef<ServerSocket*> server;
+
+/* TLS sockets are non-blocking, read() returns -1 until a whole
+ * record has arrived */
+static int32_t readWait( MRef<StreamSocket*> sock, void *buf, int32_t count ){
+	for(;;){
+		int32_t ret = sock->read( buf, count );
+		if( ret >= 0 ){
+			return ret;
+		}
+
+		fd_set set;
+		FD_ZERO( &set );
+		FD_SET( sock->getFd(), &set );
+		select( sock->getFd() + 1, &set, NULL, NULL, NULL );
+	}
+}
+
+static void * serve( void * ){
+	for(;;){
+		MRef<StreamSocket*> conn;
+		try{
+			conn = server->accept();
+		}
+		catch( ... ){
+			return NULL;
+		}
+		if( !conn ){
+			return NULL;
+		}
+
+		char buf[1024];
+		int32_t n;
+		while( ( n = readWait( conn, buf, sizeof( buf ) ) ) > 0 ){
+			conn->write( buf, n );
+		}
+	}
+}
+
+static void exchange( MRef<StreamSocket*> sock ){
+	char buf[sizeof( request )];
+	int32_t n = 0;
+
+	sock->write( request, sizeof( request ) );
+	while( n < (int32_t)sizeof( request ) ){
+		int32_t ret = readWait( sock, buf + n, sizeof( request ) - n );
+		if( ret <= 0 ){
+			fprintf( stderr, "Connection closed by the server\n" );
+			exit( 1 );
+		}
+		n += ret;
+	}
+}
+
+static void run( const char * name, int port, bool reuse,
+		MRef<Certificate*> cert, MRef<CertificateSet*> cas ){
+	MRef<IPAddress *> addr = IPAddress::create( "127.0.0.1" );
+	MRef<StreamSocket*> sock;
+	uint64_t setupMs = 0;
+	uint64_t full0, resumed0, full, resumed;
+
+	TLSSocket::getHandshakeCounts( full0, resumed0 );
+
+	uint64_t start = mtime();
+	for( int i = 0; i < BENCH_REQUESTS; i++ ){
+		if( !reuse || !sock ){
+			uint64_t t = mtime();
+			sock = NULL;
+			sock = TLSSocket::connect( new TCPSocket( **addr, port ),
+						   cert, cas, "bench.example" );
+			setupMs += mtime() - t;
+		}
+		exchange( sock );
+	}
+	uint64_t ms = mtime() - start;
+	sock = NULL;
+
+	TLSSocket::getHandshakeCounts( full, resumed );
+	printf( "%-22s full: %5llu  resumed: %5llu  setup: %6.3f ms/request  total: %6llu ms\n",
+		name,
+		(unsigned long long)( full - full0 ),
+		(unsigned long long)( resumed - resumed0 ),
+		(double)setupMs / BENCH_REQUESTS,
+		(unsigned long long)ms );
+}
+
+int main( int argc, char *argv[] ){
+	if( argc < 3 ){
+		fprintf( stderr, "Usage: %s <certificate.pem> <private_key.pem>\n", argv[0] );
+		return 1;
+	}
+
+	MRef<Certificate*> cert = Certificate::load( argv[1], argv[2] );
+	MRef<CertificateSet*> cas = CertificateSet::create();
+	cas->addCertificate( cert );
+
+	MRef<ServerSocket*> tcp = TcpServerSocket::create( 0 );
+	int port = tcp->getPort();
+	server = TLSServerSocket::create( tcp, cert, cas );
+	Thread::createThread( serve, NULL );
+
+	TLSSocket::setSessionCache( 0 );
+	run( "new connection", port, false, cert, cas );
+
+	TLSSocket::setSessionCache( 3600 );
+	run( "new connection, cache", port, false, cert, cas );
+
+	run( "reused connection", port, true, cert, cas );
+
+	return 0;
+}
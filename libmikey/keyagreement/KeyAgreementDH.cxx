@@ -29,6 +29,8 @@
 #include<libmikey/MikeyException.h>
 #include<libmikey/MikeyMessage.h>
 #include<libmcrypto/OakleyDH.h>
+#include<libmcrypto/DhKeyPool.h>
+#include<libmcrypto/CertificateChainCache.h>
 #include<libmcrypto/SipSim.h>
 #include<algorithm>
 #include<string.h>
@@ -142,8 +144,13 @@ int KeyAgreementDHBase::setGroup( int groupValue ){
 	else
 #endif
 	{
-		if( !dh->setGroup( groupValue ) )
+		/* Take a key pair generated in advance, if any */
+		OakleyDH * pooled =
+			DhKeyPool::getInstance()->takeOakleyDH( groupValue );
+		if( !pooled )
 			return 1;
+		delete dh;
+		dh = pooled;
 
 		uint32_t len = dh->secretLength();
 
@@ -240,7 +247,9 @@ int PeerCertificates::controlPeerCertificate( const std::string &peerUri ){
 	if( peerCertChainPtr.isNull() || certDbPtr.isNull() )
 		return 0;
 
-	int res = peerCertChainPtr->control( certDbPtr );
+	/* Peers calling again present the same chain */
+	int res = CertificateChainCache::getInstance()->control(
+		peerCertChainPtr, certDbPtr );
 	if( !res ){
 		return res;
 	}
@@ -86,6 +86,9 @@ class ConfigRegistry: public MPluginRegistry{
 
 		virtual std::string getPluginType(){ return "Config"; }
 
+		/** Backends are looked up by name */
+		virtual bool isLazy() const{ return true; }
+
 		static MRef<ConfigRegistry*> getInstance();
 
 		MRef<ConfBackend*> createBackend( std::string backendName="" );
@@ -28,7 +28,9 @@
 #include<libminisip/libminisip_config.h>
 
 #include<libmutil/MemObject.h>
+#include<libmutil/Mutex.h>
 #include<string>
+#include<vector>
 
 class ContactDb;
 class PhoneBookPerson;
@@ -82,21 +84,91 @@ class LIBMINISIP_API ContactEntry : public MObject{
                 friend class PhoneBook;
 };
 
+/**
+ * Index of the contact entries of the phone books, used to resolve
+ * the caller of an incoming call or the sender of a presence update.
+ *
+ * Entries are found by id, by normalized URI (see normalizeUri) and,
+ * for the URIs and numbers that are telephone numbers, by their
+ * digits. The id and URI indexes are hash tables and the numbers are
+ * kept in a digit trie, so that the cost of a look up does not grow
+ * with the size of the phone books.
+ */
 class LIBMINISIP_API ContactDb : public MObject{
 	public:
 		ContactDb();
-
+		~ContactDb();
+
+		/**
+		 * Entry of a URI, compared after normalization. A URI
+		 * that is a telephone number also matches an entry of
+		 * the same number written differently, such as
+		 * "tel:+46-8-123" for "sip:+468123@gateway".
+		 * @return the entry added first, or NULL
+		 */
 		ContactEntry * lookUp(  std::string uri );
 		ContactEntry * lookUp( uint32_t id );
 
+		/**
+		 * Entry whose number is the longest prefix of the number
+		 * or telephone URI given, such as the switchboard of a
+		 * company for one of its extensions.
+		 * @return the entry, or NULL
+		 */
+		ContactEntry * lookUpNumber( std::string number );
+
 		void addEntry( ContactEntry * entry );
 		void delEntry( ContactEntry * entry );
 
+		/** Number of entries */
+		size_t size();
+
+		/**
+		 * Key of a URI in the index: the display name, the angle
+		 * brackets, the sip: and sips: schemes, the port, the
+		 * parameters and the headers are removed, and the host is
+		 * lower cased. "Alice <sips:alice@Example.COM:5061;transport=tls>"
+		 * gives "alice@example.com".
+		 */
+		static std::string normalizeUri( const std::string &uri );
+
+		/**
+		 * Digits of a telephone number, or of the user part of a
+		 * URI that is one, without the visual separators of
+		 * RFC 3966 and the leading +. Empty if it is not a number.
+		 */
+		static std::string numberDigits( const std::string &uri );
+
 		virtual std::string getMemObjectType() const {return "ContactDb";}
 
 	private:
+		typedef std::vector< ContactEntry * > IdBucket;
+		typedef std::vector< std::pair< std::string, ContactEntry * > > UriBucket;
+
+		/* Node of the digit trie, with the index of the child of
+		 * each digit (0 if none) and of its entries in
+		 * numberEntries (-1 if none) */
+		struct DigitNode{
+			int32_t child[10];
+			int32_t entries;
+		};
+
+		void rehash( size_t buckets );
+		void addNumber( const std::string &digits, ContactEntry * entry );
+		void delNumber( const std::string &digits, ContactEntry * entry );
+
+		/* Look ups with the lock held */
+		ContactEntry * findUri( const std::string &key );
+		ContactEntry * findNumber( const std::string &digits, bool prefix );
+
+		Mutex lock;
+		size_t count;
+
+		std::vector< IdBucket > idIndex;
+		std::vector< UriBucket > uriIndex;
 
-		std::list< ContactEntry * > entries;
+		std::vector< DigitNode > digitTrie;
+		std::vector< std::vector< ContactEntry * > > numberEntries;
 };
 
 #endif
@@ -28,10 +28,14 @@
 #include<libminisip/libminisip_config.h>
 
 #include<libminisip/media/RealtimeMedia.h>
+#include<libminisip/media/codecs/ComfortNoise.h>
 #include<libminisip/media/soundcard/SoundIO.h>
+#include<libminisip/media/soundcard/SoundSource.h>
+
+#include<libmutil/Mutex.h>
 
 #ifdef AEC_SUPPORT
-#include<libminisip/media/aec/aec.h>		//hanning
+#include<libminisip/media/aec/BlockAEC.h>
 #endif
 
 #include<string>
@@ -61,6 +65,8 @@ class LIBMINISIP_API AudioMedia : public RealtimeMedia, public SoundRecorderCall
 		* and sorted according to her preference
 		*/
 		AudioMedia( MRef<SoundIO *> soundIo, const std::list<MRef<Codec *> > & codecList );
+
+		virtual ~AudioMedia();
 		
 		virtual std::string getMemObjectType() const {return "AudioMedia";}
 
@@ -156,6 +162,20 @@ class LIBMINISIP_API AudioMedia : public RealtimeMedia, public SoundRecorderCall
 		*/
 		void stopRinging();
 
+		/**
+		* Enables or disables the discontinuous transmission.
+		* When enabled, the frames of silence detected by the
+		* voice activity detector are neither encoded nor sent
+		* to the peers that accept comfort noise, which are sent
+		* comfort noise packets (RFC 3389) instead. Only senders
+		* of a CODEC at 8 kHz are concerned, and none while the
+		* media is forwarded between calls.
+		* @param enabled whether or not silences are suppressed
+		*/
+		void setDtx( bool enabled ) { dtx = enabled; }
+
+		bool getDtx() { return dtx; }
+
 #ifdef DEBUG_OUTPUT
 		virtual std::string getDebugString();
 #endif
@@ -173,19 +193,40 @@ class LIBMINISIP_API AudioMedia : public RealtimeMedia, public SoundRecorderCall
 		uint32_t seqNo;
 		byte_t encoded[1600];                 
 		short resampledData[1600];
+		bool dtx;
+		/* Estimate of the background noise sent during the
+		 * silences, from the microphone signal at 8 kHz */
+		ComfortNoiseEncoder comfortNoise;
+		MRef<Resampler *> comfortNoiseResampler;
+		short comfortNoiseData[1600];
+		byte_t comfortNoisePayload[COMFORT_NOISE_ORDER + 1];
 		#ifdef AEC_SUPPORT
-		short resampledDataR[160];		//hanning
-		static AEC aec;				//hanning
+		/* Echo canceller of the microphone and loudspeaker of soundIo */
+		BlockAEC aec;
+		short aecData[SOUND_CARD_FREQ * 20 / 1000];
 		#endif
 		std::list< MRef<AudioCodec *> > codecs;
 		std::list< MRef<AudioMediaSource *> > sources;
 };
 
-class LIBMINISIP_API AudioMediaSource : public BasicSoundSource{
+/**
+ * Decodes the stream of one SSRC for the SoundIO. Once the peer
+ * has sent comfort noise, the noise it describes is played when no
+ * audio is left, until the next packet of audio.
+ */
+class LIBMINISIP_API AudioMediaSource : public BasicSoundSource, public SoundIOPLCInterface{
 	public:
 		AudioMediaSource( uint32_t ssrc, std::string callId, MRef<Media *> media );
 
 		void playData( const MRef<RtpPacket *> & rtpPacket );
+
+		/**
+		* Called by the sound player thread when the buffer is
+		* empty.
+		* @returns a frame of comfort noise, or NULL if the peer
+		* is not in a silence
+		*/
+		virtual short *get_plc_sound( uint32_t &ret_size );
 		uint32_t getSsrc();
 		
 		MRef<Media *> getMedia() { return media; };
@@ -200,6 +241,16 @@ class LIBMINISIP_API AudioMediaSource : public BasicSoundSource{
 		short codecOutput[AUDIOMEDIA_CODEC_MAXLEN];
 		uint32_t ssrc;
 
+		/* Set by the RTP thread, used by the player thread */
+		Mutex comfortNoiseLock;
+		ComfortNoiseGenerator comfortNoise;
+		bool comfortNoiseActive;
+
+		/* 20 ms of stereo at 8 kHz, and at up to 48 kHz */
+		MRef<Resampler *> comfortNoiseResampler;
+		short comfortNoiseStereo[2 * 160];
+		short comfortNoiseOutput[2 * 960];
+
 };
 
 
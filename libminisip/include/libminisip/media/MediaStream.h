@@ -438,8 +438,10 @@ class LIBMINISIP_API RealtimeMediaStreamSender : public RealtimeMediaStream{
 		 * @param marker whether or not the marker should be set
 		 * in the RTP header
 		 * @param dtmf whether or not the data is a DTMF signal
+		 * @param comfortNoise whether or not the data is a comfort
+		 * noise payload (RFC 3389)
 		 */
-		void send( byte_t * data, uint32_t length, uint32_t * ts, bool marker = false, bool dtmf = false );
+		void send( byte_t * data, uint32_t length, uint32_t * ts, bool marker = false, bool dtmf = false, bool comfortNoise = false );
 
 
 		void setSelectedCodecHacked( MRef <RealtimeMedia*> m);
@@ -515,6 +517,41 @@ class LIBMINISIP_API RealtimeMediaStreamSender : public RealtimeMediaStream{
 		 */
 		bool muteKeepAlive( uint32_t max);
 
+		/**
+		 * Whether or not the peer listed the comfort noise
+		 * payload type in its session description. Silences are
+		 * only suppressed for peers that do.
+		 */
+		bool acceptsComfortNoise() { return peerComfortNoise; }
+
+		/**
+		 * Used by the Media for each frame of silence of the
+		 * discontinuous transmission. The frame is suppressed,
+		 * but its timestamp is counted.
+		 * @param noiseLevel the level of the background noise,
+		 * in -dBov
+		 * @returns whether or not a comfort noise packet should
+		 * be sent in place of the frame, at the start of a
+		 * silence, when the noise level changed or to refresh
+		 * that of the peer
+		 */
+		bool dtxSilence( int32_t noiseLevel );
+
+		/**
+		 * Used by the Media for each frame of speech.
+		 * @returns whether or not the frame starts a talkspurt
+		 * after a suppressed silence, and should be sent with
+		 * the marker bit set
+		 */
+		bool dtxSpeech();
+
+		/**
+		 * Frames of silence that were not encoded nor sent,
+		 * and comfort noise packets sent in their place.
+		 */
+		uint32_t getSuppressedFrames() { return suppressedFrames; }
+		uint32_t getComfortNoisePackets() { return comfortNoisePackets; }
+
 		/**
 		 * Used to check a m: header in a session description
 		 * against the media stream for compatibility. In
@@ -561,6 +598,14 @@ class LIBMINISIP_API RealtimeMediaStreamSender : public RealtimeMediaStream{
 		bool muted;
 		uint32_t muteCounter;
 
+		// Discontinuous transmission
+		bool peerComfortNoise;
+		bool inSilence;
+		int32_t silenceLevel;
+		uint32_t silenceFrames;
+		uint32_t suppressedFrames;
+		uint32_t comfortNoisePackets;
+
 };
 
 #endif
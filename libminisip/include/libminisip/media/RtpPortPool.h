@@ -0,0 +1,152 @@
+/*
+ Copyright (C) 2004-2006 the Minisip Team
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#ifndef RTPPORTPOOL_H
+#define RTPPORTPOOL_H
+
+#include<libminisip/libminisip_config.h>
+
+#include<libmutil/MemObject.h>
+#include<libmutil/Thread.h>
+#include<libmutil/CondVar.h>
+#include<libmutil/Mutex.h>
+
+#include<libminisip/ipprovider/IpProvider.h>
+
+#include<list>
+
+class UDPSocket;
+
+/* Range of the local RTP ports, even ones from the min to the max,
+ * and the number of random ports tried before giving up */
+#define RTP_LOCAL_PORT_RANGE_MIN 30000
+#define RTP_LOCAL_PORT_RANGE 5000
+#define RTP_LOCAL_PORT_RANGE_MAX RTP_LOCAL_PORT_RANGE_MIN + RTP_LOCAL_PORT_RANGE
+#define RTP_RECEIVER_MAX_RETRIES 5
+
+/**
+ * A socket bound to an even port for RTP and one bound to the port
+ * above it for RTCP, with the port on which the peer should send
+ * the RTP packets, as given by the IpProvider (the port mapped by
+ * the NAT when STUN is used).
+ */
+class LIBMINISIP_API RtpPortPair : public MObject{
+	public:
+		RtpPortPair( MRef<UDPSocket *> rtpSocket,
+			     MRef<UDPSocket *> rtcpSocket );
+
+		MRef<UDPSocket *> getRtpSocket(){ return rtpSocket; }
+		MRef<UDPSocket *> getRtcpSocket(){ return rtcpSocket; }
+
+		uint16_t getExternalPort(){ return externalPort; }
+
+		virtual std::string getMemObjectType() const {return "RtpPortPair";}
+
+	private:
+		MRef<UDPSocket *> rtpSocket;
+		MRef<UDPSocket *> rtcpSocket;
+		uint16_t externalPort;
+
+		/* mtime() of the last discovery of the external port */
+		uint64_t discovered;
+		/* mtime() of the return to the pool */
+		uint64_t released;
+
+		friend class RtpPortPool;
+};
+
+/**
+ * Keeps RTP/RTCP port pairs bound in advance, with their external
+ * port already known, so that creating a media session neither
+ * probes for free ports nor waits for a STUN server.
+ *
+ * A background thread binds pairs until the pool has its size, and
+ * queries the external port of every pair in the pool again before
+ * the mapping of the NAT may expire. A pair returned at the end of
+ * a session is kept aside for a while before being handed out
+ * again, so that late packets of the old peer are not received by
+ * the next session. Taking a pair from an empty pool binds one in
+ * the calling thread, as was done without the pool.
+ */
+class LIBMINISIP_API RtpPortPool : public Runnable{
+	public:
+		/**
+		 * @param ipProvider gives the external IP address, which
+		 * selects IPv4 or IPv6, and the external port of the
+		 * pairs
+		 * @param size number of pairs kept ready
+		 */
+		RtpPortPool( MRef<IpProvider *> ipProvider, int size );
+		~RtpPortPool();
+
+		/**
+		 * Returns a pair for a new session, or NULL if no port
+		 * could be bound. The caller gives it back with
+		 * release() when the session ends.
+		 */
+		MRef<RtpPortPair *> take();
+
+		/** Gives back a pair taken from the pool */
+		void release( MRef<RtpPortPair *> pair );
+
+		MRef<IpProvider *> getIpProvider(){ return ipProvider; }
+
+		/** Pairs ready to be taken */
+		int getAvailable();
+
+		/** Pairs served from the pool, and pairs bound inline */
+		uint64_t getHits(){ return nHits; }
+		uint64_t getMisses(){ return nMisses; }
+
+		/** Starts the background thread */
+		void start();
+
+		/** Stops the background thread and closes the pairs */
+		void stop();
+
+		virtual void run();
+
+		virtual std::string getMemObjectType() const {return "RtpPortPool";}
+
+	private:
+		/* Binds a pair on a random even port of the range */
+		MRef<RtpPortPair *> bind();
+
+		/* Queries the external port of a pair, without the lock */
+		void discover( MRef<RtpPortPair *> pair );
+
+		/* Reads and drops the packets waiting on a pair */
+		static void drain( MRef<RtpPortPair *> pair );
+
+		MRef<IpProvider *> ipProvider;
+		bool useIPv6;
+		int size;
+
+		std::list< MRef<RtpPortPair *> > ready;
+		std::list< MRef<RtpPortPair *> > returned;
+
+		MRef<Thread *> thread;
+		Mutex lock;
+		CondVar wake;
+		bool quit;
+
+		uint64_t nHits;
+		uint64_t nMisses;
+};
+
+#endif
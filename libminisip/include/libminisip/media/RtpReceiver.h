@@ -32,6 +32,7 @@
 #include<libmutil/Thread.h>
 
 #include<libminisip/ipprovider/IpProvider.h>
+#include<libminisip/media/RtpPortPool.h>
 
 class UDPSocket;
 class RealtimeMediaStreamReceiver;
@@ -55,6 +56,15 @@ class LIBMINISIP_API RtpReceiver : public Runnable{
 		 */
 		RtpReceiver( MRef<IpProvider *> ipProvider, std::string callId );
 
+		/**
+		 * Constructor listening on a port pair taken from a
+		 * pool, whose external port is already known. The
+		 * pair is given back to the pool by the destructor.
+		 * @param pool pool of pairs bound in advance
+		 * @throws NetworkException if no pair could be bound
+		 */
+		RtpReceiver( MRef<RtpPortPool *> pool, std::string callId );
+
 		/**
 		 * Used for a RealtimeMediaStreamReceiver to subscribe to data
 		 * incoming on this RtpReceiver. If the payload type
@@ -110,6 +120,9 @@ class LIBMINISIP_API RtpReceiver : public Runnable{
 	private:
 		MRef<UDPSocket *> socket;
 		uint16_t externalPort;
+
+		MRef<RtpPortPool *> pool;
+		MRef<RtpPortPair *> pair;
 		bool kill;
 
 		std::list< MRef<RealtimeMediaStreamReceiver *> > realtimeMediaStreams;
@@ -83,6 +83,8 @@ class LIBMINISIP_API SubsystemMedia: public CommandReceiver {
 		 * @param config the call specific configuration
 		 * @param callId identifier shared with the SIP stack
 		 * @returns a reference to the session created
+		 * @throws NetworkException if the RTP sockets could not
+		 * be created, the call is to fail
 		 */
 		MRef<Session *> createSession( MRef<SipIdentity*> ident, std::string callId );
 
@@ -0,0 +1,168 @@
+/*
+ Copyright (C) 2004-2006 the Minisip Team
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#ifndef _BLOCKAEC_H
+#define _BLOCKAEC_H
+
+#include<libminisip/libminisip_config.h>
+
+#include<libmutil/mtypes.h>
+
+/**
+ * Real FFT of a fixed power of two size.
+ *
+ * Spectra are kept as separate arrays of real and imaginary parts
+ * of the size/2+1 non negative frequency bins, so that the
+ * butterflies and the per bin products vectorize.
+ */
+class LIBMINISIP_API BlockFFT{
+	public:
+		BlockFFT( int32_t size );
+		~BlockFFT();
+
+		int32_t getSize() const { return size; }
+
+		/** Spectrum (re, im) of the size samples of in */
+		void forward( const float *in, float *re, float *im );
+
+		/** Samples of a spectrum, scaled so that inverse(forward(x)) = x */
+		void inverse( const float *re, const float *im, float *out );
+
+	private:
+		/** Complex FFT of size/2 points in place, inverse if sign > 0 */
+		void complexFFT( float *re, float *im, int sign );
+
+		int32_t size;
+		int32_t half;
+
+		int32_t *bitrev;
+
+		/* Twiddles of the complex FFT, those of the butterflies of
+		 * half length h start at offset h */
+		float *twRe;
+		float *twIm;
+
+		/* Twiddles splitting the complex FFT into the real one */
+		float *splitRe;
+		float *splitIm;
+
+		float *workRe;
+		float *workIm;
+};
+
+/**
+ * Acoustic echo canceller with a partitioned block frequency domain
+ * adaptive filter (PBFDAF).
+ *
+ * The echo tail is split in partitions of one block each. The
+ * loudspeaker spectra of the last partitions are kept, and each
+ * block of microphone signal is cancelled by their product with
+ * the filter weights, an overlap-save convolution costing two FFTs
+ * and one complex multiply-add per bin and partition. The weights
+ * are adapted per bin with a step normalized by the loudspeaker
+ * power in that bin. Adaptation is frozen during double talk,
+ * detected with a Geigel detector as in the sample based AEC.
+ *
+ * Unlike the AEC class it is not bound to 8 kHz, and an instance
+ * keeps the state of a single echo path, so every microphone and
+ * loudspeaker pair needs its own.
+ */
+class LIBMINISIP_API BlockAEC{
+	public:
+		/**
+		 * @param sampleRate sampling rate of the signals
+		 * @param frameSize number of samples passed to each
+		 * 	process() call.
+		 * @param tailMs length of the echo tail cancelled
+		 */
+		BlockAEC( int32_t sampleRate, int32_t frameSize, int32_t tailMs = 128 );
+		~BlockAEC();
+
+		/**
+		 * Cancels the echo of spk in mic, frameSize samples.
+		 * When frameSize is not a multiple of the block size,
+		 * out is delayed by one block. out may be mic.
+		 */
+		void process( const short *mic, const short *spk, short *out );
+
+		/** Enables the non linear processor, on by default */
+		void setSuppression( bool on ){ suppression = on; }
+
+		int32_t getSampleRate() const { return sampleRate; }
+		int32_t getBlockSize() const { return blockSize; }
+		int32_t getPartitions() const { return nPartitions; }
+
+	private:
+		void processBlock( const float *mic, const float *spk, float *out );
+		bool doubleTalk( const float *mic, const float *spk );
+
+		int32_t sampleRate;
+		int32_t frameSize;
+		int32_t blockSize;
+		int32_t nPartitions;
+		int32_t nBins;
+		/* Bins rounded up to a multiple of 4 for the SIMD loops */
+		int32_t nBinsPadded;
+		bool suppression;
+
+		BlockFFT fft;
+
+		/* DC removal */
+		float dcMic;
+		float dcSpk;
+
+		/* Loudspeaker spectra of the last nPartitions blocks, the
+		 * newest at index newest */
+		float *xRe;
+		float *xIm;
+		int32_t newest;
+
+		/* Filter weights, one spectrum per partition */
+		float *wRe;
+		float *wIm;
+		/* Partition whose weights are constrained next */
+		int32_t constrainNext;
+
+		/* Loudspeaker power per bin */
+		float *power;
+
+		/* Previous and current loudspeaker block */
+		float *spkTime;
+
+		float *yRe;
+		float *yIm;
+		float *eRe;
+		float *eIm;
+		float *time;
+
+		/* Geigel double talk detector, the maximum loudspeaker
+		 * level of each of the last partitions */
+		float *spkMax;
+		int32_t hangover;
+		int32_t hangoverBlocks;
+
+		/* Blocks being filled and processed, and processed
+		 * output not yet returned */
+		float *micIn;
+		float *spkIn;
+		int32_t inFill;
+		float *outQueue;
+		int32_t outFill;
+};
+
+#endif
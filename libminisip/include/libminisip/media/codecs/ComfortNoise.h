@@ -0,0 +1,95 @@
+/*
+ Copyright (C) 2004-2006 the Minisip Team
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#ifndef _COMFORTNOISE_H
+#define _COMFORTNOISE_H
+
+#include<libminisip/libminisip_config.h>
+
+#include<libmutil/mtypes.h>
+
+/* Static payload type of comfort noise at 8 kHz (RFC 3551) */
+#define COMFORT_NOISE_PAYLOAD_TYPE 13
+
+/* Order of the spectral model sent, the payload is one byte longer */
+#define COMFORT_NOISE_ORDER 10
+
+/* Longest model accepted from the peer */
+#define COMFORT_NOISE_MAX_ORDER 32
+
+/**
+ * Estimates the background noise of the 8 kHz signal during the
+ * silences of discontinuous transmission, and describes it with a
+ * comfort noise payload (RFC 3389): its level in -dBov and the
+ * reflection coefficients of a linear prediction filter giving its
+ * spectrum.
+ */
+class LIBMINISIP_API ComfortNoiseEncoder{
+	public:
+		ComfortNoiseEncoder();
+
+		/** Adds n samples of background noise to the estimate */
+		void analyse( const short *samples, int32_t n );
+
+		/** Level of the noise estimated, from 0 to 127 -dBov */
+		int32_t getLevel() const;
+
+		/**
+		 * Writes the payload describing the noise estimated.
+		 * @return the length of the payload,
+		 * COMFORT_NOISE_ORDER + 1 bytes
+		 */
+		uint32_t encode( byte_t *payload );
+
+	private:
+		/* Autocorrelation of the noise, per sample and averaged
+		 * over the frames analysed */
+		double autocorr[COMFORT_NOISE_ORDER + 1];
+		bool first;
+};
+
+/**
+ * Synthesizes comfort noise from the payloads received, by filtering
+ * white noise with the prediction filter they describe.
+ */
+class LIBMINISIP_API ComfortNoiseGenerator{
+	public:
+		ComfortNoiseGenerator();
+
+		/**
+		 * Takes the level and spectrum of a payload. Those of a
+		 * payload without reflection coefficients are flat.
+		 */
+		void decode( const byte_t *payload, uint32_t length );
+
+		/** Writes n samples of noise at 8 kHz */
+		void generate( short *samples, int32_t n );
+
+	private:
+		/* Direct form of the synthesis filter, 1 / (1 + sum of
+		 * lpc[j] z^-j) */
+		float lpc[COMFORT_NOISE_MAX_ORDER + 1];
+		float history[COMFORT_NOISE_MAX_ORDER];
+		int32_t order;
+
+		/* Amplitude of the uniform noise filtered */
+		float gain;
+		uint32_t seed;
+};
+
+#endif
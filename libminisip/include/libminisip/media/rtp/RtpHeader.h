@@ -29,6 +29,9 @@
 
 #include<vector>
 
+/* 12 fixed bytes, 15 CSRC and the TCP friendly extension */
+#define RTP_HEADER_MAX_SIZE 80
+
 class LIBMINISIP_API RtpHeader{
 
 	public:
@@ -64,6 +67,20 @@ class LIBMINISIP_API RtpHeader{
 		int size();
 		char *getBytes();
 
+		/**
+		 * Writes the header in network order to buf, which must
+		 * hold at least size() bytes.
+		 * @return the number of bytes written
+		 */
+		int writeTo( unsigned char *buf );
+
+		/**
+		 * Decodes the header at the start of a received packet.
+		 * @return the size of the header including the CSRC
+		 * list, or -1 if buf is too short to hold it
+		 */
+		int parse( const unsigned char *buf, int length );
+
 		int CSRC_count;
 		int version;
 		int extension;
@@ -33,6 +33,7 @@
 #include<libmnetutil/IPAddress.h>
 
 #include<libminisip/media/rtp/RtpHeader.h>
+#include<libminisip/media/rtp/RtpPacketPool.h>
 
 /**
  * This class implements the RTP header.
@@ -49,6 +50,15 @@ class LIBMINISIP_API RtpPacket: public MObject {
 		RtpPacket(unsigned char *content, int content_length, int seq_no,
                           unsigned timestamp, unsigned ssrc);
 		RtpPacket(const RtpHeader &hdr, unsigned char *content, int content_length);
+
+		/**
+		 * Creates a packet over a received datagram held in a
+		 * slab of the RtpPacketPool. The header has already been
+		 * parsed from it, the content and extension header are
+		 * left in place and the slab goes back to the pool with
+		 * the packet.
+		 */
+		RtpPacket(const RtpHeader &hdr, unsigned char *slab, int headerSize, int length);
 		virtual ~RtpPacket();
 
 		static RtpPacket *readPacket(UDPSocket &udp_sock, int timeout=-1);
@@ -129,6 +139,27 @@ class LIBMINISIP_API RtpPacket: public MObject {
 		virtual int size();
 
 	protected:
+		/**
+		 * Lays the header and extension header out in front of
+		 * the content, in the headroom of the slab.
+		 *
+		 * @return the start of the packet as it goes on the wire,
+		 *    or NULL if the content is not held in a slab with
+		 *    enough room around it
+		 */
+		virtual unsigned char *layoutInPlace();
+
+		/** True if p points into the slab of this packet */
+		bool inSlab(unsigned char *p) const {
+			return slab && p >= slab && p < slab + RTP_PACKET_SLAB_SIZE;
+		}
+
+		void setContent(unsigned char *content, int content_length, bool copy);
+
+		/* Pooled buffer holding the content, or NULL if the
+		 * content was allocated on its own */
+		unsigned char *slab;
+
                 int zrtpChecksum;
 		RtpHeader header;
 		int content_length;
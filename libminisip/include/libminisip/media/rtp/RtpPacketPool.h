@@ -0,0 +1,83 @@
+/*
+ Copyright (C) 2004-2006 the Minisip Team
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#ifndef RTPPACKETPOOL_H
+#define RTPPACKETPOOL_H
+
+#include<libminisip/libminisip_config.h>
+
+#include<vector>
+#include<stdint.h>
+#include<libmutil/Mutex.h>
+
+/* Size of a slab. Datagrams filling a whole slab may have been
+ * truncated by the socket and are dropped */
+#define RTP_PACKET_SLAB_SIZE 2048
+
+/* Room kept in front of the content of outgoing packets, for the
+ * RTP header and a ZRTP extension header */
+#define RTP_PACKET_HEADROOM 128
+
+/* Room kept after the content of outgoing packets, for the SRTP
+ * authentication tag and MKI */
+#define RTP_PACKET_TAILROOM 64
+
+/* Free slabs and packet objects kept for reuse, anything beyond
+ * that is given back to the heap */
+#define RTP_PACKET_POOL_MAX 512
+
+/**
+ * Recycles the memory of RTP packets. Received datagrams are read
+ * straight into a slab, and outgoing payloads are copied once into
+ * one, so that the SRTP processing and the header are done in place.
+ * The SRtpPacket objects themselves are also recycled, through the
+ * class operators new and delete, so a packet and its slab go back
+ * to the pool when the last MRef to it is dropped.
+ *
+ * All methods are thread safe.
+ */
+class LIBMINISIP_API RtpPacketPool{
+	public:
+		static RtpPacketPool * getInstance();
+
+		/** Returns a slab of RTP_PACKET_SLAB_SIZE bytes */
+		unsigned char * getSlab();
+		void releaseSlab( unsigned char * slab );
+
+		/** Memory for a packet object of the given size */
+		void * allocPacket( size_t size );
+		void freePacket( void * packet, size_t size );
+
+		/** Number of slabs and packets taken from the heap */
+		uint64_t getHeapAllocations(){ return nHeapAllocations; }
+
+		/** Number of slabs and packets served from the pool */
+		uint64_t getReuses(){ return nReuses; }
+
+	private:
+		RtpPacketPool();
+
+		std::vector<unsigned char *> freeSlabs;
+		std::vector<void *> freePackets;
+		Mutex poolLock;
+
+		uint64_t nHeapAllocations;
+		uint64_t nReuses;
+};
+
+#endif
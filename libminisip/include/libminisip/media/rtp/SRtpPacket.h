@@ -50,6 +50,12 @@ class LIBMINISIP_API SRtpPacket : public RtpPacket{
 			int seq_no, unsigned timestamp,
 			unsigned ssrc);
 		SRtpPacket(RtpHeader hdr, unsigned char *content, int content_length);
+
+		/**
+		 * Creates an encrypted packet over a received datagram held
+		 * in a slab of the RtpPacketPool, see RtpPacket.
+		 */
+		SRtpPacket(const RtpHeader &hdr, unsigned char *slab, int headerSize, int length);
 		virtual ~SRtpPacket();
 
 		/**
@@ -73,6 +79,12 @@ class LIBMINISIP_API SRtpPacket : public RtpPacket{
 		virtual char* getBytes();
 		virtual int size();
 
+		/* Packet objects are recycled by the RtpPacketPool */
+		static void *operator new(size_t size);
+		static void operator delete(void *packet, size_t size);
+
+	protected:
+		virtual unsigned char *layoutInPlace();
 
 	private:
 		bool encrypted;
@@ -68,7 +68,7 @@ class LIBMINISIP_API AudioMixer: public MObject{
 		The returned short * buffer is not to be deleted!
 		Before using this function, a call to init() must be made!!!
 		*/
-		virtual short * mix(std::list<MRef<SoundSource *> > sources) = 0;
+		virtual short * mix(std::list<MRef<SoundSource *> > &sources) = 0;
 		
 		/**
 		Initialize the buffers and stuff, as well as receive any needed
@@ -66,7 +66,7 @@ class LIBMINISIP_API AudioMixerSimple: public AudioMixer {
 		
 		This mixer calls the normalize function, to prevent audio saturation.
 		*/
-		virtual short * mix(std::list<MRef<SoundSource *> > sources);
+		virtual short * mix(std::list<MRef<SoundSource *> > &sources);
 	
 		/**
 		Overload the init() function ... we need to initialize the normalize
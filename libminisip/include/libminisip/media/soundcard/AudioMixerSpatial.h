@@ -63,7 +63,7 @@ class LIBMINISIP_API AudioMixerSpatial: public AudioMixer {
 		The returned short * buffer is not to be deleted!
 		Before using this function, a call to init() must be made!!!
 		*/
-		virtual short * mix(std::list<MRef<SoundSource *> > sources);
+		virtual short * mix(std::list<MRef<SoundSource *> > &sources);
 		
 		/**
 		Position the sources as we want.
@@ -0,0 +1,158 @@
+/*
+ Copyright (C) 2004-2006 the Minisip Team
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#ifndef MEDIACLOCK_H
+#define MEDIACLOCK_H
+
+#include<libminisip/libminisip_config.h>
+
+#include<libmutil/MemObject.h>
+#include<libmutil/Mutex.h>
+#include<libmutil/CondVar.h>
+#include<libmutil/Thread.h>
+
+#include<vector>
+
+/**
+ * Work run on every tick of a MediaClock.
+ */
+class LIBMINISIP_API MediaClockClient{
+	public:
+		virtual ~MediaClockClient(){}
+
+		/**
+		 * Processes one period. Called by one of the threads of
+		 * the clock, never concurrently for the same client.
+		 */
+		virtual void tick()=0;
+};
+
+/**
+ * Statistics of a MediaClock. Times are in microseconds.
+ */
+class LIBMINISIP_API MediaClockStats{
+	public:
+		MediaClockStats(): ticks(0), missed(0), overruns(0),
+				totalTickTime(0), maxTickTime(0), clients(0){}
+
+		/** Ticks run */
+		uint64_t ticks;
+
+		/** Ticks skipped because the previous one was still running */
+		uint64_t missed;
+
+		/** Ticks which took longer than a period to run */
+		uint64_t overruns;
+
+		uint64_t totalTickTime;
+		uint64_t maxTickTime;
+
+		/** Clients run by the last tick */
+		uint32_t clients;
+};
+
+/**
+ * Headless media clock.
+ *
+ * Paces audio processing without a sound card: a single timer
+ * (a timerfd where available) ticks every period, and each tick
+ * runs all the registered clients as one batch, split into slices
+ * run in parallel by a pool of worker threads. A SoundIO on devices
+ * of the "nullclock" sound driver is such a client, it mixes,
+ * encodes and sends one period of audio per tick instead of having
+ * its own player and recorder threads blocked on a device.
+ */
+class LIBMINISIP_API MediaClock : public MObject{
+	public:
+		/**
+		 * @param periodMs length of a tick in milliseconds, the
+		 * 	packetization interval.
+		 * @param nWorkers number of threads running the clients,
+		 * 	the clock thread included. 0 uses one per processor.
+		 */
+		MediaClock( int32_t periodMs = 20, int32_t nWorkers = 0 );
+		~MediaClock();
+
+		/** Starts the clock and worker threads */
+		void start();
+
+		/** Stops and joins the threads, after the current tick */
+		void stop();
+
+		/** Runs client from the next tick on. */
+		void addClient( MediaClockClient *client );
+
+		/**
+		 * Stops running client. When this returns, client is not
+		 * in a tick, and will not be run again. Must not be called
+		 * from a tick().
+		 */
+		void removeClient( MediaClockClient *client );
+
+		int32_t getPeriod() const { return periodMs; }
+		int32_t getNWorkers() const { return nWorkers; }
+
+		MediaClockStats getStats();
+		void resetStats();
+
+		virtual std::string getMemObjectType() const { return "MediaClock"; }
+
+	private:
+		static void *clockLoop( void *arg );
+		static void *workerLoop( void *arg );
+
+		/**
+		 * Blocks until the next tick. Returns the number of
+		 * ticks elapsed since the previous call, 0 when stopped.
+		 */
+		uint64_t waitTick();
+
+		bool isRunning();
+
+		/** Runs the share of the clients of a worker */
+		void runSlice( int32_t worker );
+
+		int32_t periodMs;
+		int32_t nWorkers;
+		/* Both guarded by workLock */
+		bool running;
+		bool quitWorkers;
+
+		int timerFd;
+		uint64_t nextTick;
+
+		/* Held by the clock thread during a whole tick */
+		Mutex clientsLock;
+		std::vector<MediaClockClient *> clients;
+
+		/* Hands a tick to the workers and waits for them */
+		Mutex workLock;
+		CondVar workCond;
+		CondVar doneCond;
+		uint64_t tickNo;
+		int32_t pending;
+		int32_t startedWorkers;
+
+		ThreadHandle clockThread;
+		std::vector<ThreadHandle> workerThreads;
+
+		Mutex statsLock;
+		MediaClockStats stats;
+};
+
+#endif
@@ -59,6 +59,9 @@ class LIBMINISIP_API ResamplerRegistry : public MPluginRegistry, public MSinglet
 	public:
 		virtual std::string getPluginType(){ return "Resampler"; }
 
+		/** Resamplers are looked up by name */
+		virtual bool isLazy() const{ return true; }
+
 		MRef<Resampler *> create(
 			uint32_t inputFreq, uint32_t outputFreq,
 			uint32_t duration, uint32_t nChannels );
@@ -54,4 +54,38 @@ class LIBMINISIP_API SimpleSilenceSensor : public SilenceSensor{
 		int limit_off;
 };
 
+/**
+ * Voice activity detector of the discontinuous transmission.
+ *
+ * A frame is speech when its energy is well above the level of the
+ * background noise, or a little above with a spectral tilt or zero
+ * crossing rate unlike those of the noise. The level of the noise is
+ * the lowest energy of the last second or two, its spectral features
+ * are tracked during the silences. Speech
+ * is held for a hangover after the last active frame so that the
+ * ends of words are not cut.
+ */
+class LIBMINISIP_API VadSilenceSensor : public SilenceSensor{
+	public:
+		VadSilenceSensor();
+		virtual bool silence(uint16_t *buf, int n);
+
+	private:
+		/* Features of the background noise: energy in dB,
+		 * normalized first autocorrelation and zero crossings
+		 * per sample */
+		float noiseEnergy;
+		float noiseTilt;
+		float noiseZcr;
+
+		/* Lowest energies of the current and previous windows */
+		float windowMin;
+		float prevWindowMin;
+		int windowFrames;
+
+		int nFrames;
+		int speechFrames;
+		int hangover;
+};
+
 #endif
@@ -33,6 +33,8 @@
 
 #include<iostream>
 
+class MediaClock;
+
 /**
 Define sound types, specially useful for the soundcard access
 SOUND_XNNYE
@@ -225,6 +227,14 @@ class LIBMINISIP_API SoundDevice: public MObject{
 		void setSleepTime( int sleep ) { sleepTime = sleep; };
 		int getSleepTime( ) { return sleepTime; };
 
+		/**
+		Clock pacing this device, or NULL if its reads and writes
+		block like those of a sound card. SoundIO drives a device
+		with a clock from the ticks of the clock, instead of from
+		player and recorder threads.
+		*/
+		virtual MRef<MediaClock *> getClock();
+
 	protected:
 		SoundDevice( std::string fileName );
 
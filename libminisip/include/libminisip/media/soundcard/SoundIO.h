@@ -31,6 +31,7 @@
 
 #include<libminisip/media/soundcard/SoundRecorderCallback.h>
 #include<libminisip/media/soundcard/AudioMixer.h>
+#include<libminisip/media/soundcard/MediaClock.h>
 class SoundIOPLCInterface;
 
 #include<libmutil/Mutex.h>
@@ -80,7 +81,7 @@ class LIBMINISIP_API RecorderReceiver{
  * @author Erik Eliasson eliasson@it.kth.se
  * @version 0.01
 */
-class LIBMINISIP_API SoundIO : public MObject{
+class LIBMINISIP_API SoundIO : public MObject, public MediaClockClient{
 
 	public:
 		/**
@@ -95,6 +96,9 @@ class LIBMINISIP_API SoundIO : public MObject{
 		 * @param format format of the audio samples (signed/unsigned, 
 		 * 		bytes per sample, endiannes). See SoundDevice.h
 		 * 		for a definition of valid types.
+		 *
+		 * If both devices have the same MediaClock, no player and
+		 * recorder threads are started, the clock runs tick().
 		 */
 		SoundIO(MRef<SoundDevice *> inputDevice, 
 			MRef<SoundDevice *> outputDevice,
@@ -193,8 +197,33 @@ class LIBMINISIP_API SoundIO : public MObject{
 		*/
 		bool setMixer(  std::string type );
 
+		/**
+		 * Records and plays one period, when driven by a
+		 * MediaClock: what the recorder and player threads
+		 * do in one iteration, without blocking.
+		 */
+		virtual void tick();
+
 	private:
 
+		/**
+		 * Copies the sources to play to playing, and opens
+		 * or closes playback when the first is added or the last
+		 * removed. If wait is set and there is no source, waits
+		 * for one to be added.
+		 */
+		void refreshSources( std::list<MRef<SoundSource *> > &playing,
+				int32_t &generation, bool &opened, bool wait );
+
+		/** Mixes playing and writes the result to the device */
+		void playFrame( std::list<MRef<SoundSource *> > &playing );
+
+		/**
+		 * Gives a recorded buffer to the recorder receivers.
+		 * right is the second channel, used by the AEC.
+		 */
+		void callRecorders( short *buf, short *right );
+
 		void send_to_card(short *buf, int32_t n_samples);
 
 		void cycle_sound_buffers();
@@ -225,6 +254,12 @@ class LIBMINISIP_API SoundIO : public MObject{
 		std::list<RecorderReceiver *> recorder_callbacks;
 
 		CondVar recorderCond;
+
+		/**
+		Guards recorder_callbacks against receivers added or
+		removed while recording, and recording for tick().
+		*/
+		Mutex recorderLock;
 		
                 volatile int32_t recorder_buffer_size;
 		
@@ -233,6 +268,14 @@ class LIBMINISIP_API SoundIO : public MObject{
 		
                 //pthread_mutex_t queueLock;
                 Mutex queueLock;
+
+		/**
+		Incremented whenever a source is added or removed, with
+		queueLock held, by a release store once the list changed.
+		playerLoop() reads it with an acquire load, and only takes
+		the lock to copy the list of sources when this changed.
+		*/
+		volatile int32_t sourcesGeneration;
 		
 		//int openCount;
 		//bool duplex;
@@ -244,6 +287,20 @@ class LIBMINISIP_API SoundIO : public MObject{
 
 		MRef<SoundDevice *> soundDevIn;
 		MRef<SoundDevice *> soundDevOut;
+
+		/**
+		Clock running tick(), NULL if the player and recorder
+		threads run instead.
+		*/
+		MRef<MediaClock *> clock;
+
+		/* State of tick(), see playerLoop() and recorderLoop() */
+		std::list<MRef<SoundSource *> > tickSources;
+		int32_t tickGeneration;
+		bool tickOpened;
+		short *tickBuffer;
+		short *tickLeft;
+		short *tickRight;
 		//AEC aec;
 
 };
@@ -41,6 +41,12 @@
 class LIBMINISIP_API SoundIOPLCInterface{
 
 	public:
+		/**
+		 * Returns a frame of sound in the format of the source,
+		 * or NULL to let the source fade out its last frame.
+		 * @param ret_size the number of frames wanted, set to
+		 * the number of frames returned
+		 */
 		virtual short *get_plc_sound(uint32_t &ret_size)=0;
 		virtual ~SoundIOPLCInterface() {}
 };
@@ -40,7 +40,7 @@
 
 #include<string>
 
-class CircularBuffer;
+class SPSCCircularBuffer;
 
 /**
 Definition of a SoundSource.
@@ -207,6 +207,11 @@ Simple implementation of an audio sound source.
 It has a circular buffer object, where we keep the audio samples.
 The mutation from mono input to stereo output, and from
 input frequency to output frequency is done in push/getSound().
+
+pushSound() is called by a single thread (the one receiving the
+RTP stream), and getSound() by the sound player thread only. They
+share nothing but the circular buffer, which needs no lock, so the
+player never waits for a packet being decoded or resampled.
 */
 class LIBMINISIP_API BasicSoundSource: public SoundSource{
         public:
@@ -286,23 +291,21 @@ class LIBMINISIP_API BasicSoundSource: public SoundSource{
 			We can set this even smaller ... but then we may have problems
 			if rtp packets come in burst  ... 
 		*/
-		CircularBuffer * cbuff;
+		SPSCCircularBuffer * cbuff;
 
 		short plcCache[2048];
 
 		int oFreq;
 
 		/**
-		Auxiliary buffer .. used both in pushSound() and getSound().
-		We need the mutex
+		Auxiliary buffer used by getSound().
 		*/
 		short *temp;
-		
+
 		/**
-		We lock access to the CircularBuffer object, as well as to the 
-		"temp" buffer
-		*/		
-		Mutex bufferLock;
+		Auxiliary buffer used by pushSound().
+		*/
+		short *pushTemp;
 		
 		/**
 		Output frame size ... that is, how many samples
@@ -29,6 +29,7 @@
 #include<libminisip/libminisip_config.h>
 
 #include<string>
+#include<list>
 
 #include<libminisip/media/video/ImageHandler.h>
 #include<libminisip/media/video/display/VideoDisplay.h>
@@ -51,6 +52,7 @@ class VideoEncoderCallback;
 class LIBMINISIP_API AVEncoder: public ImageHandler, public MObject{
 	public:
 		AVEncoder();
+		virtual ~AVEncoder();
 		virtual void handle( MImage * image );
 		virtual void init( uint32_t height, uint32_t width );
 		virtual MImage * provideImage();
@@ -86,14 +88,51 @@ class LIBMINISIP_API AVEncoder: public ImageHandler, public MObject{
 		void hdviper_h264_packetize_nal_unit(Video *v, unsigned char *h264_data, int size, int timecode, int last_nal_unit_of_frame);
 		void hdviper_h264_packetize(Video *v, int timecode);
 
+		/**
+		 * Returns a conversion context from the given source format
+		 * and size to I420 of the given size. Contexts are created
+		 * once per (format, size) pair and kept until close().
+		 */
+		void *getSwsContext( int srcFormat, uint32_t srcWidth, uint32_t srcHeight,
+				uint32_t dstWidth, uint32_t dstHeight );
+		void freeSwsContexts();
+
+		/**
+		 * Pool of encoder input frames, I420 of the encoder
+		 * size, 32 byte aligned. The frame of a Video is given
+		 * back when init() replaces it, and taken again if the
+		 * size did not change. The pool is emptied when the
+		 * size changes.
+		 */
+		uint8_t *takeFrame( size_t size );
+		void releaseFrame( uint8_t *frame );
+		void freeFrames();
+		std::list<uint8_t *> framePool;
+		size_t frameSize;
+
+		struct SwsCacheEntry{
+			int srcFormat;
+			uint32_t srcWidth;
+			uint32_t srcHeight;
+			uint32_t dstWidth;
+			uint32_t dstHeight;
+			void *ctx;
+		};
+		std::list<SwsCacheEntry> swsCache;
+
 
 		VideoEncoderCallback * callback;
 	 	byte_t outBuffer[AVCODEC_MAX_VIDEO_FRAME_SIZE];
 
 		MRef<VideoDisplay*> localDisplay;
 
-		void *swsctx;
 		int N;
+		/* Heap allocations of the encoder (Video, codec, frames,
+		 * output buffers and conversion contexts), counted where
+		 * made, and I420 frames given to the encoder in place.
+		 * Both are reported with FPS_ENCODE */
+		int nAllocations;
+		int nZeroCopyFrames;
 		int profile;
 		uint32_t width;
 		uint32_t height;
@@ -124,6 +124,9 @@ class LIBMINISIP_API VideoDisplayRegistry: public MPluginRegistry, public MSingl
 	public:
 		virtual std::string getPluginType(){ return "VideoDisplay"; }
 
+		/** Displays are looked up by name */
+		virtual bool isLazy() const{ return true; }
+
 		MRef<VideoDisplay*> createDisplay( uint32_t width, uint32_t height, bool doStart, bool fullscreen );
 		void signalDisplayDeleted();
 
@@ -75,6 +75,9 @@ class LIBMINISIP_API GrabberRegistry: public MPluginRegistry, public MSingleton<
 	public:
 		virtual std::string getPluginType(){ return "Grabber"; }
 
+		/** Grabbers are looked up by name */
+		virtual bool isLazy() const{ return true; }
+
 		MRef<Grabber*> createGrabber( std::string deviceName );
 
 	protected:
@@ -0,0 +1,89 @@
+/*
+ Copyright (C) 2004-2006 the Minisip Team
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#ifndef IMAGE_COMPOSITOR_H
+#define IMAGE_COMPOSITOR_H
+
+#include<libminisip/libminisip_config.h>
+
+#include<libminisip/media/video/ImageHandler.h>
+
+#include<vector>
+
+#define COMPOSITOR_LAYOUT_ACTIVE_SPEAKER 0
+#define COMPOSITOR_LAYOUT_GRID           1
+
+/**
+ * Composites several I420 images into one output frame.
+ *
+ * In the active speaker layout the main image is kept full size and
+ * the other sources are drawn as thumbnails along its bottom edge.
+ * In the grid layout the main image is scaled (in place) into the
+ * first tile and the other sources fill the following tiles.
+ *
+ * Images are downscaled with a box (area average) filter, one pass
+ * per plane. The common 2:1 case uses SSE2 when available.
+ */
+class LIBMINISIP_API ImageCompositor{
+	public:
+		ImageCompositor();
+
+		void setLayout( int layout );
+		int getLayout(){ return layout; }
+
+		/**
+		 * Draws the n images in sources on top of main.
+		 * NULL entries in sources are skipped. The width and
+		 * height fields of all images must be set.
+		 */
+		void compose( MImage * main, MImage ** sources, uint32_t n );
+
+		/**
+		 * Scales the I420 image src into the rectangle
+		 * (x, y, w, h) of dst. The rectangle must lie within dst
+		 * and have even coordinates.
+		 */
+		void scaleInto( MImage * src, MImage * dst,
+				uint32_t x, uint32_t y, uint32_t w, uint32_t h );
+
+		/**
+		 * Scales one 8 bit plane. src and dst may be the same
+		 * buffer if dst starts at the same address and is not
+		 * larger than src.
+		 */
+		void scalePlane( const uint8_t * src, int srcStride,
+				uint32_t srcWidth, uint32_t srcHeight,
+				uint8_t * dst, int dstStride,
+				uint32_t dstWidth, uint32_t dstHeight );
+
+	private:
+		void composeActiveSpeaker( MImage * main, MImage ** sources, uint32_t n );
+		void composeGrid( MImage * main, MImage ** sources, uint32_t n );
+		void fill( MImage * dst, uint32_t x, uint32_t y, uint32_t w, uint32_t h );
+
+		int layout;
+
+		/* Scratch state reused between frames */
+		std::vector<uint16_t> acc;
+		std::vector<uint32_t> runningSum;
+		std::vector<uint32_t> spanStart;
+		std::vector<uint32_t> spanLength;
+		std::vector<uint32_t> reciprocal;
+};
+
+#endif
@@ -28,6 +28,7 @@
 #include<libminisip/libminisip_config.h>
 
 #include<libminisip/media/video/ImageHandler.h>
+#include<libminisip/media/video/mixer/ImageCompositor.h>
 
 #include<libmutil/MemObject.h>
 #include<libmutil/Mutex.h>
@@ -58,6 +59,13 @@ class LIBMINISIP_API ImageMixer : public ImageHandler, public MObject{
 
 		virtual void mix( MImage * image );
 
+		/**
+		 * Selects how the other sources are drawn on the main
+		 * source, COMPOSITOR_LAYOUT_ACTIVE_SPEAKER (default) or
+		 * COMPOSITOR_LAYOUT_GRID.
+		 */
+		void setLayout( int layout );
+
 		void setMedia( MRef<VideoMedia *> media );
 
 		virtual std::string getMemObjectType() const {return "ImageMixer";};
@@ -77,6 +85,8 @@ class LIBMINISIP_API ImageMixer : public ImageHandler, public MObject{
 		MImage * images[MAX_SOURCES];
 		uint32_t nImagesToMix;
 
+		ImageCompositor compositor;
+
 		
 };
 
@@ -150,6 +150,14 @@ class LIBMINISIP_API DefaultDialogHandler : public SipDefaultHandler {
 		void sendIM(std::string msg, int seqno, std::string toUri);
 			
 		MRef<SipIdentity *> lookupTarget(const SipUri &uri);
+
+		/**
+		 * Creates the media session of an incoming INVITE. If it
+		 * could not be created the INVITE is answered with 500.
+		 * @return the session, or NULL if the call was refused
+		 */
+		MRef<Session *> createMediaSession(MRef<SipRequest*> inv,
+				MRef<SipIdentity *> id);
 };
 
 #endif
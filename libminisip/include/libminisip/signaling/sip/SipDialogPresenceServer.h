@@ -40,6 +40,18 @@
 
 #include<libmsip/SipDialog.h>
 #include<libmsip/SipResponse.h>
+#include<libmsip/SipMessageContent.h>
+
+#include<deque>
+
+/* Default time during which changes of the local presence are
+ * merged into one notification, in milliseconds */
+#define PRESENCE_COALESCE_WINDOW 500
+
+/* Default number of NOTIFY requests sent per batch, and time
+ * between batches in milliseconds */
+#define PRESENCE_NOTIFY_BATCH 100
+#define PRESENCE_NOTIFY_INTERVAL 50
 
 
 class Session;
@@ -61,14 +73,28 @@ class LIBMINISIP_API SipDialogPresenceServer: public SipDialog{
 
 		void setUpStateMachine();
 
+		/**
+		 * Changes of the local presence within windowMs of the
+		 * first one are sent as one notification with the last
+		 * status. Zero sends each change at once.
+		 */
+		void setCoalesceWindow( int32_t windowMs );
+
+		/**
+		 * Limits the notifications of a change to batchSize
+		 * NOTIFY requests every intervalMs.
+		 */
+		void setNotifyRate( int32_t batchSize, int32_t intervalMs );
+
 	private:
-		void sendNoticeToAll( std::string onlineStatus);
-		void sendNotice( std::string onlinestatus,  std::string user);
+		void sendNoticeToAll();
+		void sendNoticeBatch();
+		void sendNotice( std::string user, int queue );
 		void sendSubscribeOk(MRef<SipRequest*> sub);
 		void removeUser( std::string user);
 		void addUser( std::string user);
-		
-		void sendNotify(std::string toUri,  std::string callId);
+
+		MRef<SipMessageContent*> getPresenceContent();
 
 		bool a0_start_default_startpresenceserver(const SipSMCommand &command);
 		bool a1_default_default_timerremovesubscriber(const SipSMCommand &command);
@@ -76,12 +102,28 @@ class LIBMINISIP_API SipDialogPresenceServer: public SipDialog{
 		bool a3_default_termwait_stoppresenceserver(const SipSMCommand &command);
 		bool a4_termwait_terminated_notransactions(const SipSMCommand &command);
 		bool a5_default_default_SUBSCRIBE(const SipSMCommand &command);
+		bool a6_default_default_timerpresenceflush(const SipSMCommand &command);
+		bool a7_default_default_timerpresencebatch(const SipSMCommand &command);
 
 		bool useSTUN;
 		minilist< std::string> subscribing_users;
 		Mutex usersLock;
 
 		std::string onlineStatus;
+
+		/* The presence document of onlineStatus, rendered once
+		 * and shared by all NOTIFY requests sending it */
+		MRef<SipMessageContent*> presenceContent;
+		std::string presenceContentStatus;
+
+		/* Subscribers not yet notified of the last change */
+		std::deque<std::string> pendingNotices;
+
+		int32_t coalesceWindow;
+		int32_t notifyBatch;
+		int32_t notifyInterval;
+		bool flushPending;
+		bool batchPending;
 };
 
 #endif
@@ -117,6 +117,35 @@ class LIBMINISIP_API SipSoftPhoneConfiguration : public MObject{
 
 		bool useAnat;
 		bool useIpv6;
+
+		/**
+		 * Diffie-Hellman key pairs generated in advance for each
+		 * group used by MIKEY and ZRTP, and the number of keys left
+		 * below which a warning is logged. Zero disables the pool.
+		 */
+		uint32_t dhPoolSize;
+		uint32_t dhPoolLowWater;
+
+		/**
+		 * Seconds a verified peer certificate chain is trusted
+		 * without verifying it again. Zero disables the cache.
+		 */
+		uint32_t certCacheMaxAge;
+
+		/**
+		 * Milliseconds during which changes of the local presence
+		 * are merged into one notification, and NOTIFY requests
+		 * sent to subscribers per batch (one batch every
+		 * PRESENCE_NOTIFY_INTERVAL ms).
+		 */
+		uint32_t presenceCoalesceWindow;
+		uint32_t presenceNotifyBatch;
+
+		/**
+		 * Bytes of a file sent per MSRP SEND request. Zero uses
+		 * the default chunk size of the MSRP sender.
+		 */
+		uint32_t msrpChunkSize;
 		
 		std::string soundDeviceIn;
 		std::string soundDeviceOut;
@@ -143,6 +172,19 @@ class LIBMINISIP_API SipSoftPhoneConfiguration : public MObject{
 // 		bool muteAllButOne;
 		
 		std::string soundIOmixerType;
+
+		/**
+		 * Discontinuous transmission: silences are not sent to
+		 * the peers that accept comfort noise.
+		 */
+		bool useDtx;
+
+		/**
+		 * RTP/RTCP port pairs bound in advance, with their
+		 * external port, for the new sessions. Zero disables
+		 * the pool.
+		 */
+		uint32_t rtpPortPoolSize;
 		
 		/**
 		Start up commands, specified in the config file.
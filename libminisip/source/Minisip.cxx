@@ -52,6 +52,7 @@
 #include<libmutil/MessageRouter.h>
 #include<libmutil/MPlugin.h>
 #include<libmutil/Library.h>
+#include<libmutil/mtime.h>
 
 #include<libmnetutil/UDPSocket.h>
 #include<libmnetutil/NetworkFunctions.h>
@@ -59,6 +60,9 @@
 #include<libmnetutil/NetworkException.h>
 
 #include<libmcrypto/init.h>
+#include<libmcrypto/DhKeyPool.h>
+#include<libmcrypto/CertificateChainCache.h>
+#include<libmcrypto/OakleyDH.h>
 #include<libmnetutil/init.h>
 
 #include<libmikey/KeyAgreementDH.h>
@@ -77,6 +81,7 @@
 #include<libminisip/signaling/conference/ConferenceControl.h>
 #include<libminisip/signaling/conference/ConfCallback.h>
 #include<libminisip/config/ConfBackend.h>
+#include<libminisip/config/UserConfig.h>
 #include<libminisip/contacts/PhoneBook.h>
 #include<libminisip/signaling/conference/ConfMessageRouter.h>
 #include<libminisip/media/soundcard/SoundDriverRegistry.h>
@@ -127,6 +132,27 @@ static void signal_handler( int signal ){
 
 bool Minisip::pluginsLoaded=false;
 
+/* Time taken by each phase of the start up, written to mdbg("init") at
+ * the end of startSip */
+static list< pair<string, uint64_t> > startupTimes;
+
+static void startupPhase( const string &phase, uint64_t start ){
+	startupTimes.push_back( make_pair( phase, mtime() - start ) );
+}
+
+static void reportStartupTimes(){
+	list< pair<string, uint64_t> >::iterator i;
+	uint64_t total = 0;
+
+	mdbg("init") << "Startup times:";
+	for( i = startupTimes.begin(); i != startupTimes.end(); i++ ){
+		mdbg("init") << " " << i->first << " " << (int)i->second << " ms,";
+		total += i->second;
+	}
+	mdbg("init") << " total " << (int)total << " ms" << endl;
+	startupTimes.clear();
+}
+
 static string buildPluginPath( const string &argv0 ){
 	string pluginPath;
 	size_t pos = argv0.find_last_of(DIR_SEPARATOR);
@@ -152,6 +178,14 @@ static void loadPlugins(const string &argv0){
 
 	MRef<MPluginManager *> pluginManager = MPluginManager::getInstance();
 
+	// Keeps the plugins found in each library, so that the
+	// libraries of the config backends, resamplers, grabbers and
+	// displays not used are not opened at the next start.
+	// MINISIP_PLUGIN_CACHE="" turns the cache off.
+	const char *cache = getenv( "MINISIP_PLUGIN_CACHE" );
+	pluginManager->setManifestFile(
+		cache ? string( cache ) : UserConfig::getFileName( "minisip.plugins" ) );
+
 	string pluginPath;
 	const char *path = getenv( "MINISIP_PLUGIN_PATH" );
 
@@ -220,7 +254,9 @@ void Minisip::doLoadPlugins(char **argv){
 	mdbg("init") << "Loading plugins"<<endl;
 	#endif
 
+	uint64_t start = mtime();
 	loadPlugins( pluginPath );
+	startupPhase( "plugins", start );
 }
 
 /**
@@ -335,6 +371,8 @@ int Minisip::join(){
 
 	stopDebugger();
 
+	DhKeyPool::getInstance()->stop();
+
 	messageRouter->clear();
 	messageRouter=NULL;
 
@@ -374,6 +412,7 @@ int Minisip::startSip() {
 	}
 
 	try{
+		uint64_t start = mtime();
 		messageRouter =  new MessageRouter();
 		confMessageRouter =  new ConfMessageRouter();
 
@@ -385,6 +424,8 @@ int Minisip::startSip() {
 		if( phoneConf->useIpv6 ){
 			ip6Provider = IpProvider::create( phoneConf, true );
 		}
+		startupPhase( "ip provider", start );
+		start = mtime();
 		//#ifdef DEBUG_OUTPUT
 		//                mout << BOLD << "init 5/9: Creating SIP transport layer" << PLAIN << endl;
 		//#endif
@@ -418,6 +459,8 @@ int Minisip::startSip() {
 		if( ip6Provider )
 			phoneConf->sipStackConfig->localIp6String = ip6Provider->getExternalIp();
 		udpSocket=NULL;
+		startupPhase( "sip port", start );
+		start = mtime();
 
 #ifdef DEBUG_OUTPUT
 		mout << BOLD << "init 5/9: Creating MediaHandler" << PLAIN << endl;
@@ -432,9 +475,23 @@ int Minisip::startSip() {
 
 		//Session::registry = *mediaHandler; Moved to MediaHandler::MediaHandler
 
-		/* Hack: precompute a KeyAgreementDH */
-		//	Session::precomputedKa = new KeyAgreementDH( phoneConf->securityConfig.cert, 
-		//                phoneConf->securityConfig.cert_db, DH_GROUP_OAKLEY5 );
+		/* Generate the DH key pairs of MIKEY and ZRTP in the
+		 * background, ahead of the calls needing them */
+		if( phoneConf->dhPoolSize > 0 ){
+			MRef<DhKeyPool*> dhPool = DhKeyPool::getInstance();
+			dhPool->setPoolSize( DH_GROUP_OAKLEY5, phoneConf->dhPoolSize,
+					     phoneConf->dhPoolLowWater );
+#ifdef ZRTP_SUPPORT
+			dhPool->setPoolSize( DH_POOL_ZRTP3072, phoneConf->dhPoolSize,
+					     phoneConf->dhPoolLowWater );
+#endif
+			dhPool->start();
+		}
+
+		CertificateChainCache::getInstance()->setMaxAge(
+			phoneConf->certCacheMaxAge );
+		startupPhase( "media", start );
+		start = mtime();
 
 #ifdef DEBUG_OUTPUT
 		mout << BOLD << "init 6/9: Creating MSip SIP stack" << PLAIN << endl;
@@ -465,6 +522,8 @@ int Minisip::startSip() {
 #ifdef ZRTP_SUPPORT
 		ZrtpHostBridgeMinisip::initialize(sip->getSipStack()->getTimeoutProvider());
 #endif
+		startupPhase( "sip stack", start );
+		start = mtime();
 		/* Load the plugins at this stage */
 		//		int32_t pluginCount = MPlugin::loadFromDirectory( PLUGINS_PATH );
 
@@ -505,6 +564,8 @@ printf("---------------------- Minisip startSip Message Router setCallBack ");
 		gui->setConfCallback(*confMessageRouter);
 
 		sip->start(); //run as a thread ...
+		startupPhase( "gui and start", start );
+		reportStartupTimes();
 		//		sleep(5);
 
 		//		CommandString pupd("", SipCommandString::remote_presence_update,"someone@ssvl.kth.se","online","Working hard");
@@ -544,8 +605,10 @@ int Minisip::initParseConfig(){
 #ifdef DEBUG_OUTPUT
 			mout << BOLD << "init 3/9: Parsing configuration" << PLAIN << endl;
 #endif
+			uint64_t start = mtime();
 			MRef<ConfBackend *> confBackend =
 			ConfigRegistry::getInstance()->createBackend( confPath);
+			startupPhase( "config backend", start );
 			if( !confBackend ){
 				merr << "Minisip could not load a configuration" << endl << 
 					"back end. The application will now" << endl <<
@@ -553,7 +616,9 @@ int Minisip::initParseConfig(){
 				throw new MinisipBadArgument("The configured backend could not be loaded");
 				//::exit( 1 );
 			}
+			start = mtime();
 			string ret = phoneConf->load( confBackend );
+			startupPhase( "config load", start );
 
 			done = true;
 			retGlobal = 1; //for now, we finished ok ... check the return string
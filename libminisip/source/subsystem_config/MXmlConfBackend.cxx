@@ -30,10 +30,26 @@
 #include<libmutil/XMLParser.h>
 #include<libmutil/stringutils.h>
 
+#include<errno.h>
+#include<stdio.h>
 #include<stdlib.h>
+#include<string.h>
+
+#ifdef WIN32
+#include<windows.h>
+#include<fstream>
+#else
+#include<fcntl.h>
+#include<sys/stat.h>
+#include<unistd.h>
+#endif
 
 using namespace std;
 
+/* Buckets of the index of an empty file, doubled when there are more
+ * nodes than buckets */
+#define MXML_CONF_MIN_BUCKETS 256
+
 static std::list<std::string> pluginList;
 static bool initialized;
 
@@ -70,7 +86,16 @@ string searchReplace(const string &str,
 	return tmp;
 }
 
-MXmlConfBackend::MXmlConfBackend( const string& path ){
+/* FNV-1a */
+static size_t hashKey( const string &s ){
+	uint32_t h = 2166136261U;
+	for( size_t i = 0; i < s.size(); i++ ){
+		h = ( h ^ (unsigned char)s[i] ) * 16777619U;
+	}
+	return h;
+}
+
+MXmlConfBackend::MXmlConfBackend( const string& path ): indexSize( 0 ){
 
 	if (path.size()>0)
 		fileName = path;
@@ -89,70 +114,290 @@ MXmlConfBackend::MXmlConfBackend( const string& path ){
 		cerr << "Caught XMLException" << endl;
 		throw ConfBackendException();
 	}
+
+	buildIndex();
 }
 
 MXmlConfBackend::~MXmlConfBackend(){
 	delete parser;
 }
 
-void MXmlConfBackend::commit(){
-	parser->saveToFile( fileName );
+string MXmlConfBackend::canonicalKey( const string &key ){
+	string ret;
+	size_t i = 0;
+
+	ret.reserve( key.size() );
+	while( i < key.size() ){
+		size_t end = key.find( '/', i );
+		if( end == string::npos ){
+			end = key.size();
+		}
+
+		if( end > i ){
+			string part = key.substr( i, end - i );
+			if( part[ part.size() - 1 ] == ']' ){
+				size_t bracket = part.rfind( '[' );
+				if( bracket != string::npos ){
+					int32_t n = atoi( part.substr( bracket + 1 ).c_str() );
+					part = part.substr( 0, bracket );
+					if( n > 0 ){
+						part += "[" + itoa( n ) + "]";
+					}
+				}
+			}
+			if( !ret.empty() ){
+				ret += '/';
+			}
+			ret += part;
+		}
+		i = end + 1;
+	}
+
+	return ret;
 }
 
-void MXmlConfBackend::save( const std::string &key, const std::string &value ){
-	try{
-		string tmp = searchReplace( value, "&", "&amp;" );
-		string xmlStr = searchReplace( tmp, "<", "&lt;" );
-		parser->changeValue( key, xmlStr );
+void MXmlConfBackend::buildIndex(){
+	index.clear();
+	indexSize = 0;
+	rehash( MXML_CONF_MIN_BUCKETS );
+	indexChildren( "", parser->getRoot() );
+}
+
+void MXmlConfBackend::indexChildren( const string &prefix, XMLNode * parent ){
+	list<XMLNode *>::iterator i;
+	for( i = parent->subnodes.begin(); i != parent->subnodes.end(); i++ ){
+		indexNode( prefix, *i );
 	}
-	catch( XMLException &exc ){
-		mdbg << "MXmlConfBackend caught XMLException: " << exc.what() << endl;
-		throw ConfBackendException();
+}
+
+/* Numbers the nodes of a name in the order of the children, as
+ * XMLNode::getNode does, attributes included */
+void MXmlConfBackend::indexNode( const string &prefix, XMLNode * node ){
+	string key = prefix + node->getName();
+	IndexEntry * first = findEntry( key );
+
+	if( first ){
+		key += "[" + itoa( first->count ) + "]";
+		first->count++;
+		insertEntry( key, node, 0 );
 	}
-	
+	else{
+		insertEntry( key, node, 1 );
+	}
+
+	indexChildren( key + "/", node );
 }
 
-void MXmlConfBackend::save( const std::string &key, const int32_t value ){
-	try{
-		parser->changeValue( key, itoa( value ) );
+MXmlConfBackend::IndexEntry * MXmlConfBackend::findEntry( const string &key ){
+	IndexBucket &bucket = index[ hashKey( key ) % index.size() ];
+	for( size_t i = 0; i < bucket.size(); i++ ){
+		if( bucket[i].key == key ){
+			return &bucket[i];
+		}
 	}
-	catch( XMLException &exc ){
-		mdbg << "MXmlConfBackend caught XMLException: " << exc.what() << endl;
-		throw ConfBackendException();
+	return NULL;
+}
+
+void MXmlConfBackend::insertEntry( const string &key, XMLNode * node,
+		int32_t count ){
+	IndexEntry entry;
+	entry.key = key;
+	entry.node = node;
+	entry.count = count;
+	index[ hashKey( key ) % index.size() ].push_back( entry );
+
+	if( ++indexSize > index.size() ){
+		rehash( 2 * index.size() );
 	}
 }
 
+void MXmlConfBackend::rehash( size_t buckets ){
+	vector< IndexBucket > entries( buckets );
+	for( size_t i = 0; i < index.size(); i++ ){
+		for( size_t j = 0; j < index[i].size(); j++ ){
+			IndexEntry &entry = index[i][j];
+			entries[ hashKey( entry.key ) % buckets ].push_back( entry );
+		}
+	}
+	index.swap( entries );
+}
 
-std::string MXmlConfBackend::loadString( const std::string &key, const std::string &defaultValue ){
-	std::string ret = "";
-	
-	try{
-		string xmlStr = parser->getValue( key, defaultValue );
-		string tmp = searchReplace( xmlStr, "&lt;", "<" );
-		ret = searchReplace( tmp, "&amp;", "&" );
+XMLNode * MXmlConfBackend::lookUp( const string &key ){
+	IndexEntry * entry = findEntry( canonicalKey( key ) );
+	return entry ? entry->node : NULL;
+}
+
+/* Adds the missing elements of the key, where XMLParser::changeValue
+ * would: a new node is the last of its name, whatever the index asked
+ * for */
+XMLNode * MXmlConfBackend::addNode( const string &key ){
+	XMLNode * parent = parser->getRoot();
+	string prefix;
+	size_t i = 0;
+
+	while( i < key.size() ){
+		size_t end = key.find( '/', i );
+		if( end == string::npos ){
+			end = key.size();
+		}
+		string part = key.substr( i, end - i );
+		i = end + 1;
+
+		IndexEntry * entry = findEntry( prefix + part );
+		if( entry ){
+			parent = entry->node;
+			prefix += part + "/";
+			continue;
+		}
+
+		size_t bracket = part.find( '[' );
+		if( bracket != string::npos ){
+			part = part.substr( 0, bracket );
+		}
+
+		XMLNode * node = new XMLElement( part );
+		parent->addNode( node );
+		indexNode( prefix, node );
+
+		/* indexNode numbered the new node */
+		IndexEntry * first = findEntry( prefix + part );
+		if( first->node != node ){
+			part += "[" + itoa( first->count - 1 ) + "]";
+		}
+		parent = node;
+		prefix += part + "/";
 	}
-	catch( XMLException &exc ){
-		mdbg << "MXmlConfBackend caught XMLException: " << exc.what() << endl;
+
+	return parent;
+}
+
+void MXmlConfBackend::commit(){
+	if( dirtyKeys.empty() ){
+		return;
+	}
+
+	mdbg << "MXmlConfBackend: writing " << fileName << ", "
+	     << (int)dirtyKeys.size() << " keys changed" << endl;
+	writeFile( parser->xmlstring() );
+	dirtyKeys.clear();
+}
+
+void MXmlConfBackend::writeFile( const string &contents ){
+	string tmpName = fileName + ".tmp";
+
+#ifdef WIN32
+	{
+		ofstream file( tmpName.c_str(), ios::out | ios::binary | ios::trunc );
+		file << contents;
+		file.close();
+		if( !file ){
+			remove( tmpName.c_str() );
+			merr << "MXmlConfBackend: could not write " << tmpName << endl;
+			throw ConfBackendException();
+		}
+	}
+
+	if( !MoveFileExA( tmpName.c_str(), fileName.c_str(),
+			MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) ){
+		remove( tmpName.c_str() );
+		merr << "MXmlConfBackend: could not replace " << fileName << endl;
 		throw ConfBackendException();
 	}
+#else
+	/* Keeps the permissions of the file replaced, it holds
+	 * passwords */
+	mode_t mode = 0666;
+	bool exists = false;
+	struct stat st;
+	if( stat( fileName.c_str(), &st ) == 0 ){
+		mode = st.st_mode & 07777;
+		exists = true;
+	}
 
-	return ret;
+	int fd = open( tmpName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, mode );
+	if( fd < 0 ){
+		merr << "MXmlConfBackend: could not create " << tmpName << ": "
+		     << strerror( errno ) << endl;
+		throw ConfBackendException();
+	}
+	if( exists ){
+		fchmod( fd, mode );
+	}
 
-}
+	const char * data = contents.data();
+	size_t left = contents.size();
+	bool ok = true;
+	while( left > 0 ){
+		ssize_t n = write( fd, data, left );
+		if( n < 0 ){
+			if( errno == EINTR ){
+				continue;
+			}
+			ok = false;
+			break;
+		}
+		data += n;
+		left -= n;
+	}
 
-int32_t MXmlConfBackend::loadInt( const std::string &key,
-		                  const int32_t defaultValue ){
-	int32_t ret = -1;
-	
-	try{
-		ret = parser->getIntValue( key, defaultValue );
+	if( !ok || fsync( fd ) != 0 ){
+		ok = false;
 	}
-	catch( XMLException &exc ){
-		mdbg << "MXmlConfBackend caught XMLException: " << exc.what() << endl;
+	if( close( fd ) != 0 ){
+		ok = false;
+	}
+	if( ok && rename( tmpName.c_str(), fileName.c_str() ) != 0 ){
+		ok = false;
+	}
+	if( !ok ){
+		merr << "MXmlConfBackend: could not write " << fileName << ": "
+		     << strerror( errno ) << endl;
+		unlink( tmpName.c_str() );
 		throw ConfBackendException();
 	}
+#endif
+}
 
-	return ret;
+void MXmlConfBackend::save( const std::string &key, const std::string &value ){
+	string tmp = searchReplace( value, "&", "&amp;" );
+	string xmlStr = searchReplace( tmp, "<", "&lt;" );
+	string canonical = canonicalKey( key );
+
+	IndexEntry * entry = findEntry( canonical );
+	XMLNode * node;
+	if( entry ){
+		node = entry->node;
+		if( node->getValue() == xmlStr ){
+			return;
+		}
+	}
+	else{
+		node = addNode( canonical );
+	}
+
+	node->setValue( xmlStr );
+	dirtyKeys.insert( canonical );
+}
+
+void MXmlConfBackend::save( const std::string &key, const int32_t value ){
+	save( key, itoa( value ) );
+}
+
+
+std::string MXmlConfBackend::loadString( const std::string &key, const std::string &defaultValue ){
+	XMLNode * node = lookUp( key );
+	string xmlStr = node ? node->getValue() : defaultValue;
+	string tmp = searchReplace( xmlStr, "&lt;", "<" );
+	return searchReplace( tmp, "&amp;", "&" );
+}
+
+int32_t MXmlConfBackend::loadInt( const std::string &key,
+		                  const int32_t defaultValue ){
+	XMLNode * node = lookUp( key );
+	if( !node ){
+		return defaultValue;
+	}
+	return atoi( node->getValue().c_str() );
 }
 
 string MXmlConfBackend::getDefaultConfigFilename(){
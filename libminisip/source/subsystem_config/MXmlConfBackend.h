@@ -27,8 +27,27 @@
 
 #include<libminisip/config/ConfBackend.h>
 
+#include<set>
+#include<vector>
+
 class XMLFileParser;
+class XMLNode;
 
+/**
+ * Configuration stored in an XML file.
+ *
+ * The file is parsed once, and the nodes of the tree are indexed in a
+ * hash table by their full key ("account[1]/proxy_addr"), so that a
+ * load does not walk the path through the lists of children. The keys
+ * are compared in a canonical form, without leading or trailing '/'
+ * and without the index [0], so that "account/sip_uri" and
+ * "/account[0]/sip_uri" are the same key, as they are for XMLParser.
+ *
+ * A save only changes the tree and marks the key dirty when the value
+ * differs. commit() does nothing when no key is dirty, and otherwise
+ * writes the file to a temporary file renamed over it, so that a crash
+ * leaves either the old or the new configuration.
+ */
 class MXmlConfBackend : public ConfBackend {
 	public:
 		MXmlConfBackend(const std::string &path);
@@ -48,9 +67,33 @@ class MXmlConfBackend : public ConfBackend {
 
 		 std::string getMemObjectType() const {return "MXmlConfBackend";}
 	private:
+		/* The entry of "p/n" also counts the nodes n below p */
+		struct IndexEntry{
+			std::string key;
+			XMLNode * node;
+			int32_t count;
+		};
+		typedef std::vector< IndexEntry > IndexBucket;
+
 		std::string getDefaultConfigFilename();
+		static std::string canonicalKey( const std::string &key );
+		void buildIndex();
+		void indexChildren( const std::string &prefix, XMLNode * parent );
+		void indexNode( const std::string &prefix, XMLNode * node );
+		IndexEntry * findEntry( const std::string &key );
+		void insertEntry( const std::string &key, XMLNode * node,
+				int32_t count );
+		void rehash( size_t buckets );
+		XMLNode * lookUp( const std::string &key );
+		XMLNode * addNode( const std::string &key );
+		void writeFile( const std::string &contents );
+
 		std::string fileName;
 		XMLFileParser * parser;
+
+		std::vector< IndexBucket > index;
+		size_t indexSize;
+		std::set< std::string > dirtyKeys;
 };
 
 class MXmlConfigPlugin : public ConfigPlugin{
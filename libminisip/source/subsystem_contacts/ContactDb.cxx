@@ -28,18 +28,32 @@
 #include<libminisip/contacts/PhoneBook.h>
 
 #include<stdlib.h>
+#include<ctype.h>
+#include<string.h>
+
+/* Buckets of the hash tables of an empty database, doubled when
+ * there are more entries than buckets */
+#define CONTACT_DB_MIN_BUCKETS 64
 
 using namespace std;
 
 MRef<ContactDb *> ContactEntry::db = NULL;
 
+/* Ids are random, but unique in the database */
+static uint32_t newId( MRef<ContactDb *> db ){
+	uint32_t id;
+	do{
+		id = rand();
+	} while( !db.isNull() && db->lookUp( id ) );
+	return id;
+}
+
 ContactEntry::ContactEntry():person(NULL), onlineStatus(CONTACT_STATUS_UNKNOWN){
+        personIndex = 0;
+	id = newId( db );
 	if( ! db.isNull() ){
 		db->addEntry( this );
 	}
-        personIndex = 0;
-	id = rand();
-
 }
 
 ContactEntry::ContactEntry( string uri_, string desc_, 
@@ -47,14 +61,13 @@ ContactEntry::ContactEntry( string uri_, string desc_,
 	uri(uri_),
 	desc(desc_),
 	person(p),
+	personIndex(0),
 	onlineStatus(CONTACT_STATUS_UNKNOWN){
 	
-	
+	id = newId( db );
 	if( ! db.isNull() ){
                 db->addEntry( this );
         }
-        
-	id = rand();
 }
 
 ContactEntry::~ContactEntry(){
@@ -92,51 +105,359 @@ void ContactEntry::setDesc( string d ){
 }
 
 void ContactEntry::setUri( string u ){
+	/* The entry is indexed by its URI */
+	if( ! db.isNull() ){
+		db->delEntry( this );
+	}
 	this->uri = u;
+	if( ! db.isNull() ){
+		db->addEntry( this );
+	}
+}
+
+/* FNV-1a */
+static size_t hashString( const string &s ){
+	uint32_t h = 2166136261u;
+	for( size_t i = 0; i < s.size(); i++ ){
+		h = ( h ^ (unsigned char)s[i] ) * 16777619u;
+	}
+	return h;
+}
+
+static size_t hashId( uint32_t id ){
+	return id * 2654435761u;
+}
+
+static string lowerCase( const string &s ){
+	string r( s );
+	for( size_t i = 0; i < r.size(); i++ ){
+		r[i] = (char)tolower( (unsigned char)r[i] );
+	}
+	return r;
+}
+
+static bool startsWithNoCase( const string &s, const char *prefix ){
+	size_t n = strlen( prefix );
+	return s.size() >= n && lowerCase( s.substr( 0, n ) ) == prefix;
+}
+
+/* The URI without the display name, the angle brackets and the
+ * surrounding spaces */
+static string bareUri( const string &uri ){
+	size_t lt = uri.find( '<' );
+	if( lt != string::npos ){
+		size_t gt = uri.find( '>', lt );
+		return uri.substr( lt + 1, gt == string::npos ? string::npos : gt - lt - 1 );
+	}
+
+	size_t b = uri.find_first_not_of( " \t" );
+	size_t e = uri.find_last_not_of( " \t" );
+	if( b == string::npos ){
+		return "";
+	}
+	return uri.substr( b, e - b + 1 );
 }
 
+string ContactDb::normalizeUri( const string &uri ){
+	string s = bareUri( uri );
 
-ContactDb::ContactDb(){
+	if( startsWithNoCase( s, "sip:" ) ){
+		s = s.substr( 4 );
+	}
+	else if( startsWithNoCase( s, "sips:" ) ){
+		s = s.substr( 5 );
+	}
+
+	size_t at = s.rfind( '@' );
+	if( at == string::npos ){
+		/* tel: and other URIs without a host, or a bare host */
+		return lowerCase( s.substr( 0, s.find_first_of( ";?" ) ) );
+	}
+
+	string user = s.substr( 0, at );
+	string host = s.substr( at + 1 );
+
+	user = user.substr( 0, user.find( ';' ) );
+	host = host.substr( 0, host.find_first_of( ";?" ) );
+	if( !host.empty() && host[0] == '[' ){
+		host = host.substr( 0, host.find( ']' ) + 1 );
+	}
+	else{
+		host = host.substr( 0, host.find( ':' ) );
+	}
+
+	return user + "@" + lowerCase( host );
+}
+
+/* The digits of a telephone subscriber, empty if it has other
+ * characters than the visual separators */
+static string digitsOf( const string &number ){
+	string digits;
+	size_t i = 0;
+
+	if( !number.empty() && number[0] == '+' ){
+		i++;
+	}
+	for( ; i < number.size(); i++ ){
+		char c = number[i];
+		if( c >= '0' && c <= '9' ){
+			digits += c;
+		}
+		else if( !strchr( "-.() ", c ) ){
+			return "";
+		}
+	}
+	return digits;
+}
+
+string ContactDb::numberDigits( const string &uri ){
+	string s = bareUri( uri );
+
+	if( startsWithNoCase( s, "tel:" ) ){
+		return digitsOf( s.substr( 4, s.find_first_of( ";?" ) - 4 ) );
+	}
+
+	bool sip = false;
+	if( startsWithNoCase( s, "sip:" ) ){
+		s = s.substr( 4 );
+		sip = true;
+	}
+	else if( startsWithNoCase( s, "sips:" ) ){
+		s = s.substr( 5 );
+		sip = true;
+	}
+
+	size_t at = s.rfind( '@' );
+	if( at == string::npos ){
+		/* A bare number, as in the telephone attributes of
+		 * LDAP phone books */
+		return sip ? "" : digitsOf( s );
+	}
+
+	/* Only global numbers and users marked as telephone numbers,
+	 * an extension of one host is not that of another */
+	string user = s.substr( 0, at );
+	string params = lowerCase( s.substr( at ) );
+	if( ( !user.empty() && user[0] == '+' ) ||
+			params.find( ";user=phone" ) != string::npos ){
+		return digitsOf( user.substr( 0, user.find( ';' ) ) );
+	}
+	return "";
+}
+
+ContactDb::ContactDb(): count( 0 ){
+	rehash( CONTACT_DB_MIN_BUCKETS );
+
+	DigitNode root;
+	memset( &root, 0, sizeof( root ) );
+	root.entries = -1;
+	digitTrie.push_back( root );
+}
+
+ContactDb::~ContactDb(){
+}
+
+void ContactDb::rehash( size_t buckets ){
+	vector< IdBucket > ids( buckets );
+	vector< UriBucket > uris( buckets );
+	size_t i, j;
+
+	/* Entries keep their order within a bucket */
+	for( i = 0; i < idIndex.size(); i++ ){
+		for( j = 0; j < idIndex[i].size(); j++ ){
+			ContactEntry * e = idIndex[i][j];
+			ids[ hashId( e->getId() ) % buckets ].push_back( e );
+		}
+	}
+	for( i = 0; i < uriIndex.size(); i++ ){
+		for( j = 0; j < uriIndex[i].size(); j++ ){
+			const string &key = uriIndex[i][j].first;
+			uris[ hashString( key ) % buckets ].push_back( uriIndex[i][j] );
+		}
+	}
+
+	idIndex.swap( ids );
+	uriIndex.swap( uris );
+}
+
+void ContactDb::addNumber( const string &digits, ContactEntry * entry ){
+	int32_t node = 0;
+
+	for( size_t i = 0; i < digits.size(); i++ ){
+		int d = digits[i] - '0';
+		if( digitTrie[node].child[d] == 0 ){
+			DigitNode n;
+			memset( &n, 0, sizeof( n ) );
+			n.entries = -1;
+			digitTrie.push_back( n );
+			digitTrie[node].child[d] = (int32_t)digitTrie.size() - 1;
+		}
+		node = digitTrie[node].child[d];
+	}
+
+	if( digitTrie[node].entries < 0 ){
+		digitTrie[node].entries = (int32_t)numberEntries.size();
+		numberEntries.push_back( vector< ContactEntry * >() );
+	}
+	numberEntries[ digitTrie[node].entries ].push_back( entry );
+}
+
+void ContactDb::delNumber( const string &digits, ContactEntry * entry ){
+	int32_t node = 0;
+
+	for( size_t i = 0; i < digits.size(); i++ ){
+		node = digitTrie[node].child[ digits[i] - '0' ];
+		if( node == 0 ){
+			return;
+		}
+	}
+
+	if( digitTrie[node].entries >= 0 ){
+		vector< ContactEntry * > &v = numberEntries[ digitTrie[node].entries ];
+		for( size_t i = 0; i < v.size(); i++ ){
+			if( v[i] == entry ){
+				v.erase( v.begin() + i );
+				break;
+			}
+		}
+	}
 }
 
 void ContactDb::addEntry( ContactEntry * entry ){
-	entries.push_back( entry );
+	string uri = entry->getUri();
+	string key = normalizeUri( uri );
+	string digits = numberDigits( uri );
+
+	lock.lock();
+	idIndex[ hashId( entry->getId() ) % idIndex.size() ].push_back( entry );
+	uriIndex[ hashString( key ) % uriIndex.size() ].push_back( make_pair( key, entry ) );
+	if( !digits.empty() ){
+		addNumber( digits, entry );
+	}
+	count++;
+	if( count > idIndex.size() ){
+		rehash( 2 * idIndex.size() );
+	}
+	lock.unlock();
 }
 
 void ContactDb::delEntry( ContactEntry * entry ){
-	list< ContactEntry * >::iterator i;
+	string uri = entry->getUri();
+	string key = normalizeUri( uri );
+	string digits = numberDigits( uri );
+	size_t i;
+
+	lock.lock();
+	IdBucket &ids = idIndex[ hashId( entry->getId() ) % idIndex.size() ];
+	for( i = 0; i < ids.size(); i++ ){
+		if( ids[i] == entry ){
+			ids.erase( ids.begin() + i );
+			count--;
+			break;
+		}
+	}
 
-	for( i = entries.begin(); i != entries.end(); i++ ){
-		if( (*i)->getId() == entry->getId() ){
-			i = entries.erase( i );
+	UriBucket &uris = uriIndex[ hashString( key ) % uriIndex.size() ];
+	for( i = 0; i < uris.size(); i++ ){
+		if( uris[i].second == entry ){
+			uris.erase( uris.begin() + i );
+			break;
 		}
 	}
+
+	if( !digits.empty() ){
+		delNumber( digits, entry );
+	}
+	lock.unlock();
 }
 
-ContactEntry * ContactDb::lookUp( string uri ){
+size_t ContactDb::size(){
+	size_t n;
 
-	list<ContactEntry *>::iterator i;
+	lock.lock();
+	n = count;
+	lock.unlock();
+	return n;
+}
 
-        for( i = entries.begin(); i != entries.end(); i++ ){
-                if( (*i)->getUri() == uri ){
-                        return *i;
-                }
-        }
+ContactEntry * ContactDb::findUri( const string &key ){
+	UriBucket &uris = uriIndex[ hashString( key ) % uriIndex.size() ];
 
-        return NULL;
+	for( size_t i = 0; i < uris.size(); i++ ){
+		if( uris[i].first == key ){
+			return uris[i].second;
+		}
+	}
+	return NULL;
 }
 
-ContactEntry * ContactDb::lookUp( uint32_t id ){
+ContactEntry * ContactDb::findNumber( const string &digits, bool prefix ){
+	ContactEntry * best = NULL;
+	int32_t node = 0;
 
-	list< ContactEntry * >::iterator i;
+	for( size_t i = 0; i < digits.size(); i++ ){
+		node = digitTrie[node].child[ digits[i] - '0' ];
+		if( node == 0 ){
+			return best;
+		}
 
-        for( i = entries.begin(); i != entries.end(); i++ ){
-                if( (*i)->getId() == id ){
-                        return *i;
-                }
-        }
+		int32_t e = digitTrie[node].entries;
+		if( e >= 0 && !numberEntries[e].empty() &&
+				( prefix || i == digits.size() - 1 ) ){
+			best = numberEntries[e].front();
+		}
+	}
+	return best;
+}
+
+ContactEntry * ContactDb::lookUp( string uri ){
+	string key = normalizeUri( uri );
+	ContactEntry * entry = NULL;
+
+	if( key.empty() ){
+		return NULL;
+	}
+
+	lock.lock();
+	entry = findUri( key );
+	lock.unlock();
+
+	if( !entry ){
+		string digits = numberDigits( uri );
+		if( !digits.empty() ){
+			lock.lock();
+			entry = findNumber( digits, false );
+			lock.unlock();
+		}
+	}
+	return entry;
+}
 
-        return NULL;
+ContactEntry * ContactDb::lookUp( uint32_t id ){
+	ContactEntry * entry = NULL;
+
+	lock.lock();
+	IdBucket &ids = idIndex[ hashId( id ) % idIndex.size() ];
+	for( size_t i = 0; i < ids.size(); i++ ){
+		if( ids[i]->getId() == id ){
+			entry = ids[i];
+			break;
+		}
+	}
+	lock.unlock();
+	return entry;
 }
 
+ContactEntry * ContactDb::lookUpNumber( string number ){
+	string digits = numberDigits( number );
+	ContactEntry * entry;
 
+	if( digits.empty() ){
+		return NULL;
+	}
+
+	lock.lock();
+	entry = findNumber( digits, true );
+	lock.unlock();
+	return entry;
+}
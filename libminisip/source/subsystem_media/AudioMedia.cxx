@@ -31,6 +31,7 @@
 #include<libminisip/media/soundcard/FileSoundSource.h>
 
 #include<libminisip/media/soundcard/Resampler.h>
+#include<libminisip/media/soundcard/SilenceSensor.h>
 #include<libminisip/media/soundcard/SoundSource.h>
 
 #include<libminisip/media/rtp/RtpPacket.h>
@@ -58,9 +59,6 @@
 #endif
 
 class G711CODEC;
-#ifdef AEC_SUPPORT
-AEC AudioMedia::aec;		//hanning
-#endif
 
 #ifdef _WIN32_WCE
 #	include"../include/minisip_wce_extra_includes.h"
@@ -75,7 +73,11 @@ using namespace std;
 AudioMedia::AudioMedia( MRef<SoundIO *> soundIo_, 
 			const std::list<MRef<Codec *> > & codecList_):
 							RealtimeMedia(codecList_)//,
-							/*soundIo(soundIo_)*/{
+							/*soundIo(soundIo_)*/
+#ifdef AEC_SUPPORT
+							, aec( SOUND_CARD_FREQ, SOUND_CARD_FREQ * 20 / 1000 )
+#endif
+							{
 						
 	soundIo = soundIo_;
 	// for audio media, we assume that we can both send and receive
@@ -92,6 +94,16 @@ AudioMedia::AudioMedia( MRef<SoundIO *> soundIo_,
 	
 	// NOTE Sampling frequency FIXED to 8000 Hz
 	resampler = ResamplerRegistry::getInstance()->create( SOUND_CARD_FREQ, 8000, 20, 1 /*Nb channels */);
+
+	// The estimate of the noise has its own resampler, the state
+	// of the one of the encoders must not be disturbed
+	dtx = false;
+	silenceSensor = new VadSilenceSensor();
+	comfortNoiseResampler = ResamplerRegistry::getInstance()->create( SOUND_CARD_FREQ, 8000, 20, 1 );
+}
+
+AudioMedia::~AudioMedia(){
+	delete silenceSensor;
 }
 
 string AudioMedia::getSdpMediaType(){
@@ -173,13 +185,17 @@ void AudioMedia::srcb_handleSound( void * data, int nsamples, int samplerate){
 
 #ifdef AEC_SUPPORT
 void AudioMedia::srcb_handleSound( void * data, int length, void * dataR){				//hanning
-	resampler->resample( (short *)data, resampledData );
-	resampler->resample( (short *)dataR, resampledDataR );
-
-	for(int j=0; j<160; j++){
-		resampledData[j] = (short)aec.doAEC((int)resampledData[j], (int)resampledDataR[j]);
+	// The loudspeaker signal is recorded on the right channel,
+	// there is none with a mono device
+	if( dataR == NULL ){
+		srcb_handleSound( data, length, SOUND_CARD_FREQ );
+		return;
 	}
-	sendData( (byte_t*) &resampledData, 160*sizeof(short), 0, false );
+
+	// Cancelled at the sound card rate, before the resampling
+	// to the rate of the codec done by sendData
+	aec.process( (short *)data, (short *)dataR, aecData );
+	sendData( (byte_t*) aecData, length, SOUND_CARD_FREQ, 0, false );
 	seqNo ++;
 }
 #endif
@@ -194,6 +210,9 @@ void AudioMedia::sendData( byte_t * data, uint32_t nsamples, int samplerate, uin
 	bool encodeZeroData;
 	
 	uint32_t encodedLength;
+
+	bool silent = false;
+	uint32_t comfortNoiseLength = 0;
 	
 	if( ! zeroDataInit ) {
 		zeroDataInit = true;
@@ -203,6 +222,24 @@ void AudioMedia::sendData( byte_t * data, uint32_t nsamples, int samplerate, uin
 	list< MRef<RealtimeMediaStreamSender *> >::iterator i;
 	list< MRef<RealtimeMediaStreamReceiver *> >::iterator ir;
 	list< MRef<Session*> >::iterator is;
+
+	// Discontinuous transmission. Not while forwarding media, the
+	// audio of the other calls is then mixed per sender.
+	if( dtx && !mediaForwarding ){
+		silent = silenceSensor->silence( (uint16_t *)data, nsamples );
+	}
+	if( silent ){
+		short *noise = (short *)data;
+		int32_t noiseSamples = nsamples * 8000 / SOUND_CARD_FREQ;
+
+		if( SOUND_CARD_FREQ != 8000 ){
+			comfortNoiseResampler->resample( (short *)data, comfortNoiseData );
+			noise = comfortNoiseData;
+		}
+		comfortNoise.analyse( noise, noiseSamples );
+		comfortNoiseLength = comfortNoise.encode( comfortNoisePayload );
+	}
+
 	sendersLock.lock();
 
 	for( i = senders.begin(); i != senders.end(); i++ ){
@@ -221,15 +258,26 @@ void AudioMedia::sendData( byte_t * data, uint32_t nsamples, int samplerate, uin
 		}
 		
 		MRef<CodecState *> selectedCodec = (*(*i)->getSelectedCodec());
+		int sfreq = ((AudioCodec*)(*selectedCodec->getCodec()))->getSamplingFreq();
+		bool talkspurt = false;
 
 		//if we must send silence (zeroData), encode it ... 
 		if( encodeZeroData ) {
 
-			int sfreq = ((AudioCodec*)(*selectedCodec->getCodec()))->getSamplingFreq();
-			
 			encodedLength = selectedCodec->encode( &zeroData, sfreq==8000?160*sizeof(short):320*sizeof(short), sfreq, encoded);
 		} else {
 
+			// The clock of comfort noise is at 8 kHz, it
+			// replaces the frames of CODECs at that rate only
+			if( sfreq == 8000 && (*i)->acceptsComfortNoise() ){
+				if( silent ){
+					if( (*i)->dtxSilence( comfortNoise.getLevel() ) ){
+						(*i)->send( comfortNoisePayload, comfortNoiseLength, &givenTs, false, false, true );
+					}
+					continue;
+				}
+				talkspurt = (*i)->dtxSpeech();
+			}
 
 			// If audio forwarding is enabled, then we need to
 			// connect the input of all other calls with the
@@ -251,7 +299,6 @@ void AudioMedia::sendData( byte_t * data, uint32_t nsamples, int samplerate, uin
 					}
 				}
 			}
-			int sfreq = ((AudioCodec*)(*selectedCodec->getCodec()))->getSamplingFreq();
 			if (sfreq==8000 && SOUND_CARD_FREQ!=8000){
 				resampler->resample( (short *)data, resampledData );
 				encodedLength = selectedCodec->encode( resampledData, nsamples/2*sizeof(short), 8000, encoded);
@@ -268,7 +315,7 @@ void AudioMedia::sendData( byte_t * data, uint32_t nsamples, int samplerate, uin
 			}
 		}
 
-		(*i)->send( encoded, encodedLength, &givenTs, marker );
+		(*i)->send( encoded, encodedLength, &givenTs, marker || talkspurt );
 	}
 	
 	sendersLock.unlock();
@@ -309,7 +356,7 @@ MRef<AudioMediaSource *> AudioMedia::getSource( uint32_t ssrc ){
 AudioMediaSource::AudioMediaSource( uint32_t ssrc_, string callId, MRef<Media *> m):
 	BasicSoundSource( ssrc_, 
 			callId,
-			NULL, //plc
+			this, //plc, playing the comfort noise
 			0/*position*/, 
 			SOUND_CARD_FREQ, 
 			20, //duration in ms
@@ -317,20 +364,38 @@ AudioMediaSource::AudioMediaSource( uint32_t ssrc_, string callId, MRef<Media *>
 			//buffer size defaults to 16000 * numChannels
 			),
 	media(m),
-	ssrc(ssrc_)
+	ssrc(ssrc_),
+	comfortNoiseActive(false)
 {
 	//The codec output might be mixed into outgoing streams
 	//any data has been decoded. We therefore initialize it
 	//to silence.
 	for (int i=0; i<AUDIOMEDIA_CODEC_MAXLEN; i++)
 		codecOutput[i]=0;
+
+	comfortNoiseResampler = ResamplerRegistry::getInstance()->create( 8000, SOUND_CARD_FREQ, 20, 2 );
 }
 
 void AudioMediaSource::playData( const MRef<RtpPacket *> & rtpPacket ){
         RtpHeader hdr = rtpPacket->getHeader();
-	MRef<CodecState *> codec = findCodec( hdr.getPayloadType() );
+	MRef<CodecState *> codec;
+
+	if( hdr.getPayloadType() == COMFORT_NOISE_PAYLOAD_TYPE ){
+		comfortNoiseLock.lock();
+		comfortNoise.decode( rtpPacket->getContent(), rtpPacket->getContentLength() );
+		comfortNoiseActive = true;
+		comfortNoiseLock.unlock();
+		return;
+	}
 
+	codec = findCodec( hdr.getPayloadType() );
 	if( codec ){
+		if( comfortNoiseActive ){
+			comfortNoiseLock.lock();
+			comfortNoiseActive = false;
+			comfortNoiseLock.unlock();
+		}
+
 		uint32_t outputSize = codec->decode( rtpPacket->getContent(), rtpPacket->getContentLength(), codecOutput );
 		int sfreq = ((AudioCodec*)(*codec->getCodec()))->getSamplingFreq();
 		//cerr <<"EEEE: -------------------------> decode len="<<outputSize<<" sfreq="<<sfreq<<endl;
@@ -342,6 +407,26 @@ void AudioMediaSource::playData( const MRef<RtpPacket *> & rtpPacket ){
 
 }
 
+short *AudioMediaSource::get_plc_sound( uint32_t &ret_size ){
+	short noise[160];
+
+	comfortNoiseLock.lock();
+	if( !comfortNoiseActive ){
+		comfortNoiseLock.unlock();
+		return NULL;
+	}
+	comfortNoise.generate( noise, 160 );
+	comfortNoiseLock.unlock();
+
+	for( int i = 0; i < 160; i++ ){
+		comfortNoiseStereo[2 * i] = noise[i];
+		comfortNoiseStereo[2 * i + 1] = noise[i];
+	}
+	comfortNoiseResampler->resample( comfortNoiseStereo, comfortNoiseOutput );
+	ret_size = SOUND_CARD_FREQ * 20 / 1000;
+	return comfortNoiseOutput;
+}
+
 MRef<CodecState *> AudioMediaSource::findCodec( uint8_t payloadType ){
 	std::list< MRef<CodecState *> >::iterator iCodec;
 	MRef<CodecState *> newCodecInstance;
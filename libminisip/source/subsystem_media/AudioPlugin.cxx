@@ -100,5 +100,8 @@ MRef<Media*> AudioPlugin::createMedia( MRef<SipSoftPhoneConfiguration *> config
 		
 	}
 	
-	return new AudioMedia( soundIo, codecList );
+	MRef<AudioMedia *> media = new AudioMedia( soundIo, codecList );
+	media->setDtx( config->useDtx );
+
+	return *media;
 }
@@ -69,6 +69,47 @@ MediaHandler::MediaHandler( MRef<SipSoftPhoneConfiguration *> conf, MRef<IpProvi
 }
 
 MediaHandler::~MediaHandler(){
+	stopPortPools();
+}
+
+void MediaHandler::startPortPools(){
+	stopPortPools();
+
+	if( config->rtpPortPoolSize == 0 ){
+		return;
+	}
+
+	if( ipProvider ){
+		rtpPortPool = new RtpPortPool( ipProvider, config->rtpPortPoolSize );
+		rtpPortPool->start();
+	}
+
+	if( ip6Provider ){
+		rtp6PortPool = new RtpPortPool( ip6Provider, config->rtpPortPoolSize );
+		rtp6PortPool->start();
+	}
+}
+
+void MediaHandler::stopPortPools(){
+	/* The receivers still running hold a reference to their
+	 * pool, and close their pair when they end */
+	if( rtpPortPool ){
+		rtpPortPool->stop();
+		rtpPortPool = NULL;
+	}
+
+	if( rtp6PortPool ){
+		rtp6PortPool->stop();
+		rtp6PortPool = NULL;
+	}
+}
+
+MRef<RtpReceiver *> MediaHandler::createRtpReceiver( MRef<IpProvider *> provider,
+		MRef<RtpPortPool *> pool, string callId ){
+	if( pool ){
+		return new RtpReceiver( pool, callId );
+	}
+	return new RtpReceiver( provider, callId );
 }
 
 void MediaHandler::init(){
@@ -102,6 +143,8 @@ void MediaHandler::init(){
 //	muteAllButOne = config->muteAllButOne;
 	
         ringtoneFile = config->ringtone;
+
+	startPortPools();
 }
 
 
@@ -146,10 +189,10 @@ MRef<Session *> MediaHandler::createSession( MRef<SipIdentity*> id, string callI
 		if( rtm && rtm->receive ){
 			if( ipProvider )
 // edw pernei to port mesw callId mallon 
-				rtpReceiver = new RtpReceiver( ipProvider, callId );
+				rtpReceiver = createRtpReceiver( ipProvider, rtpPortPool, callId );
 
 			if( ip6Provider )
-				rtp6Receiver = new RtpReceiver( ip6Provider, callId );
+				rtp6Receiver = createRtpReceiver( ip6Provider, rtp6PortPool, callId );
 
 			MRef<RealtimeMediaStreamReceiver *> rStream;
 			rStream = new RealtimeMediaStreamReceiver( callId, rtm, rtpReceiver, rtp6Receiver );
@@ -183,11 +226,11 @@ MRef<Session *> MediaHandler::createSession( MRef<SipIdentity*> id, string callI
 		
 		if( rtm && rtm->send ){
 		    if( !rtpReceiver && !ipProvider.isNull() ){
-			rtpReceiver = new RtpReceiver( ipProvider, callId );
+			rtpReceiver = createRtpReceiver( ipProvider, rtpPortPool, callId );
 		    }
 
 		    if( !rtp6Receiver && !ip6Provider.isNull() ){
-		      rtp6Receiver = new RtpReceiver( ip6Provider, callId );
+		      rtp6Receiver = createRtpReceiver( ip6Provider, rtp6PortPool, callId );
 		    }
 
 		    MRef<UDPSocket *> sock;
@@ -35,6 +35,7 @@
 #include"Session.h"
 #include"SessionRegistry.h"
 #include<libminisip/ipprovider/IpProvider.h>
+#include<libminisip/media/RtpPortPool.h>
 #include<libmutil/CommandString.h>
 #include<libmutil/MessageRouter.h>
 
@@ -42,6 +43,7 @@
 class SipSoftPhoneConfiguration;
 class IpProvider;
 class AudioMedia;
+class RtpReceiver;
 
 
 class LIBMINISIP_API MediaHandler : public virtual MObject, public SessionRegistry, public CommandReceiver {
@@ -61,6 +63,8 @@ class LIBMINISIP_API MediaHandler : public virtual MObject, public SessionRegist
 		 * @param config the call specific configuration
 		 * @param callId identifier shared with the SIP stack
 		 * @returns a reference to the session created
+		 * @throws NetworkException if the RTP sockets could not
+		 * be created, the call is to fail
 		 */
 		MRef<Session *> createSession( MRef<SipIdentity*> ident, std::string callId );
 		
@@ -137,6 +141,15 @@ class LIBMINISIP_API MediaHandler : public virtual MObject, public SessionRegist
 	private:
 		void init();
 
+		/* Starts the port pools of the IP providers */
+		void startPortPools();
+		void stopPortPools();
+
+		/* Receiver on a pair of the pool of the provider if
+		 * there is one */
+		MRef<RtpReceiver *> createRtpReceiver( MRef<IpProvider *> provider,
+				MRef<RtpPortPool *> pool, std::string callId );
+
 		std::list< MRef<Media *> > media;
 		
 		 std::list< MRef<Session *> > sessionList; 
@@ -148,6 +161,8 @@ class LIBMINISIP_API MediaHandler : public virtual MObject, public SessionRegist
 		MRef<AudioMedia *> audioMedia;
 		MRef<IpProvider *> ipProvider;
 		MRef<IpProvider *> ip6Provider;
+		MRef<RtpPortPool *> rtpPortPool;
+		MRef<RtpPortPool *> rtp6PortPool;
 		MRef<SipSoftPhoneConfiguration *> config;
                 
                 MRef<CommandReceiver*> messageRouterCallback;
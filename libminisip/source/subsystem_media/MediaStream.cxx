@@ -38,6 +38,7 @@
 #include<libminisip/media/Media.h>
 #include<libminisip/media/RtpReceiver.h>
 #include<libminisip/media/codecs/Codec.h>
+#include<libminisip/media/codecs/ComfortNoise.h>
 #include<libminisip/ipprovider/IpProvider.h>
 #include<iostream>
 
@@ -47,6 +48,11 @@
 
 using namespace std;
 
+/* During a silence, a comfort noise packet is sent when the noise
+ * level changed by this many dB, or after this many frames */
+#define DTX_LEVEL_CHANGE 3
+#define DTX_REFRESH_FRAMES 50
+
 RealtimeMediaStream::RealtimeMediaStream( string cid, MRef<RealtimeMedia *> m) : MediaStream(cid,*m), realtimeMedia(m) /*callId(cid), media(m)*/,ka(NULL) {
 	disabled = false;
 #ifdef ZRTP_SUPPORT
@@ -480,6 +486,12 @@ RealtimeMediaStreamSender::RealtimeMediaStreamSender( string callid, MRef<Realti
         payloadType = "255";
 	setMuted( true );
 	muteCounter = 0;
+	peerComfortNoise = false;
+	inSilence = false;
+	silenceLevel = 0;
+	silenceFrames = 0;
+	suppressedFrames = 0;
+	comfortNoisePackets = 0;
 //	senderSockHack = new UDPSocket();
 	if( senderSocket ){
 		this->senderSock = senderSocket;
@@ -572,7 +584,7 @@ void RealtimeMediaStreamSender::sendZrtp(unsigned char* data, int length,
 }
 #endif // ZRTP_SUPPORT
 
-void RealtimeMediaStreamSender::send( byte_t * data, uint32_t length, uint32_t * givenTs, bool marker, bool dtmf ){
+void RealtimeMediaStreamSender::send( byte_t * data, uint32_t length, uint32_t * givenTs, bool marker, bool dtmf, bool comfortNoise ){
 	 
 
 	if (this->remoteAddress.isNull()) {
@@ -603,6 +615,9 @@ void RealtimeMediaStreamSender::send( byte_t * data, uint32_t length, uint32_t *
 	if( dtmf ){
 		packet->getHeader().setPayloadType( 101 );
 	}
+	else if( comfortNoise ){
+		packet->getHeader().setPayloadType( COMFORT_NOISE_PAYLOAD_TYPE );
+	}
 	else{
 		if( payloadType != "255" ){
 			packet->getHeader().setPayloadType( atoi(payloadType.c_str() ) );
@@ -694,6 +709,9 @@ string RealtimeMediaStreamSender::getDebugString() {
 		ret += "; isMuted=true";
 	else ret += "; isMuted=false";
 
+	ret += "; suppressedFrames=" + itoa(suppressedFrames) +
+		"; comfortNoisePackets=" + itoa(comfortNoisePackets);
+
 	return ret;
 }
 #endif
@@ -719,8 +737,54 @@ bool RealtimeMediaStreamSender::muteKeepAlive( uint32_t max ) {
 	return ret;
 }
 
+bool RealtimeMediaStreamSender::dtxSilence( int32_t noiseLevel ){
+	int32_t change = noiseLevel - silenceLevel;
+	bool update;
+
+	suppressedFrames++;
+
+	if( !inSilence ){
+		inSilence = true;
+		update = true;
+	}
+	else{
+		update = ++silenceFrames >= DTX_REFRESH_FRAMES ||
+			change >= DTX_LEVEL_CHANGE || change <= -DTX_LEVEL_CHANGE;
+	}
+
+	if( update ){
+		silenceLevel = noiseLevel;
+		silenceFrames = 0;
+		comfortNoisePackets++;
+	}
+	else{
+		senderLock.lock();
+		increaseLastTs();
+		senderLock.unlock();
+	}
+	return update;
+}
+
+bool RealtimeMediaStreamSender::dtxSpeech(){
+	bool talkspurt = inSilence;
+
+	inSilence = false;
+	return talkspurt;
+}
+
 bool RealtimeMediaStreamSender::matches( MRef<SdpHeaderM *> m, uint32_t formatIndex ){
 	bool result = RealtimeMediaStream::matches( m, formatIndex );
+
+	if( m->getMedia() == getSdpMediaType() ){
+		string cn = itoa( COMFORT_NOISE_PAYLOAD_TYPE );
+
+		peerComfortNoise = false;
+		for( int32_t j = 0; j < m->getNrFormats(); j++ ){
+			if( m->getFormat( j ) == cn ){
+				peerComfortNoise = true;
+			}
+		}
+	}
 	
 	if( result && !selectedCodec ){
 		selectedCodec = realtimeMedia->createCodecInstance(
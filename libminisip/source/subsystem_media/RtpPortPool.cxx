@@ -0,0 +1,262 @@
+/*
+ Copyright (C) 2004-2006 the Minisip Team
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#include<config.h>
+
+#include<libminisip/media/RtpPortPool.h>
+
+#include<libmnetutil/UDPSocket.h>
+#include<libmnetutil/NetworkException.h>
+#include<libmutil/mtime.h>
+#include<libmutil/dbg.h>
+
+#include<stdlib.h> //for rand
+
+#ifdef WIN32
+#include<winsock2.h>
+#else
+#include<sys/time.h>
+#include<sys/types.h>
+#include<unistd.h>
+#endif
+
+/* The background thread checks the pool at least this often */
+#define RTP_POOL_POLL_MS 1000
+
+/* The external port of a pair in the pool is queried again after
+ * this long, below the shortest UDP timeouts of common NATs */
+#define RTP_POOL_REFRESH_MS 20000
+
+/* A returned pair is not handed out again before this long */
+#define RTP_POOL_QUARANTINE_MS 5000
+
+using namespace std;
+
+RtpPortPair::RtpPortPair( MRef<UDPSocket *> rtp, MRef<UDPSocket *> rtcp ):
+		rtpSocket( rtp ), rtcpSocket( rtcp ), externalPort( 0 ),
+		discovered( 0 ), released( 0 ){
+}
+
+RtpPortPool::RtpPortPool( MRef<IpProvider *> ip, int s ):
+		ipProvider( ip ), size( s > 0 ? s : 0 ),
+		quit( false ), nHits( 0 ), nMisses( 0 ){
+	useIPv6 = ipProvider->getExternalIp().find( ':' ) != string::npos;
+}
+
+RtpPortPool::~RtpPortPool(){
+	stop();
+}
+
+int RtpPortPool::getAvailable(){
+	int n;
+
+	lock.lock();
+	n = (int)ready.size();
+	lock.unlock();
+	return n;
+}
+
+MRef<RtpPortPair *> RtpPortPool::take(){
+	MRef<RtpPortPair *> pair;
+
+	lock.lock();
+	/* The pair refreshed last has the freshest mapping */
+	if( !ready.empty() ){
+		pair = ready.back();
+		ready.pop_back();
+		nHits++;
+	}
+	else{
+		nMisses++;
+	}
+	wake.broadcast();
+	lock.unlock();
+
+	if( !pair ){
+		pair = bind();
+		if( pair ){
+			discover( pair );
+		}
+	}
+	return pair;
+}
+
+void RtpPortPool::release( MRef<RtpPortPair *> pair ){
+	if( !pair ){
+		return;
+	}
+
+	lock.lock();
+	if( !quit && !thread.isNull() ){
+		pair->released = mtime();
+		returned.push_back( pair );
+		wake.broadcast();
+	}
+	lock.unlock();
+}
+
+MRef<RtpPortPair *> RtpPortPool::bind(){
+	for( int retry = 0; retry < RTP_RECEIVER_MAX_RETRIES; retry++ ){
+		//generate a random port, even number, in the given range
+		float randPartial = (float)rand() / RAND_MAX;
+		int port = (int)( RTP_LOCAL_PORT_RANGE * randPartial );
+		port = 2 * ( port / 2 );
+		port += RTP_LOCAL_PORT_RANGE_MIN;
+
+		MRef<UDPSocket *> rtp;
+		try{
+			rtp = new UDPSocket( port, useIPv6 );
+			MRef<UDPSocket *> rtcp = new UDPSocket( port + 1, useIPv6 );
+			return new RtpPortPair( rtp, rtcp );
+		}
+		catch( NetworkException & ){
+			/* Either port is taken, the RTP socket if bound
+			 * is closed with its last reference */
+			#ifdef DEBUG_OUTPUT
+			cerr << "RtpPortPool: could not bind port " << port << endl;
+			#endif
+		}
+	}
+	return NULL;
+}
+
+void RtpPortPool::discover( MRef<RtpPortPair *> pair ){
+	uint16_t port = ipProvider->getExternalPort( pair->rtpSocket );
+	pair->externalPort = port;
+	pair->discovered = mtime();
+}
+
+void RtpPortPool::drain( MRef<RtpPortPair *> pair ){
+	MRef<UDPSocket *> sockets[2] = { pair->rtpSocket, pair->rtcpSocket };
+	char buf[2048];
+
+	for( int i = 0; i < 2; i++ ){
+		int fd = sockets[i]->getFd();
+		for( ;; ){
+			fd_set rfds;
+			struct timeval nowait = { 0, 0 };
+
+			FD_ZERO( &rfds );
+			#ifdef WIN32
+			FD_SET( (uint32_t) fd, &rfds );
+			#else
+			FD_SET( fd, &rfds );
+			#endif
+			if( select( fd + 1, &rfds, NULL, NULL, &nowait ) <= 0 ){
+				break;
+			}
+			try{
+				if( sockets[i]->recv( buf, sizeof( buf ) ) < 0 ){
+					break;
+				}
+			}
+			catch( NetworkException & ){
+				break;
+			}
+		}
+	}
+}
+
+void RtpPortPool::start(){
+	lock.lock();
+	if( thread.isNull() && size > 0 ){
+		quit = false;
+		thread = new Thread( this );
+	}
+	lock.unlock();
+}
+
+void RtpPortPool::stop(){
+	MRef<Thread *> t;
+
+	lock.lock();
+	quit = true;
+	t = thread;
+	thread = NULL;
+	wake.broadcast();
+	lock.unlock();
+
+	if( t ){
+		t->join();
+	}
+
+	lock.lock();
+	ready.clear();
+	returned.clear();
+	lock.unlock();
+}
+
+void RtpPortPool::run(){
+#ifdef DEBUG_OUTPUT
+	setThreadName( "RtpPortPool" );
+#endif
+
+	lock.lock();
+	while( !quit ){
+		uint64_t now = mtime();
+		MRef<RtpPortPair *> pair;
+		bool fresh = false;
+
+		if( !returned.empty() &&
+				now - returned.front()->released >= RTP_POOL_QUARANTINE_MS ){
+			pair = returned.front();
+			returned.pop_front();
+		}
+		else if( (int)ready.size() < size ){
+			fresh = true;
+		}
+		else if( !ready.empty() &&
+				now - ready.front()->discovered >= RTP_POOL_REFRESH_MS ){
+			/* Refreshed pairs go to the back, the front one
+			 * has the oldest mapping */
+			pair = ready.front();
+			ready.pop_front();
+		}
+
+		if( !pair && !fresh ){
+			wake.wait( lock, RTP_POOL_POLL_MS );
+			continue;
+		}
+
+		/* Binding and STUN are done without the lock, so that
+		 * pairs can be taken meanwhile */
+		lock.unlock();
+		if( fresh ){
+			pair = bind();
+		}
+		else{
+			drain( pair );
+		}
+		if( pair ){
+			discover( pair );
+		}
+		lock.lock();
+
+		if( !pair ){
+			merr << "RtpPortPool: could not bind a RTP port pair" << endl;
+			wake.wait( lock, RTP_POOL_POLL_MS );
+			continue;
+		}
+
+		/* A pair not kept is closed with its last reference */
+		if( !quit && (int)ready.size() < size ){
+			ready.push_back( pair );
+		}
+	}
+	lock.unlock();
+}
@@ -56,13 +56,6 @@
 #	include"../include/minisip_wce_extra_includes.h"
 #endif
 
-//Set the range of rtp usable ports ... starting at min and spanning a range, up to max
-#define RTP_LOCAL_PORT_RANGE_MIN 30000
-#define RTP_LOCAL_PORT_RANGE 5000
-#define RTP_LOCAL_PORT_RANGE_MAX RTP_LOCAL_PORT_RANGE_MIN + RTP_LOCAL_PORT_RANGE
-#define RTP_RECEIVER_MAX_RETRIES 5
-
-
 using namespace std;
 
 RtpReceiver::RtpReceiver( MRef<IpProvider *> ipProvider, string cid) : callId(cid)
@@ -117,9 +110,30 @@ RtpReceiver::RtpReceiver( MRef<IpProvider *> ipProvider, string cid) : callId(ci
 	thread = new Thread(this);
 }
 
+RtpReceiver::RtpReceiver( MRef<RtpPortPool *> p, string cid) : pool(p), callId(cid)
+{
+	pair = pool->take();
+	if( !pair ) {
+		/* Fails the call the receiver is created for */
+		merr << "Minisip could not create a UDP socket!" << endl;
+		merr << "Check your network settings." << endl;
+		throw NetworkException();
+	}
+
+	socket = pair->getRtpSocket();
+	externalPort = pair->getExternalPort();
+
+	kill = false;
+
+	thread = new Thread(this);
+}
+
 RtpReceiver::~RtpReceiver(){
 	stop();
 	join();
+	if( pool ){
+		pool->release( pair );
+	}
 }
 
 /**
@@ -37,6 +37,7 @@
 #include<libminisip/media/video/codec/AVCoder.h>
 #include<libminisip/media/DtmfSender.h>
 #include<libminisip/media/codecs/Codec.h>
+#include<libminisip/media/codecs/ComfortNoise.h>
 #include<libminisip/signaling/sdp/SdpPacket.h>
 #include<libminisip/signaling/sdp/SdpHeaderV.h>
 #include<libminisip/signaling/sdp/SdpHeaderT.h>
@@ -113,7 +114,6 @@ class MikeyConfig: public IMikeyConfig{
 
 
 SessionRegistry * Session::registry = NULL;
-MRef<KeyAgreement *> Session::precomputedKa = NULL;
 
 Session::Session( string localIp, MRef<SipIdentity*> ident, string localIp6 ):
 		started(false),
@@ -124,7 +124,6 @@ Session::Session( string localIp, MRef<SipIdentity*> ident, string localIp6 ):
 	ka_type = ident->ka_type;
 
 	dtmfTOProvider = new TimeoutProvider<DtmfEvent *, MRef<DtmfSender *> >;
-	Session::precomputedKa = NULL;
 
 	mutedSenders = true;
 	silencedSources = false;
@@ -153,16 +152,6 @@ void Session::unregister(){
 	if( registry ){
 		registry->unregisterSession( this );
 	}
-
-	if( Session::precomputedKa.isNull()
-	    && identity && identity->getSim() ){
-		KeyAgreementDH* ka = NULL;
-		//ka = new KeyAgreementDH( identity->getSim()->getCertificateChain(), 
-		//			 identity->getSim()->getCAs() );
-		ka = new KeyAgreementDH( identity->getSim() );
-		ka->setGroup( DH_GROUP_OAKLEY5 );
-		Session::precomputedKa = ka;
-	}
 }
 
 Session::~Session(){
@@ -368,6 +357,13 @@ bool Session::addRealtimeMediaToOffer(MRef<SdpPacket*> result, const string &pee
 			MRef<SdpHeaderA*> dtmf_fmtp = new SdpHeaderA("a=X");
 			dtmf_fmtp->setAttributes("fmtp:101 0-15");
 			m->addAttribute(*dtmf_fmtp);
+
+			//comfort noise (RFC 3389), played during the
+			//silences of the peer
+			m->addFormat( itoa( COMFORT_NOISE_PAYLOAD_TYPE ) );
+			MRef<SdpHeaderA*> cn = new SdpHeaderA("a=X");
+			cn->setAttributes("rtpmap:" + itoa( COMFORT_NOISE_PAYLOAD_TYPE ) + " CN/8000");
+			m->addAttribute(*cn);
 		}
 		
 		result->addHeader( *m );
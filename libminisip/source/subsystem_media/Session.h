@@ -61,11 +61,6 @@ class LIBMINISIP_API Session : public MObject{
 		 * access for instance from the user interface */
 		static SessionRegistry * registry;
 
-		/**
-		 * Pre-computed parameters to optimize the next key exchange
-		 */
-		static MRef<KeyAgreement *> precomputedKa;
-
 		/**
 		 * Constructor, called by MediaHandler::createSession only
 		 * @param localIp IP address to give as contact in session
@@ -0,0 +1,562 @@
+/*
+ Copyright (C) 2004-2006 the Minisip Team
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#include<config.h>
+
+#ifdef _MSC_VER
+#define _USE_MATH_DEFINES
+#endif
+
+#include<libminisip/media/aec/BlockAEC.h>
+
+#include<libmutil/massert.h>
+
+#include<math.h>
+#include<string.h>
+
+#ifdef __SSE__
+#include<xmmintrin.h>
+#endif
+
+#ifdef _WIN32_WCE
+# define M_PI           3.14159265358979323846  /* pi */
+#endif
+
+/* Step size of the weight update, relative to the loudspeaker power */
+#define BLOCKAEC_MU 0.5f
+
+/* Longest block, in milliseconds */
+#define BLOCKAEC_MAX_BLOCK_MS 8
+
+/* Shortest block worth cancelling frames of in place */
+#define BLOCKAEC_MIN_BLOCK 16
+
+/* Same tuning as the sample based AEC, see aec.h */
+#define BLOCKAEC_GEIGEL_THRESHOLD 0.5f	/* -6 dB */
+#define BLOCKAEC_HANGOVER_MS 30
+#define BLOCKAEC_UPDATE_THRESHOLD 104.0f	/* -50 dB */
+#define BLOCKAEC_NLP_ATTENUATION 0.5f	/* -6 dB */
+
+/* Regularization of the power normalization, per sample of a block */
+#define BLOCKAEC_DELTA ( 104.0f * 104.0f )
+
+#define BLOCKAEC_MAXPCM 32767.0f
+
+/* ================================================================ */
+/* Vector kernels on split complex arrays. Each returns the number of
+ * elements it did, the caller finishes the rest. */
+
+#ifdef __SSE__
+/* y += a * b */
+static int32_t complexMacSse( float *yRe, float *yIm,
+		const float *aRe, const float *aIm,
+		const float *bRe, const float *bIm, int32_t n ){
+	int32_t i;
+
+	for( i = 0; i + 4 <= n; i += 4 ){
+		__m128 ar = _mm_loadu_ps( aRe + i );
+		__m128 ai = _mm_loadu_ps( aIm + i );
+		__m128 br = _mm_loadu_ps( bRe + i );
+		__m128 bi = _mm_loadu_ps( bIm + i );
+		__m128 yr = _mm_loadu_ps( yRe + i );
+		__m128 yi = _mm_loadu_ps( yIm + i );
+
+		yr = _mm_add_ps( yr, _mm_sub_ps( _mm_mul_ps( ar, br ), _mm_mul_ps( ai, bi ) ) );
+		yi = _mm_add_ps( yi, _mm_add_ps( _mm_mul_ps( ar, bi ), _mm_mul_ps( ai, br ) ) );
+		_mm_storeu_ps( yRe + i, yr );
+		_mm_storeu_ps( yIm + i, yi );
+	}
+	return i;
+}
+
+/* y += conj(a) * b */
+static int32_t conjMacSse( float *yRe, float *yIm,
+		const float *aRe, const float *aIm,
+		const float *bRe, const float *bIm, int32_t n ){
+	int32_t i;
+
+	for( i = 0; i + 4 <= n; i += 4 ){
+		__m128 ar = _mm_loadu_ps( aRe + i );
+		__m128 ai = _mm_loadu_ps( aIm + i );
+		__m128 br = _mm_loadu_ps( bRe + i );
+		__m128 bi = _mm_loadu_ps( bIm + i );
+		__m128 yr = _mm_loadu_ps( yRe + i );
+		__m128 yi = _mm_loadu_ps( yIm + i );
+
+		yr = _mm_add_ps( yr, _mm_add_ps( _mm_mul_ps( ar, br ), _mm_mul_ps( ai, bi ) ) );
+		yi = _mm_add_ps( yi, _mm_sub_ps( _mm_mul_ps( ar, bi ), _mm_mul_ps( ai, br ) ) );
+		_mm_storeu_ps( yRe + i, yr );
+		_mm_storeu_ps( yIm + i, yi );
+	}
+	return i;
+}
+
+/* The butterflies of half length h, h a multiple of 4 */
+static void butterfliesSse( float *re, float *im, int32_t n, int32_t h,
+		const float *twRe, const float *twIm, float sign ){
+	const __m128 s = _mm_set1_ps( sign );
+
+	for( int32_t i = 0; i < n; i += 2 * h ){
+		float *aRe = re + i;
+		float *aIm = im + i;
+		float *bRe = aRe + h;
+		float *bIm = aIm + h;
+
+		for( int32_t j = 0; j < h; j += 4 ){
+			__m128 wr = _mm_loadu_ps( twRe + j );
+			__m128 wi = _mm_mul_ps( s, _mm_loadu_ps( twIm + j ) );
+			__m128 br = _mm_loadu_ps( bRe + j );
+			__m128 bi = _mm_loadu_ps( bIm + j );
+			__m128 ar = _mm_loadu_ps( aRe + j );
+			__m128 ai = _mm_loadu_ps( aIm + j );
+			__m128 tr = _mm_sub_ps( _mm_mul_ps( br, wr ), _mm_mul_ps( bi, wi ) );
+			__m128 ti = _mm_add_ps( _mm_mul_ps( br, wi ), _mm_mul_ps( bi, wr ) );
+
+			_mm_storeu_ps( aRe + j, _mm_add_ps( ar, tr ) );
+			_mm_storeu_ps( aIm + j, _mm_add_ps( ai, ti ) );
+			_mm_storeu_ps( bRe + j, _mm_sub_ps( ar, tr ) );
+			_mm_storeu_ps( bIm + j, _mm_sub_ps( ai, ti ) );
+		}
+	}
+}
+#endif
+
+static void complexMac( float *yRe, float *yIm,
+		const float *aRe, const float *aIm,
+		const float *bRe, const float *bIm, int32_t n ){
+	int32_t i = 0;
+#ifdef __SSE__
+	i = complexMacSse( yRe, yIm, aRe, aIm, bRe, bIm, n );
+#endif
+	for( ; i < n; i++ ){
+		yRe[i] += aRe[i] * bRe[i] - aIm[i] * bIm[i];
+		yIm[i] += aRe[i] * bIm[i] + aIm[i] * bRe[i];
+	}
+}
+
+static void conjMac( float *yRe, float *yIm,
+		const float *aRe, const float *aIm,
+		const float *bRe, const float *bIm, int32_t n ){
+	int32_t i = 0;
+#ifdef __SSE__
+	i = conjMacSse( yRe, yIm, aRe, aIm, bRe, bIm, n );
+#endif
+	for( ; i < n; i++ ){
+		yRe[i] += aRe[i] * bRe[i] + aIm[i] * bIm[i];
+		yIm[i] += aRe[i] * bIm[i] - aIm[i] * bRe[i];
+	}
+}
+
+/* ================================================================ */
+
+BlockFFT::BlockFFT( int32_t size_ ): size( size_ ), half( size_ / 2 ){
+	massert( size >= 2 && ( size & ( size - 1 ) ) == 0 );
+
+	bitrev = new int32_t[half];
+	twRe = new float[half];
+	twIm = new float[half];
+	splitRe = new float[half + 1];
+	splitIm = new float[half + 1];
+	workRe = new float[half];
+	workIm = new float[half];
+
+	int32_t bits = 0;
+	while( ( 1 << bits ) < half ){
+		bits++;
+	}
+	for( int32_t i = 0; i < half; i++ ){
+		int32_t r = 0;
+		for( int32_t b = 0; b < bits; b++ ){
+			if( i & ( 1 << b ) ){
+				r |= 1 << ( bits - 1 - b );
+			}
+		}
+		bitrev[i] = r;
+	}
+
+	twRe[0] = 1.0f;
+	twIm[0] = 0.0f;
+	for( int32_t h = 1; h < half; h *= 2 ){
+		for( int32_t j = 0; j < h; j++ ){
+			twRe[h + j] = (float)cos( M_PI * j / h );
+			twIm[h + j] = (float)sin( M_PI * j / h );
+		}
+	}
+
+	for( int32_t k = 0; k <= half; k++ ){
+		splitRe[k] = (float)cos( 2.0 * M_PI * k / size );
+		splitIm[k] = (float)-sin( 2.0 * M_PI * k / size );
+	}
+}
+
+BlockFFT::~BlockFFT(){
+	delete [] bitrev;
+	delete [] twRe;
+	delete [] twIm;
+	delete [] splitRe;
+	delete [] splitIm;
+	delete [] workRe;
+	delete [] workIm;
+}
+
+void BlockFFT::complexFFT( float *re, float *im, int sign ){
+	for( int32_t i = 0; i < half; i++ ){
+		int32_t r = bitrev[i];
+		if( i < r ){
+			float t = re[i]; re[i] = re[r]; re[r] = t;
+			t = im[i]; im[i] = im[r]; im[r] = t;
+		}
+	}
+
+	/* sign < 0 uses e^(-i theta), twIm holds sin(theta) */
+	for( int32_t h = 1; h < half; h *= 2 ){
+		const float *wRe = twRe + h;
+		const float *wIm = twIm + h;
+#ifdef __SSE__
+		if( h >= 4 ){
+			butterfliesSse( re, im, half, h, wRe, wIm, (float)sign );
+			continue;
+		}
+#endif
+		for( int32_t i = 0; i < half; i += 2 * h ){
+			for( int32_t j = 0; j < h; j++ ){
+				int32_t a = i + j;
+				int32_t b = a + h;
+				float wr = wRe[j];
+				float wi = sign * wIm[j];
+				float tr = re[b] * wr - im[b] * wi;
+				float ti = re[b] * wi + im[b] * wr;
+
+				re[b] = re[a] - tr;
+				im[b] = im[a] - ti;
+				re[a] += tr;
+				im[a] += ti;
+			}
+		}
+	}
+}
+
+/* The size real samples are transformed as size/2 complex ones, the
+ * even samples as real parts and the odd ones as imaginary parts,
+ * whose spectrum is then split into those of the even and odd
+ * samples and recombined. */
+void BlockFFT::forward( const float *in, float *re, float *im ){
+	for( int32_t n = 0; n < half; n++ ){
+		workRe[n] = in[2 * n];
+		workIm[n] = in[2 * n + 1];
+	}
+	complexFFT( workRe, workIm, -1 );
+
+	re[0] = workRe[0] + workIm[0];
+	im[0] = 0.0f;
+	re[half] = workRe[0] - workIm[0];
+	im[half] = 0.0f;
+
+	for( int32_t k = 1; k < half; k++ ){
+		float zr = workRe[k];
+		float zi = workIm[k];
+		float cr = workRe[half - k];
+		float ci = workIm[half - k];
+
+		/* Spectra of the even and odd samples */
+		float er = 0.5f * ( zr + cr );
+		float ei = 0.5f * ( zi - ci );
+		float or_ = 0.5f * ( zi + ci );
+		float oi = -0.5f * ( zr - cr );
+
+		re[k] = er + splitRe[k] * or_ - splitIm[k] * oi;
+		im[k] = ei + splitRe[k] * oi + splitIm[k] * or_;
+	}
+}
+
+void BlockFFT::inverse( const float *re, const float *im, float *out ){
+	for( int32_t k = 0; k < half; k++ ){
+		float xr = re[k];
+		float xi = im[k];
+		float cr = re[half - k];
+		float ci = -im[half - k];
+
+		float er = 0.5f * ( xr + cr );
+		float ei = 0.5f * ( xi + ci );
+		float dr = 0.5f * ( xr - cr );
+		float di = 0.5f * ( xi - ci );
+
+		/* Spectrum of the odd samples, (x - conj(x')) / 2 / W^k */
+		float or_ = dr * splitRe[k] + di * splitIm[k];
+		float oi = di * splitRe[k] - dr * splitIm[k];
+
+		workRe[k] = er - oi;
+		workIm[k] = ei + or_;
+	}
+	complexFFT( workRe, workIm, 1 );
+
+	float scale = 1.0f / half;
+	for( int32_t n = 0; n < half; n++ ){
+		out[2 * n] = workRe[n] * scale;
+		out[2 * n + 1] = workIm[n] * scale;
+	}
+}
+
+/* ================================================================ */
+
+static int32_t chooseBlockSize( int32_t sampleRate, int32_t frameSize ){
+	int32_t maxBlock = 1;
+	while( maxBlock * 2 <= sampleRate * BLOCKAEC_MAX_BLOCK_MS / 1000 ){
+		maxBlock *= 2;
+	}
+
+	/* The largest one dividing the frames adds no delay */
+	int32_t block = 1;
+	while( block * 2 <= maxBlock && frameSize % ( block * 2 ) == 0 ){
+		block *= 2;
+	}
+	if( block < BLOCKAEC_MIN_BLOCK ){
+		block = maxBlock;
+	}
+	return block;
+}
+
+static float *newZeroed( int32_t n ){
+	float *ret = new float[n];
+	memset( ret, 0, n * sizeof( float ) );
+	return ret;
+}
+
+BlockAEC::BlockAEC( int32_t sampleRate_, int32_t frameSize_, int32_t tailMs ):
+		sampleRate( sampleRate_ ),
+		frameSize( frameSize_ ),
+		blockSize( chooseBlockSize( sampleRate_, frameSize_ ) ),
+		suppression( true ),
+		fft( 2 * blockSize ),
+		dcMic( 0.0f ),
+		dcSpk( 0.0f ),
+		newest( 0 ),
+		constrainNext( 0 ),
+		hangover( 0 ),
+		inFill( 0 ),
+		outFill( 0 ){
+	int32_t tail = sampleRate * tailMs / 1000;
+
+	nPartitions = ( tail + blockSize - 1 ) / blockSize;
+	if( nPartitions < 1 ){
+		nPartitions = 1;
+	}
+	nBins = blockSize + 1;
+	nBinsPadded = ( nBins + 3 ) & ~3;
+
+	hangoverBlocks = ( sampleRate * BLOCKAEC_HANGOVER_MS / 1000 + blockSize - 1 ) / blockSize;
+
+	xRe = newZeroed( nPartitions * nBinsPadded );
+	xIm = newZeroed( nPartitions * nBinsPadded );
+	wRe = newZeroed( nPartitions * nBinsPadded );
+	wIm = newZeroed( nPartitions * nBinsPadded );
+	power = newZeroed( nBinsPadded );
+	spkTime = newZeroed( 2 * blockSize );
+	yRe = newZeroed( nBinsPadded );
+	yIm = newZeroed( nBinsPadded );
+	eRe = newZeroed( nBinsPadded );
+	eIm = newZeroed( nBinsPadded );
+	time = newZeroed( 2 * blockSize );
+	spkMax = newZeroed( nPartitions );
+	micIn = newZeroed( blockSize );
+	spkIn = newZeroed( blockSize );
+	outQueue = newZeroed( frameSize + blockSize );
+
+	if( frameSize % blockSize != 0 ){
+		outFill = blockSize;
+	}
+}
+
+BlockAEC::~BlockAEC(){
+	delete [] xRe;
+	delete [] xIm;
+	delete [] wRe;
+	delete [] wIm;
+	delete [] power;
+	delete [] spkTime;
+	delete [] yRe;
+	delete [] yIm;
+	delete [] eRe;
+	delete [] eIm;
+	delete [] time;
+	delete [] spkMax;
+	delete [] micIn;
+	delete [] spkIn;
+	delete [] outQueue;
+}
+
+void BlockAEC::process( const short *mic, const short *spk, short *out ){
+	const float alphaDc = 0.01f * 8000 / sampleRate;
+
+	/* All of mic is read before out is written, it may be mic */
+	for( int32_t i = 0; i < frameSize; i++ ){
+		float m = (float)mic[i];
+		float s = (float)spk[i];
+
+		dcMic += alphaDc * ( m - dcMic );
+		dcSpk += alphaDc * ( s - dcSpk );
+		micIn[inFill] = m - dcMic;
+		spkIn[inFill] = s - dcSpk;
+
+		if( ++inFill == blockSize ){
+			processBlock( micIn, spkIn, outQueue + outFill );
+			outFill += blockSize;
+			inFill = 0;
+		}
+	}
+
+	for( int32_t i = 0; i < frameSize; i++ ){
+		float s = outQueue[i];
+
+		if( s > BLOCKAEC_MAXPCM ){
+			out[i] = (short)BLOCKAEC_MAXPCM;
+		}
+		else if( s < -BLOCKAEC_MAXPCM ){
+			out[i] = (short)-BLOCKAEC_MAXPCM;
+		}
+		else{
+			out[i] = (short)floorf( s + 0.5f );
+		}
+	}
+	outFill -= frameSize;
+	memmove( outQueue, outQueue + frameSize, outFill * sizeof( float ) );
+}
+
+bool BlockAEC::doubleTalk( const float *mic, const float *spk ){
+	float blockMax = 0.0f;
+	float micMax = 0.0f;
+
+	for( int32_t i = 0; i < blockSize; i++ ){
+		float s = fabsf( spk[i] );
+		float m = fabsf( mic[i] );
+		if( s > blockMax ){
+			blockMax = s;
+		}
+		if( m > micMax ){
+			micMax = m;
+		}
+	}
+	spkMax[newest] = blockMax;
+
+	float tailMax = 0.0f;
+	for( int32_t p = 0; p < nPartitions; p++ ){
+		if( spkMax[p] > tailMax ){
+			tailMax = spkMax[p];
+		}
+	}
+
+	if( micMax >= BLOCKAEC_GEIGEL_THRESHOLD * tailMax ){
+		hangover = hangoverBlocks;
+	}
+	else if( hangover > 0 ){
+		hangover--;
+	}
+
+	/* No update with silence either */
+	return tailMax < BLOCKAEC_UPDATE_THRESHOLD || hangover > 0;
+}
+
+void BlockAEC::processBlock( const float *mic, const float *spk, float *out ){
+	const int32_t n = blockSize;
+	const int32_t stride = nBinsPadded;
+
+	/* Overlap-save: the spectrum of the previous and this block */
+	memcpy( spkTime, spkTime + n, n * sizeof( float ) );
+	memcpy( spkTime + n, spk, n * sizeof( float ) );
+
+	newest = ( newest + 1 ) % nPartitions;
+	float *newRe = xRe + newest * stride;
+	float *newIm = xIm + newest * stride;
+
+	/* Running sum of the power of all the partitions, recomputed
+	 * once per round so that rounding errors do not pile up */
+	if( newest == 0 ){
+		fft.forward( spkTime, newRe, newIm );
+		memset( power, 0, stride * sizeof( float ) );
+		for( int32_t p = 0; p < nPartitions; p++ ){
+			const float *pRe = xRe + p * stride;
+			const float *pIm = xIm + p * stride;
+			for( int32_t k = 0; k < nBins; k++ ){
+				power[k] += pRe[k] * pRe[k] + pIm[k] * pIm[k];
+			}
+		}
+	}
+	else{
+		for( int32_t k = 0; k < nBins; k++ ){
+			power[k] -= newRe[k] * newRe[k] + newIm[k] * newIm[k];
+		}
+		fft.forward( spkTime, newRe, newIm );
+		for( int32_t k = 0; k < nBins; k++ ){
+			power[k] += newRe[k] * newRe[k] + newIm[k] * newIm[k];
+			if( power[k] < 0.0f ){
+				power[k] = 0.0f;
+			}
+		}
+	}
+
+	bool update = !doubleTalk( mic, spk );
+
+	/* Echo estimate, the last half of the circular convolution */
+	memset( yRe, 0, stride * sizeof( float ) );
+	memset( yIm, 0, stride * sizeof( float ) );
+	for( int32_t p = 0; p < nPartitions; p++ ){
+		int32_t x = ( newest - p + nPartitions ) % nPartitions;
+		complexMac( yRe, yIm, wRe + p * stride, wIm + p * stride,
+				xRe + x * stride, xIm + x * stride, nBins );
+	}
+	fft.inverse( yRe, yIm, time );
+
+	for( int32_t i = 0; i < n; i++ ){
+		out[i] = mic[i] - time[n + i];
+	}
+
+	if( update ){
+		memset( time, 0, n * sizeof( float ) );
+		memcpy( time + n, out, n * sizeof( float ) );
+		fft.forward( time, eRe, eIm );
+
+		const float delta = BLOCKAEC_DELTA * 2 * n * nPartitions;
+		for( int32_t k = 0; k < nBins; k++ ){
+			float step = BLOCKAEC_MU / ( power[k] + delta );
+			eRe[k] *= step;
+			eIm[k] *= step;
+		}
+
+		for( int32_t p = 0; p < nPartitions; p++ ){
+			int32_t x = ( newest - p + nPartitions ) % nPartitions;
+			conjMac( wRe + p * stride, wIm + p * stride,
+					xRe + x * stride, xIm + x * stride,
+					eRe, eIm, nBins );
+		}
+
+		/* Only the first half of the impulse response of a
+		 * partition is valid, one is cut back per block */
+		float *cRe = wRe + constrainNext * stride;
+		float *cIm = wIm + constrainNext * stride;
+		fft.inverse( cRe, cIm, time );
+		memset( time + n, 0, n * sizeof( float ) );
+		fft.forward( time, cRe, cIm );
+		constrainNext = ( constrainNext + 1 ) % nPartitions;
+
+		if( suppression ){
+			for( int32_t i = 0; i < n; i++ ){
+				out[i] *= BLOCKAEC_NLP_ATTENUATION;
+			}
+		}
+	}
+}
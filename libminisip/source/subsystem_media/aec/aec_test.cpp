@@ -5,11 +5,27 @@
  * Test stub for Acoustic Echo Cancellation NLMS-pw algorithm
  * Author: Andre Adrian, DFS Deutsche Flugsicherung
  * <Andre.Adrian@dfs.de>
- *
- * compile
-c++ -DWIDEB=1 -O2 -march=pentium3 -o aec_test aec_test.cpp aec.cpp -lm
  *
  * Version 1.3 set/get ambient in dB
+ *
+ * Version 2.0 benchmark and ERLE measurement of the sample based
+ * NLMS-pw AEC and of the block frequency domain BlockAEC.
+ *
+ * usage:
+ *   aec_test [-r rate] [-t tail ms] [-o out.wav] mic.wav spk.wav
+ *   aec_test [-r rate] [-t tail ms] [-o out.wav] stereo.wav
+ *   aec_test
+ *
+ * The microphone signal (with echo) and the loudspeaker signal are
+ * read from two mono WAV files, or from the left and right channel
+ * of a stereo one, 16 bit PCM. Without files, a synthetic echo of
+ * noise bursts through a random room impulse response is used, at
+ * 8, 16 and 48 kHz.
+ *
+ * ERLE (echo return loss enhancement) is measured over the second
+ * half of the signal, where the loudspeaker is active, as the ratio
+ * of the microphone energy to the output energy. The output of the
+ * BlockAEC without its non linear processor (-o) may be written.
  */
 
 #include<config.h>
@@ -18,17 +34,16 @@ c++ -DWIDEB=1 -O2 -march=pentium3 -o aec_test aec_test.cpp aec.cpp -lm
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <sys/time.h>
 
-#include <libminisip/aec.h>
+#include <vector>
 
-#define TAPS  	(80*WIDEB*8)
+#include <libminisip/media/aec/aec.h>
+#include <libminisip/media/aec/BlockAEC.h>
 
-typedef signed short MONO;
+#define FRAME_MS 20
 
-typedef struct {
-  signed short l;
-  signed short r;
-} STEREO;
+typedef std::vector<short> Signal;
 
 float dB2q(float dB)
 {
@@ -42,43 +57,310 @@ float q2dB(float q)
   return 20.0f * log10f(q);
 }
 
-/* Read a raw audio file (8KHz sample frequency, 16bit PCM, stereo)
- * from stdin, echo cancel it and write it to stdout
- */
-int main(int argc, char *argv[])
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static unsigned get16(const unsigned char *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static unsigned long get32(const unsigned char *p)
+{
+  return get16(p) | ((unsigned long)get16(p + 2) << 16);
+}
+
+/* Reads a 16 bit PCM WAV file, returns the samples of each channel */
+static bool readWav(const char *name, int *rate, std::vector<Signal> &channels)
+{
+  FILE *f = fopen(name, "rb");
+  unsigned char hdr[12];
+  int nChannels = 0;
+
+  if (!f) {
+    fprintf(stderr, "%s: cannot open\n", name);
+    return false;
+  }
+  if (fread(hdr, 1, 12, f) != 12 || memcmp(hdr, "RIFF", 4) || memcmp(hdr + 8, "WAVE", 4)) {
+    fprintf(stderr, "%s: not a WAV file\n", name);
+    fclose(f);
+    return false;
+  }
+
+  unsigned char chunk[8];
+  while (fread(chunk, 1, 8, f) == 8) {
+    unsigned long len = get32(chunk + 4);
+
+    if (!memcmp(chunk, "fmt ", 4)) {
+      std::vector<unsigned char> fmt(len);
+      if (len < 16 || fread(&fmt[0], 1, len, f) != len) {
+        break;
+      }
+      nChannels = get16(&fmt[2]);
+      *rate = get32(&fmt[4]);
+      if (get16(&fmt[0]) != 1 || get16(&fmt[14]) != 16) {
+        fprintf(stderr, "%s: not 16 bit PCM\n", name);
+        fclose(f);
+        return false;
+      }
+    } else if (!memcmp(chunk, "data", 4) && nChannels > 0) {
+      std::vector<short> data(len / 2);
+      len = fread(&data[0], 2, data.size(), f);
+      channels.assign(nChannels, Signal());
+      for (unsigned long i = 0; i + nChannels <= len; i += nChannels) {
+        for (int c = 0; c < nChannels; ++c) {
+          const unsigned char *p = (const unsigned char *)&data[i + c];
+          channels[c].push_back((short)get16(p));
+        }
+      }
+      fclose(f);
+      return true;
+    } else {
+      fseek(f, len + (len & 1), SEEK_CUR);
+    }
+  }
+  fprintf(stderr, "%s: no PCM data\n", name);
+  fclose(f);
+  return false;
+}
+
+static void put16(FILE *f, unsigned v)
+{
+  fputc(v & 0xff, f);
+  fputc((v >> 8) & 0xff, f);
+}
+
+static void put32(FILE *f, unsigned long v)
+{
+  put16(f, v & 0xffff);
+  put16(f, v >> 16);
+}
+
+static void writeWav(const char *name, int rate, const Signal &s)
+{
+  FILE *f = fopen(name, "wb");
+
+  if (!f) {
+    fprintf(stderr, "%s: cannot create\n", name);
+    return;
+  }
+  fwrite("RIFF", 1, 4, f);
+  put32(f, 36 + s.size() * 2);
+  fwrite("WAVEfmt ", 1, 8, f);
+  put32(f, 16);
+  put16(f, 1);
+  put16(f, 1);
+  put32(f, rate);
+  put32(f, rate * 2);
+  put16(f, 2);
+  put16(f, 16);
+  fwrite("data", 1, 4, f);
+  put32(f, s.size() * 2);
+  for (size_t i = 0; i < s.size(); ++i) {
+    put16(f, (unsigned short)s[i]);
+  }
+  fclose(f);
+}
+
+static float gauss()
+{
+  /* Sum of uniform variables, close enough for test signals */
+  float s = 0.0f;
+  for (int i = 0; i < 12; ++i) {
+    s += rand() / (float)RAND_MAX;
+  }
+  return s - 6.0f;
+}
+
+/* Noise bursts, one second on and half a second off over a noise
+ * floor 60 dB down (digital silence makes the NLMS-pw diverge),
+ * echoed through an exponentially decaying random impulse response
+ * of tail ms, 10 dB below the loudspeaker signal, with noise 80 dB
+ * down at the mic */
+static void synthesize(int rate, int seconds, int tailMs, Signal &mic, Signal &spk)
+{
+  int n = rate * seconds;
+  int taps = rate * tailMs / 1000 * 3 / 4;
+  int delay = rate * 5 / 1000;
+  std::vector<float> h(delay + taps, 0.0f);
+  std::vector<float> x(n);
+  float energy = 0.0f;
+
+  srand(1);
+  for (int i = 0; i < taps; ++i) {
+    h[delay + i] = gauss() * expf(-6.9f * i / taps);     /* -60 dB at the end */
+    energy += h[delay + i] * h[delay + i];
+  }
+  for (size_t i = 0; i < h.size(); ++i) {
+    h[i] *= dB2q(-10.0f) / sqrtf(energy);
+  }
+
+  float lp = 0.0f;
+  for (int i = 0; i < n; ++i) {
+    bool on = (i % (rate * 3 / 2)) < rate;
+    lp += 0.3f * (gauss() - lp);  /* some low pass coloring, as speech */
+    x[i] = on ? lp * M20dB_PCM : gauss() * M60dB_PCM;
+  }
+
+  spk.resize(n);
+  mic.resize(n);
+  for (int i = 0; i < n; ++i) {
+    float e = 0.0f;
+    int first = i - (int)h.size() + 1;
+    for (int j = first < 0 ? 0 : first; j <= i; ++j) {
+      e += h[i - j] * x[j];
+    }
+    e += gauss() * M60dB_PCM / 10;
+    spk[i] = (short)x[i];
+    mic[i] = (short)floorf(e + 0.5f);
+  }
+}
+
+/* Echo return loss enhancement over the second half, where the
+ * loudspeaker is active, NAN if it is not */
+static float erle(int rate, const Signal &mic, const Signal &spk, const Signal &out)
+{
+  int frame = rate * FRAME_MS / 1000;
+  double in = 0.0, res = 0.0;
+
+  for (size_t f = mic.size() / 2 / frame * frame; f + frame <= mic.size(); f += frame) {
+    double sEnergy = 0.0, mEnergy = 0.0, oEnergy = 0.0;
+    for (int i = 0; i < frame; ++i) {
+      sEnergy += (double)spk[f + i] * spk[f + i];
+      mEnergy += (double)mic[f + i] * mic[f + i];
+      oEnergy += (double)out[f + i] * out[f + i];
+    }
+    if (sEnergy / frame > M40dB_PCM * M40dB_PCM) {
+      in += mEnergy;
+      res += oEnergy;
+    }
+  }
+  if (in == 0.0) {
+    return NAN;         /* the loudspeaker is never active */
+  }
+  return res > 0.0 ? 10.0f * log10f(in / res) : 99.0f;
+}
+
+static void report(const char *name, int rate, int tailMs, double seconds,
+                   const Signal &mic, const Signal &spk, const Signal &out)
 {
-  STEREO inbuf[TAPS], outbuf[TAPS];
+  int frames = mic.size() / (rate * FRAME_MS / 1000);
+  double perFrame = seconds * 1e6 / frames;
 
-  fprintf(stderr, "usage: aec_test [ambient in dB] <in.raw >out.raw\n");
+  printf("%6d Hz %4d ms  %-18s %8.1f us/frame %7.0fx realtime  ERLE %5.1f dB\n",
+         rate, tailMs, name, perFrame, FRAME_MS * 1000.0 / perFrame,
+         erle(rate, mic, spk, out));
+}
 
-  AEC aec;
+static void runBlock(int rate, int tailMs, bool suppression,
+                     const Signal &mic, const Signal &spk, Signal &out)
+{
+  int frame = rate * FRAME_MS / 1000;
+  BlockAEC aec(rate, frame, tailMs);
 
-  if (argc >= 2) {
-    aec.setambient(MAXPCM*dB2q(atof(argv[1])));    
+  aec.setSuppression(suppression);
+  out.assign(mic.size(), 0);
+
+  double start = now();
+  for (size_t f = 0; f + frame <= mic.size(); f += frame) {
+    aec.process(&mic[f], &spk[f], &out[f]);
   }
+  report(suppression ? "BlockAEC" : "BlockAEC (no NLP)", rate, tailMs,
+         now() - start, mic, spk, out);
+}
 
-  int taps;
-  float ambient;
-  while (taps = fread(inbuf, sizeof(STEREO), TAPS, stdin)) {
-    int i;
-    for (i = 0; i < taps; ++i) {
-      int s0 = inbuf[i].l;      /* left channel microphone */
-      int s1 = inbuf[i].r;      /* right channel speaker */
+static void runNlms(const Signal &mic, const Signal &spk)
+{
+  AEC *aec = new AEC;
+  Signal out(mic.size(), 0);
+
+  double start = now();
+  for (size_t i = 0; i < mic.size(); ++i) {
+    out[i] = aec->doAEC(mic[i], spk[i]);
+  }
+  report("NLMS-pw", 8000, NLMS_LEN / 8, now() - start, mic, spk, out);
+  delete aec;
+}
 
-      /* and do NLMS */
-      s0 = aec.doAEC(s0, s1);
+static void run(int rate, int tailMs, const Signal &mic, const Signal &spk,
+                const char *outName)
+{
+  Signal out;
 
-      /* copy back */
-      outbuf[i].l = 0;          /* left channel silence */
-      outbuf[i].r = s0;         /* right channel echo cancelled mic */
+  /* The NLMS-pw filter is tuned for 8 kHz and NLMS_LEN taps */
+  if (rate == 8000) {
+    runNlms(mic, spk);
+  }
+  runBlock(rate, tailMs, true, mic, spk, out);
+  runBlock(rate, tailMs, false, mic, spk, out);
+  if (outName) {
+    writeWav(outName, rate, out);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int rate = 0;
+  int tailMs = NLMS_LEN / 8;
+  const char *outName = NULL;
+  int i;
+
+  for (i = 1; i < argc && argv[i][0] == '-'; ++i) {
+    if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+      rate = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+      tailMs = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+      outName = argv[++i];
+    } else {
+      fprintf(stderr, "usage: aec_test [-r rate] [-t tail ms] [-o out.wav] "
+              "[mic.wav spk.wav | stereo.wav]\n");
+      return 1;
     }
+  }
+
+  if (i == argc) {
+    const int rates[] = { 8000, 16000, 48000 };
+    for (int r = 0; r < 3; ++r) {
+      if (rate && rate != rates[r]) {
+        continue;
+      }
+      Signal mic, spk;
+      synthesize(rates[r], 10, tailMs, mic, spk);
+      run(rates[r], tailMs, mic, spk, outName);
+    }
+    return 0;
+  }
 
-    fwrite(outbuf, sizeof(STEREO), taps, stdout);
+  std::vector<Signal> a, b;
+  int rateB = 0;
+
+  if (!readWav(argv[i], &rate, a)) {
+    return 1;
+  }
+  if (i + 1 < argc) {
+    if (!readWav(argv[i + 1], &rateB, b)) {
+      return 1;
+    }
+    if (rateB != rate) {
+      fprintf(stderr, "the files have different rates\n");
+      return 1;
+    }
+    a.resize(1);
+    a.push_back(b[0]);
+  } else if (a.size() < 2) {
+    fprintf(stderr, "%s: mic and spk are needed in a stereo file\n", argv[i]);
+    return 1;
+  }
+  if (a[1].size() < a[0].size()) {
+    a[0].resize(a[1].size());
   }
-  ambient = aec.getambient();
-  float ambientdB = q2dB(ambient / 32767.0f);
-  fprintf(stderr, "Ambient = %2.0f dB\n", ambientdB);
-  fflush(NULL);
+  a[1].resize(a[0].size());
 
+  run(rate, tailMs, a[0], a[1], outName);
   return 0;
 }
@@ -0,0 +1,214 @@
+/*
+ Copyright (C) 2004-2006 the Minisip Team
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#include<config.h>
+
+#ifdef _MSC_VER
+#define _USE_MATH_DEFINES
+#endif
+
+#include<libminisip/media/codecs/ComfortNoise.h>
+
+#include<math.h>
+#include<string.h>
+
+#ifdef _WIN32_WCE
+# define M_PI           3.14159265358979323846  /* pi */
+#endif
+
+/* Weight of a new frame in the average of the autocorrelation */
+#define NOISE_SMOOTHING 0.2
+
+/* Power of a full scale square wave, the 0 dBov level */
+#define FULL_SCALE_POWER ( 32768.0 * 32768.0 )
+
+/* Reflection coefficients are kept below this magnitude, so that
+ * the synthesis filter of a quantized model stays stable */
+#define MAX_REFLECTION 0.99f
+
+ComfortNoiseEncoder::ComfortNoiseEncoder(): first( true ){
+	memset( autocorr, 0, sizeof( autocorr ) );
+}
+
+void ComfortNoiseEncoder::analyse( const short *samples, int32_t n ){
+	double r[COMFORT_NOISE_ORDER + 1];
+
+	if( n <= COMFORT_NOISE_ORDER ){
+		return;
+	}
+
+	for( int32_t j = 0; j <= COMFORT_NOISE_ORDER; j++ ){
+		double sum = 0;
+		for( int32_t i = j; i < n; i++ ){
+			sum += (double)samples[i] * samples[i - j];
+		}
+		r[j] = sum / n;
+	}
+
+	for( int32_t j = 0; j <= COMFORT_NOISE_ORDER; j++ ){
+		if( first ){
+			autocorr[j] = r[j];
+		}
+		else{
+			autocorr[j] += NOISE_SMOOTHING * ( r[j] - autocorr[j] );
+		}
+	}
+	first = false;
+}
+
+int32_t ComfortNoiseEncoder::getLevel() const{
+	if( autocorr[0] < 1.0 ){
+		return 127;
+	}
+
+	int32_t level = (int32_t)floor( -10 * log10( autocorr[0] / FULL_SCALE_POWER ) + 0.5 );
+	if( level < 0 ){
+		return 0;
+	}
+	if( level > 127 ){
+		return 127;
+	}
+	return level;
+}
+
+uint32_t ComfortNoiseEncoder::encode( byte_t *payload ){
+	double r[COMFORT_NOISE_ORDER + 1];
+	double a[COMFORT_NOISE_ORDER + 1];
+	double k[COMFORT_NOISE_ORDER + 1];
+	double err;
+
+	payload[0] = (byte_t)getLevel();
+
+	// Gaussian lag window of 60 Hz and a white noise floor 40 dB
+	// down, which smooth the spectrum and keep the model stable
+	for( int32_t j = 0; j <= COMFORT_NOISE_ORDER; j++ ){
+		double w = 2 * M_PI * 60 * j / 8000;
+		r[j] = autocorr[j] * exp( -0.5 * w * w );
+	}
+	r[0] *= 1.0001;
+
+	// Levinson-Durbin recursion, giving the reflection coefficients
+	// of the prediction error filter 1 + sum of a[j] z^-j
+	memset( a, 0, sizeof( a ) );
+	memset( k, 0, sizeof( k ) );
+	err = r[0];
+	for( int32_t i = 1; i <= COMFORT_NOISE_ORDER && err > 0; i++ ){
+		double acc = r[i];
+		double tmp[COMFORT_NOISE_ORDER + 1];
+
+		for( int32_t j = 1; j < i; j++ ){
+			acc += a[j] * r[i - j];
+		}
+		k[i] = -acc / err;
+
+		memcpy( tmp, a, sizeof( tmp ) );
+		for( int32_t j = 1; j < i; j++ ){
+			a[j] = tmp[j] + k[i] * tmp[i - j];
+		}
+		a[i] = k[i];
+		err *= 1 - k[i] * k[i];
+	}
+
+	// From -1..1 to 0..254
+	for( int32_t i = 1; i <= COMFORT_NOISE_ORDER; i++ ){
+		int32_t q = (int32_t)floor( ( k[i] + 1 ) * 127 + 0.5 );
+		if( q < 0 ){
+			q = 0;
+		}
+		if( q > 254 ){
+			q = 254;
+		}
+		payload[i] = (byte_t)q;
+	}
+
+	return COMFORT_NOISE_ORDER + 1;
+}
+
+ComfortNoiseGenerator::ComfortNoiseGenerator():
+		order( 0 ), gain( 0 ), seed( 0x2545f491 ){
+	memset( lpc, 0, sizeof( lpc ) );
+	memset( history, 0, sizeof( history ) );
+}
+
+void ComfortNoiseGenerator::decode( const byte_t *payload, uint32_t length ){
+	float k[COMFORT_NOISE_MAX_ORDER + 1];
+	float tmp[COMFORT_NOISE_MAX_ORDER + 1];
+	double predictionGain = 1.0;
+
+	if( length < 1 ){
+		return;
+	}
+
+	order = length - 1;
+	if( order > COMFORT_NOISE_MAX_ORDER ){
+		order = COMFORT_NOISE_MAX_ORDER;
+	}
+
+	for( int32_t i = 1; i <= order; i++ ){
+		k[i] = payload[i] / 127.0f - 1;
+		if( k[i] > MAX_REFLECTION ){
+			k[i] = MAX_REFLECTION;
+		}
+		if( k[i] < -MAX_REFLECTION ){
+			k[i] = -MAX_REFLECTION;
+		}
+		predictionGain *= 1 - k[i] * k[i];
+	}
+
+	// Step up recursion, from the reflection coefficients to the
+	// direct form
+	memset( lpc, 0, sizeof( lpc ) );
+	for( int32_t i = 1; i <= order; i++ ){
+		memcpy( tmp, lpc, sizeof( tmp ) );
+		for( int32_t j = 1; j < i; j++ ){
+			lpc[j] = tmp[j] + k[i] * tmp[i - j];
+		}
+		lpc[i] = k[i];
+	}
+
+	// The filter multiplies the power of the white noise by
+	// 1 / predictionGain, and uniform noise of amplitude 1 has a
+	// power of 1/3
+	double power = FULL_SCALE_POWER * pow( 10.0, -( payload[0] & 0x7f ) / 10.0 );
+	gain = (float)sqrt( 3 * power * predictionGain );
+}
+
+void ComfortNoiseGenerator::generate( short *samples, int32_t n ){
+	for( int32_t i = 0; i < n; i++ ){
+		seed = seed * 1103515245 + 12345;
+		float y = gain * ( (int32_t)( seed >> 1 ) / 1073741824.0f - 1 );
+
+		for( int32_t j = 1; j <= order; j++ ){
+			y -= lpc[j] * history[j - 1];
+		}
+		for( int32_t j = order - 1; j > 0; j-- ){
+			history[j] = history[j - 1];
+		}
+		if( order > 0 ){
+			history[0] = y;
+		}
+
+		if( y > 32767 ){
+			y = 32767;
+		}
+		if( y < -32768 ){
+			y = -32768;
+		}
+		samples[i] = (short)y;
+	}
+}
@@ -5,7 +5,7 @@
 #include<libmutil/minilist.h>
 #include<libmutil/MemObject.h>
 #include<libmnetutil/Socket.h>
-#include<libmnetutil/ServerSocket.h>
+#include<libmnetutil/TcpServerSocket.h>
 #include<libmnetutil/TCPSocket.h>
 #include<libmnetutil/NetworkException.h>
 #include<libmutil/CommandString.h>
@@ -17,21 +17,29 @@
 #include<string>
 
 #include<sys/types.h>
+#include<sys/stat.h>
 #include<netinet/in.h>
+#include<fcntl.h>
+#include<stdio.h>
+#include<string.h>
 
-#include"../../subsystem_media/msrp/MSRPMessage.h"
+#ifdef _MSC_VER
+#	include<io.h>
+#else
+#	include<unistd.h>
+#endif
 
-#define SERVER_PORT 3333
+#include<libmutil/stringutils.h>
 
-using namespace std;
+#include<vector>
+
+#include"../../subsystem_media/msrp/MSRPMessage.h"
 
-char chunk[1024];
-int chunkSize;
-char * byterange = "";
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
 
-string first;
-string second;
-string last;
+using namespace std;
 
 /*class MSRPMessage : public MObject{
 
@@ -105,327 +113,259 @@ MSRPSender::MSRPSender(const string Addr, int32_t Port, const string name, MRef<
 	fName = name;
 	sipstack = sipStack;
 	callid = callId;
+	chunkSize = MSRP_CHUNK_SIZE;
+	bytesSent = 0;
+}
+
+void MSRPSender::setChunkSize(int32_t size){
+	if( size < MSRP_CHUNK_SIZE_MIN )
+		size = MSRP_CHUNK_SIZE_MIN;
+	if( size > MSRP_CHUNK_SIZE_MAX )
+		size = MSRP_CHUNK_SIZE_MAX;
+	chunkSize = size;
 }
 
 void MSRPSender::run(){
-	cerr <<"MAFE: MSRPSender::run() started"<<endl;
+	MRef<TCPSocket*> sock;
+	struct stat st;
 
-	string from_server;
+	bytesSent = 0;
 
-	int num_chunks;
-	TCPSocket *sock=NULL;
-	char report_rec[1000];
-	char * msg;
-	int pktLen=0;
-	//ifstream myfile;
-		
-	cerr <<"MAFE: creating socket, sAddr=<"<<sAddr<<"> and sPort=" << sPort << endl;
-	 try{	
+	try{
 		sock = new TCPSocket(sAddr, sPort);
-		cerr << "MY IP ADDRESS IS "<< sock->getLocalAddress()->getString()<<endl;
-		
 	}catch(ConnectFailed &){
-	       	cerr << "Sorry, I could not connect to port "<< sPort << " on the server." << endl;
+		cerr << "Sorry, I could not connect to port "<< sPort << " on the server." << endl;
 		return;
-	
 	}catch(HostNotFound &){
 		cerr << "Sorry, the server <"<< sAddr<<"> could not be found"<< endl;
 		return;
 	}
-		
-	//cerr <<"MAFE: opening file..."<<endl;
-	myfile.open(fName.c_str(), ios::in|ios::binary|ios::ate);
-	if (myfile.is_open()){
-
-		cerr << "file open correctly" << endl;
-
-		//get size of file
-		myfile.seekg(0, ifstream::end);
-		int filesize = myfile.tellg();
-		myfile.seekg(0);
-
-		num_chunks = filesize/1024;
-
-		cerr <<"Filesize is "<<filesize<<endl;
-		//cerr <<num_chunks<<endl;
-
-		string brange;
-
-		if(num_chunks == 0){
-			brange = "1-"+itoa(filesize)+"/"+itoa(filesize);
-			byterange=(char*)brange.c_str();
-		}
-		else{
-			brange = "1-1024/"+itoa(filesize);
-			byterange=(char*) brange.c_str();
-		}
-		//cerr<<"Byte range is "<<byterange<<endl;
-
-		if(filesize%1024!=0)
-			num_chunks=num_chunks+1;
-
-		while(num_chunks !=0){
-
-			num_chunks--;
-			setchunk();
-
-			//cerr<<"number of chunks "<<num_chunks<<endl;
 
-			MSRPMessageSend new_msg(chunk, chunkSize);
-			//cerr<<"MAFE:  created new object... "<<endl;
-			msg = new_msg.CreateMSRPSend(pktLen);
+	/* The headers between the chunks are small, do not let them
+	 * wait for the acknowledgement of the chunk before */
+	sock->useNoDelay(true);
 
-			//int aux = htonl(chunkSize);
-			if (sock==NULL)
-				cerr<<"MAFE: socket is NULL"<<endl;
-			//int sendtam=sock->write((char*)&aux,sizeof(chunkSize));
+	int fd = ::open(fName.c_str(), O_RDONLY | O_BINARY);
+	if( fd < 0 || fstat(fd, &st) != 0 ){
+		cerr << "MSRPSender: could not open " << fName << endl;
+		if( fd >= 0 )
+			::close(fd);
+		fd = -1;
+	}
 
-			assert(sock);
+	if( fd >= 0 ){
+		int64_t filesize = st.st_size;
+		string toPath = "msrp://" + sAddr + ":" + itoa(sPort) + "/" + callid + ";tcp";
+		string fromPath = "msrp://" + sock->getLocalAddress()->getString() + ":" + itoa(sock->getPort()) + "/" + callid + ";tcp";
+		string endLine;
+		int32_t n = 0;
+
+		/* The end line of a chunk is written with the headers
+		 * of the next one, the file data is written by the
+		 * socket itself, with sendfile when it can */
+		do{
+			int32_t length = chunkSize;
+			if( filesize - bytesSent < length )
+				length = (int32_t)(filesize - bytesSent);
+
+			MSRPMessageSend msg(callid + "-" + itoa(n++), toPath, fromPath,
+					callid, bytesSent + 1, length, filesize);
+			string header = msg.getHeader();
+
+			const void *bufs[2] = { endLine.data(), header.data() };
+			int32_t lengths[2] = { (int32_t)endLine.size(), (int32_t)header.size() };
+
+			if( sock->writev(bufs, lengths, 2) < 0 ||
+			    sock->sendFile(fd, bytesSent, length) != length ){
+				cerr << "MSRPSender: sending " << fName << " failed" << endl;
+				endLine = "";
+				break;
+			}
 
-			int nsent=sock->write(msg, pktLen);
+			bytesSent += length;
+			endLine = msg.getEndLine();
+		}while( bytesSent < filesize );
 
-			//int reprec = sock->read(report_rec, 1024);
+		if( endLine.size() > 0 )
+			sock->write(endLine);
 
-			//report_rec[reprec]=0;
-			//from_server=trim(string(report_rec));
+		::close(fd);
+	}
 
-			//cerr<<"receiving "<<reprec<< " bytes"<<endl;
-			//cerr<<report_rec<<endl;
+	sock->close();
 
-			//string byterange = new_msg.UpdateByteRange();
-		}
-		
+	if( sipstack ){
+		CommandString cmd(callid, "MSRP_DONE");
+		sipstack->handleCommand(cmd);
 	}
-	CommandString cmd(callid, "MSRP_DONE");
-	sipstack->handleCommand(cmd);
 }
-			
-void MSRPSender::setchunk(){
-	
-//	ifstream myfile;
 
-	chunkSize = myfile.readsome(chunk, 1024);
-	//BytesSet += chunkSize;
-	//BytesIndex += BytesSet;
-	cerr << "Read " << chunkSize <<" bytes" << endl; 
-}
-
-MSRPReceiver::MSRPReceiver(const string fileName, int fileSize){
+MSRPReceiver::MSRPReceiver(const string fileName, int fileSize, int32_t port){
 	name = fileName;
 	sizercv = fileSize;
+	received = 0;
+
+	/* Listening before the sender is told the port */
+	try{
+		ssock = TcpServerSocket::create(port);
+	}catch(NetworkException &e){
+		cerr << "MSRPReceiver: could not listen on port " << port << ": " << e.what() << endl;
+	}
 }
 
 void MSRPReceiver::run(){
+	enum { HEADERS, BODY, END } state = HEADERS;
+	vector<char> buf(MSRP_RECEIVE_BUFFER_SIZE);
+	vector<char> writeBuf(MSRP_WRITE_BUFFER_SIZE);
+	size_t pos = 0;
+	size_t end = 0;
+	int64_t bodyLeft = 0;
+	string tid;
+	bool last = false;
+
+	received = 0;
+
+	if( !ssock )
+		return;
 
-	cerr <<"MAFE: MSRPReceiver::run() started on port "<< SERVER_PORT << endl;
-	//cerr<<"receiver before ssock"<<endl;
-
-	MRef<ServerSocket*> ssock = ServerSocket::create(SERVER_PORT);
-	//cerr << "MY IP ADDRESS IS "<< ssock->getLocalAddress()->getString()<<endl;
-
-	//cerr<<"receiver after ssock"<<endl;
-	
-	string from_client;
-	string new_chunk;
-	
-	string string_rep;
-	
-	char * loc;
-	char * loc2;
-	int j;
-	int lng;
-	int lngchunk;
-
-	ofstream SaveFile(name.c_str(), ios::trunc);  //get filename from SDP msg
-
-	cerr <<"waiting for client"<<endl;
 	MRef<StreamSocket*> client_sock = ssock->accept();
-	cerr <<"client connected"<<endl;
-	
-	cerr<<"size of file"<<sizercv<<endl;
-
-	int aux;
-	char receive_buf [10000];
-	char chunk_buffer_prov[1024];
-	int i;
-	//int rectam = client_sock->read((char*)&aux,sizeof(int));
-	//lng = ntohl(aux);
-
-	int chunkRcv = sizercv/1024;
-	if( (aux=sizercv%1024) !=0 )
-		chunkRcv=chunkRcv+1;
+	ssock->close();
+
+	ofstream SaveFile;
+	SaveFile.rdbuf()->pubsetbuf(&writeBuf[0], writeBuf.size());
+	SaveFile.open(name.c_str(), ios::out | ios::trunc | ios::binary);  //get filename from SDP msg
+
+	while( !last ){
+		bool needData = false;
+
+		if( state == HEADERS ){
+			const char *p = &buf[0];
+			const char *hend = NULL;
+			for( size_t i = pos; i + 4 <= end; i++ ){
+				if( memcmp(p + i, "\r\n\r\n", 4) == 0 ){
+					hend = p + i;
+					break;
+				}
+			}
 
-	do{
-		//if(chunkRcv>0){
+			if( !hend ){
+				needData = true;
+			}else{
+				string hdr(p + pos, hend - p - pos);
+				pos = hend - p + 4;
+
+				size_t sp1 = hdr.find(' ');
+				size_t sp2 = hdr.find(' ', sp1 + 1);
+				size_t br = hdr.find("\r\nByte-Range: ");
+				if( sp1 == string::npos || sp2 == string::npos || br == string::npos ){
+					cerr << "MSRPReceiver: malformed request" << endl;
+					break;
+				}
+				tid = hdr.substr(sp1 + 1, sp2 - sp1 - 1);
+
+				/* Byte-Range: start-end/total */
+				int64_t first = 0, lastByte = 0;
+				sscanf(hdr.c_str() + br + 14, "%lld-%lld", (long long*)&first, (long long*)&lastByte);
+				bodyLeft = lastByte - first + 1;
+				if( bodyLeft < 0 )
+					bodyLeft = 0;
+				state = BODY;
+			}
+		}
 
-			int nrecv = client_sock->read(receive_buf,10000);
-		
-			loc = strstr(receive_buf,"Content-Type: ");
-			
-			//cerr<<"localizador del content type: "<<loc<<endl;
+		if( state == BODY ){
+			int64_t n = end - pos;
+			if( n > bodyLeft )
+				n = bodyLeft;
+			if( n > 0 ){
+				SaveFile.write(&buf[pos], n);
+				pos += n;
+				bodyLeft -= n;
+				received += n;
+			}
+			if( bodyLeft == 0 )
+				state = END;
+			else
+				needData = true;
+		}
 
-			while(*loc != '\n'){
-				loc++;
+		if( state == END ){
+			/* CRLF "-------" transaction-id flag CRLF */
+			size_t len = 2 + 7 + tid.size() + 1 + 2;
+			if( end - pos < len ){
+				needData = true;
+			}else{
+				char flag = buf[pos + len - 3];
+				pos += len;
+				last = flag == '$' && received >= sizercv;
+				state = HEADERS;
 			}
-			if(chunkRcv>1){
-			for(j=0; j!=1024; j++){
-				chunk_buffer_prov[j]=*loc;
-				loc++;
-			}	
-			//cerr<<"buffer provisional "<<chunk_buffer_prov<<endl;
-			SaveFile.write(chunk_buffer_prov,1024);
+		}
+
+		if( needData ){
+			/* Keep what is left of a header or end line */
+			if( pos > 0 ){
+				memmove(&buf[0], &buf[pos], end - pos);
+				end -= pos;
+				pos = 0;
 			}
-			else{
-				for(j=0; j!=aux; j++){
-				chunk_buffer_prov[j]=*loc;
-				loc++;
-			}	
-			//cerr<<"buffer provisional "<<chunk_buffer_prov<<endl;
-			SaveFile.write(chunk_buffer_prov,aux);
+			if( end == buf.size() ){
+				cerr << "MSRPReceiver: request headers too long" << endl;
+				break;
 			}
-	
-			chunkRcv--;
-		//}else;
-	}while(chunkRcv>0);
-}
 
-MSRPMessageSend::MSRPMessageSend(char * data, int len){
+			int32_t nrecv = client_sock->read(&buf[end], (int32_t)(buf.size() - end));
+			if( nrecv <= 0 )
+				break;
+			end += nrecv;
+		}
+	}
+
+	SaveFile.close();
+	client_sock->close();
 
-	//mChunk = data;
-	//mChunkLength = len;
+	if( received != sizercv )
+		cerr << "MSRPReceiver: received " << received << " of " << sizercv << " bytes of " << name << endl;
 }
 
-char* MSRPMessageSend::CreateMSRPSend(int& bufferSize){
+MSRPMessageSend::MSRPMessageSend(const string &transactionId, const string &toPath,
+		const string &fromPath, const string &messageId,
+		int64_t start, int32_t length, int64_t total){
+	tid = transactionId;
+	to = toPath;
+	from = fromPath;
+	msgId = messageId;
+	byteStart = start;
+	byteLength = length;
+	byteTotal = total;
+}
 
+string MSRPMessageSend::getHeader(){
 	list<MSRPHeader> hsend;
-	
-	char *nametemp;
-	char *valuetemp;
-	MSRPHeader temp(nametemp,valuetemp);
-	
-	string transc_id ="num_transc";
-	string first_line = "MSRP "+transc_id+" SEND\n";
-	string last_line= "";
-	string hdr = "";
-	string newbyterange;
+	string hdr = "MSRP " + tid + " SEND\r\n";
 
-	MSRPMessageSend m(chunk,chunkSize);
-	
-	bool several_chunks=m.PutLastLine();
-	
-	if(several_chunks == true){
-		
-		last_line = "-------"+transc_id+"+";
-		newbyterange =m.UpdateByteRange();
-	}
-	else{	
-		last_line = "-------"+transc_id+"$";
-		newbyterange = byterange;
-	}
-	
-	hsend.push_back(MSRPHeader("To-Path: ","ToUri"));
-	hsend.push_back(MSRPHeader("From-Path: ","FromUri"));
-	hsend.push_back(MSRPHeader("Message-ID: ","messageID"));
-	hsend.push_back(MSRPHeader("Byte-Range: ",(char*)newbyterange.c_str()));
-	hsend.push_back(MSRPHeader("Failure-Report: ","failrep"));
-	hsend.push_back(MSRPHeader("Success-Report: ","succrep"));
-	hsend.push_back(MSRPHeader("Content-Type: ","contenttype"));
+	hsend.push_back(MSRPHeader("To-Path: ", to));
+	hsend.push_back(MSRPHeader("From-Path: ", from));
+	hsend.push_back(MSRPHeader("Message-ID: ", msgId));
+	hsend.push_back(MSRPHeader("Byte-Range: ", itoa(byteStart) + "-" + itoa(byteStart + byteLength - 1) + "/" + itoa(byteTotal)));
+	hsend.push_back(MSRPHeader("Failure-Report: ", "no"));
+	hsend.push_back(MSRPHeader("Content-Type: ", "application/octet-stream"));
 
 	list<MSRPHeader>::iterator h = hsend.begin();
-
 	while(h != hsend.end()){
-		temp = *h;
-		hdr = hdr + temp.getString();
-		hdr = hdr + "\n";
+		hdr += h->getString();
+		hdr += "\r\n";
 		h++;
 	}
-	hdr += "\n";
-
-	//cerr<<newbyterange<<endl;
+	hdr += "\r\n";
 
-	//string all = first_line + hdr + chunk + last_line;
-	
-	string first= first_line+hdr;
-	
-	cerr<<"MAFE: allocating "<<first.size()+chunkSize+last_line.size()<<" bytes"<<endl;
-	char *pkt = (char*)malloc(first.size()+chunkSize +last_line.size());
-	
-	cerr<<"MAFE: memcpy1"<<endl;
-	memcpy(pkt, first.c_str(), first.size());
-	pkt = pkt+first.size();
-	cerr<<"MAFE: memcpy2"<<endl;
-	memcpy(pkt, chunk, chunkSize);
-	pkt = pkt+chunkSize;
-	cerr<<"MAFE: memcpy3"<<endl;
-	memcpy(pkt, last_line.c_str(), last_line.size());
-	cerr<<"MAFE: memcpy3 done"<<endl;
-	pkt = pkt - (chunkSize + first.size());
-
-	bufferSize=first.size()+chunkSize+last_line.size();
-	//cerr<<"MsrpMessage is: "<<pkt<<endl;
-
-	return pkt;
-}
-
-bool MSRPMessageSend::PutLastLine(){
-
-	bool sev_chunk_bool;
-	int i=0;
-	int sec;
-	first = "";
-	second = "";
-	last = "";
-	
-	//cerr<<byterange<<endl;
-	
-	string rangehere;
-	rangehere = byterange;
-
-	do{
-		first = first + byterange[i];
-		i++;
-	}while(byterange[i] != '-');
-	i++;
-
-	for(byterange[i] != '-'; byterange[i] != '/'; i++){
-		second = second + byterange[i];
-	}
-	i++;
-
-	for(byterange[i] != '/'; i<rangehere.length(); i++){
-		last = last + byterange[i];
-	}
-
-	if(second == last)
-		sev_chunk_bool = false;
-	else
-		sev_chunk_bool = true;
-	
-	//cerr<<sev_chunk_bool<<endl;
-	return(sev_chunk_bool);
+	return hdr;
 }
 
-string MSRPMessageSend::UpdateByteRange(){
-
-	string updbyterange;
-	int one;
-	int two;
-	
-	MSRPMessageSend m(chunk,chunkSize);
-		
-	one = atoi(first.c_str());
-	two = atoi(second.c_str());
-	
-	one = two + 1;
-	two = one + 1024;
-	
-	string strone = itoa(one);
-	string strtwo = itoa(two);
-	
-	updbyterange = strone+"-"+strtwo+"/"+last;
-		
-	//cerr<<updbyterange<<endl;
-	return(updbyterange);
+string MSRPMessageSend::getEndLine(){
+	/* "+" while more chunks of the file follow */
+	bool complete = byteStart + byteLength - 1 >= byteTotal;
+	return "\r\n-------" + tid + (complete ? "$" : "+") + "\r\n";
 }
 
 MSRPMessageReport::MSRPMessageReport(char * chunk, int chunklenght){}
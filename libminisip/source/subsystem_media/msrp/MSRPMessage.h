@@ -6,7 +6,7 @@
 #include<libmutil/MemObject.h>
 #include<libmnetutil/Socket.h>
 #include<libmnetutil/TCPSocket.h>
-#include<libmnetutil/ServerSocket.h>
+#include<libmnetutil/TcpServerSocket.h>
 #include<libmnetutil/NetworkException.h>
 #include<libmutil/CommandString.h>
 #include<libmutil/Thread.h>
@@ -20,6 +20,17 @@
 
 #define SERVER_PORT 3333
 
+/* Default bytes of the file sent per SEND request, and the limits
+ * of the configured size */
+#define MSRP_CHUNK_SIZE (256*1024)
+#define MSRP_CHUNK_SIZE_MIN 1024
+#define MSRP_CHUNK_SIZE_MAX (1024*1024)
+
+/* Bytes the receiver reads from the socket at a time, and buffers
+ * before writing them to the file */
+#define MSRP_RECEIVE_BUFFER_SIZE (256*1024)
+#define MSRP_WRITE_BUFFER_SIZE (1024*1024)
+
 using namespace std;
 
 class MSRPMessage : public MObject{
@@ -40,7 +51,7 @@ class MSRPHeader : public MObject{
 		string attrib;
 		string val;
 		
-		MSRPHeader(char* name, char* value){
+		MSRPHeader(const string &name, const string &value){
 			attrib = name;
 			val = value;
 		}
@@ -50,22 +61,33 @@ class MSRPHeader : public MObject{
 		}
 };
 
+/**
+ * A SEND request carrying length bytes of a file of total bytes,
+ * from the byte start on (the first byte is 1). The body is not
+ * part of the message, so that the sender can pass it from the
+ * file to the socket without copying it.
+ */
 class MSRPMessageSend : public MSRPMessage{
 
 	public:
-		MSRPMessageSend(char * chunk, int chunklength);
-		
-		//virtual ~MSRPMessageSend();
-
-		//MSRPMessageSend(TCPSocket * sock);
-		char * CreateMSRPSend(int &outlength);
-		//string CreateMSRPSend();
-		string UpdateByteRange();
-		bool PutLastLine();
-/*	
+		MSRPMessageSend(const string &transactionId, const string &toPath,
+				const string &fromPath, const string &messageId,
+				int64_t start, int32_t length, int64_t total);
+
+		/** The start line and the headers, up to the body */
+		string getHeader();
+
+		/** The end line following the body */
+		string getEndLine();
+
 	private:
-		char * mChunk;
-		int mChunkLength;*/
+		string tid;
+		string to;
+		string from;
+		string msgId;
+		int64_t byteStart;
+		int32_t byteLength;
+		int64_t byteTotal;
 };
 
 class MSRPMessageReport : public MSRPMessage{
@@ -88,36 +110,44 @@ class MSRPSender : public Runnable{
 		//virtual ~MSRPSender();
 
 		void run();
-		void setchunk();
 
-		int BytesSet;
-		int BytesLeft;
-		int BytesIndex;
-		int BytesTotal;
-		
-		ifstream myfile;
-		string string_msg;
-		string filetosend;		
-		
-	private:
-		//char chunk[8];
+		/**
+		 * Bytes of the file sent per SEND request, kept within
+		 * MSRP_CHUNK_SIZE_MIN and MSRP_CHUNK_SIZE_MAX.
+		 */
+		void setChunkSize(int32_t size);
+
+		/** Bytes of the file sent by run */
+		int64_t getBytesSent(){ return bytesSent; }
 
+	private:
 		string sAddr;
 		string fName;
 		int32_t sPort;
 		MRef<SipStack*> sipstack;
 		string callid;
+		int32_t chunkSize;
+		int64_t bytesSent;
 };
 
 class MSRPReceiver : public Runnable{
 
 	public:
-		MSRPReceiver(const std::string filename, int file_size);
+		/**
+		 * Listens on the given port, run then accepts the sender
+		 * and saves the file.
+		 */
+		MSRPReceiver(const std::string filename, int file_size, int32_t port = SERVER_PORT);
 		void run();	
+
+		/** Bytes of the file received by run */
+		int64_t getBytesReceived(){ return received; }
+
 	private:
-		char chunk[1024];
+		MRef<ServerSocket*> ssock;
 		string name;
-		int sizercv;
+		int64_t sizercv;
+		int64_t received;
 };
 
 #endif
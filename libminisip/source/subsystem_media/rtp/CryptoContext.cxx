@@ -229,7 +229,8 @@ void CryptoContext::rtp_authenticate( RtpPacket * rtp, uint32_t roc, unsigned ch
 		unsigned int chunkLength[6];
 		uint32_t beRoc = hton32( roc );
 
-		char* bytes = rtp->getHeader().getBytes();
+		unsigned char bytes[RTP_HEADER_MAX_SIZE];
+		rtp->getHeader().writeTo( bytes );
 		unsigned char* content = rtp->getContent();
                 unsigned char* extension = rtp->getExtensionHeader();
 
@@ -261,7 +262,6 @@ void CryptoContext::rtp_authenticate( RtpPacket * rtp, uint32_t roc, unsigned ch
 		massert( tag_length == 20 );
 		/* truncate the result */
 		memcpy( tag, temp, get_tag_length() );
-		delete [] bytes;
 
 	}
 }
@@ -124,9 +124,16 @@ int RtpHeader::size(){
 }
 
 char *RtpHeader::getBytes(){
-        uint8_t i;
 	char *ret = new char[size()];
 
+	writeTo( (unsigned char *)ret );
+
+	return ret;
+}
+
+int RtpHeader::writeTo( unsigned char *ret ){
+        uint8_t i;
+
         ret[0] = ( ( version << 6 ) & 0xc0 ) |
                  ( ( extension << 4 ) & 0x10 ) |
                  ( ( CSRC_count & 0x0F ) );
@@ -155,7 +162,39 @@ char *RtpHeader::getBytes(){
         for( i = 0; i < CSRC.size(); i++ )
 		((uint32_t *)ret)[i32+i]=hton32(CSRC[i]);
         
-	return ret;
+	return size();
+}
+
+int RtpHeader::parse( const unsigned char *buf, int length ){
+	uint8_t j;
+	uint8_t cc;
+
+	if( length < 12 ){
+		/* too small to contain an RTP header */
+		return -1;
+	}
+
+	cc = buf[0] & 0x0F;
+	if( length < 12 + cc * 4 ){
+		/* too small to contain an RTP header with cc CSRC */
+		return -1;
+	}
+
+	version = ( buf[0] >> 6 ) & 0x03;
+	extension = ( buf[0] >> 4 ) & 0x01;
+	CSRC_count = cc;
+	marker = ( buf[1] >> 7 ) & 0x01;
+	payload_type = buf[1] & 0x7F;
+
+	sequence_number = ( ((uint16_t)buf[2]) << 8 ) | buf[3];
+	timestamp = U32_AT( buf + 4 );
+	SSRC = U32_AT( buf + 8 );
+
+	CSRC.clear();
+	for( j = 0 ; j < cc ; j++ )
+		CSRC.push_back( U32_AT( buf + 12 + j*4 ) );
+
+	return 12 + cc * 4;
 }
 
 #ifdef DEBUG_OUTPUT
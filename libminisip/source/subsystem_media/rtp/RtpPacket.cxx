@@ -51,6 +51,7 @@ RtpPacket::RtpPacket() {
     extensionLength = 0;
     extensionHeader = NULL;
     zrtpChecksum = 0;
+    slab = NULL;
 }
 
 RtpPacket::RtpPacket(unsigned char *content_, int cl,
@@ -60,6 +61,7 @@ RtpPacket::RtpPacket(unsigned char *content_, int cl,
     extensionLength = 0;
     extensionHeader = NULL;
     zrtpChecksum = 0;
+    slab = NULL;
 
     header.setVersion(2);
     header.setSeqNo(seq_no);
@@ -68,7 +70,15 @@ RtpPacket::RtpPacket(unsigned char *content_, int cl,
 
     if( content_length ){
 	massert(content_length>0 && content_length<0xFFFF);
-	this->content = new unsigned char[content_length];
+	/* Leave room for the header in front and the SRTP tag
+	 * behind, so that the packet can be sent without copy */
+	if( RTP_PACKET_HEADROOM + content_length + RTP_PACKET_TAILROOM
+			<= RTP_PACKET_SLAB_SIZE ){
+	    slab = RtpPacketPool::getInstance()->getSlab();
+	    this->content = slab + RTP_PACKET_HEADROOM;
+	}
+	else
+	    this->content = new unsigned char[content_length];
 	memcpy(this->content, content_, content_length);
     }
     else
@@ -80,7 +90,26 @@ RtpPacket::RtpPacket(const RtpHeader &hdr, unsigned char *content_, int cl): hea
     extensionLength = 0;
     extensionHeader = NULL;
     zrtpChecksum = 0;
+    slab = NULL;
 
+    setContent( content_, cl, true );
+
+    header.setVersion(2);
+}
+
+RtpPacket::RtpPacket(const RtpHeader &hdr, unsigned char *slab_, int headerSize, int length): header(hdr) {
+
+    extensionLength = 0;
+    extensionHeader = NULL;
+    zrtpChecksum = 0;
+    slab = slab_;
+
+    setContent( slab + headerSize, length - headerSize, false );
+
+    header.setVersion(2);
+}
+
+void RtpPacket::setContent(unsigned char *content_, int cl, bool copy) {
     /*
      * Check if packet contains an extension header. If yes
      * set pointer to extension header, compute length and
@@ -97,20 +126,26 @@ RtpPacket::RtpPacket(const RtpHeader &hdr, unsigned char *content_, int cl): hea
 	cl -= tmp;
 
         if (cl >= 0) {
-            extensionHeader = new unsigned char[extensionLength];
-            memcpy(this->extensionHeader, content_, extensionLength);
+            if (copy) {
+                extensionHeader = new unsigned char[extensionLength];
+                memcpy(this->extensionHeader, content_, extensionLength);
+            }
+            else
+                extensionHeader = content_;
         }
     }
     this->content_length = cl;
 
     if( content_length > 0 ){
-	this->content = new unsigned char[content_length];
-	memcpy(this->content, content_ + extensionLength, content_length);
+	if (copy) {
+	    this->content = new unsigned char[content_length];
+	    memcpy(this->content, content_ + extensionLength, content_length);
+	}
+	else
+	    this->content = content_ + extensionLength;
     }
     else
 	this->content = NULL;
-
-    header.setVersion(2);
 }
 
 void RtpPacket::setExtHeader(unsigned char* data, int length) {
@@ -118,6 +153,9 @@ void RtpPacket::setExtHeader(unsigned char* data, int length) {
     if (data == NULL || length == 0) {
 	return;
     }
+    if (extensionHeader != NULL && !inSlab(extensionHeader)) {
+        delete [] extensionHeader;
+    }
     extensionHeader = new unsigned char[length];
     memcpy(extensionHeader, data, length);
 
@@ -130,15 +168,40 @@ RtpHeader &RtpPacket::getHeader(){
 }
 
 RtpPacket::~RtpPacket(){
-    if (content!=NULL)
+    if (content!=NULL && !inSlab(content))
 	delete [] content;
-    if (extensionHeader != NULL) {
+    if (extensionHeader != NULL && !inSlab(extensionHeader)) {
         delete [] extensionHeader;
     }
+    if (slab != NULL)
+	RtpPacketPool::getInstance()->releaseSlab(slab);
+}
+
+unsigned char *RtpPacket::layoutInPlace(){
+    /* The ZRTP checksum covers the packet as built by getBytes */
+    if (content == NULL || !inSlab(content) || zrtpChecksum)
+	return NULL;
+
+    int hdrSize = header.size();
+    unsigned char *start = content - extensionLength - hdrSize;
+    if (start < slab)
+	return NULL;
+
+    header.writeTo(start);
+    if (extensionLength > 0 && extensionHeader != start + hdrSize)
+	memmove(start + hdrSize, extensionHeader, extensionLength);
+
+    return start;
 }
 
 void RtpPacket::sendTo(UDPSocket &udp_sock, IPAddress &to_addr, int port){
    //  printf("---------------------------------------- RtpPacket sendTo  test 7  \n");
+    unsigned char *wire = layoutInPlace();
+    if (wire != NULL) {
+	udp_sock.sendTo(to_addr, port, wire, size());
+	return;
+    }
+
     char *bytes = getBytes();
     udp_sock.sendTo(to_addr, port, bytes, size());
     delete [] bytes;
@@ -0,0 +1,111 @@
+/*
+ Copyright (C) 2004-2006 the Minisip Team
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#include<config.h>
+
+#include<libminisip/media/rtp/RtpPacketPool.h>
+#include<libminisip/media/rtp/SRtpPacket.h>
+
+#include<new>
+
+using namespace std;
+
+RtpPacketPool * RtpPacketPool::getInstance(){
+	/* Never deleted, packets may still be released while the
+	 * static objects are being destroyed */
+	static RtpPacketPool * instance = new RtpPacketPool();
+	return instance;
+}
+
+RtpPacketPool::RtpPacketPool():nHeapAllocations(0),nReuses(0){
+	freeSlabs.reserve( RTP_PACKET_POOL_MAX );
+	freePackets.reserve( RTP_PACKET_POOL_MAX );
+}
+
+unsigned char * RtpPacketPool::getSlab(){
+	unsigned char * slab = NULL;
+
+	poolLock.lock();
+	if( !freeSlabs.empty() ){
+		slab = freeSlabs.back();
+		freeSlabs.pop_back();
+		nReuses++;
+	}
+	else{
+		nHeapAllocations++;
+	}
+	poolLock.unlock();
+
+	if( !slab ){
+		slab = new unsigned char[ RTP_PACKET_SLAB_SIZE ];
+	}
+	return slab;
+}
+
+void RtpPacketPool::releaseSlab( unsigned char * slab ){
+	poolLock.lock();
+	if( freeSlabs.size() < RTP_PACKET_POOL_MAX ){
+		freeSlabs.push_back( slab );
+		slab = NULL;
+	}
+	poolLock.unlock();
+
+	if( slab ){
+		delete [] slab;
+	}
+}
+
+void * RtpPacketPool::allocPacket( size_t size ){
+	void * packet = NULL;
+
+	/* Only SRtpPacket objects are recycled */
+	if( size != sizeof( SRtpPacket ) ){
+		return ::operator new( size );
+	}
+
+	poolLock.lock();
+	if( !freePackets.empty() ){
+		packet = freePackets.back();
+		freePackets.pop_back();
+		nReuses++;
+	}
+	else{
+		nHeapAllocations++;
+	}
+	poolLock.unlock();
+
+	if( !packet ){
+		packet = ::operator new( size );
+	}
+	return packet;
+}
+
+void RtpPacketPool::freePacket( void * packet, size_t size ){
+	if( size == sizeof( SRtpPacket ) ){
+		poolLock.lock();
+		if( freePackets.size() < RTP_PACKET_POOL_MAX ){
+			freePackets.push_back( packet );
+			packet = NULL;
+		}
+		poolLock.unlock();
+	}
+
+	if( packet ){
+		::operator delete( packet );
+	}
+}
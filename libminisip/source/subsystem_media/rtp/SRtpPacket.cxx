@@ -56,6 +56,7 @@
 #include<libmutil/stringutils.h>
 #include<libmutil/merror.h>
 #include<libmutil/MemObject.h>
+#include<libmutil/dbg.h>
 
 #ifdef DEBUG_OUTPUT
 #include<iostream>
@@ -73,9 +74,16 @@ void SRtpPacket::protect( MRef<CryptoContext *> scontext ){
     scontext->rtp_encrypt( this, index );
     encrypted = true;
 
-    /* Compute MAC */
+    /* Compute MAC, straight behind the content when it is
+     * held in a slab */
     tag_length = scontext->get_tag_length();
-    tag = new unsigned char[ tag_length ];
+    if( tag && !inSlab( tag ) )
+	delete [] tag;
+    if( content && inSlab( content ) &&
+	    content + content_length + tag_length <= slab + RTP_PACKET_SLAB_SIZE )
+	tag = content + content_length;
+    else
+	tag = new unsigned char[ tag_length ];
 
     scontext->rtp_authenticate( this, scontext->get_roc(), tag );
     /* Update the ROC if necessary */
@@ -123,7 +131,8 @@ int SRtpPacket::unprotect( MRef<CryptoContext *> scontext ){
 	return 1;
     }
 
-    unsigned char * mac = new unsigned char[tag_length];
+    unsigned char mac[20];
+    massert( tag_length <= sizeof( mac ) );
     scontext->rtp_authenticate( this, (uint32_t)( guessed_index >> 16 ), mac );
     for( unsigned i = 0; i < tag_length; i++ ){
 	if( tag[i] != mac[i] )
@@ -136,7 +145,6 @@ int SRtpPacket::unprotect( MRef<CryptoContext *> scontext ){
 	    return 1;
 	}
     }
-    delete [] mac;
 
     /* Decrypt the content */
     scontext->rtp_encrypt( this, guessed_index );
@@ -195,62 +203,89 @@ SRtpPacket::SRtpPacket(RtpHeader hdr, unsigned char *content, int content_length
 }
 
 
+SRtpPacket::SRtpPacket(const RtpHeader &hdr, unsigned char *slab, int headerSize, int length):
+    RtpPacket(hdr, slab, headerSize, length ), encrypted(true), tag(NULL), tag_length(0), mki(NULL), mki_length(0){
+}
+
+
 SRtpPacket::~SRtpPacket(){
-    if( mki )
+    if( mki && !inSlab( mki ) )
 	delete [] mki;
-    if( tag )
+    if( tag && !inSlab( tag ) )
 	delete [] tag;
 }
 
+void *SRtpPacket::operator new(size_t size){
+    return RtpPacketPool::getInstance()->allocPacket( size );
+}
+
+void SRtpPacket::operator delete(void *packet, size_t size){
+    RtpPacketPool::getInstance()->freePacket( packet, size );
+}
+
+unsigned char *SRtpPacket::layoutInPlace(){
+    unsigned char *start = RtpPacket::layoutInPlace();
+    if( !start )
+	return NULL;
+
+    /* The tag and MKI follow the content */
+    unsigned char *end = content + content_length;
+    if( end + tag_length + mki_length > slab + RTP_PACKET_SLAB_SIZE )
+	return NULL;
+
+    if( tag_length && tag != end )
+	memmove( end, tag, tag_length );
+    if( mki_length && mki != end + tag_length )
+	memmove( end + tag_length, mki, mki_length );
+
+    return start;
+}
+
 
 SRtpPacket *SRtpPacket::readPacket(UDPSocket &srtp_socket, MRef<IPAddress *> &from, int timeout) {
-#define UDP_SIZE 65536
 	int i;
-	uint8_t buf[UDP_SIZE];
 	int32_t port;
-	i = srtp_socket.recvFrom((char*)buf, UDP_SIZE, from, port);
+	RtpPacketPool * pool = RtpPacketPool::getInstance();
+	unsigned char * slab = pool->getSlab();
+
+	/* Receive straight into the slab the packet will keep */
+	i = srtp_socket.recvFrom((char*)slab, RTP_PACKET_SLAB_SIZE, from, port);
 	if( i < 0 ){
 #ifdef DEBUG_OUTPUT
 		merror("recvfrom:");
 #endif
+		pool->releaseSlab( slab );
 		return NULL;
 	}
-	return readPacket(buf, i);
-}
 
-SRtpPacket *SRtpPacket::readPacket(byte_t *buf, unsigned buflen) {
-#define UDP_SIZE 65536
-    uint8_t j;
-    uint8_t cc;
+	if( i >= RTP_PACKET_SLAB_SIZE ){
+		mdbg("media") << "SRtpPacket: dropping a datagram larger than "
+			<< RTP_PACKET_SLAB_SIZE << " bytes" << endl;
+		pool->releaseSlab( slab );
+		return NULL;
+	}
 
-    if( buflen < 12 ){
-	/* too small to contain an RTP header */
-	return NULL;
-    }
+	RtpHeader hdr;
+	int hdrSize = hdr.parse( slab, i );
+	if( hdrSize < 0 ){
+		pool->releaseSlab( slab );
+		return NULL;
+	}
 
-    cc = buf[0] & 0x0F;
-    if( buflen < 12 + cc * 4 ){
-	/* too small to contain an RTP header with cc CCSRC */
-	return NULL;
-    }
+	return new SRtpPacket( hdr, slab, hdrSize, i );
+}
 
+SRtpPacket *SRtpPacket::readPacket(byte_t *buf, unsigned buflen) {
     RtpHeader hdr;
-    hdr.setVersion( ( buf[0] >> 6 ) & 0x03 );
-    hdr.setExtension(  ( buf[0] >> 4 ) & 0x01 );
-    hdr.setCSRCCount( cc );
-    hdr.setMarker( ( buf[1] >> 7 ) & 0x01  );
-    hdr.setPayloadType( buf[1] & 0x7F );
-
-    hdr.setSeqNo( ( ((uint16_t)buf[2]) << 8 ) | buf[3] );
-    hdr.setTimestamp( U32_AT( buf + 4 ) );
-    hdr.setSSRC( U32_AT( buf + 8 ) );
+    int hdrSize = hdr.parse( buf, buflen );
 
-    for( j = 0 ; j < cc ; j++ )
-	hdr.addCSRC( U32_AT( buf + 12 + j*4 ) );
+    if( hdrSize < 0 ){
+	return NULL;
+    }
 
-    int datalen = buflen - 12 - cc*4;
+    int datalen = buflen - hdrSize;
 
-    unsigned char *data = (unsigned char *)&buf[ 12 + 4*cc ];
+    unsigned char *data = (unsigned char *)&buf[ hdrSize ];
 
     SRtpPacket *srtp = new SRtpPacket( hdr, data, datalen, NULL, 0, NULL, 0 );
 
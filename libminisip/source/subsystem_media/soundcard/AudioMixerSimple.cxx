@@ -55,7 +55,7 @@ bool AudioMixerSimple::init( uint32_t numChannels_ ) {
 	return true;
 }
 
-short * AudioMixerSimple::mix (list<MRef<SoundSource *> > sources) {
+short * AudioMixerSimple::mix (list<MRef<SoundSource *> > &sources) {
 	
 	uint32_t size = frameSize * numChannels;
 
@@ -53,7 +53,7 @@ AudioMixerSpatial::AudioMixerSpatial(MRef<SpAudio *> spatial) {
 AudioMixerSpatial::~AudioMixerSpatial() {
 }
 
-short * AudioMixerSpatial::mix (list<MRef<SoundSource *> > sources) {
+short * AudioMixerSpatial::mix (list<MRef<SoundSource *> > &sources) {
 	
 	uint32_t size = frameSize * numChannels;
 	int32_t pointer;
@@ -0,0 +1,314 @@
+/*
+ Copyright (C) 2004-2006 the Minisip Team
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#include<config.h>
+
+#include<libminisip/media/soundcard/MediaClock.h>
+#include<libmutil/mtime.h>
+#include<libmutil/dbg.h>
+
+#ifdef HAVE_SYS_TIMERFD_H
+#	include<sys/timerfd.h>
+#	include<errno.h>
+#endif
+
+#ifdef _MSC_VER
+#	include<windows.h>
+#else
+#	include<sys/time.h>
+#	include<unistd.h>
+#endif
+
+#include<algorithm>
+
+using namespace std;
+
+static uint64_t utime(){
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static int32_t countProcessors(){
+#ifdef _MSC_VER
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	return (int32_t)info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+	long n = sysconf( _SC_NPROCESSORS_ONLN );
+	return n > 0 ? (int32_t)n : 1;
+#else
+	return 1;
+#endif
+}
+
+MediaClock::MediaClock( int32_t periodMs_, int32_t nWorkers_ ):
+		periodMs( periodMs_ ),
+		nWorkers( nWorkers_ ),
+		running( false ),
+		quitWorkers( false ),
+		timerFd( -1 ),
+		nextTick( 0 ),
+		tickNo( 0 ),
+		pending( 0 ),
+		startedWorkers( 0 ){
+	if( nWorkers <= 0 ){
+		nWorkers = countProcessors();
+	}
+}
+
+MediaClock::~MediaClock(){
+	stop();
+}
+
+void MediaClock::start(){
+	if( running ){
+		return;
+	}
+	running = true;
+
+#ifdef HAVE_SYS_TIMERFD_H
+	timerFd = timerfd_create( CLOCK_MONOTONIC, 0 );
+	if( timerFd >= 0 ){
+		struct itimerspec spec;
+		spec.it_interval.tv_sec = periodMs / 1000;
+		spec.it_interval.tv_nsec = ( periodMs % 1000 ) * 1000000L;
+		spec.it_value = spec.it_interval;
+		if( timerfd_settime( timerFd, 0, &spec, NULL ) < 0 ){
+			close( timerFd );
+			timerFd = -1;
+		}
+	}
+	if( timerFd < 0 ){
+		merr << "MediaClock: no timerfd, ticking with sleeps" << endl;
+	}
+#endif
+	nextTick = mtime() + periodMs;
+
+	workLock.lock();
+	quitWorkers = false;
+	startedWorkers = 0;
+	tickNo = 0;
+	workLock.unlock();
+	for( int32_t i = 1; i < nWorkers; i++ ){
+		workerThreads.push_back( Thread::createThread( workerLoop, this ) );
+	}
+	clockThread = Thread::createThread( clockLoop, this );
+}
+
+void MediaClock::stop(){
+	if( !running ){
+		return;
+	}
+
+	/* The workers are needed until the last tick is done */
+	workLock.lock();
+	running = false;
+	workLock.unlock();
+	Thread::join( clockThread );
+
+	workLock.lock();
+	quitWorkers = true;
+	workCond.broadcast();
+	workLock.unlock();
+	for( size_t i = 0; i < workerThreads.size(); i++ ){
+		Thread::join( workerThreads[i] );
+	}
+	workerThreads.clear();
+
+#ifdef HAVE_SYS_TIMERFD_H
+	if( timerFd >= 0 ){
+		close( timerFd );
+		timerFd = -1;
+	}
+#endif
+}
+
+void MediaClock::addClient( MediaClockClient *client ){
+	clientsLock.lock();
+	if( find( clients.begin(), clients.end(), client ) == clients.end() ){
+		clients.push_back( client );
+	}
+	clientsLock.unlock();
+}
+
+void MediaClock::removeClient( MediaClockClient *client ){
+	/* Waits for the tick in progress, if any */
+	clientsLock.lock();
+	vector<MediaClockClient *>::iterator i;
+	i = find( clients.begin(), clients.end(), client );
+	if( i != clients.end() ){
+		clients.erase( i );
+	}
+	clientsLock.unlock();
+}
+
+MediaClockStats MediaClock::getStats(){
+	statsLock.lock();
+	MediaClockStats ret = stats;
+	statsLock.unlock();
+	return ret;
+}
+
+void MediaClock::resetStats(){
+	statsLock.lock();
+	stats = MediaClockStats();
+	statsLock.unlock();
+}
+
+bool MediaClock::isRunning(){
+	workLock.lock();
+	bool ret = running;
+	workLock.unlock();
+	return ret;
+}
+
+uint64_t MediaClock::waitTick(){
+#ifdef HAVE_SYS_TIMERFD_H
+	if( timerFd >= 0 ){
+		uint64_t expirations = 0;
+		ssize_t n;
+
+		do{
+			n = read( timerFd, &expirations, sizeof( expirations ) );
+		} while( n < 0 && errno == EINTR );
+
+		if( !isRunning() || n != sizeof( expirations ) ){
+			return 0;
+		}
+		return expirations;
+	}
+#endif
+	/* Sleep to an absolute deadline, so that the time spent in
+	 * the ticks does not add up */
+	uint64_t now = mtime();
+	while( isRunning() && now < nextTick ){
+		Thread::msleep( (int32_t)( nextTick - now ) );
+		now = mtime();
+	}
+	if( !isRunning() ){
+		return 0;
+	}
+
+	uint64_t elapsed = 1 + ( now - nextTick ) / periodMs;
+	nextTick += elapsed * periodMs;
+	return elapsed;
+}
+
+void MediaClock::runSlice( int32_t worker ){
+	size_t n = clients.size();
+	size_t first = n * worker / nWorkers;
+	size_t last = n * ( worker + 1 ) / nWorkers;
+
+	for( size_t i = first; i < last; i++ ){
+		clients[i]->tick();
+	}
+}
+
+void *MediaClock::clockLoop( void *arg ){
+#ifdef DEBUG_OUTPUT
+	setThreadName( "MediaClock" );
+#endif
+	MediaClock *clock = (MediaClock *)arg;
+	uint64_t elapsed;
+
+	while( ( elapsed = clock->waitTick() ) > 0 ){
+		uint64_t start = utime();
+
+		clock->clientsLock.lock();
+
+		uint32_t nClients = (uint32_t)clock->clients.size();
+
+		/* Hand their slices to the workers, with few clients
+		 * waking them up costs more than it saves */
+		bool parallel = clock->nWorkers > 1 &&
+				nClients >= (uint32_t)clock->nWorkers;
+		if( parallel ){
+			clock->workLock.lock();
+			clock->tickNo++;
+			clock->pending = clock->nWorkers - 1;
+			clock->workCond.broadcast();
+			clock->workLock.unlock();
+
+			clock->runSlice( 0 );
+
+			clock->workLock.lock();
+			while( clock->pending > 0 ){
+				clock->doneCond.wait( clock->workLock );
+			}
+			clock->workLock.unlock();
+		}
+		else{
+			for( uint32_t i = 0; i < nClients; i++ ){
+				clock->clients[i]->tick();
+			}
+		}
+
+		clock->clientsLock.unlock();
+
+		uint64_t tickTime = utime() - start;
+
+		clock->statsLock.lock();
+		clock->stats.ticks++;
+		clock->stats.missed += elapsed - 1;
+		clock->stats.totalTickTime += tickTime;
+		if( tickTime > clock->stats.maxTickTime ){
+			clock->stats.maxTickTime = tickTime;
+		}
+		if( tickTime > (uint64_t)clock->periodMs * 1000 ){
+			clock->stats.overruns++;
+		}
+		clock->stats.clients = nClients;
+		clock->statsLock.unlock();
+	}
+	return NULL;
+}
+
+void *MediaClock::workerLoop( void *arg ){
+#ifdef DEBUG_OUTPUT
+	setThreadName( "MediaClock worker" );
+#endif
+	MediaClock *clock = (MediaClock *)arg;
+	/* Ticks are numbered from 1, one handed out before this
+	 * thread got the lock is still run */
+	uint64_t seen = 0;
+
+	clock->workLock.lock();
+	int32_t worker = ++clock->startedWorkers;
+
+	while( true ){
+		while( !clock->quitWorkers && clock->tickNo == seen ){
+			clock->workCond.wait( clock->workLock );
+		}
+		if( clock->quitWorkers ){
+			break;
+		}
+		seen = clock->tickNo;
+		clock->workLock.unlock();
+
+		/* The clock thread holds clientsLock until all are done */
+		clock->runSlice( worker );
+
+		clock->workLock.lock();
+		if( --clock->pending == 0 ){
+			clock->doneCond.broadcast();
+		}
+	}
+	clock->workLock.unlock();
+	return NULL;
+}
@@ -0,0 +1,81 @@
+/*
+ Copyright (C) 2004-2006 the Minisip Team
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#include<config.h>
+
+#include"NullClockSoundDevice.h"
+
+#include<string.h>
+
+using namespace std;
+
+NullClockSoundDevice::NullClockSoundDevice( string device, MRef<MediaClock *> c ):
+		SoundDevice( device ), clock( c ){
+	/* The clock paces SoundIO, write() must not sleep */
+	setSleepTime( 0 );
+}
+
+int NullClockSoundDevice::openRecord( int32_t samplingRate_, int nChannels, int format_ ){
+	samplingRate = samplingRate_;
+	nChannelsRecord = nChannels;
+	setFormat( format_ );
+	openedRecord = true;
+	return 0;
+}
+
+int NullClockSoundDevice::openPlayback( int32_t samplingRate_, int nChannels, int format_ ){
+	samplingRate = samplingRate_;
+	nChannelsPlay = nChannels;
+	setFormat( format_ );
+	openedPlayback = true;
+	return 0;
+}
+
+int NullClockSoundDevice::closeRecord(){
+	openedRecord = false;
+	return 0;
+}
+
+int NullClockSoundDevice::closePlayback(){
+	openedPlayback = false;
+	return 0;
+}
+
+int NullClockSoundDevice::readFromDevice( byte_t * buffer, uint32_t nSamples ){
+	memset( buffer, 0, nSamples * getSampleSize() * getNChannelsRecord() );
+	return nSamples;
+}
+
+int NullClockSoundDevice::writeToDevice( byte_t * buffer, uint32_t nSamples ){
+	return nSamples;
+}
+
+int NullClockSoundDevice::readError( int errcode, byte_t * buffer, uint32_t nSamples ){
+	return -1;
+}
+
+int NullClockSoundDevice::writeError( int errcode, byte_t * buffer, uint32_t nSamples ){
+	return -1;
+}
+
+void NullClockSoundDevice::sync(){
+}
+
+MRef<MediaClock *> NullClockSoundDevice::getClock(){
+	return clock;
+}
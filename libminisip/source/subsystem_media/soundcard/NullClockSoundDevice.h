@@ -0,0 +1,58 @@
+/*
+ Copyright (C) 2004-2006 the Minisip Team
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#ifndef NULLCLOCKSOUNDDEVICE_H
+#define NULLCLOCKSOUNDDEVICE_H
+
+#include<libminisip/libminisip_config.h>
+
+#include<libminisip/media/soundcard/SoundDevice.h>
+#include<libminisip/media/soundcard/MediaClock.h>
+
+/**
+Sound device without hardware, for servers.
+Records silence and discards what is played, without blocking:
+SoundIO calls it once per tick of the MediaClock of the device.
+*/
+class NullClockSoundDevice: public SoundDevice{
+	public:
+		NullClockSoundDevice( std::string device, MRef<MediaClock *> clock );
+
+		virtual int readFromDevice( byte_t * buffer, uint32_t nSamples );
+		virtual int writeToDevice( byte_t * buffer, uint32_t nSamples );
+
+		virtual int readError( int errcode, byte_t * buffer, uint32_t nSamples );
+		virtual int writeError( int errcode, byte_t * buffer, uint32_t nSamples );
+
+		virtual int openPlayback( int32_t samplingRate, int nChannels, int format );
+		virtual int openRecord( int32_t samplingRate, int nChannels, int format );
+
+		virtual int closePlayback();
+		virtual int closeRecord();
+
+		virtual void sync();
+
+		virtual MRef<MediaClock *> getClock();
+
+		virtual std::string getMemObjectType() const { return "NullClockSoundDevice"; }
+
+	private:
+		MRef<MediaClock *> clock;
+};
+
+#endif
@@ -0,0 +1,67 @@
+/*
+ Copyright (C) 2004-2006 the Minisip Team
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#include<config.h>
+
+#include<libminisip/media/soundcard/SoundDriver.h>
+#include<libminisip/media/soundcard/SoundDriverRegistry.h>
+#include<libmutil/MPlugin.h>
+
+#include"NullClockSoundDriver.h"
+#include"NullClockSoundDevice.h"
+
+using namespace std;
+
+static const char DRIVER_PREFIX[] = "nullclock";
+
+/* The packetization interval SoundIO works with */
+#define NULLCLOCK_PERIOD 20
+
+NullClockSoundDriver::NullClockSoundDriver( MRef<Library*> lib ) : SoundDriver( DRIVER_PREFIX, lib ){
+}
+
+NullClockSoundDriver::~NullClockSoundDriver( ){
+	if( clock ){
+		clock->stop();
+	}
+}
+
+MRef<SoundDevice*> NullClockSoundDriver::createDevice( string deviceId ){
+	return new NullClockSoundDevice( deviceId, getClock() );
+}
+
+MRef<MediaClock *> NullClockSoundDriver::getClock(){
+	clockLock.lock();
+	if( !clock ){
+		clock = new MediaClock( NULLCLOCK_PERIOD );
+		clock->start();
+	}
+	MRef<MediaClock *> ret = clock;
+	clockLock.unlock();
+	return ret;
+}
+
+std::vector<SoundDeviceName> NullClockSoundDriver::getDeviceNames() const {
+	std::vector<SoundDeviceName> names;
+
+	return names;
+}
+
+uint32_t NullClockSoundDriver::getVersion() const{
+	return 0x00000001;
+}
@@ -26,6 +26,8 @@
 
 #include<libminisip/media/soundcard/SilenceSensor.h>
 
+#include<math.h>
+
 static int iabs(int i){
     if (i<0)
         return -i;
@@ -56,6 +58,104 @@ bool SimpleSilenceSensor::silence(uint16_t *buf, int n){
     return inSilence;
 }
 
+
+/* Frames below this energy (about -60 dBov) are always silent */
+#define VAD_MIN_ENERGY 30.0f
+
+/* Margins over the noise energy, in dB, of a frame of speech, and of
+ * one whose spectrum differs from that of the noise */
+#define VAD_ENERGY_MARGIN 9.0f
+#define VAD_SPECTRAL_MARGIN 4.0f
+#define VAD_TILT_DIFF 0.25f
+#define VAD_ZCR_DIFF 0.1f
+
+/* The noise energy is the lowest frame energy of the last one to
+ * two windows of this many frames */
+#define VAD_WINDOW 50
+
+/* Frames used to learn the noise before any is reported silent */
+#define VAD_INIT_FRAMES VAD_WINDOW
+
+/* Weight of a silent frame in the spectral features of the noise */
+#define VAD_NOISE_ADAPT 0.1f
+
+/* Hangover after a burst of speech, after a short one (a click) */
+#define VAD_HANGOVER 10
+#define VAD_SHORT_HANGOVER 2
+#define VAD_SHORT_BURST 3
+
+VadSilenceSensor::VadSilenceSensor():noiseEnergy(0),noiseTilt(0),noiseZcr(0),
+        windowMin(1000),prevWindowMin(1000),windowFrames(0),
+        nFrames(0),speechFrames(0),hangover(0){
+}
+
+bool VadSilenceSensor::silence(uint16_t *buf, int n){
+    const short *x = (const short *)buf;
+    double e = 0, r1 = 0;
+    int zc = 0;
+
+    if (n < 2)
+        return false;
+
+    for (int i=0; i<n; i++){
+        e += (double)x[i]*x[i];
+        if (i > 0){
+            r1 += (double)x[i]*x[i-1];
+            if ((x[i] < 0) != (x[i-1] < 0))
+                zc++;
+        }
+    }
+
+    float energy = (float)(10*log10(e/n + 1));
+    float tilt = e > 0 ? (float)(r1/e) : 0;
+    float zcr = (float)zc/n;
+
+    // Minimum statistics: a louder noise is followed within two
+    // windows, speech is not since it has pauses
+    if (energy < windowMin)
+        windowMin = energy;
+    if (++windowFrames == VAD_WINDOW){
+        prevWindowMin = windowMin;
+        windowMin = energy;
+        windowFrames = 0;
+    }
+    noiseEnergy = windowMin < prevWindowMin ? windowMin : prevWindowMin;
+
+    if (nFrames < VAD_INIT_FRAMES){
+        // Average of the first frames, as if they were noise
+        nFrames++;
+        noiseTilt += (tilt-noiseTilt)/nFrames;
+        noiseZcr += (zcr-noiseZcr)/nFrames;
+        return false;
+    }
+
+    float margin = energy-noiseEnergy;
+    bool speech = energy > VAD_MIN_ENERGY &&
+        (margin > VAD_ENERGY_MARGIN ||
+         (margin > VAD_SPECTRAL_MARGIN &&
+          (fabs(tilt-noiseTilt) > VAD_TILT_DIFF ||
+           fabs(zcr-noiseZcr) > VAD_ZCR_DIFF)));
+
+    if (speech){
+        speechFrames++;
+        if (speechFrames >= VAD_SHORT_BURST)
+            hangover = VAD_HANGOVER;
+        else if (hangover < VAD_SHORT_HANGOVER)
+            hangover = VAD_SHORT_HANGOVER;
+        return false;
+    }
+
+    noiseTilt += VAD_NOISE_ADAPT*(tilt-noiseTilt);
+    noiseZcr += VAD_NOISE_ADAPT*(zcr-noiseZcr);
+
+    speechFrames = 0;
+    if (hangover > 0){
+        hangover--;
+        return false;
+    }
+    return true;
+}
+
 /*
 
 
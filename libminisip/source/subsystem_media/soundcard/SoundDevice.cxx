@@ -27,6 +27,7 @@
 
 #include<libminisip/media/soundcard/SoundDevice.h>
 #include<libminisip/media/soundcard/SoundDriverRegistry.h>
+#include<libminisip/media/soundcard/MediaClock.h>
 
 #ifdef WAVE_SOUND
 #	include"WaveSoundDevice.h"
@@ -86,6 +87,10 @@ void SoundDevice::unlockWrite(){
 	mLockWrite.unlock();
 }
 
+MRef<MediaClock *> SoundDevice::getClock(){
+	return NULL;
+}
+
 void SoundDevice::setFormat( int format_ ) {
 	switch( format_ ) {
 		case SOUND_S16LE: 
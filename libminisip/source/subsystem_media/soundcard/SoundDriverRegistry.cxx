@@ -27,6 +27,7 @@
 #include<libminisip/media/soundcard/SoundDriverRegistry.h>
 #include<libmutil/dbg.h>
 #include"FileSoundDriver.h"
+#include"NullClockSoundDriver.h"
 
 #ifdef _MSC_VER
 #include"DirectSoundDriver.h"
@@ -56,6 +57,7 @@ static void dumpAllNames( MRef<SoundDriverRegistry*> instance ){
 
 SoundDriverRegistry::SoundDriverRegistry(){
 	registerPlugin( new FileSoundDriver( NULL ) );
+	registerPlugin( new NullClockSoundDriver( NULL ) );
 #ifdef _MSC_VER
 	registerPlugin( new DirectSoundDriver(NULL) );
 #endif
@@ -61,7 +61,7 @@
 #endif
 
 #ifdef _MSC_VER
-
+#	include<windows.h>
 #else
 #	include<sys/time.h>
 #	include<unistd.h>
@@ -73,6 +73,37 @@
 
 using namespace std;
 
+/*
+ * sourcesGeneration is stored with release order after the list of
+ * sources is changed, and loaded with acquire order by the player,
+ * so that a new generation is never seen before the new list.
+ */
+static inline int32_t loadAcquire( volatile int32_t *p ){
+#if defined(__ATOMIC_ACQUIRE)
+	return __atomic_load_n( p, __ATOMIC_ACQUIRE );
+#elif defined(_MSC_VER)
+	int32_t v = *p;
+	MemoryBarrier();
+	return v;
+#else
+	int32_t v = *p;
+	__sync_synchronize();
+	return v;
+#endif
+}
+
+static inline void storeRelease( volatile int32_t *p, int32_t v ){
+#if defined(__ATOMIC_RELEASE)
+	__atomic_store_n( p, v, __ATOMIC_RELEASE );
+#elif defined(_MSC_VER)
+	MemoryBarrier();
+	*p = v;
+#else
+	__sync_synchronize();
+	*p = v;
+#endif
+}
+
 // //This object is created always, for now, even we do not 
 // //use spatial audio ...
 // SpAudio SoundIO::spAudio(5);
@@ -84,21 +115,52 @@ SoundIO::SoundIO(
 		int nChannels_, 
 		int32_t samplingRate_, 
 		int format_): 
+			sourcesGeneration(0),
 			nChannels(nChannels_),
 			samplingRate(samplingRate_),
 			format(format_),
-			recording(false)
+			recording(false),
+			tickGeneration(-1),
+			tickOpened(false),
+			tickBuffer(NULL),
+			tickLeft(NULL),
+			tickRight(NULL)
 {
 	soundDevIn = inputDevice;
 	soundDevOut = outputDevice;
 
 	setMixer( mixerType );
+
+	if( soundDevIn && soundDevOut ){
+		clock = soundDevOut->getClock();
+		if( clock && soundDevIn->getClock() != clock ){
+			clock = NULL;
+		}
+	}
+
+	if( clock ){
+		//FIXME: fixed like in recorderLoop()
+		recorder_buffer_size = SOUND_CARD_FREQ*20/1000;
+		tickBuffer = new short[recorder_buffer_size * nChannels];
+		tickLeft = new short[recorder_buffer_size];
+		tickRight = new short[recorder_buffer_size];
+		clock->addClient( this );
+		return;
+	}
+
 	/* Create the SoundPlayerLoop */
 	start_sound_player();
 	start_recorder();
 }
 
 SoundIO::~SoundIO(){
+	if( clock ){
+		clock->removeClient( this );
+		delete [] tickBuffer;
+		delete [] tickLeft;
+		delete [] tickRight;
+	}
+
 	while( recorder_callbacks.size() ){
 		delete *( recorder_callbacks.begin() );
 		recorder_callbacks.pop_back();
@@ -172,35 +234,43 @@ void SoundIO::openRecord(){
 }
 
 void SoundIO::startRecord(){
+	recorderLock.lock();
 	recording = true;
+	recorderLock.unlock();
 	recorderCond.broadcast();
 }
 
 void SoundIO::stopRecord(){
+	recorderLock.lock();
 	recording = false;
+	recorderLock.unlock();
 }
 
 void SoundIO::register_recorder_receiver(SoundRecorderCallback *callback, 
                                         int32_t nrsamples,
                                         bool stereo )
 {
+	recorderLock.lock();
 	recorder_callbacks.push_back(new RecorderReceiver(callback, stereo));
 	recorder_buffer_size = nrsamples;   // FIXME: implement a way to 
                                             // return different amount of data 
                                             // to different recorders - needed 
                                             // for G711+ilbc.
+	recorderLock.unlock();
 }
 
 void SoundIO::unregisterRecorderReceiver( SoundRecorderCallback *callback ) {
 	list<RecorderReceiver *>::iterator iter;
+	recorderLock.lock();
 	for( iter = recorder_callbacks.begin();
 		iter != recorder_callbacks.end();
 		iter++ ) {
 		if( (*iter)->getCallback() == callback ) {
 			recorder_callbacks.erase( iter );
-			return;
+			break;
 		}
 	}
+	recorderLock.unlock();
 }
 
 void SoundIO::set_recorder_buffer_size(int32_t bs){
@@ -306,31 +376,11 @@ void *SoundIO::recorderLoop(void *sc_arg){
 #endif
 		}else{
 			//AudioMedia iimplements the callback ...
-			for (list<RecorderReceiver *>::iterator 
-                                    cb=soundcard->recorder_callbacks.begin(); 
-                                    cb!= soundcard->recorder_callbacks.end(); 
-                                    cb++){
-
-				if ((*cb)!=NULL && (*cb)->getCallback()!=NULL){
-					#ifdef AEC_SUPPORT
-					(*cb)->getCallback()->srcb_handleSound(
-							tempBuffer, 
-							soundcard->recorder_buffer_size,
-							tempBufferR); //hanning
-					#else
-					//cerr <<"EEEE: SoundIO: data is"<<binToHex((unsigned char*)tempBuffer, soundcard->recorder_buffer_size*2)<<endl;
-					(*cb)->getCallback()->srcb_handleSound(
-							tempBuffer, 
-							soundcard->recorder_buffer_size,
-							soundcard->samplingRate
-							);
-					#endif
-					
-					
-				}else{
-					cerr << "Ignoring null callback"<< endl;
-				}
-			}
+			#ifdef AEC_SUPPORT
+			soundcard->callRecorders( tempBuffer, tempBufferR );
+			#else
+			soundcard->callRecorders( tempBuffer, NULL );
+			#endif
 
 			i++;
 		}
@@ -338,6 +388,36 @@ void *SoundIO::recorderLoop(void *sc_arg){
 	return NULL;
 }
 
+void SoundIO::callRecorders( short *buf, short *right ){
+	recorderLock.lock();
+	for (list<RecorderReceiver *>::iterator 
+                            cb=recorder_callbacks.begin(); 
+                            cb!= recorder_callbacks.end(); 
+                            cb++){
+
+		if ((*cb)!=NULL && (*cb)->getCallback()!=NULL){
+			#ifdef AEC_SUPPORT
+			(*cb)->getCallback()->srcb_handleSound(
+					buf, 
+					recorder_buffer_size,
+					right); //hanning
+			#else
+			//cerr <<"EEEE: SoundIO: data is"<<binToHex((unsigned char*)buf, recorder_buffer_size*2)<<endl;
+			(*cb)->getCallback()->srcb_handleSound(
+					buf, 
+					recorder_buffer_size,
+					samplingRate
+					);
+			#endif
+			
+			
+		}else{
+			cerr << "Ignoring null callback"<< endl;
+		}
+	}
+	recorderLock.unlock();
+}
+
 void SoundIO::start_recorder(){
         Thread::createThread(recorderLoop, this);
 }
@@ -366,6 +446,7 @@ void SoundIO::registerSource( MRef<SoundSource *> source ){
 	//sources.push_front(source);
 	sources.push_back(source);
 	mixer->setSourcesPosition( sources, true ); //added sources
+	storeRelease( &sourcesGeneration, sourcesGeneration + 1 );
 
 	sourceListCond.broadcast();
 	queueLock.unlock();
@@ -397,6 +478,7 @@ void SoundIO::unregisterSource(int sourceId){
 //		(*i)->initLookup(nextSize);
 //	}
 	mixer->setSourcesPosition( sources, false );//removed sources
+	storeRelease( &sourcesGeneration, sourcesGeneration + 1 );
 	queueLock.unlock();
 }
 
@@ -422,14 +504,55 @@ MRef<SoundSource *> SoundIO::getSoundSource(int32_t id){
 	return NULL;	
 }
 
+void SoundIO::refreshSources( list<MRef<SoundSource *> > &playing,
+		int32_t &generation, bool &opened, bool wait ){
+	queueLock.lock();
+	if( sources.size() == 0 ){
+		playing.clear();
+		if( soundDevOut->isOpenedPlayback() ){
+			closePlayback();
+		}
+
+		opened = false;
+
+		if( wait ){
+			/* Wait for someone to add a source */
+			sourceListCond.wait( queueLock );
+		}
+	}
+
+	/* A source may have been added before the player
+	 * first got the lock */
+	if( !opened && sources.size() > 0 ){
+		openPlayback();
+		mixer->init( soundDevOut->getNChannelsPlay() );
+		opened = true;
+	}
+
+	playing = sources;
+	generation = sourcesGeneration;
+	queueLock.unlock();
+}
+
+void SoundIO::playFrame( list<MRef<SoundSource *> > &playing ){
+	short *outbuf = mixer->mix( playing );
+
+	if( soundDevOut->isOpenedPlayback() ){
+		send_to_card( outbuf, mixer->getFrameSize() );
+	}
+}
+
 void *SoundIO::playerLoop(void *arg){
 #ifdef DEBUG_OUTPUT
 	setThreadName("SoundIO::playerLoop");
 #endif
 	SoundIO *soundcard = (SoundIO *)arg;
 
-	short *outbuf = NULL;
-	uint32_t nChannels = 0;
+	/* The sources being played, copied from sources when the
+	 * list changes. Mixing them takes no lock. */
+	list<MRef<SoundSource *> > playing;
+	int32_t generation = -1;
+	bool opened = false;
 
 	if( soundcard->getMixer().isNull() ) {
 		cerr << "Error: Sound I/O ... mixer is null ... stopping the thread!!!" << endl;
@@ -441,30 +564,65 @@ void *SoundIO::playerLoop(void *arg){
 #endif
 	while( true ){
 
-                soundcard->queueLock.lock();
-		if( soundcard->sources.size() == 0 ){
-			if( soundcard->soundDevOut->isOpenedPlayback() ){
-				soundcard->closePlayback();
+		if( generation != loadAcquire( &soundcard->sourcesGeneration ) ||
+				playing.empty() ){
+			soundcard->refreshSources( playing, generation, opened, true );
+
+			if( playing.empty() ){
+				/* Woken up with nothing to play */
+				continue;
 			}
-			
-			/* Wait for someone to add a source */
-			soundcard->sourceListCond.wait( soundcard->queueLock );
+		}
 
-			soundcard->openPlayback();
-			nChannels = soundcard->soundDevOut->getNChannelsPlay();
-			soundcard->mixer->init(nChannels);
+		soundcard->playFrame( playing );
+	}
+	return NULL;
+}
+
+void SoundIO::tick(){
+	/* One iteration of recorderLoop() */
+	recorderLock.lock();
+	bool record = recording;
+	recorderLock.unlock();
+
+	if( record ){
+		if( !soundDevIn->isOpenedRecord() ){
+			openRecord();
+		}
+
+		int32_t nread = -1;
+		soundDevIn->lockRead();
+		if( soundDevIn->isOpenedRecord() ){
+			nread = soundDevIn->read( (byte_t *)tickBuffer,
+					recorder_buffer_size );
 		}
+		soundDevIn->unlockRead();
 
-		outbuf = soundcard->mixer->mix( soundcard->sources );
- 		
-		soundcard->queueLock.unlock();
+		if( nread == recorder_buffer_size ){
+			int32_t nch = soundDevIn->getNChannelsRecord();
+			short *buf = tickBuffer;
 
-		if( soundcard->soundDevOut->isOpenedPlayback() ){
-			soundcard->send_to_card(outbuf, soundcard->mixer->getFrameSize());
+			if( nch > 1 ){
+				for( int32_t j = 0; j < recorder_buffer_size; j++ ){
+					tickLeft[j] = tickBuffer[j * nch];
+					tickRight[j] = tickBuffer[j * nch + 1];
+				}
+				buf = tickLeft;
+			}
+			callRecorders( buf, tickRight );
 		}
-		
 	}
-	return NULL;
+	else if( soundDevIn->isOpenedRecord() ){
+		closeRecord();
+	}
+
+	/* One iteration of playerLoop() */
+	if( tickGeneration != loadAcquire( &sourcesGeneration ) ){
+		refreshSources( tickSources, tickGeneration, tickOpened, false );
+	}
+	if( !tickSources.empty() ){
+		playFrame( tickSources );
+	}
 }
 
 void SoundIO::start_sound_player(){
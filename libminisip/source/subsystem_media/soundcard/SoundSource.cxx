@@ -92,6 +92,8 @@ BasicSoundSource::BasicSoundSource(int32_t id,
 
 	temp = new short[iFrames * oNChannels];
 	memset(temp,0,iFrames * oNChannels*sizeof(short));
+	pushTemp = new short[iFrames * oNChannels];
+	memset(pushTemp,0,iFrames * oNChannels*sizeof(short));
 	
 	//FIXME FIXME FIXME FIXME FIXME FIXME FIXME FIXME FIXME
 	//With this implementation, we keep losing audio ... 
@@ -103,7 +105,10 @@ BasicSoundSource::BasicSoundSource(int32_t id,
 	//         For now, we do 20ms * 5 = 100ms
 	//	We can set this even smaller ... but then we may have problems
 	//	if rtp packets come in burst  ... 
-	cbuff = new CircularBuffer( iFrames * oNChannels * CIRCULAR_BUFFER_SIZE );
+	//With the lock-free buffer, a write that does not fit is dropped
+	//instead of overwriting the oldest samples, the delay is bounded
+	//the same way.
+	cbuff = new SPSCCircularBuffer( iFrames * oNChannels * CIRCULAR_BUFFER_SIZE );
 
 	/* spatial audio initialization */
 	leftch = new short[1028];
@@ -123,6 +128,7 @@ BasicSoundSource::BasicSoundSource(int32_t id,
 
 BasicSoundSource::~BasicSoundSource(){
 	delete [] temp;
+	delete [] pushTemp;
 // 	delete [] stereoBuffer;
 	delete cbuff;
 }
@@ -157,7 +163,6 @@ void BasicSoundSource::pushSound(short * samples,
 	}
 #endif
         
-	bufferLock.lock();
 	//Check for OverFlow ... this happens if we receive big burst of packets ...
 	//or we are not emptying the buffer quick enough ...
  	if( cbuff->getFree() < nMonoSamples * (int)oNChannels ) {
@@ -175,8 +180,8 @@ void BasicSoundSource::pushSound(short * samples,
 	if( isStereo ) {
 
 		//TODO: FIXME: handle case where sampleRate is > 8kHz
-		resampler->resample( samples, temp);
-		writeRet = cbuff->write( temp, nMonoSamples * 2, true );
+		resampler->resample( samples, pushTemp);
+		writeRet = cbuff->write( pushTemp, nMonoSamples * 2 );
 	} else {
 		int tempVal;
 
@@ -185,30 +190,28 @@ void BasicSoundSource::pushSound(short * samples,
 
 			if( cur > (int32_t)iFrames )
 				cur = iFrames;
-			memset( temp, 0, iFrames * oNChannels ); 
+			memset( pushTemp, 0, iFrames * oNChannels ); 
 			for( int32_t i = 0; i<cur; i++ ) {
 				tempVal = i*oNChannels;
-				temp[ tempVal ] = samples[i];
+				pushTemp[ tempVal ] = samples[i];
 				tempVal ++;
-				temp[ tempVal ] = samples[i];
+				pushTemp[ tempVal ] = samples[i];
 			}
 
 			if (sampleRate==oFreq){
-				writeRet = cbuff->write( temp, cur * 2, true );
+				writeRet = cbuff->write( pushTemp, cur * 2 );
 				samples += cur;
 				nSamples -= cur;
 			}else{
 				short temp2[2048];
-				resampler->resample( temp, temp2);
-				writeRet = cbuff->write( temp2, cur * 2*2, true );
+				resampler->resample( pushTemp, temp2);
+				writeRet = cbuff->write( temp2, cur * 2*2 );
 				samples += cur;
 				nSamples -= cur;
 			}
 		}
 	}
 
-
-	bufferLock.unlock();
 #ifdef DEBUG_OUTPUT
 	if( writeRet == false ) {
 		cerr << "BasicSoundSource::pushSound - Buffer write error"<<endl;
@@ -239,8 +242,6 @@ void BasicSoundSource::getSound(short *dest,
 	}
 #endif
 	
-	bufferLock.lock();
-        	
 	//Check for underflow ...
 	//	if it is so, use the PLC to fill in the missing audio, or produce silence
 	//NOTE Underflow is not so bad ... for example, if using a peer like minisip, it will
@@ -250,12 +251,21 @@ void BasicSoundSource::getSound(short *dest,
 	#ifdef DEBUG_OUTPUT
 		printf("UF");
 	#endif
+		short *b = NULL;
+		uint32_t size = oFrames;
 		if (plcProvider){
 		#ifdef DEBUG_OUTPUT
 			cerr << "PLC!"<< endl;
 		#endif			
-			short *b = plcProvider->get_plc_sound(oFrames);
-			memcpy(dest, b, oFrames);
+			b = plcProvider->get_plc_sound(size);
+		}
+		if (b){
+			/* The provider may return fewer frames than asked
+			 * for, the rest is silence */
+			uint32_t n = size < oFrames ? size : oFrames;
+			memcpy(dest, b, n * oNChannels * sizeof(short));
+			memset(dest + n * oNChannels, 0,
+					(oFrames - n) * oNChannels * sizeof(short));
 		}else{
 		//	for (uint32_t i=0; i < oFrames * oNChannels; i++){
 		//		dest[i]=0;
@@ -266,7 +276,6 @@ void BasicSoundSource::getSound(short *dest,
 			}
 
 		}
-		bufferLock.unlock();
                 return;
 	}
 	
@@ -291,7 +300,6 @@ void BasicSoundSource::getSound(short *dest,
 	memcpy((void*)&plcCache[0], dest, oFrames*oNChannels );
 
 // 	memset( dest, 0, oFrames * oNChannels * sizeof( short ) ); 
-	bufferLock.unlock();
 	
 }
 
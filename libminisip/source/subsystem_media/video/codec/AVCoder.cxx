@@ -32,6 +32,7 @@
 
 #include<config.h>
 #include<stdio.h>
+#include<stdlib.h>
 #include<fcntl.h>
 #include<iostream>
 #include<string.h>
@@ -76,14 +77,26 @@ using namespace std;
 AVEncoder::AVEncoder() {
 	video=NULL;
 	videoCodec=NULL;
-	swsctx=NULL;
 	N=0;
+	nAllocations=0;
+	nZeroCopyFrames=0;
+	frameSize=0;
 	profile=1;
 	width=1280;
 	height=720;
 
 }
 
+AVEncoder::~AVEncoder(){
+	Video *video = (Video*)this->video;
+	if (video){
+		releaseFrame(video->yuv);
+		video->yuv=NULL;
+	}
+	freeFrames();
+	freeSwsContexts();
+}
+
 #ifdef GLOBAL_BANDWIDTH_HACK
 extern volatile int globalBitRate;
 #endif
@@ -100,6 +113,8 @@ void AVEncoder::init( uint32_t width, uint32_t height ){
 	VideoCodec *videoCodec = (VideoCodec*)this->videoCodec;
 
 	if (video){
+		releaseFrame(video->yuv);
+		free(video->compressed);
 		delete video;
 		video=NULL;
 	}
@@ -110,7 +125,9 @@ void AVEncoder::init( uint32_t width, uint32_t height ){
 	}
 
 	this->video = video = new Video;
+	nAllocations++;
 	this->videoCodec = videoCodec = new VideoCodec;
+	nAllocations++;
 
 	avcodec_init(); //perhaps needed for img_convert?
 
@@ -140,11 +157,9 @@ void AVEncoder::init( uint32_t width, uint32_t height ){
 
 	hdviper_setup_video_encoder(videoCodec, VIDEO_CODEC_H264, video);
 
-	video->yuv=(unsigned char *)malloc(sizeof(unsigned char)*video->width*video->height*3/2);
+	video->yuv=takeFrame(video->width*video->height*3/2);
 	video->compressed=(char *)malloc(sizeof(unsigned char)*videoCodec->bitrate*1000/8);
-
-//	if (swsctx) //make handle() allocate a new context with the new dimensions and format
-//		sws_freeContext( (struct SwsContext*)swsctx );
+	nAllocations++;
 }
 
 void AVEncoder::close(){
@@ -152,6 +167,72 @@ void AVEncoder::close(){
 	VideoCodec *videoCodec = (VideoCodec*)this->videoCodec;
 	if (videoCodec)
 		hdviper_destroy_video_encoder(videoCodec);
+	freeSwsContexts();
+}
+
+void *AVEncoder::getSwsContext( int srcFormat, uint32_t srcWidth, uint32_t srcHeight,
+		uint32_t dstWidth, uint32_t dstHeight ){
+	std::list<SwsCacheEntry>::iterator i;
+	for( i = swsCache.begin(); i != swsCache.end(); i++ ){
+		if( (*i).srcFormat == srcFormat &&
+				(*i).srcWidth == srcWidth && (*i).srcHeight == srcHeight &&
+				(*i).dstWidth == dstWidth && (*i).dstHeight == dstHeight ){
+			return (*i).ctx;
+		}
+	}
+
+	SwsCacheEntry e;
+	e.srcFormat = srcFormat;
+	e.srcWidth = srcWidth;
+	e.srcHeight = srcHeight;
+	e.dstWidth = dstWidth;
+	e.dstHeight = dstHeight;
+	e.ctx = sws_getContext( srcWidth, srcHeight, (PixelFormat)srcFormat,
+			dstWidth, dstHeight, PIX_FMT_YUV420P,
+			SWS_FAST_BILINEAR, NULL, NULL, NULL );
+	nAllocations++;
+	swsCache.push_front( e );
+	return e.ctx;
+}
+
+void AVEncoder::freeSwsContexts(){
+	std::list<SwsCacheEntry>::iterator i;
+	for( i = swsCache.begin(); i != swsCache.end(); i++ ){
+		if( (*i).ctx )
+			sws_freeContext( (struct SwsContext*)(*i).ctx );
+	}
+	swsCache.clear();
+}
+
+uint8_t *AVEncoder::takeFrame( size_t size ){
+	if( size != frameSize ){
+		freeFrames();
+		frameSize = size;
+	}
+
+	if( !framePool.empty() ){
+		uint8_t *frame = framePool.front();
+		framePool.pop_front();
+		return frame;
+	}
+
+	void *frame = NULL;
+	if( posix_memalign( &frame, 32, size ) != 0 )
+		throw VideoException( "AVEncoder: could not allocate a frame" );
+	nAllocations++;
+	return (uint8_t *)frame;
+}
+
+void AVEncoder::releaseFrame( uint8_t *frame ){
+	if( frame )
+		framePool.push_front( frame );
+}
+
+void AVEncoder::freeFrames(){
+	std::list<uint8_t *>::iterator i;
+	for( i = framePool.begin(); i != framePool.end(); i++ )
+		free( *i );
+	framePool.clear();
 }
 
 void AVEncoder::setLocalDisplay(MRef<VideoDisplay*> d){
@@ -213,7 +294,9 @@ void AVEncoder::handle( MImage * image ){
                 int diffms = (now.tv_sec-lasttime.tv_sec)*1000+(now.tv_usec-lasttime.tv_usec)/1000;
                 float sec = (float)diffms/1000.0f;
                 printf("%d frames in %fs\n", REPORT_N, sec);
-                printf("FPS_ENCODE: %f for video of size %dx%d\n", (float)REPORT_N/(float)sec, video->width, video->height );
+                printf("FPS_ENCODE: %f for video of size %dx%d, %d allocations, %d zero-copy frames of %d\n",
+				(float)REPORT_N/(float)sec, video->width, video->height,
+				nAllocations, nZeroCopyFrames, N );
                 lasttime=now;
         }
 #endif
@@ -228,112 +311,71 @@ void AVEncoder::handle( MImage * image ){
 		videoCodec = (VideoCodec*)this->videoCodec;
 	}
 
-	int ret;
-	AVFrame frame;
-	bool mustFreeFrame = false;
-
-	if (video->profile == BASELINE_PROFILE) {
-		PixelFormat srcFormat;
-		if (image->chroma != M_CHROMA_I420) {
-
-			switch (image->chroma) {
-			case M_CHROMA_RV32:
-				srcFormat = PIX_FMT_RGB32;
-				break;
-			case M_CHROMA_RV24:
-				srcFormat = PIX_FMT_BGR24;
-				break;
-			default:
-				/* FIXME: handle other formats */
-				srcFormat = PIX_FMT_RGB32;
-				break;
-			}
-		} else
-			srcFormat = PIX_FMT_YUV420P;
-
-		/* We will need a convertion */
-		avpicture_alloc((AVPicture*) &frame, PIX_FMT_YUV420P, video->width,
-				video->height);
-		//cerr << "EEEE: allocated picture of dim "<<video->width<<"x"<<video->height<<endl;
-
-		/* We must free frame ourselves */
-		mustFreeFrame = true;
-
-		if (!swsctx)
-			swsctx = sws_getContext(image->width, image->height, srcFormat,
-					video->width, video->height, PIX_FMT_YUV420P,
-					SWS_FAST_BILINEAR, NULL, NULL, NULL);
-		struct SwsContext* ctx = (struct SwsContext*) swsctx;
-
-		sws_scale(ctx, image->data, image->linesize, 0, video->height,
-				frame.data, frame.linesize);
-		//		yuv2rgb(image->data[0], image->data[1], image->data[2], image->width, image->height, frame.data[0]);
-		//	}
-		//	else{
-		//		/* We can use the picture as is */
-		//		memcpy( &frame, image, sizeof( MData ) );
-		//	}
+	PixelFormat srcFormat;
+	switch (image->chroma) {
+	case M_CHROMA_I420:
+		srcFormat = PIX_FMT_YUV420P;
+		break;
+	case M_CHROMA_RV32:
+		srcFormat = PIX_FMT_RGB32;
+		break;
+	case M_CHROMA_RV24:
+		srcFormat = PIX_FMT_BGR24;
+		break;
+	default:
+		/* FIXME: handle other formats */
+		srcFormat = PIX_FMT_RGB32;
+		break;
 	}
-	else {
-		if (image->chroma != M_CHROMA_I420) {
-			PixelFormat srcFormat;
-
-			switch (image->chroma) {
-			case M_CHROMA_RV32:
-				srcFormat = PIX_FMT_RGB32;
-				break;
-			case M_CHROMA_RV24:
-				srcFormat = PIX_FMT_BGR24;
-				break;
-			default:
-				/* FIXME: handle other formats */
-				srcFormat = PIX_FMT_RGB32;
-				break;
-			}
-
-			/* We will need a convertion */
-			avpicture_alloc((AVPicture*) &frame, PIX_FMT_YUV420P, image->width,
-					image->height);
-			//cerr << "EEEE: allocated picture of dim "<<video->width<<"x"<<video->height<<endl;
-
-			/* We must free frame ourselves */
-			mustFreeFrame = true;
 
-			if (!swsctx)
-				swsctx = sws_getContext(image->width, image->height, srcFormat,
-						image->width, image->height, PIX_FMT_YUV420P,
-						SWS_FAST_BILINEAR, NULL, NULL, NULL);
-			struct SwsContext* ctx = (struct SwsContext*) swsctx;
-
-			sws_scale(ctx, image->data, image->linesize, 0, image->height,
-					frame.data, frame.linesize);
-			//		yuv2rgb(image->data[0], image->data[1], image->data[2], image->width, image->height, frame.data[0]);
+	unsigned char *ownYuv = video->yuv;
+	int ySize = video->width*video->height;
+	int cSize = video->width/2*video->height/2;
+
+	if (srcFormat == PIX_FMT_YUV420P &&
+			image->width == video->width && image->height == video->height) {
+		if (image->linesize[0] == (int)video->width &&
+				image->linesize[1] == (int)video->width/2 &&
+				image->linesize[2] == (int)video->width/2 &&
+				image->data[1] == image->data[0] + ySize &&
+				image->data[2] == image->data[1] + cSize) {
+			/* The grabber delivers a packed I420 frame of the
+			 * right size: let the encoder read it in place */
+			video->yuv = image->data[0];
+			nZeroCopyFrames++;
 		} else {
-			/* We can use the picture as is */
-			memcpy(&frame, image, sizeof(MData));
+			uint32_t y;
+			for (y = 0; y < video->height; y++)
+				memcpy(&video->yuv[y*video->width],
+						image->data[0] + y*image->linesize[0], video->width);
+			for (y = 0; y < video->height/2; y++) {
+				memcpy(&video->yuv[ySize + y*video->width/2],
+						image->data[1] + y*image->linesize[1], video->width/2);
+				memcpy(&video->yuv[ySize + cSize + y*video->width/2],
+						image->data[2] + y*image->linesize[2], video->width/2);
+			}
 		}
+	} else {
+		/* Convert (and scale if needed) directly into the
+		 * encoder input buffer */
+		uint8_t *dst[4];
+		int dstStride[4];
+		dst[0] = &video->yuv[0];
+		dst[1] = &video->yuv[ySize];
+		dst[2] = &video->yuv[ySize + cSize];
+		dst[3] = NULL;
+		dstStride[0] = video->width;
+		dstStride[1] = video->width/2;
+		dstStride[2] = video->width/2;
+		dstStride[3] = 0;
+
+		struct SwsContext* ctx = (struct SwsContext*) getSwsContext(srcFormat,
+				image->width, image->height, video->width, video->height);
+
+		sws_scale(ctx, image->data, image->linesize, 0, image->height,
+				dst, dstStride);
 	}
 
-	frame.pict_type = 0;
-	if( !image->mTime ){
-		frame.pts = mtime() * 1000;
-	}
-	else{
-		frame.pts = image->mTime * 1000;
-	}
-
-	//Y
-	massert(frame.linesize[0] == (video->width));
-	memcpy(&(video->yuv[0]),frame.data[0], video->width*video->height);
-
-	//U
-	massert(frame.linesize[1] == video->width/2);
-	memcpy(&(video->yuv[ video->width*video->height ]), frame.data[1], video->width/2*video->height/2);
-
-	//V
-	massert(frame.linesize[2] == video->width/2);
-	memcpy(&video->yuv[ video->width*video->height + video->width/2*video->height/2 ], frame.data[2], video->width/2*video->height/2 );
-
 	video->size_out=0;
 	hdviper_video_encode(videoCodec, video);
 
@@ -342,9 +384,7 @@ void AVEncoder::handle( MImage * image ){
 
 	hdviper_h264_packetize(video, rtp_ts);
 
-	if (mustFreeFrame){
-		avpicture_free( (AVPicture*)&frame );
-	}
+	video->yuv = ownYuv;
 
 	//printSnd();
 }
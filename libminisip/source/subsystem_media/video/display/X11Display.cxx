@@ -23,18 +23,28 @@
  *          Mikael Magnusson <mikma@users.sourceforge.net> 
 */
 
+#include<config.h>
+
 #include"X11Display.h"
 #include<sys/time.h>
 #include<libminisip/media/video/VideoException.h>
+#include<libmutil/mtime.h>
 #include<X11/Xatom.h>
 #include<stdlib.h>
 #include<string.h>
 #include<stdio.h>
+#include<algorithm>
 
 using namespace std;
 
 #define NB_IMAGES 3
 
+/* Milliseconds createWindow waits for the window to be mapped, then
+ * for the window manager to resize it. Without a window manager no
+ * ConfigureNotify arrives and the requested size is kept */
+#define X11_MAP_TIMEOUT 2000
+#define X11_CONFIGURE_TIMEOUT 200
+
 static std::list<std::string> pluginList;
 static bool initialized;
 
@@ -53,10 +63,29 @@ MPlugin * mx11_LTX_getPlugin( MRef<Library*> lib ){
 	return new X11Plugin( lib );
 }
 
+#ifdef XSHM_SUPPORT
+/* XShmAttach failures are reported asynchronously through the
+ * process wide X error handler, which is swapped in for the
+ * duration of the attach */
+static Mutex shmAttachLock;
+static bool shmAttachFailed;
+
+static int shmAttachErrorHandler( Display *, XErrorEvent * ){
+	shmAttachFailed = true;
+	return 0;
+}
+
+static Bool isShmCompletion( Display *, XEvent * event, XPointer completionType ){
+	return event->type == *(int *)completionType;
+}
+#endif
+
 X11Display::X11Display( uint32_t width, uint32_t height):VideoDisplay(){
 	this->width = width;
 	this->height = height;
 	fullscreen = false;
+	useShm = false;
+	shmCompletionType = -1;
 
 	//openDisplay();
 }
@@ -110,7 +139,90 @@ void X11Display::openDisplay(){
                         }
                 }
         }
-        
+
+	initShm();
+}
+
+void X11Display::initShm(){
+	useShm = false;
+#ifdef XSHM_SUPPORT
+	if( XShmQueryExtension( display ) ){
+		useShm = true;
+		shmCompletionType = XShmGetEventBase( display ) + ShmCompletion;
+	}
+	else{
+		mdbg << "X11Display: no MIT-SHM extension, using XPutImage" << endl;
+	}
+#endif
+}
+
+bool X11Display::attachSharedSegment( X11ImageData * data, size_t size ){
+#ifdef XSHM_SUPPORT
+	XShmSegmentInfo * shmInfo = &data->shmInfo;
+	XErrorHandler oldHandler;
+
+	shmInfo->shmid = shmget( IPC_PRIVATE, size, IPC_CREAT | 0600 );
+	if( shmInfo->shmid < 0 ){
+		mdbg << "X11Display: shmget failed, using XPutImage" << endl;
+		useShm = false;
+		return false;
+	}
+
+	shmInfo->shmaddr = (char *)shmat( shmInfo->shmid, NULL, 0 );
+	if( shmInfo->shmaddr == (char *)-1 ){
+		shmctl( shmInfo->shmid, IPC_RMID, NULL );
+		mdbg << "X11Display: shmat failed, using XPutImage" << endl;
+		useShm = false;
+		return false;
+	}
+	shmInfo->readOnly = False;
+
+	/* A remote X server accepts the extension query but
+	 * fails the attach */
+	shmAttachLock.lock();
+	shmAttachFailed = false;
+	XSync( display, False );
+	oldHandler = XSetErrorHandler( shmAttachErrorHandler );
+	XShmAttach( display, shmInfo );
+	XSync( display, False );
+	XSetErrorHandler( oldHandler );
+	bool failed = shmAttachFailed;
+	shmAttachLock.unlock();
+
+	/* Either way the segment goes away with its last user */
+	shmctl( shmInfo->shmid, IPC_RMID, NULL );
+
+	if( failed ){
+		shmdt( shmInfo->shmaddr );
+		mdbg << "X11Display: XShmAttach failed, using XPutImage" << endl;
+		useShm = false;
+		return false;
+	}
+
+	data->shared = true;
+	return true;
+#else
+	return false;
+#endif
+}
+
+void X11Display::detachSharedSegment( X11ImageData * data ){
+#ifdef XSHM_SUPPORT
+	if( !data->shared ){
+		return;
+	}
+	XShmDetach( display, &data->shmInfo );
+	XSync( display, False );
+	shmdt( data->shmInfo.shmaddr );
+	data->shared = false;
+#endif
+}
+
+void X11Display::waitShmCompletion(){
+#ifdef XSHM_SUPPORT
+	XEvent event;
+	XIfEvent( display, &event, isShmCompletion, (XPointer)&shmCompletionType );
+#endif
 }
 
 void X11Display::init( uint32_t width, uint32_t height ){
@@ -172,23 +284,37 @@ void X11Display::createWindow(){
 //#endif
         
 	XMapWindow( display, baseWindow );
-	do{
-		XNextEvent( display, &event );
-		if( ( event.type == Expose )
-			&& ( event.xexpose.window == baseWindow ) ){
-			exposeSent = true;
+	XFlush( display );
+
+	uint64_t start = mtime();
+	uint64_t mapped = 0;
+	while( !( exposeSent && configureNotifySent && mapNotifySent ) ){
+		uint64_t now = mtime();
+		bool received = false;
+
+		if( now - start >= X11_MAP_TIMEOUT ||
+		    ( mapped && now - mapped >= X11_CONFIGURE_TIMEOUT ) ){
+			break;
+		}
+
+		if( XCheckTypedWindowEvent( display, baseWindow, Expose, &event ) ){
+			exposeSent = received = true;
 		}
-		else if( ( event.type == MapNotify)
-			&& ( event.xmap.window == baseWindow ) ){
-			mapNotifySent = true;
+		if( XCheckTypedWindowEvent( display, baseWindow, MapNotify, &event ) ){
+			mapNotifySent = received = true;
 		}
-		else if( ( event.type == ConfigureNotify )
-			&& ( event.xconfigure.window == baseWindow ) ){
-			configureNotifySent = true;
+		if( XCheckTypedWindowEvent( display, baseWindow, ConfigureNotify, &event ) ){
+			configureNotifySent = received = true;
 			baseWindowWidth = event.xconfigure.width;
 			baseWindowHeight = event.xconfigure.height;
 		}
-	} while( !( exposeSent && configureNotifySent && mapNotifySent ) );
+		if( exposeSent && mapNotifySent && !mapped ){
+			mapped = mtime();
+		}
+		if( !received ){
+			msleep( 10 );
+		}
+	}
 
     	XSelectInput( display, baseWindow, StructureNotifyMask | KeyPressMask );
 //                  StructureNotifyMask | KeyPressMask |
@@ -230,11 +356,34 @@ void X11Display::destroyWindow(){
 }
 
 MImage * X11Display::allocateImage(){
-	
-	char * imageData = ( char * )malloc( width * height * bytesPerPixel );
-	XImage * image= XCreateImage( display, visualInfo->visual, 
+	X11ImageData * privateData = new X11ImageData;
+	XImage * image = NULL;
+
+	memset( privateData, 0, sizeof( X11ImageData ) );
+
+#ifdef XSHM_SUPPORT
+	if( useShm ){
+		image = XShmCreateImage( display, visualInfo->visual,
+				screenDepth, ZPixmap, NULL,
+				&privateData->shmInfo, width, height );
+
+		if( image && attachSharedSegment( privateData,
+				image->bytes_per_line * image->height ) ){
+			image->data = privateData->shmInfo.shmaddr;
+		}
+		else if( image ){
+			XFree( image );
+			image = NULL;
+		}
+	}
+#endif
+
+	if( !image ){
+		char * imageData = ( char * )malloc( width * height * bytesPerPixel );
+		image= XCreateImage( display, visualInfo->visual, 
                                 screenDepth, ZPixmap, 0/*Offset*/,
 			        imageData, width, height, 32, 0 );
+	}
 
 	
 	MImage * mimage;
@@ -243,13 +392,13 @@ MImage * X11Display::allocateImage(){
 	mimage->width=width;
 	mimage->height=height;
 
-        fprintf( stderr, "bytesPerPixel: %i\n",  bytesPerPixel );
 	//for( unsigned int i = 0; i < 3; i++ ){
 		mimage->data[0] = (uint8_t *)(image->data);
-		mimage->linesize[0] = width*bytesPerPixel;
+		mimage->linesize[0] = image->bytes_per_line;
 	//}
 
-	mimage->privateData = image;
+	privateData->image = image;
+	mimage->privateData = privateData;
         switch( screenDepth ){
                 case 16:
                         mimage->chroma = M_CHROMA_RV16;
@@ -265,10 +414,18 @@ MImage * X11Display::allocateImage(){
 }
 
 void X11Display::deallocateImage( MImage * mimage ){
-	XImage * image = (XImage *)mimage->privateData;
+	X11ImageData * privateData = (X11ImageData *)mimage->privateData;
+	XImage * image = (XImage *)privateData->image;
 
+	if( privateData->shared ){
+		detachSharedSegment( privateData );
+	}
+	else{
+		free( image->data );
+	}
 	XFree( image );
 	
+	delete privateData;
 	delete mimage;
 	
 }
@@ -288,10 +445,29 @@ bool X11Display::handlesChroma( uint32_t chroma ){
 
 void X11Display::displayImage( MImage * mimage ){
 
-        mdbg << "Called X11Display::displayImage" << endl;
+	X11ImageData * privateData = (X11ImageData *)mimage->privateData;
+
+#ifdef XSHM_SUPPORT
+	if( privateData->shared ){
+		/* Unlike XPutImage, the server does not clip the
+		 * source rectangle to the image */
+		XShmPutImage( display, videoWindow, gc,
+			    (XImage*)(privateData->image),
+			    0 /*src_x*/, 0 /*src_y*/,
+			    0 /*dest_x*/, 0 /*dest_y*/,
+			    min( baseWindowWidth, mimage->width ),
+			    min( baseWindowHeight, mimage->height ), True );
+
+		/* The image goes back to the decoder as soon as we
+		 * return, the other images of the pool are being
+		 * filled in the meantime */
+		waitShmCompletion();
+		return;
+	}
+#endif
 
 	XPutImage( display, videoWindow, gc,
-                    (XImage*)(mimage->privateData),
+                    (XImage*)(privateData->image),
                     0 /*src_x*/, 0 /*src_y*/,
                     0 /*dest_x*/, 0 /*dest_y*/,
                     baseWindowWidth, baseWindowHeight );
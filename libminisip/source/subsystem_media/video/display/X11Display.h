@@ -35,8 +35,28 @@
 #include <X11/Xutil.h>
 #include <X11/keysym.h>
 
+#ifdef XSHM_SUPPORT
+#include<sys/ipc.h>
+#include<sys/shm.h>
+#include <X11/extensions/XShm.h>
+#endif
+
 #include<libminisip/media/video/display/VideoDisplay.h>
 
+/**
+ * Stored in MImage::privateData by the X11 based displays.
+ * The image is an XImage or an XvImage. When shared is true its
+ * data lives in a MIT-SHM segment attached to the X server, and
+ * the decoder writes the frames directly into that segment.
+ */
+struct X11ImageData{
+	void * image;
+	bool shared;
+#ifdef XSHM_SUPPORT
+	XShmSegmentInfo shmInfo;
+#endif
+};
+
 class X11Display: public VideoDisplay{
 	public: 
 		X11Display( uint32_t width, uint32_t height );
@@ -66,6 +86,23 @@ class X11Display: public VideoDisplay{
 
 		void toggleFullscreen();
 
+		/* Decides whether images are put through MIT-SHM,
+		 * to be called once the display is open */
+		void initShm();
+
+		/* Creates a segment of size bytes and attaches it to
+		 * the X server. Returns false, and disables MIT-SHM for
+		 * this display, if either step fails */
+		bool attachSharedSegment( X11ImageData * data, size_t size );
+		void detachSharedSegment( X11ImageData * data );
+
+		/* Blocks until the X server has read the last image
+		 * put from a shared segment */
+		void waitShmCompletion();
+
+		bool useShm;
+		int shmCompletionType;
+
 		Display * display;
 		int screen;
                 int screenDepth;
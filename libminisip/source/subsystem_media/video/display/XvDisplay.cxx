@@ -23,10 +23,13 @@
  *          Mikael Magnusson <mikma@users.sourceforge.net>
 */
 
+#include<config.h>
+
 #include"XvDisplay.h"
 #include<sys/time.h>
 #include<libminisip/media/video/VideoException.h>
 #include<stdlib.h>
+#include<string.h>
 #include<stdio.h>
 
 using namespace std;
@@ -140,6 +143,8 @@ void XvDisplay::openDisplay(){
 	if( xvPort == -1 ){
 		throw VideoException( "Could not find a suitable Xv Port" );
 	}
+
+	initShm();
 }
 
 void XvDisplay::init( uint32_t width, uint32_t height ){
@@ -161,11 +166,31 @@ void XvDisplay::destroyWindow(){
 }
 
 MImage * XvDisplay::allocateImage(){
-	
+	X11ImageData * privateData = new X11ImageData;
+	XvImage * image = NULL;
+
+	memset( privateData, 0, sizeof( X11ImageData ) );
 
-	char * imageData = ( char * )malloc( width * height * 3 );
-	XvImage * image= XvCreateImage( display, xvPort, M_CHROMA_I420,
+#ifdef XSHM_SUPPORT
+	if( useShm ){
+		image = XvShmCreateImage( display, xvPort, M_CHROMA_I420,
+				NULL, width, height, &privateData->shmInfo );
+
+		if( image && attachSharedSegment( privateData, image->data_size ) ){
+			image->data = privateData->shmInfo.shmaddr;
+		}
+		else if( image ){
+			XFree( image );
+			image = NULL;
+		}
+	}
+#endif
+
+	if( !image ){
+		char * imageData = ( char * )malloc( width * height * 3 );
+		image= XvCreateImage( display, xvPort, M_CHROMA_I420,
 			       imageData, width, height );
+	}
 
 	
 	MImage * mimage;
@@ -179,17 +204,26 @@ MImage * XvDisplay::allocateImage(){
 		mimage->linesize[i] = image->pitches[i];
 	}
 
-	mimage->privateData = image;
+	privateData->image = image;
+	mimage->privateData = privateData;
 
 	return mimage;
 	
 }
 
 void XvDisplay::deallocateImage( MImage * mimage ){
-	XvImage * image = (XvImage *)mimage->privateData;
+	X11ImageData * privateData = (X11ImageData *)mimage->privateData;
+	XvImage * image = (XvImage *)privateData->image;
 
+	if( privateData->shared ){
+		detachSharedSegment( privateData );
+	}
+	else{
+		free( image->data );
+	}
 	XFree( image );
 	
+	delete privateData;
 	delete mimage;
 	
 }
@@ -200,9 +234,23 @@ bool XvDisplay::handlesChroma( uint32_t chroma ){
 
 
 void XvDisplay::displayImage( MImage * mimage ){
+	X11ImageData * privateData = (X11ImageData *)mimage->privateData;
+
+#ifdef XSHM_SUPPORT
+	if( privateData->shared ){
+		XvShmPutImage( display, xvPort, videoWindow, gc,
+			    (XvImage*)(privateData->image),
+			    0 /*src_x*/, 0 /*src_y*/,
+			    width, height,
+			    0 /*dest_x*/, 0 /*dest_y*/, baseWindowWidth, baseWindowHeight,
+			    True );
+		waitShmCompletion();
+		return;
+	}
+#endif
 
 	XvPutImage( display, xvPort, videoWindow, gc,
-                    (XvImage*)(mimage->privateData),
+                    (XvImage*)(privateData->image),
                     0 /*src_x*/, 0 /*src_y*/,
                     width, height,
                     0 /*dest_x*/, 0 /*dest_y*/, baseWindowWidth, baseWindowHeight );
@@ -35,6 +35,9 @@
 #include <X11/Xutil.h>
 #include <X11/keysym.h>
 
+#ifdef XSHM_SUPPORT
+#include <X11/extensions/XShm.h>
+#endif
 #include <X11/extensions/Xv.h>
 #include <X11/extensions/Xvlib.h>
 
@@ -0,0 +1,374 @@
+/*
+ Copyright (C) 2004-2006 the Minisip Team
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#include<config.h>
+
+/* The files are mapped with mmap, POSIX only */
+#ifdef HAVE_SYS_MMAN_H
+
+#include"FileGrabber.h"
+#include<libminisip/media/video/ImageHandler.h>
+#include<libminisip/media/video/VideoException.h>
+#include<libmutil/dbg.h>
+#include<libmutil/mtime.h>
+#include<libmutil/stringutils.h>
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<errno.h>
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+
+#define Y4M_MAGIC "YUV4MPEG2 "
+#define Y4M_FRAME_HEADER "FRAME\n"
+
+using namespace std;
+
+FileGrabber::FileGrabber( string device ):
+		pattern(false),width(640),height(480),fpsNum(30),fpsDen(1),
+		fd(-1),map(NULL),mapLength(0),patternBuffer(NULL),
+		frameOffset(0),frameStride(0),nSourceFrames(0),nDelivered(0),
+		handler(NULL),stopped(true){
+	memset( pool, 0, sizeof( pool ) );
+	parseDevice( device );
+}
+
+FileGrabber::~FileGrabber(){
+	unmapFile();
+}
+
+void FileGrabber::parseDevice( string device ){
+	vector<string> args = split( device, true, ',' );
+
+	if( args.size() == 0 || args[0] == "pattern" ){
+		pattern = true;
+	}
+	else{
+		fileName = args[0];
+	}
+
+	for( size_t i = 1; i < args.size(); i++ ){
+		size_t x = args[i].find( 'x' );
+		if( x != string::npos ){
+			width = atoi( args[i].substr( 0, x ).c_str() );
+			height = atoi( args[i].substr( x + 1 ).c_str() );
+		}
+		else{
+			fpsNum = atoi( args[i].c_str() );
+			fpsDen = 1;
+		}
+	}
+}
+
+void FileGrabber::open(){
+	if( pattern ){
+		generatePattern();
+	}
+	else{
+		mapFile();
+	}
+
+	if( width == 0 || height == 0 || width % 2 || height % 2 ){
+		throw VideoException( "FileGrabber: invalid frame size " +
+				itoa( width ) + "x" + itoa( height ) );
+	}
+
+	nDelivered = 0;
+	mdbg("media") << "FileGrabber: " << ( pattern ? string( "test pattern" ) : fileName )
+		<< " " << width << "x" << height << "@" << fpsNum << "/" << fpsDen
+		<< ", " << nSourceFrames << " frames" << endl;
+}
+
+void FileGrabber::generatePattern(){
+	uint32_t frameSize = width * height * 3 / 2;
+	uint32_t f, x, y;
+
+	frameOffset = 0;
+	frameStride = frameSize;
+	nSourceFrames = FILE_GRABBER_PATTERN_FRAMES;
+
+	delete [] patternBuffer;
+	patternBuffer = new uint8_t[ frameStride * nSourceFrames ];
+
+	/* Vertical colour bars moving to the right, over a
+	 * luminance ramp */
+	for( f = 0; f < nSourceFrames; f++ ){
+		uint8_t * yp = patternBuffer + f * frameStride;
+		uint8_t * up = yp + width * height;
+		uint8_t * vp = up + width * height / 4;
+		uint32_t shift = f * width / ( 8 * nSourceFrames );
+
+		for( y = 0; y < height; y++ ){
+			for( x = 0; x < width; x++ ){
+				yp[ y * width + x ] = (uint8_t)( 16 + ( ( x + shift ) * 219 / width + y ) % 220 );
+			}
+		}
+		for( y = 0; y < height / 2; y++ ){
+			for( x = 0; x < width / 2; x++ ){
+				uint32_t bar = ( ( 2 * x + shift ) * 8 / width ) % 8;
+				up[ y * width / 2 + x ] = (uint8_t)( 16 + bar * 28 );
+				vp[ y * width / 2 + x ] = (uint8_t)( 240 - bar * 28 );
+			}
+		}
+	}
+}
+
+void FileGrabber::parseY4mHeader(){
+	size_t magicLength = strlen( Y4M_MAGIC );
+	size_t i;
+
+	/* Header is a single line of space separated tags */
+	for( i = 0; i < mapLength && map[i] != '\n'; i++ );
+	if( i == mapLength ){
+		throw VideoException( "FileGrabber: truncated YUV4MPEG2 header in " + fileName );
+	}
+
+	string header( (const char *)map + magicLength, i - magicLength );
+	vector<string> tags = split( header, true, ' ' );
+
+	for( size_t t = 0; t < tags.size(); t++ ){
+		if( tags[t].size() < 2 ){
+			continue;
+		}
+		string value = tags[t].substr( 1 );
+		switch( tags[t][0] ){
+			case 'W':
+				width = atoi( value.c_str() );
+				break;
+			case 'H':
+				height = atoi( value.c_str() );
+				break;
+			case 'F':{
+				size_t colon = value.find( ':' );
+				if( colon != string::npos ){
+					/* Kept as a fraction, such as 30000:1001 */
+					int num = atoi( value.substr( 0, colon ).c_str() );
+					int den = atoi( value.substr( colon + 1 ).c_str() );
+					if( num >= 0 && den > 0 ){
+						fpsNum = num;
+						fpsDen = den;
+					}
+				}
+				break;
+			}
+			case 'C':
+				if( value.substr( 0, 3 ) != "420" ){
+					throw VideoException( "FileGrabber: unsupported YUV4MPEG2 colour space " + value );
+				}
+				break;
+		}
+	}
+
+	frameOffset = i + 1 + strlen( Y4M_FRAME_HEADER );
+	frameStride = strlen( Y4M_FRAME_HEADER ) + width * height * 3 / 2;
+
+	/* Frame parameters are not supported, every frame must start
+	 * with a plain header for the fixed stride to hold */
+	if( mapLength < frameOffset ||
+			memcmp( map + i + 1, Y4M_FRAME_HEADER, strlen( Y4M_FRAME_HEADER ) ) != 0 ){
+		throw VideoException( "FileGrabber: unsupported YUV4MPEG2 frame header in " + fileName );
+	}
+
+	nSourceFrames = ( mapLength - i - 1 ) / frameStride;
+}
+
+void FileGrabber::mapFile(){
+	struct stat st;
+
+	unmapFile();
+
+	fd = ::open( fileName.c_str(), O_RDONLY );
+	if( fd < 0 ){
+		throw VideoException( "FileGrabber: " + fileName + ": " + strerror( errno ) );
+	}
+
+	if( fstat( fd, &st ) != 0 || st.st_size == 0 ){
+		::close( fd );
+		fd = -1;
+		throw VideoException( "FileGrabber: could not read " + fileName );
+	}
+
+	mapLength = st.st_size;
+	map = (uint8_t *)mmap( NULL, mapLength, PROT_READ, MAP_SHARED, fd, 0 );
+	if( map == MAP_FAILED ){
+		map = NULL;
+		::close( fd );
+		fd = -1;
+		throw VideoException( "FileGrabber: mmap: " + string( strerror( errno ) ) );
+	}
+
+	/* Frames are read front to back */
+	madvise( map, mapLength, MADV_SEQUENTIAL );
+
+	if( mapLength > strlen( Y4M_MAGIC ) &&
+			memcmp( map, Y4M_MAGIC, strlen( Y4M_MAGIC ) ) == 0 ){
+		parseY4mHeader();
+	}
+	else{
+		frameOffset = 0;
+		frameStride = width * height * 3 / 2;
+		nSourceFrames = frameStride ? mapLength / frameStride : 0;
+	}
+
+	if( nSourceFrames == 0 ){
+		unmapFile();
+		throw VideoException( "FileGrabber: " + fileName + " holds no complete frame" );
+	}
+}
+
+void FileGrabber::unmapFile(){
+	if( map ){
+		munmap( map, mapLength );
+		map = NULL;
+		mapLength = 0;
+	}
+	if( fd >= 0 ){
+		::close( fd );
+		fd = -1;
+	}
+	if( patternBuffer ){
+		delete [] patternBuffer;
+		patternBuffer = NULL;
+	}
+	nSourceFrames = 0;
+}
+
+uint8_t * FileGrabber::frameData( uint32_t index ){
+	uint8_t * base = pattern ? patternBuffer : map;
+	return base + frameOffset + (size_t)index * frameStride;
+}
+
+bool FileGrabber::setImageChroma( uint32_t chroma ){
+	return chroma == M_CHROMA_I420;
+}
+
+void FileGrabber::start(){
+	massert(!runthread);
+	stopped = false;
+	runthread = new Thread(this);
+}
+
+void FileGrabber::stop(){
+	stopped = true;
+	if( runthread ){
+		runthread->join();
+		runthread = NULL;
+	}
+}
+
+void FileGrabber::close(){
+	stop();
+	grabberLock.lock();
+	unmapFile();
+	grabberLock.unlock();
+}
+
+void FileGrabber::run(){
+#ifdef DEBUG_OUTPUT
+	setThreadName("FileGrabber::run");
+#endif
+
+	read( handler );
+}
+
+void FileGrabber::setHandler( ImageHandler * handler ){
+	grabberLock.lock();
+	this->handler = handler;
+	grabberLock.unlock();
+}
+
+void FileGrabber::setLocalDisplay(MRef<VideoDisplay*>){
+
+}
+
+void FileGrabber::read( ImageHandler * handler ){
+	bool handlerProvidesImage = ( handler && handler->providesImage() );
+	uint32_t frame = 0;
+	uint64_t startTime = mtime();
+
+	while( !stopped ){
+		/* Held for a frame only, so that stop() and close()
+		 * get in between two frames */
+		grabberLock.lock();
+
+		if( nSourceFrames == 0 ){
+			grabberLock.unlock();
+			break;
+		}
+
+		uint32_t ySize = width * height;
+		uint8_t * data = frameData( frame % nSourceFrames );
+		MImage * image;
+
+		if( handlerProvidesImage ){
+			uint32_t y;
+			image = handler->provideImage();
+			if( !image ){
+				grabberLock.unlock();
+				break;
+			}
+			for( y = 0; y < height; y++ ){
+				memcpy( image->data[0] + y * image->linesize[0],
+						data + y * width, width );
+			}
+			for( y = 0; y < height / 2; y++ ){
+				memcpy( image->data[1] + y * image->linesize[1],
+						data + ySize + y * width / 2, width / 2 );
+				memcpy( image->data[2] + y * image->linesize[2],
+						data + ySize * 5 / 4 + y * width / 2, width / 2 );
+			}
+		}
+		else{
+			/* Point a pooled descriptor straight into the
+			 * mapped frame */
+			image = &pool[ nDelivered % FILE_GRABBER_POOL_SIZE ];
+			image->data[0] = data;
+			image->data[1] = data + ySize;
+			image->data[2] = data + ySize * 5 / 4;
+			image->linesize[0] = width;
+			image->linesize[1] = width / 2;
+			image->linesize[2] = width / 2;
+		}
+
+		image->chroma = M_CHROMA_I420;
+		image->width = width;
+		image->height = height;
+		image->mTime = mtime();
+
+		if( handler ){
+			handler->handle( image );
+		}
+
+		nDelivered++;
+		frame = ( frame + 1 ) % nSourceFrames;
+		grabberLock.unlock();
+
+		if( fpsNum > 0 ){
+			int64_t due = startTime + (int64_t)( nDelivered * 1000 * fpsDen / fpsNum );
+			int64_t wait = due - (int64_t)mtime();
+			if( wait > 0 ){
+				msleep( (int32_t)wait );
+			}
+		}
+	}
+}
+
+#endif
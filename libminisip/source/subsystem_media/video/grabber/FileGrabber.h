@@ -0,0 +1,135 @@
+/*
+ Copyright (C) 2004-2006 the Minisip Team
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#ifndef FILE_GRABBER_H
+#define FILE_GRABBER_H
+
+#include<libminisip/libminisip_config.h>
+
+#include<string>
+#include<stdint.h>
+#include<libmutil/Mutex.h>
+
+#include<libminisip/media/video/grabber/Grabber.h>
+
+/* Number of MImage descriptors handed out round robin */
+#define FILE_GRABBER_POOL_SIZE 4
+
+/* Number of distinct frames in the generated test pattern */
+#define FILE_GRABBER_PATTERN_FRAMES 8
+
+class ImageHandler;
+
+/**
+ * Grabber that does not need any capture hardware. It either
+ * generates a moving test pattern or replays a raw I420 (.yuv) or
+ * YUV4MPEG2 (.y4m) file in a loop, paced at the configured frame rate.
+ *
+ * The device string is
+ *   pattern[,<width>x<height>][,<fps>]
+ * or
+ *   <file>[,<width>x<height>][,<fps>]
+ * A frame rate of 0 delivers frames as fast as the handler takes them.
+ * For .y4m files the size and rate default to the ones in the header.
+ *
+ * Files are mapped in memory and frames are handed to the handler
+ * without being copied, unless the handler provides its own images.
+ */
+class FileGrabber : public Grabber{
+	public:
+		FileGrabber( std::string device );
+		virtual ~FileGrabber();
+
+		virtual void open();
+		bool setImageChroma( uint32_t chroma );
+
+		virtual void read( ImageHandler * );
+		virtual void run();
+
+		virtual void start();
+		virtual void stop();
+		virtual void close();
+
+		uint32_t getHeight(){ return height; };
+		uint32_t getWidth(){ return width; };
+
+		/** Number of frames delivered since open() */
+		uint64_t getFrameCount(){ return nDelivered; };
+
+		virtual void setHandler( ImageHandler * handler );
+
+		virtual void setLocalDisplay(MRef<VideoDisplay*>);
+
+		virtual std::string getMemObjectType() const {return "FileGrabber";}
+
+	private:
+		void parseDevice( std::string device );
+		void parseY4mHeader();
+		void mapFile();
+		void unmapFile();
+		void generatePattern();
+		uint8_t * frameData( uint32_t index );
+
+		std::string fileName;
+		bool pattern;
+
+		uint32_t width;
+		uint32_t height;
+		/* Frame rate, as a fraction */
+		uint32_t fpsNum;
+		uint32_t fpsDen;
+
+		int fd;
+		uint8_t * map;
+		size_t mapLength;
+		uint8_t * patternBuffer;
+
+		/* Layout of the frames in the mapping: the first frame
+		 * starts at frameOffset, the next one frameStride bytes
+		 * further on */
+		size_t frameOffset;
+		size_t frameStride;
+		uint32_t nSourceFrames;
+
+		MImage pool[FILE_GRABBER_POOL_SIZE];
+		uint64_t nDelivered;
+
+		ImageHandler * handler;
+		Mutex grabberLock;
+
+		bool stopped;
+		MRef<Thread*> runthread;
+};
+
+class FileGrabberPlugin : public GrabberPlugin{
+	public:
+		FileGrabberPlugin( MRef<Library *> lib ) : GrabberPlugin( lib ){}
+
+		virtual MRef<Grabber *> create( const std::string &device ) const{
+			return new FileGrabber( device );
+		}
+
+		virtual std::string getName() const { return "file"; }
+
+		virtual uint32_t getVersion() const { return 0x00000001; }
+
+		virtual std::string getDescription() const { return "Test pattern and YUV file grabber"; }
+		virtual std::string getMemObjectType() const { return "FileGrabberPlugin"; }
+};
+
+#endif
@@ -33,6 +33,9 @@
 #ifdef HAVE_LINUX_VIDEODEV_H
 #include"V4LGrabber.h"
 #endif
+#ifdef HAVE_SYS_MMAN_H
+#include"FileGrabber.h"
+#endif
 
 using namespace std;
 
@@ -48,6 +51,9 @@ GrabberRegistry::GrabberRegistry(){
 #ifdef HAVE_LINUX_VIDEODEV_H
 	registerPlugin( new V4LPlugin( NULL ) );
 #endif
+#ifdef HAVE_SYS_MMAN_H
+	registerPlugin( new FileGrabberPlugin( NULL ) );
+#endif
 }
 
 MRef<Grabber *> GrabberRegistry::createGrabber( string device ){
@@ -0,0 +1,322 @@
+/*
+ Copyright (C) 2004-2006 the Minisip Team
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#include<config.h>
+#include<libminisip/media/video/mixer/ImageCompositor.h>
+
+#include<string.h>
+#include<math.h>
+
+#ifdef __SSE2__
+#include<emmintrin.h>
+#endif
+
+/* Thumbnails in the active speaker layout are 1/THUMB_FACTOR of the
+ * main image in each dimension */
+#define THUMB_FACTOR 4
+#define THUMB_MARGIN 10
+
+using namespace std;
+
+ImageCompositor::ImageCompositor():layout(COMPOSITOR_LAYOUT_ACTIVE_SPEAKER){
+}
+
+void ImageCompositor::setLayout( int layout ){
+	this->layout = layout;
+}
+
+void ImageCompositor::compose( MImage * main, MImage ** sources, uint32_t n ){
+	if( layout == COMPOSITOR_LAYOUT_GRID ){
+		composeGrid( main, sources, n );
+	}
+	else{
+		composeActiveSpeaker( main, sources, n );
+	}
+}
+
+void ImageCompositor::composeActiveSpeaker( MImage * main, MImage ** sources, uint32_t n ){
+	uint32_t w = (main->width / THUMB_FACTOR) & ~1;
+	uint32_t h = (main->height / THUMB_FACTOR) & ~1;
+	uint32_t x = THUMB_MARGIN;
+	uint32_t y;
+	uint32_t i;
+
+	if( w == 0 || h == 0 || main->height < h + THUMB_MARGIN ){
+		return;
+	}
+	y = (main->height - h - THUMB_MARGIN) & ~1;
+
+	for( i = 0; i < n; i++ ){
+		if( !sources[i] ){
+			continue;
+		}
+		if( x + w > main->width ){
+			break;
+		}
+		scaleInto( sources[i], main, x, y, w, h );
+		x += w + THUMB_MARGIN;
+		x &= ~1;
+	}
+}
+
+void ImageCompositor::composeGrid( MImage * main, MImage ** sources, uint32_t n ){
+	uint32_t tiles = 1;
+	uint32_t i;
+
+	for( i = 0; i < n; i++ ){
+		if( sources[i] ){
+			tiles++;
+		}
+	}
+
+	uint32_t cols = (uint32_t)ceil( sqrt( (double)tiles ) );
+	uint32_t rows = ( tiles + cols - 1 ) / cols;
+	uint32_t w = ( main->width / cols ) & ~1;
+	uint32_t h = ( main->height / rows ) & ~1;
+
+	if( w == 0 || h == 0 ){
+		return;
+	}
+
+	/* The main image goes to the first tile. Scaling down towards
+	 * the origin never overwrites pixels that are still to be read,
+	 * so this can be done in place. */
+	scaleInto( main, main, 0, 0, w, h );
+
+	/* Clear everything outside the first tile */
+	fill( main, w, 0, main->width - w, h );
+	fill( main, 0, h, main->width, main->height - h );
+
+	uint32_t tile = 1;
+	for( i = 0; i < n; i++ ){
+		if( !sources[i] ){
+			continue;
+		}
+		scaleInto( sources[i], main,
+				( tile % cols ) * w, ( tile / cols ) * h, w, h );
+		tile++;
+	}
+}
+
+void ImageCompositor::fill( MImage * dst, uint32_t x, uint32_t y, uint32_t w, uint32_t h ){
+	uint32_t j;
+
+	if( w == 0 || h == 0 ){
+		return;
+	}
+
+	/* Black in I420 */
+	for( j = 0; j < h; j++ ){
+		memset( dst->data[0] + ( y + j ) * dst->linesize[0] + x, 16, w );
+	}
+	for( j = 0; j < h / 2; j++ ){
+		memset( dst->data[1] + ( y / 2 + j ) * dst->linesize[1] + x / 2, 128, w / 2 );
+		memset( dst->data[2] + ( y / 2 + j ) * dst->linesize[2] + x / 2, 128, w / 2 );
+	}
+}
+
+void ImageCompositor::scaleInto( MImage * src, MImage * dst,
+		uint32_t x, uint32_t y, uint32_t w, uint32_t h ){
+	uint32_t p;
+
+	for( p = 0; p < 3; p++ ){
+		uint32_t shift = ( p == 0 ) ? 0 : 1;
+		scalePlane( src->data[p], src->linesize[p],
+				src->width >> shift, src->height >> shift,
+				dst->data[p] + ( y >> shift ) * dst->linesize[p] + ( x >> shift ),
+				dst->linesize[p],
+				w >> shift, h >> shift );
+	}
+}
+
+#ifdef __SSE2__
+/*
+ * Exact 2:1 box filter of two source rows, 16 output pixels per
+ * iteration. Produces the same result as the generic path:
+ * (a + b + c + d + 2) >> 2
+ */
+static uint32_t scaleRowHalfSse2( const uint8_t * s0, const uint8_t * s1,
+		uint8_t * d, uint32_t dstWidth ){
+	const __m128i mask = _mm_set1_epi16( 0x00FF );
+	const __m128i two = _mm_set1_epi16( 2 );
+	uint32_t x;
+
+	for( x = 0; x + 16 <= dstWidth; x += 16 ){
+		__m128i a0 = _mm_loadu_si128( (const __m128i *)( s0 + 2 * x ) );
+		__m128i a1 = _mm_loadu_si128( (const __m128i *)( s0 + 2 * x + 16 ) );
+		__m128i b0 = _mm_loadu_si128( (const __m128i *)( s1 + 2 * x ) );
+		__m128i b1 = _mm_loadu_si128( (const __m128i *)( s1 + 2 * x + 16 ) );
+
+		__m128i lo = _mm_add_epi16(
+				_mm_add_epi16( _mm_and_si128( a0, mask ), _mm_srli_epi16( a0, 8 ) ),
+				_mm_add_epi16( _mm_and_si128( b0, mask ), _mm_srli_epi16( b0, 8 ) ) );
+		__m128i hi = _mm_add_epi16(
+				_mm_add_epi16( _mm_and_si128( a1, mask ), _mm_srli_epi16( a1, 8 ) ),
+				_mm_add_epi16( _mm_and_si128( b1, mask ), _mm_srli_epi16( b1, 8 ) ) );
+
+		lo = _mm_srli_epi16( _mm_add_epi16( lo, two ), 2 );
+		hi = _mm_srli_epi16( _mm_add_epi16( hi, two ), 2 );
+
+		_mm_storeu_si128( (__m128i *)( d + x ), _mm_packus_epi16( lo, hi ) );
+	}
+	return x;
+}
+#endif
+
+#ifdef __SSE2__
+/* Adds (or, for the first row, stores) zero-extended source bytes
+ * to the 16 bit column sums */
+static uint32_t addRowSse2( uint16_t * a, const uint8_t * s, uint32_t width, bool first ){
+	const __m128i zero = _mm_setzero_si128();
+	uint32_t x;
+
+	for( x = 0; x + 16 <= width; x += 16 ){
+		__m128i v = _mm_loadu_si128( (const __m128i *)( s + x ) );
+		__m128i lo = _mm_unpacklo_epi8( v, zero );
+		__m128i hi = _mm_unpackhi_epi8( v, zero );
+		if( !first ){
+			lo = _mm_add_epi16( lo, _mm_loadu_si128( (const __m128i *)( a + x ) ) );
+			hi = _mm_add_epi16( hi, _mm_loadu_si128( (const __m128i *)( a + x + 8 ) ) );
+		}
+		_mm_storeu_si128( (__m128i *)( a + x ), lo );
+		_mm_storeu_si128( (__m128i *)( a + x + 8 ), hi );
+	}
+	return x;
+}
+#endif
+
+/* Largest number of 8 bit samples whose sum fits in 16 bits */
+#define MAX_ROWS_16 257
+
+void ImageCompositor::scalePlane( const uint8_t * src, int srcStride,
+		uint32_t srcWidth, uint32_t srcHeight,
+		uint8_t * dst, int dstStride,
+		uint32_t dstWidth, uint32_t dstHeight ){
+	uint32_t x, y;
+
+	if( srcWidth == 0 || srcHeight == 0 || dstWidth == 0 || dstHeight == 0 ){
+		return;
+	}
+
+	if( srcWidth == 2 * dstWidth && srcHeight == 2 * dstHeight ){
+		for( y = 0; y < dstHeight; y++ ){
+			const uint8_t * s0 = src + 2 * y * srcStride;
+			const uint8_t * s1 = s0 + srcStride;
+			uint8_t * d = dst + y * dstStride;
+			x = 0;
+#ifdef __SSE2__
+			x = scaleRowHalfSse2( s0, s1, d, dstWidth );
+#endif
+			for( ; x < dstWidth; x++ ){
+				d[x] = ( s0[2*x] + s0[2*x+1] + s1[2*x] + s1[2*x+1] + 2 ) >> 2;
+			}
+		}
+		return;
+	}
+
+	/* Source column span of each output column */
+	if( spanStart.size() < dstWidth ){
+		spanStart.resize( dstWidth );
+		spanLength.resize( dstWidth );
+	}
+	if( acc.size() < srcWidth ){
+		acc.resize( srcWidth );
+		runningSum.resize( srcWidth + 1 );
+	}
+	uint32_t maxLength = 1;
+	for( x = 0; x < dstWidth; x++ ){
+		uint32_t s0 = (uint32_t)( (uint64_t)x * srcWidth / dstWidth );
+		uint32_t s1 = (uint32_t)( (uint64_t)( x + 1 ) * srcWidth / dstWidth );
+		spanStart[x] = s0;
+		spanLength[x] = ( s1 > s0 ) ? s1 - s0 : 1;
+		if( spanLength[x] > maxLength ){
+			maxLength = spanLength[x];
+		}
+	}
+
+	/* 16.16 reciprocals of every possible sample count, so that
+	 * the inner loop does not divide */
+	uint32_t maxRows = ( srcHeight + dstHeight - 1 ) / dstHeight;
+	if( maxRows > MAX_ROWS_16 ){
+		maxRows = MAX_ROWS_16;
+	}
+	uint32_t nMax = maxLength * maxRows;
+	if( reciprocal.size() < nMax + 1 ){
+		reciprocal.resize( nMax + 1 );
+	}
+	for( x = 1; x <= nMax; x++ ){
+		reciprocal[x] = ( 65536 + x / 2 ) / x;
+	}
+	const uint32_t * recip = &reciprocal[0];
+
+	uint16_t * a = &acc[0];
+	uint32_t * prefix = &runningSum[0];
+	const uint32_t * start = &spanStart[0];
+	const uint32_t * length = &spanLength[0];
+
+	for( y = 0; y < dstHeight; y++ ){
+		uint32_t sy0 = (uint32_t)( (uint64_t)y * srcHeight / dstHeight );
+		uint32_t sy1 = (uint32_t)( (uint64_t)( y + 1 ) * srcHeight / dstHeight );
+		uint32_t nRows = ( sy1 > sy0 ) ? sy1 - sy0 : 1;
+		uint32_t sy;
+
+		/* Only absurd ratios need more rows than the 16 bit column
+		 * sums can hold; those are reduced to a subsample */
+		if( nRows > MAX_ROWS_16 ){
+			nRows = MAX_ROWS_16;
+		}
+
+		/* Vertical pass: sum the source rows of the span column
+		 * by column */
+		const uint8_t * s = src + sy0 * srcStride;
+		for( sy = 0; sy < nRows; sy++, s += srcStride ){
+			x = 0;
+#ifdef __SSE2__
+			x = addRowSse2( a, s, srcWidth, sy == 0 );
+#endif
+			if( sy == 0 ){
+				for( ; x < srcWidth; x++ ){
+					a[x] = s[x];
+				}
+			}
+			else{
+				for( ; x < srcWidth; x++ ){
+					a[x] += s[x];
+				}
+			}
+		}
+
+		/* Running sum of the column sums, so that each output
+		 * pixel is the difference of two entries */
+		uint32_t run = 0;
+		for( x = 0; x < srcWidth; x++ ){
+			prefix[x] = run;
+			run += a[x];
+		}
+		prefix[srcWidth] = run;
+
+		/* Horizontal pass, normalized with a 16.16 reciprocal and
+		 * rounded to nearest */
+		uint8_t * d = dst + y * dstStride;
+		for( x = 0; x < dstWidth; x++ ){
+			uint32_t sum = prefix[start[x] + length[x]] - prefix[start[x]];
+			uint32_t v = ( sum * recip[length[x] * nRows] + 32768 ) >> 16;
+			d[x] = (uint8_t)( v > 255 ? 255 : v );
+		}
+	}
+}
@@ -131,55 +131,16 @@ void ImageMixer::handle( MImage * image ){
 
 
 void ImageMixer::mix( MImage * image ){
-	uint32_t i;
-
-
-	for( i = 0; i < nImagesToMix; i++ ){
-
-		MImage * toMix = images[i];
-
-		if( !images[i] ){
-			continue;
-		}
-		
-		uint32_t i,j;
-		uint8_t * yd, *ud, *vd, *ys, *us, *vs;
-		uint32_t factor = 4;
-		uint32_t widthOffset = 10;
-		uint32_t heightOffset = height - height / factor - 10;
-
-		
-
-		yd = image->data[0] + heightOffset*image->linesize[0] + widthOffset;
-		ud = image->data[1] + heightOffset*image->linesize[1]/2 + widthOffset/2;
-		vd = image->data[2] + heightOffset*image->linesize[1]/2 + widthOffset/2;
-
-		ys = toMix->data[0];
-		us = toMix->data[1];
-		vs = toMix->data[2];
-
-		for( j = 0; (j < (height)/(2*factor)) && (heightOffset + 2*j<height); j++ ){
-			for( i = 0; (i < image->linesize[0] / (2*factor)) && (widthOffset + 2*i < width ); i++ ){
-				yd[2*i] = ys[2*i*factor];
-				yd[2*i+1] = ys[2*i*factor+1];
-				yd[2*i+image->linesize[0]] = ys[2*i*factor+image->linesize[0]];
-				yd[2*i+image->linesize[0]+1] = ys[2*i*factor+image->linesize[0]+1];
-				ud[i] = us[i*factor];
-				vd[i] = vs[i*factor];
-			}
-			yd += image->linesize[0]*2;
-			ud += image->linesize[1];
-			vd += image->linesize[2];
-
-			ys += toMix->linesize[0]*2*factor;
-			us += toMix->linesize[1]*factor;
-			vs += toMix->linesize[2]*factor;
-
-		}
-
+	if( image->width == 0 || image->height == 0 ){
+		image->width = width;
+		image->height = height;
 	}
 
-	
+	compositor.compose( image, images, nImagesToMix );
+}
+
+void ImageMixer::setLayout( int layout ){
+	compositor.setLayout( layout );
 }
 
 void ImageMixer::setOutput( ImageHandler * output ){
@@ -106,6 +106,23 @@ MRef<SipIdentity *> DefaultDialogHandler::lookupTarget(const SipUri &uri){
 	return id;
 }
 
+MRef<Session *> DefaultDialogHandler::createMediaSession(MRef<SipRequest*> inv,
+		MRef<SipIdentity *> id){
+	try{
+		return subsystemMedia->createSession( id, inv->getCallId() );
+	}
+	catch( NetworkException &e ){
+		merr << "ERROR: could not create the media session: " << e.what() << endl;
+	}
+
+	MRef<SipResponse*> resp =
+		new SipResponse( 500, "Server Internal Error", inv );
+	SipSMCommand cmd( *resp, SipSMCommand::dialog_layer,
+			  SipSMCommand::transaction_layer );
+	sipStack->enqueueCommand(cmd, HIGH_PRIO_QUEUE);
+	return NULL;
+}
+
 bool DefaultDialogHandler::handleCommandPacket( MRef<SipMessage*> pkt){
 
 	if (pkt->getType()=="INVITE"){
@@ -178,8 +195,9 @@ bool DefaultDialogHandler::handleCommandPacket( MRef<SipMessage*> pkt){
 			//string gID = sdp->getSessionLevelAttribute("p2tGroupIdentity");
 			//string prot = sdp->getSessionLevelAttribute("p2tGroupListProt");
 			// get a session from the mediaHandler
-			MRef<Session *> mediaSession = 
-				subsystemMedia->createSession(/*phoneconf->securityConfig*/ id, pkt->getCallId() );
+			MRef<Session *> mediaSession = createMediaSession(inv, id);
+			if( !mediaSession )
+				return true;
 
 /*			MRef<SipDialogConfig*> callConf = new SipDialogConfig(phoneconf->inherited);
 			if( id ){
@@ -212,8 +230,9 @@ bool DefaultDialogHandler::handleCommandPacket( MRef<SipMessage*> pkt){
 			massert(dynamic_cast<SdpPacket*>(*inv->getContent())!=NULL);
 			MRef<SdpPacket*> sdp = (SdpPacket*)*inv->getContent();
 			string confid = sdp->getSessionLevelAttribute("confId");
-			MRef<Session *> mediaSession = 
-				subsystemMedia->createSession(/*phoneconf->securityConfig*/ id, pkt->getCallId() );
+			MRef<Session *> mediaSession = createMediaSession(inv, id);
+			if( !mediaSession )
+				return true;
 
 /*			MRef<SipDialogConfig*> callConf = new SipDialogConfig(phoneconf->inherited);
 
@@ -248,8 +267,9 @@ bool DefaultDialogHandler::handleCommandPacket( MRef<SipMessage*> pkt){
 				MRef<SipIdentity *> id = lookupTarget(inv->getUri());
 
 				// get a session from the mediaHandler
-				MRef<Session *> mediaSession = 
-					subsystemMedia->createSession(/*phoneconf->securityConfig*/ id, pkt->getCallId() );
+				MRef<Session *> mediaSession = createMediaSession(inv, id);
+				if( !mediaSession )
+					return true;
 
 				MRef<SipDialog*> voipCall;
 				voipCall = new SipDialogVoipServer(sipStack,
@@ -375,6 +395,8 @@ bool DefaultDialogHandler::handleCommandString( CommandString &cmdstr){
 		//MRef<SipDialogConfig*> conf = new SipDialogConfig(phoneconf->inherited);
 
 		MRef<SipDialogPresenceServer*> pres(new SipDialogPresenceServer(sipStack, phoneconf->defaultIdentity, phoneconf->useSTUN ));
+		pres->setCoalesceWindow( phoneconf->presenceCoalesceWindow );
+		pres->setNotifyRate( phoneconf->presenceNotifyBatch, PRESENCE_NOTIFY_INTERVAL );
 
 		sipStack->addDialog( MRef<SipDialog*>(*pres) );
 		
@@ -604,7 +626,15 @@ CommandString DefaultDialogHandler::handleCommandResp(string subsystem, const Co
 	
 	MRef<SipDialogVoip*> voipCall = new SipDialogVoipClient(sipStack, id, phoneconf->useSTUN, phoneconf->useAnat, NULL); 
 
-	MRef<Session *> mediaSession = subsystemMedia->createSession( id, voipCall->getCallId() );
+	MRef<Session *> mediaSession;
+	try{
+		mediaSession = subsystemMedia->createSession( id, voipCall->getCallId() );
+	}
+	catch( NetworkException &e ){
+		merr << "ERROR: could not create the media session: " << e.what() << endl;
+		CommandString err("","error", "Could not create the media session");
+		return err;
+	}
 	voipCall->setMediaSession( mediaSession );
 
 	sipStack->addDialog(*voipCall);
@@ -259,7 +259,10 @@ bool SipDialogFileTransferClient::a2_trying_transfering_200OK(const SipSMCommand
 			
 								//msrp = new MSRPSender...
 								//MRef<Thread .... . .. new Thread(msrp);
-								MRef<Thread*> rpThread = new Thread(new MSRPSender(serveraddr, acceptedPort, (*h)->filename,getSipStack(), dialogState.callId));
+								MRef<MSRPSender*> sender = new MSRPSender(serveraddr, acceptedPort, (*h)->filename,getSipStack(), dialogState.callId);
+								if( phoneConf->msrpChunkSize > 0 )
+									sender->setChunkSize( phoneConf->msrpChunkSize );
+								MRef<Thread*> rpThread = new Thread(*sender);
 							}	
 					}else;
 					h++;
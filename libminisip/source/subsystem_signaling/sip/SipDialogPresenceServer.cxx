@@ -70,12 +70,17 @@ using namespace std;
 	     | a0: -
              |
              | +---+ localPresenceUpdated
-	     | |   | a2: sendNoticeToAll
+	     | |   | a2: set(timer_presence_flush)
              V |   V 
       +-------------+-----+ timerRemoveSubscriber
       |   default   |     | a1: removeSubscriber
       +-------------+<----+ 
-             | |   ^
+             | |   ^ ^ |
+             | |   | | | timer_presence_flush
+             | |   | +-+ a6: sendNoticeToAll
+             | |   | | |
+             | |   | +-+ timer_presence_batch
+             | |   |     a7: sendNoticeBatch
              | |   |
  stop_presen | +---+
  ce_server   |  SUBSCRIBE
@@ -122,7 +127,16 @@ bool SipDialogPresenceServer::a2_default_default_localpresenceupdated(const SipS
 				SipSMCommand::dialog_layer,
 				SipSMCommand::dialog_layer)){
 		onlineStatus = command.getCommandString().getParam();
-		sendNoticeToAll(command.getCommandString().getParam());
+
+		/* Later changes within the window only update
+		 * onlineStatus */
+		if( coalesceWindow <= 0 ){
+			sendNoticeToAll();
+		}
+		else if( !flushPending ){
+			flushPending = true;
+			requestTimeout( coalesceWindow, "timer_presence_flush" );
+		}
 		return true;
 	}else{
 		return false;
@@ -179,6 +193,33 @@ bool SipDialogPresenceServer::a5_default_default_SUBSCRIBE(const SipSMCommand &c
 }
 
 
+bool SipDialogPresenceServer::a6_default_default_timerpresenceflush(const SipSMCommand &command){
+	if (transitionMatch(command, 
+				"timer_presence_flush",
+				SipSMCommand::dialog_layer,
+				SipSMCommand::dialog_layer)){
+		flushPending = false;
+		sendNoticeToAll();
+		return true;
+	}else{
+		return false;
+	}
+}
+
+bool SipDialogPresenceServer::a7_default_default_timerpresencebatch(const SipSMCommand &command){
+	if (transitionMatch(command, 
+				"timer_presence_batch",
+				SipSMCommand::dialog_layer,
+				SipSMCommand::dialog_layer)){
+		batchPending = false;
+		sendNoticeBatch();
+		return true;
+	}else{
+		return false;
+	}
+}
+
+
 void SipDialogPresenceServer::setUpStateMachine(){
 
 	State<SipSMCommand,string> *s_start = new State<SipSMCommand,string>(this,"start");
@@ -218,6 +259,14 @@ void SipDialogPresenceServer::setUpStateMachine(){
 		(bool (StateMachine<SipSMCommand,string>::*)(const SipSMCommand&)) &SipDialogPresenceServer::a5_default_default_SUBSCRIBE,
 		s_default, s_default);
 
+ 	new StateTransition<SipSMCommand,string>(this, "transition_default_default_timerpresenceflush",
+		(bool (StateMachine<SipSMCommand,string>::*)(const SipSMCommand&)) &SipDialogPresenceServer::a6_default_default_timerpresenceflush,
+		s_default, s_default);
+
+ 	new StateTransition<SipSMCommand,string>(this, "transition_default_default_timerpresencebatch",
+		(bool (StateMachine<SipSMCommand,string>::*)(const SipSMCommand&)) &SipDialogPresenceServer::a7_default_default_timerpresencebatch,
+		s_default, s_default);
+
 
 	setCurrentState(s_start);
 }
@@ -228,7 +277,12 @@ SipDialogPresenceServer::SipDialogPresenceServer(MRef<SipStack*> stack,
 		bool use_stun) : 
                 	SipDialog(stack,ident,""),
 			useSTUN(use_stun),
-			onlineStatus("online")
+			onlineStatus("online"),
+			coalesceWindow(PRESENCE_COALESCE_WINDOW),
+			notifyBatch(PRESENCE_NOTIFY_BATCH),
+			notifyInterval(PRESENCE_NOTIFY_INTERVAL),
+			flushPending(false),
+			batchPending(false)
 {
 	setUpStateMachine();
 }
@@ -236,19 +290,57 @@ SipDialogPresenceServer::SipDialogPresenceServer(MRef<SipStack*> stack,
 SipDialogPresenceServer::~SipDialogPresenceServer(){	
 }
 
-void SipDialogPresenceServer::sendNotice(string /*onlineStatus*/, string user){ //FIXME: use onlineStatus 
-	++dialogState.seqNo;
-	string cid = "FIXME"+itoa(rand());
-	sendNotify( user, cid );
+void SipDialogPresenceServer::setCoalesceWindow( int32_t windowMs ){
+	coalesceWindow = windowMs;
+}
+
+void SipDialogPresenceServer::setNotifyRate( int32_t batchSize, int32_t intervalMs ){
+	notifyBatch = batchSize;
+	notifyInterval = intervalMs;
+}
+
+MRef<SipMessageContent*> SipDialogPresenceServer::getPresenceContent(){
+	if( !presenceContent || presenceContentStatus != onlineStatus ){
+		string uri = getDialogConfig()->sipIdentity->getSipUri().getString();
 
+		/* The document only describes the local user, it is
+		 * the same for all subscribers */
+		presenceContent = new PresenceMessageContent( uri, uri,
+				onlineStatus, onlineStatus );
+		presenceContentStatus = onlineStatus;
+	}
+	return presenceContent;
 }
 
-void SipDialogPresenceServer::sendNoticeToAll(string onlineStatus_){
+void SipDialogPresenceServer::sendNoticeToAll(){
+	/* Subscribers still waiting for the previous change get
+	 * this one instead */
+	pendingNotices.clear();
+
 	usersLock.lock();
 	for (int i=0; i<subscribing_users.size(); i++){
-		sendNotice(onlineStatus_, subscribing_users[i]);
+		pendingNotices.push_back( subscribing_users[i] );
 	}
 	usersLock.unlock();
+
+	if( !batchPending ){
+		sendNoticeBatch();
+	}
+}
+
+void SipDialogPresenceServer::sendNoticeBatch(){
+	/* Sent on the low priority queue, so that a large number of
+	 * subscribers does not hold up calls */
+	for( int32_t i = 0; !pendingNotices.empty() &&
+			( notifyBatch <= 0 || i < notifyBatch ); i++ ){
+		sendNotice( pendingNotices.front(), LOW_PRIO_QUEUE );
+		pendingNotices.pop_front();
+	}
+
+	if( !pendingNotices.empty() ){
+		batchPending = true;
+		requestTimeout( notifyInterval, "timer_presence_batch" );
+	}
 }
 
 void SipDialogPresenceServer::sendSubscribeOk(MRef<SipRequest*> sub){
@@ -261,7 +353,7 @@ void SipDialogPresenceServer::sendSubscribeOk(MRef<SipRequest*> sub){
         getSipStack()->enqueueCommand(cmd, HIGH_PRIO_QUEUE);
 
 
-	sendNotice(onlineStatus, sub->getFrom().getUserIpString());
+	sendNotice(sub->getFrom().getUserIpString(), HIGH_PRIO_QUEUE);
 }
 
 void SipDialogPresenceServer::removeUser(string user){
@@ -276,28 +368,22 @@ void SipDialogPresenceServer::addUser(string user){
 	usersLock.unlock();
 }
 
-void SipDialogPresenceServer::sendNotify( string toUri, string cid ){
-	
+void SipDialogPresenceServer::sendNotice( string toUri, int queue ){
 	MRef<SipRequest*> notify;
-	int32_t localSipPort;
-	
-	localSipPort = getSipStack()->getLocalSipPort( useSTUN );
-	
-	MRef<SipIdentity*> toId( new SipIdentity(toUri));
+
+	++dialogState.seqNo;
+	string cid = "FIXME"+itoa(rand());
+
 	notify = SipRequest::createSipMessageNotify(
 				cid,
-				toId->getSipUri(),
+				SipUri(toUri),
 				getDialogConfig()->sipIdentity->getSipUri(),
 				dialogState.seqNo
 				);
 
 	notify->getHeaderValueFrom()->setParameter("tag",dialogState.localTag);
 
-	notify->setContent(new PresenceMessageContent(getDialogConfig()->sipIdentity->getSipUri().getString(),
-				toId->getSipUri().getString(),
-				onlineStatus,
-				onlineStatus
-				));
+	notify->setContent( getPresenceContent() );
 
         MRef<SipMessage*> pktr(*notify);
 
@@ -307,7 +393,7 @@ void SipDialogPresenceServer::sendNotify( string toUri, string cid ){
                 SipSMCommand::transaction_layer
                 );
 	
-	getSipStack()->enqueueCommand(scmd, HIGH_PRIO_QUEUE );
+	getSipStack()->enqueueCommand(scmd, queue );
 }
 
 bool SipDialogPresenceServer::handleCommand(const SipSMCommand &c){
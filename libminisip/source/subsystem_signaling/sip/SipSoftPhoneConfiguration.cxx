@@ -49,6 +49,8 @@
 #include<fstream>
 #include<libminisip/media/soundcard/AudioMixer.h>
 #include<libmcrypto/SipSimSoft.h>
+#include<libmcrypto/CertificateChainCache.h>
+#include<libminisip/signaling/sip/SipDialogPresenceServer.h>
 #ifdef SCSIM_SUPPORT
 #include<libmcrypto/SipSimSmartCardGD.h>
 #endif
@@ -84,6 +86,12 @@ SipSoftPhoneConfiguration::SipSoftPhoneConfiguration():
 	useUserDefinedStunServer(false),
 	useAnat(false),
 	useIpv6(false),
+	dhPoolSize(4),
+	dhPoolLowWater(1),
+	certCacheMaxAge(CERT_CHAIN_CACHE_MAX_AGE),
+	presenceCoalesceWindow(PRESENCE_COALESCE_WINDOW),
+	presenceNotifyBatch(PRESENCE_NOTIFY_BATCH),
+	msrpChunkSize(0),
 	soundDeviceIn(""),
 	soundDeviceOut(""),
 	videoDevice(""),
@@ -92,6 +100,8 @@ SipSoftPhoneConfiguration::SipSoftPhoneConfiguration():
 	displayFrameRate(""),
 	usePSTNProxy(false),
 	ringtone(""),
+	useDtx(true),
+	rtpPortPoolSize(4),
 	p2tGroupListServerPort(0)
 {
 	sipStackConfig = new SipStackConfig;
@@ -362,6 +372,8 @@ void SipSoftPhoneConfiguration::save(){
 // 	backend->saveBool( "mute_all_but_one", muteAllButOne ); //not used anymore
 
 	backend->save( "mixer_type", soundIOmixerType );
+	backend->saveBool( "dtx", useDtx );
+	backend->save( "rtp_port_pool_size", rtpPortPoolSize );
 
 	//Save the startup commands
 	list<string>::iterator iter;
@@ -425,10 +437,29 @@ void SipSoftPhoneConfiguration::save(){
 	backend->saveBool( "use_100rel", sipStackConfig->use100Rel );
 	backend->saveBool( "use_anat", useAnat );
 
+	/************************************************************
+	 * Key agreement
+	 ************************************************************/
+	backend->save( "dh_pool_size", dhPoolSize );
+	backend->save( "dh_pool_low_water", dhPoolLowWater );
+	backend->save( "cert_cache_max_age", certCacheMaxAge );
+
+	/************************************************************
+	 * Presence
+	 ************************************************************/
+	backend->save( "presence_coalesce_window", presenceCoalesceWindow );
+	backend->save( "presence_notify_batch", presenceNotifyBatch );
+
+	/************************************************************
+	 * File transfer
+	 ************************************************************/
+	backend->save( "msrp_chunk_size", msrpChunkSize );
+
 	/************************************************************
 	 * Advanced settings
 	 ************************************************************/
 	backend->saveBool( "use_ipv6", useIpv6 );
+	backend->save( "sip_worker_threads", sipStackConfig->transportWorkerThreads );
 	list< MRef<SipTransportConfig*> >::iterator j;
 	for( j = sipStackConfig->transports.begin();
 	     j != sipStackConfig->transports.end(); j++ ){
@@ -805,6 +836,7 @@ string SipSoftPhoneConfiguration::load( MRef<ConfBackend *> be ){
 	}while( true );
 
 	useIpv6 = backend->loadBool( "use_ipv6", true );
+	sipStackConfig->transportWorkerThreads = backend->loadInt( "sip_worker_threads", 0 );
 
 	list< MRef<SipTransportConfig*> >::iterator j;
 	for( j = sipStackConfig->transports.begin();
@@ -829,6 +861,8 @@ string SipSoftPhoneConfiguration::load( MRef<ConfBackend *> be ){
 	soundDeviceOut = backend->loadString("sound_device_out",soundDeviceIn);
 
 	soundIOmixerType = backend->loadString("mixer_type", "simple");
+	useDtx = backend->loadBool("dtx", true);
+	rtpPortPoolSize = backend->loadInt( "rtp_port_pool_size", 4 );
 // 	cerr << "sipconfigfile : soundiomixertype = " << soundIOmixerType << endl << endl;
 
 	//Load the startup commands ... there may be more than one
@@ -865,6 +899,18 @@ string SipSoftPhoneConfiguration::load( MRef<ConfBackend *> be ){
 	sipStackConfig->use100Rel = backend->loadBool("use_100rel");
 	useAnat = backend->loadBool("use_anat");
 
+	dhPoolSize = backend->loadInt( "dh_pool_size", 4 );
+	dhPoolLowWater = backend->loadInt( "dh_pool_low_water", 1 );
+	certCacheMaxAge = backend->loadInt( "cert_cache_max_age",
+					    CERT_CHAIN_CACHE_MAX_AGE );
+
+	presenceCoalesceWindow = backend->loadInt( "presence_coalesce_window",
+						   PRESENCE_COALESCE_WINDOW );
+	presenceNotifyBatch = backend->loadInt( "presence_notify_batch",
+						PRESENCE_NOTIFY_BATCH );
+
+	msrpChunkSize = backend->loadInt( "msrp_chunk_size", 0 );
+
 	useSTUN = backend->loadBool("use_stun");
 	findStunServerFromSipUri = backend->loadBool("stun_server_autodetect");
 
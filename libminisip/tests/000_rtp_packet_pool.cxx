@@ -0,0 +1,143 @@
+/*
+ * Test of the RtpPacketPool slabs.
+ *
+ * Reads RTP packets from a loopback socket and checks that a slab
+ * goes back to the pool when the last MRef to its packet is dropped,
+ * that datagrams larger than a slab are dropped and outgoing payloads
+ * larger than a slab fall back to the heap, and that the pool does
+ * not grow across repeated packets.
+ */
+
+#include<config.h>
+
+#include<libminisip/media/rtp/RtpPacketPool.h>
+#include<libminisip/media/rtp/SRtpPacket.h>
+#include<libmnetutil/UDPSocket.h>
+#include<libmnetutil/IP4Address.h>
+
+#include<stdio.h>
+#include<string.h>
+
+#define TEST_PAYLOAD 160
+#define TEST_OVERSIZE 3000
+#define TEST_CYCLES 10000
+
+static int failures = 0;
+
+static void check( bool ok, const char * what ){
+	if( !ok ){
+		fprintf( stderr, "FAILED: %s\n", what );
+		failures++;
+	}
+}
+
+/* Sends an RTP packet with a payload of the given length */
+static void sendPacket( UDPSocket &sock, IP4Address &to, int32_t port,
+			int payloadLength, int seqNo ){
+	unsigned char payload[ TEST_OVERSIZE ];
+
+	memset( payload, seqNo & 0xFF, payloadLength );
+	SRtpPacket * packet = new SRtpPacket( payload, payloadLength,
+			seqNo, seqNo * TEST_PAYLOAD, 0x1234 );
+	packet->sendTo( sock, to, port );
+	delete packet;
+}
+
+/* The slab the next packet will get, handed back straight away */
+static unsigned char * nextSlab(){
+	RtpPacketPool * pool = RtpPacketPool::getInstance();
+	unsigned char * slab = pool->getSlab();
+
+	pool->releaseSlab( slab );
+	return slab;
+}
+
+int main( int argc, char *argv[] ){
+	RtpPacketPool * pool = RtpPacketPool::getInstance();
+	IP4Address loopback( "127.0.0.1" );
+	UDPSocket receiver;
+	UDPSocket sender;
+	MRef<IPAddress *> from;
+	int32_t port = receiver.getPort();
+	int seqNo = 0;
+
+	/* A slab goes back to the pool with the last MRef */
+	sendPacket( sender, loopback, port, TEST_PAYLOAD, ++seqNo );
+	MRef<SRtpPacket *> packet = SRtpPacket::readPacket( receiver, from );
+	check( !packet.isNull(), "packet received" );
+	if( !packet.isNull() ){
+		check( packet->getContentLength() == TEST_PAYLOAD,
+				"content length" );
+		check( packet->getHeader().getSeqNo() == seqNo,
+				"sequence number" );
+		check( packet->getContent()[0] == ( seqNo & 0xFF ),
+				"content" );
+	}
+
+	unsigned char * content = packet.isNull() ? NULL : packet->getContent();
+	MRef<SRtpPacket *> copy = packet;
+	packet = NULL;
+	unsigned char * slab = nextSlab();
+	check( !content || content < slab || content >= slab + RTP_PACKET_SLAB_SIZE,
+			"slab kept while an MRef is held" );
+	copy = NULL;
+	slab = nextSlab();
+	check( content && content > slab && content < slab + RTP_PACKET_SLAB_SIZE,
+			"slab returned with the last MRef" );
+
+	/* Datagrams larger than a slab are dropped, their slab is
+	 * given back */
+	uint64_t allocations = pool->getHeapAllocations();
+	sendPacket( sender, loopback, port, TEST_OVERSIZE, ++seqNo );
+	packet = SRtpPacket::readPacket( receiver, from );
+	check( packet.isNull(), "oversize datagram dropped" );
+	check( nextSlab() == slab, "slab of the dropped datagram returned" );
+	check( pool->getHeapAllocations() == allocations,
+			"no allocation for the dropped datagram" );
+
+	/* The next datagram is read as usual */
+	sendPacket( sender, loopback, port, TEST_PAYLOAD, ++seqNo );
+	packet = SRtpPacket::readPacket( receiver, from );
+	check( !packet.isNull() && packet->getHeader().getSeqNo() == seqNo,
+			"packet received after the oversize one" );
+	packet = NULL;
+
+	/* Outgoing payloads larger than a slab are copied to the heap */
+	unsigned char payload[ TEST_OVERSIZE ];
+	memset( payload, 0x5a, TEST_OVERSIZE );
+	packet = new SRtpPacket( payload, TEST_OVERSIZE, ++seqNo, 0, 0x1234 );
+	check( packet->getContentLength() == TEST_OVERSIZE &&
+			memcmp( packet->getContent(), payload, TEST_OVERSIZE ) == 0,
+			"oversize payload kept" );
+	char * bytes = packet->getBytes();
+	check( packet->size() == 12 + TEST_OVERSIZE &&
+			memcmp( bytes + 12, payload, TEST_OVERSIZE ) == 0,
+			"oversize payload serialized" );
+	delete [] bytes;
+	packet = NULL;
+
+	/* Repeated packets are served by the pool */
+	allocations = pool->getHeapAllocations();
+	uint64_t reuses = pool->getReuses();
+	for( int i = 0; i < TEST_CYCLES; i++ ){
+		sendPacket( sender, loopback, port, TEST_PAYLOAD, ++seqNo );
+		packet = SRtpPacket::readPacket( receiver, from );
+		if( packet.isNull() ||
+				packet->getHeader().getSeqNo() != ( seqNo & 0xFFFF ) ){
+			check( false, "packet received in the loop" );
+			break;
+		}
+		packet = NULL;
+	}
+	check( pool->getHeapAllocations() == allocations,
+			"pool does not grow across repeated packets" );
+	check( pool->getReuses() - reuses >= 4 * TEST_CYCLES,
+			"slabs and packets reused" );
+
+	if( failures ){
+		fprintf( stderr, "%d checks failed\n", failures );
+		return 1;
+	}
+	printf( "RtpPacketPool: all checks passed\n" );
+	return 0;
+}
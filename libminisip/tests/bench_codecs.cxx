@@ -0,0 +1,568 @@
+/*
+ * Benchmark and conformance harness of the audio codecs.
+ *
+ * Loads the AudioCodec plugins through the plugin registry, as
+ * minisip does, and passes a corpus through each of them, frame by
+ * frame with CodecState::encode and decode. The corpus is the 16 bit
+ * PCM WAV files given as arguments, or a synthetic one of speech like
+ * signal, tones and noise at the rate of each codec. A file whose
+ * rate is not the one of a codec is skipped for it.
+ *
+ * One JSON object per line is printed for every codec and input, so
+ * that the results of two builds can be compared by a script:
+ *   encode_fps, decode_fps   frames coded per second, on one core,
+ *                            best of the repetitions
+ *   encode_allocs, decode_allocs
+ *                            heap allocations per frame (null where
+ *                            they cannot be counted)
+ *   delay                    samples of delay of the decoded signal,
+ *                            found by cross correlation
+ *   snr_db, segsnr_db        signal to noise ratio of the decoded
+ *                            signal over all of it and averaged
+ *                            over the active frames
+ *   lsd_db                   log spectral distance, averaged over
+ *                            the active frames
+ * The last three are objective scores, they are not PESQ, but follow
+ * the same direction: higher SNRs and a lower distance are better.
+ *
+ * usage: bench_codecs [-p plugin path] [-c codec] [-r repetitions]
+ *                     [file.wav ...]
+ */
+
+#include<config.h>
+
+#include<libminisip/media/codecs/Codec.h>
+#include<libmutil/MPlugin.h>
+
+#include<math.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<sys/time.h>
+
+#include<string>
+#include<vector>
+
+using namespace std;
+
+#define BENCH_SECONDS 10
+
+/* Active frames are those above -50 dBFS */
+#define BENCH_ACTIVE_RMS 100.0
+
+#ifdef __GLIBC__
+/*
+ * Every allocation of the codecs and of their libraries goes through
+ * malloc, those of this executable override the ones of the C
+ * library for all of them.
+ */
+extern "C" void *__libc_malloc( size_t size );
+extern "C" void *__libc_calloc( size_t n, size_t size );
+extern "C" void *__libc_realloc( void *p, size_t size );
+
+static unsigned long allocations = 0;
+
+extern "C" void *malloc( size_t size ){
+	allocations++;
+	return __libc_malloc( size );
+}
+
+extern "C" void *calloc( size_t n, size_t size ){
+	allocations++;
+	return __libc_calloc( n, size );
+}
+
+extern "C" void *realloc( void *p, size_t size ){
+	allocations++;
+	return __libc_realloc( p, size );
+}
+
+#define COUNTS_ALLOCATIONS 1
+#else
+static unsigned long allocations = 0;
+#define COUNTS_ALLOCATIONS 0
+#endif
+
+typedef vector<short> Signal;
+
+struct Input{
+	string name;
+	int rate;
+	Signal samples;
+};
+
+struct Result{
+	double encodeFps;
+	double decodeFps;
+	double encodeAllocs;
+	double decodeAllocs;
+	size_t bytes;
+	int delay;
+	double snr;
+	double segSnr;
+	double lsd;
+};
+
+static double now(){
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static unsigned get16( const unsigned char *p ){
+	return p[0] | ( p[1] << 8 );
+}
+
+static unsigned long get32( const unsigned char *p ){
+	return get16( p ) | ( (unsigned long)get16( p + 2 ) << 16 );
+}
+
+/* First channel of a 16 bit PCM WAV file */
+static bool readWav( const string &name, Input &input ){
+	FILE *f = fopen( name.c_str(), "rb" );
+	unsigned char hdr[12];
+	unsigned char chunk[8];
+	int nChannels = 0;
+
+	if( !f ){
+		fprintf( stderr, "%s: cannot open\n", name.c_str() );
+		return false;
+	}
+	if( fread( hdr, 1, 12, f ) != 12 || memcmp( hdr, "RIFF", 4 ) ||
+			memcmp( hdr + 8, "WAVE", 4 ) ){
+		fprintf( stderr, "%s: not a WAV file\n", name.c_str() );
+		fclose( f );
+		return false;
+	}
+
+	input.name = name;
+	while( fread( chunk, 1, 8, f ) == 8 ){
+		unsigned long len = get32( chunk + 4 );
+
+		if( !memcmp( chunk, "fmt ", 4 ) && len >= 16 ){
+			vector<unsigned char> fmt( len );
+			if( fread( &fmt[0], 1, len, f ) != len ){
+				break;
+			}
+			if( get16( &fmt[0] ) != 1 || get16( &fmt[14] ) != 16 ){
+				fprintf( stderr, "%s: not 16 bit PCM\n", name.c_str() );
+				break;
+			}
+			nChannels = get16( &fmt[2] );
+			input.rate = get32( &fmt[4] );
+		}
+		else if( !memcmp( chunk, "data", 4 ) && nChannels > 0 ){
+			vector<unsigned char> data( len );
+			len = fread( &data[0], 1, len, f );
+			for( unsigned long i = 0; i + 2 * nChannels <= len; i += 2 * nChannels ){
+				input.samples.push_back( (short)get16( &data[i] ) );
+			}
+			fclose( f );
+			return true;
+		}
+		else{
+			fseek( f, len + ( len & 1 ), SEEK_CUR );
+		}
+	}
+	fprintf( stderr, "%s: no PCM data\n", name.c_str() );
+	fclose( f );
+	return false;
+}
+
+static short clip( double v ){
+	if( v > 32767 ) return 32767;
+	if( v < -32768 ) return -32768;
+	return (short)v;
+}
+
+/* Pulse trains and noise through a resonance at 800 Hz, alternating
+ * voiced, unvoiced, silent and mixed segments of half a second */
+static void synthSpeech( int rate, Signal &s ){
+	unsigned int seed = 12345;
+	double r = 0.9;
+	double a1 = 2 * r * cos( 2 * M_PI * 800 / rate );
+	double a2 = -r * r;
+	double y1 = 0, y2 = 0;
+	int period = rate / 100;
+	int phase = 0;
+
+	s.resize( BENCH_SECONDS * rate );
+	for( size_t i = 0; i < s.size(); i++ ){
+		int segment = (int)( i / ( rate / 2 ) ) % 4;
+		if( i % rate == 0 ){
+			/* Pitch from 80 to 200 Hz */
+			period = rate / ( 80 + ( i / rate * 37 ) % 120 );
+		}
+		seed = seed * 1103515245 + 12345;
+		double noise = ( ( seed >> 8 ) & 0xffff ) / 32768.0 - 1.0;
+		double ex;
+		switch( segment ){
+			case 0: ex = ( phase++ % period == 0 ) ? 4000 : 0; break;
+			case 1: ex = noise * 1500; break;
+			case 2: ex = noise * 10; break;
+			default: ex = ( ( phase++ % period == 0 ) ? 2500 : 0 ) + noise * 250;
+		}
+		double y = ex + a1 * y1 + a2 * y2;
+		y2 = y1;
+		y1 = y;
+		s[i] = clip( y );
+	}
+}
+
+/* 300, 1000 and 3000 Hz at -20 dBFS each */
+static void synthTones( int rate, Signal &s ){
+	s.resize( BENCH_SECONDS * rate );
+	for( size_t i = 0; i < s.size(); i++ ){
+		double t = (double)i / rate;
+		s[i] = clip( 3277 * ( sin( 2 * M_PI * 300 * t ) +
+				sin( 2 * M_PI * 1000 * t ) +
+				sin( 2 * M_PI * 3000 * t ) ) );
+	}
+}
+
+/* White noise at -20 dBFS */
+static void synthNoise( int rate, Signal &s ){
+	unsigned int seed = 4711;
+
+	s.resize( BENCH_SECONDS * rate );
+	for( size_t i = 0; i < s.size(); i++ ){
+		seed = seed * 1103515245 + 12345;
+		s[i] = clip( ( ( ( seed >> 8 ) & 0xffff ) / 32768.0 - 1.0 ) * 3277 * 1.73 );
+	}
+}
+
+/* Delay of y relative to x, up to maxDelay samples */
+static int findDelay( const Signal &x, const Signal &y, int maxDelay ){
+	int best = 0;
+	double bestCorr = -1e300;
+
+	for( int d = 0; d <= maxDelay; d++ ){
+		double corr = 0, energy = 0;
+		for( size_t i = 0; i + d < y.size() && i < x.size(); i++ ){
+			corr += (double)x[i] * y[i + d];
+			energy += (double)y[i + d] * y[i + d];
+		}
+		if( energy > 0 && corr > 0 && corr * corr / energy > bestCorr ){
+			bestCorr = corr * corr / energy;
+			best = d;
+		}
+	}
+	return best;
+}
+
+/* Log power spectrum of a Hann windowed frame, in dB */
+static void spectrum( const short *x, int n, int nFft, vector<double> &db ){
+	db.resize( nFft / 2 + 1 );
+	for( int k = 0; k <= nFft / 2; k++ ){
+		double re = 0, im = 0;
+		for( int i = 0; i < n; i++ ){
+			double w = 0.5 - 0.5 * cos( 2 * M_PI * ( i + 0.5 ) / n );
+			double phi = 2 * M_PI * k * i / nFft;
+			re += w * x[i] * cos( phi );
+			im -= w * x[i] * sin( phi );
+		}
+		db[k] = 10 * log10( re * re + im * im + 1e-3 );
+	}
+}
+
+/* Bins more than 50 dB below the peak of the reference are raised
+ * to that level, the coding noise in the gaps of a line spectrum
+ * would weigh as much as the lines otherwise */
+static void floorSpectra( vector<double> &x, vector<double> &y ){
+	double peak = -1e300;
+	for( size_t k = 0; k < x.size(); k++ ){
+		if( x[k] > peak ) peak = x[k];
+	}
+	for( size_t k = 0; k < x.size(); k++ ){
+		if( x[k] < peak - 50 ) x[k] = peak - 50;
+		if( y[k] < peak - 50 ) y[k] = peak - 50;
+	}
+}
+
+static void score( const Signal &x, const Signal &y, int frame, Result &r ){
+	r.delay = findDelay( x, y, 2 * frame );
+
+	double signal = 0, noise = 0, segSum = 0, lsdSum = 0;
+	int nActive = 0;
+	int nFft = 1;
+	vector<double> dbX, dbY;
+
+	while( nFft < frame ){
+		nFft *= 2;
+	}
+
+	for( size_t f = 0; ( f + 1 ) * frame + r.delay <= y.size() &&
+			( f + 1 ) * frame <= x.size(); f++ ){
+		const short *px = &x[f * frame];
+		const short *py = &y[f * frame + r.delay];
+		double fs = 0, fn = 0;
+
+		for( int i = 0; i < frame; i++ ){
+			double e = (double)px[i] - py[i];
+			fs += (double)px[i] * px[i];
+			fn += e * e;
+		}
+		signal += fs;
+		noise += fn;
+
+		if( sqrt( fs / frame ) < BENCH_ACTIVE_RMS ){
+			continue;
+		}
+		double seg = 10 * log10( fs / ( fn + 1e-9 ) );
+		if( seg < -10 ) seg = -10;
+		if( seg > 35 ) seg = 35;
+		segSum += seg;
+
+		spectrum( px, frame, nFft, dbX );
+		spectrum( py, frame, nFft, dbY );
+		floorSpectra( dbX, dbY );
+		double d = 0;
+		for( size_t k = 0; k < dbX.size(); k++ ){
+			d += ( dbX[k] - dbY[k] ) * ( dbX[k] - dbY[k] );
+		}
+		lsdSum += sqrt( d / dbX.size() );
+		nActive++;
+	}
+
+	r.snr = noise > 0 ? 10 * log10( signal / noise ) : 99;
+	r.segSnr = nActive ? segSum / nActive : NAN;
+	r.lsd = nActive ? lsdSum / nActive : NAN;
+}
+
+static bool run( MRef<AudioCodec *> codec, const Signal &in, int reps, Result &r ){
+	int frame = codec->getInputNrSamples();
+	size_t nFrames = in.size() / frame;
+	/* Room for the largest frames of the codecs at 48 kHz */
+	vector<unsigned char> bits( 8192 );
+	vector<size_t> sizes( nFrames );
+	vector<unsigned char> stream;
+	Signal out( nFrames * frame );
+	Signal frameOut( 8192 );
+
+	if( nFrames == 0 ){
+		return false;
+	}
+	/* So that the growth of the stream is not counted as
+	 * allocations of the encoder */
+	stream.reserve( nFrames * bits.size() );
+
+	r.encodeFps = r.decodeFps = 0;
+	for( int rep = 0; rep < reps; rep++ ){
+		MRef<CodecState *> enc = codec->newInstance();
+		MRef<CodecState *> dec = codec->newInstance();
+		Signal block( frame );
+
+		stream.clear();
+		unsigned long before = allocations;
+		double start = now();
+		for( size_t f = 0; f < nFrames; f++ ){
+			/* encode() does not take a const buffer */
+			memcpy( &block[0], &in[f * frame], frame * sizeof( short ) );
+			sizes[f] = enc->encode( &block[0], frame * sizeof( short ),
+					codec->getSamplingFreq(), &bits[0] );
+			stream.insert( stream.end(), bits.begin(), bits.begin() + sizes[f] );
+		}
+		double t = now() - start;
+		unsigned long encAllocs = allocations - before;
+
+		if( nFrames / t > r.encodeFps ){
+			r.encodeFps = nFrames / t;
+		}
+
+		size_t pos = 0;
+		before = allocations;
+		start = now();
+		for( size_t f = 0; f < nFrames; f++ ){
+			dec->decode( &stream[pos], (int32_t)sizes[f], &frameOut[0] );
+			memcpy( &out[f * frame], &frameOut[0], frame * sizeof( short ) );
+			pos += sizes[f];
+		}
+		t = now() - start;
+		unsigned long decAllocs = allocations - before;
+
+		if( nFrames / t > r.decodeFps ){
+			r.decodeFps = nFrames / t;
+		}
+
+		if( rep == 0 ){
+			r.encodeAllocs = (double)encAllocs / nFrames;
+			r.decodeAllocs = (double)decAllocs / nFrames;
+			r.bytes = stream.size();
+		}
+	}
+
+	Signal ref( in.begin(), in.begin() + nFrames * frame );
+	score( ref, out, frame, r );
+	return true;
+}
+
+static string jsonString( const string &s ){
+	string ret = "\"";
+	for( size_t i = 0; i < s.size(); i++ ){
+		unsigned char c = s[i];
+		if( c == '"' || c == '\\' ){
+			ret += '\\';
+			ret += c;
+		}
+		else if( c < 0x20 ){
+			char buf[8];
+			snprintf( buf, sizeof( buf ), "\\u%04x", c );
+			ret += buf;
+		}
+		else{
+			ret += c;
+		}
+	}
+	return ret + "\"";
+}
+
+static string jsonNumber( double v, const char *format = "%.2f" ){
+	char buf[32];
+	if( isnan( v ) || isinf( v ) ){
+		return "null";
+	}
+	snprintf( buf, sizeof( buf ), format, v );
+	return buf;
+}
+
+static void print( MRef<AudioCodec *> codec, const Input &input, const Result &r ){
+	int frame = codec->getInputNrSamples();
+	size_t nFrames = input.samples.size() / frame;
+
+	printf( "{\"codec\": %s, \"payload_type\": %d, \"input\": %s, "
+			"\"rate\": %d, \"frame_samples\": %d, \"frames\": %lu, "
+			"\"bytes_per_frame\": %s, "
+			"\"encode_fps\": %s, \"decode_fps\": %s, "
+			"\"encode_allocs\": %s, \"decode_allocs\": %s, "
+			"\"delay\": %d, \"snr_db\": %s, \"segsnr_db\": %s, "
+			"\"lsd_db\": %s}\n",
+			jsonString( codec->getCodecName() ).c_str(),
+			codec->getSdpMediaType(),
+			jsonString( input.name ).c_str(),
+			input.rate, frame, (unsigned long)nFrames,
+			jsonNumber( (double)r.bytes / nFrames ).c_str(),
+			jsonNumber( r.encodeFps, "%.0f" ).c_str(),
+			jsonNumber( r.decodeFps, "%.0f" ).c_str(),
+			COUNTS_ALLOCATIONS ? jsonNumber( r.encodeAllocs ).c_str() : "null",
+			COUNTS_ALLOCATIONS ? jsonNumber( r.decodeAllocs ).c_str() : "null",
+			r.delay,
+			jsonNumber( r.snr ).c_str(),
+			jsonNumber( r.segSnr ).c_str(),
+			jsonNumber( r.lsd ).c_str() );
+	fflush( stdout );
+}
+
+static string defaultPluginPath(){
+	const char *env = getenv( "MINISIP_PLUGIN_PATH" );
+	string path;
+
+	if( env ){
+		return env;
+	}
+#ifdef BENCH_BUILDDIR
+	/* The plugins built along with this program */
+	path = BENCH_BUILDDIR;
+#endif
+#ifdef MINISIP_PLUGINDIR
+	if( !path.empty() ){
+		path += ":";
+	}
+	path += MINISIP_PLUGINDIR;
+#endif
+	return path;
+}
+
+int main( int argc, char **argv ){
+	string pluginPath = defaultPluginPath();
+	string only;
+	int reps = 3;
+	vector<Input> files;
+	int i;
+
+	for( i = 1; i < argc && argv[i][0] == '-'; i++ ){
+		if( !strcmp( argv[i], "-p" ) && i + 1 < argc ){
+			pluginPath = argv[++i];
+		}
+		else if( !strcmp( argv[i], "-c" ) && i + 1 < argc ){
+			only = argv[++i];
+		}
+		else if( !strcmp( argv[i], "-r" ) && i + 1 < argc ){
+			reps = atoi( argv[++i] );
+		}
+		else{
+			fprintf( stderr, "usage: bench_codecs [-p plugin path] "
+					"[-c codec] [-r repetitions] [file.wav ...]\n" );
+			return 1;
+		}
+	}
+	for( ; i < argc; i++ ){
+		Input input;
+		if( !readWav( argv[i], input ) ){
+			return 1;
+		}
+		files.push_back( input );
+	}
+	if( reps < 1 ){
+		reps = 1;
+	}
+
+	MRef<AudioCodecRegistry *> registry = AudioCodecRegistry::getInstance();
+	MRef<MPluginManager *> manager = MPluginManager::getInstance();
+
+	if( !pluginPath.empty() ){
+		manager->setSearchPath( pluginPath );
+		manager->loadFromDirectory( pluginPath );
+	}
+
+	int nCodecs = 0;
+	MPluginRegistry::const_iterator it;
+	for( it = registry->begin(); it != registry->end(); it++ ){
+		MRef<AudioCodec *> codec = dynamic_cast<AudioCodec *>( **it );
+
+		if( !codec || ( !only.empty() && codec->getCodecName() != only ) ){
+			continue;
+		}
+		nCodecs++;
+
+		int rate = codec->getSamplingFreq();
+		vector<Input> inputs;
+
+		if( files.empty() ){
+			static const char *names[] = { "synthetic:speech",
+					"synthetic:tones", "synthetic:noise" };
+			inputs.resize( 3 );
+			for( int k = 0; k < 3; k++ ){
+				inputs[k].name = names[k];
+				inputs[k].rate = rate;
+			}
+			synthSpeech( rate, inputs[0].samples );
+			synthTones( rate, inputs[1].samples );
+			synthNoise( rate, inputs[2].samples );
+		}
+		else{
+			inputs = files;
+		}
+
+		for( size_t k = 0; k < inputs.size(); k++ ){
+			Result r;
+
+			memset( &r, 0, sizeof( r ) );
+
+			if( inputs[k].rate != rate ){
+				fprintf( stderr, "%s: %s is at %d Hz, the codec at %d Hz, skipped\n",
+						codec->getCodecName().c_str(),
+						inputs[k].name.c_str(), inputs[k].rate, rate );
+				continue;
+			}
+			if( run( codec, inputs[k].samples, reps, r ) ){
+				print( codec, inputs[k], r );
+			}
+		}
+	}
+
+	if( nCodecs == 0 ){
+		fprintf( stderr, "No codec found\n" );
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,233 @@
+/*
+ * Benchmark of the start up load of the XML configuration.
+ *
+ * Writes configuration files with 1000 and 10000 accounts, and loads
+ * them the way SipSoftPhoneConfiguration::load does: the accounts in
+ * order until one has no name, and the keys of each account. The
+ * loads are done through MXmlConfBackend, which indexes the nodes by
+ * key when the file is parsed, and through XMLParser::getValue, which
+ * walks the path through the children, as done before. Then saves
+ * the configuration unchanged, and with one key changed, and reads the
+ * file written back. Prints the times taken; the exit status is 1 if
+ * a value loaded is wrong.
+ */
+
+#include"MXmlConfBackend.h"
+
+#include<libmutil/XMLParser.h>
+#include<libmutil/stringutils.h>
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<sys/time.h>
+#include<unistd.h>
+
+#include<string>
+
+/* The path walk is quadratic in the number of accounts, it is timed
+ * on that many accounts at most */
+#define BENCH_WALK_ACCOUNTS 2000
+
+static const char * const accountKeys[] = {
+	"sip_uri", "secured", "use_zrtp", "dh_enabled", "psk_enabled",
+	"check_cert", "ka_type", "psk", "hwsim_pin", "certificate",
+	"private_key", "certificate_chain[0]", "ca_file[0]", "ca_dir[0]",
+	"auto_detect_proxy", "proxy_addr", "proxy_port", "transport",
+	"proxy_username", "proxy_password", "register", "register_expires",
+	"pstn_account", "default_account", NULL
+};
+
+static const char * const globalKeys[] = {
+	"use_ipv6", "sip_worker_threads", "sound_device", "sound_device_in",
+	"sound_device_out", "mixer_type", "dtx", "rtp_port_pool_size",
+	"video_device", "frame_width", "frame_height", "use_100rel",
+	"use_anat", "dh_pool_size", "use_stun", "stun_server_domain",
+	"stun_manual_server", "phonebook[0]", "ringtone", "local_udp_port",
+	"local_tls_port", "auto_answer", "instance_id", "codec[0]",
+	"codec[1]", "network_interface", NULL
+};
+
+static double now(){
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* The value of a key of an account, with the characters escaped in
+ * the file in some of them */
+static std::string value( int account, const std::string &key ){
+	if( key == "sip_uri" ){
+		return "sip:user" + itoa( account ) + "@example.com";
+	}
+	if( key == "proxy_port" ){
+		return itoa( 5060 + account % 7 );
+	}
+	if( key == "proxy_password" ){
+		return "p&ss<" + itoa( account );
+	}
+	return key + "-" + itoa( account );
+}
+
+static std::string escape( const std::string &s ){
+	std::string ret;
+	for( size_t i = 0; i < s.size(); i++ ){
+		if( s[i] == '&' )
+			ret += "&amp;";
+		else if( s[i] == '<' )
+			ret += "&lt;";
+		else
+			ret += s[i];
+	}
+	return ret;
+}
+
+static std::string element( const std::string &key, const std::string &v ){
+	std::string name = key.substr( 0, key.find( '[' ) );
+	return "\t<" + name + ">" + escape( v ) + "</" + name + ">\n";
+}
+
+static void writeConfig( const std::string &fileName, int accounts ){
+	FILE * f = fopen( fileName.c_str(), "w" );
+	fprintf( f, "<version>3</version>\n" );
+	for( int i = 0; i < accounts; i++ ){
+		std::string s = "<account>\n";
+		s += element( "account_name", "Account " + itoa( i ) );
+		for( int k = 0; accountKeys[k]; k++ ){
+			s += element( accountKeys[k], value( i, accountKeys[k] ) );
+		}
+		s += "</account>\n";
+		fputs( s.c_str(), f );
+	}
+	for( int k = 0; globalKeys[k]; k++ ){
+		std::string s = element( globalKeys[k], value( 0, globalKeys[k] ) );
+		fputs( s.c_str() + 1, f );
+	}
+	fclose( f );
+}
+
+/* Loads as SipSoftPhoneConfiguration::load, returns the number of
+ * wrong values */
+static int loadBackend( MRef<ConfBackend *> backend, int accounts ){
+	int wrong = 0;
+	int i = 0;
+
+	if( backend->loadInt( "version", 0 ) != 3 ){
+		wrong++;
+	}
+	for( ;; i++ ){
+		std::string path = "account[" + itoa( i ) + "]/";
+		if( backend->loadString( path + "account_name" ) == "" ){
+			break;
+		}
+		for( int k = 0; accountKeys[k]; k++ ){
+			std::string key = accountKeys[k];
+			if( key == "proxy_port" ){
+				if( backend->loadInt( path + key, 5060 ) != atoi( value( i, key ).c_str() ) ){
+					wrong++;
+				}
+			}
+			else if( backend->loadString( path + key, "" ) != value( i, key ) ){
+				wrong++;
+			}
+		}
+	}
+	for( int k = 0; globalKeys[k]; k++ ){
+		if( backend->loadString( globalKeys[k], "" ) != value( 0, globalKeys[k] ) ){
+			wrong++;
+		}
+	}
+	return wrong + ( i != accounts );
+}
+
+/* The same look ups through XMLParser */
+static int loadParser( XMLParser * parser, int accounts ){
+	int wrong = 0;
+	int i = 0;
+
+	for( ; i < accounts; i++ ){
+		std::string path = "account[" + itoa( i ) + "]/";
+		if( parser->getValue( path + "account_name", "" ) == "" ){
+			break;
+		}
+		for( int k = 0; accountKeys[k]; k++ ){
+			std::string key = accountKeys[k];
+			if( parser->getValue( path + key, "" ) != escape( value( i, key ) ) ){
+				wrong++;
+			}
+		}
+	}
+	for( int k = 0; globalKeys[k]; k++ ){
+		if( parser->getValue( globalKeys[k], "" ) != value( 0, globalKeys[k] ) ){
+			wrong++;
+		}
+	}
+	return wrong + ( i != accounts );
+}
+
+static int bench( int accounts ){
+	char fileName[] = "/tmp/bench_config_loadXXXXXX";
+	int fd = mkstemp( fileName );
+	int wrong = 0, n;
+	double start;
+
+	if( fd < 0 ){
+		perror( "mkstemp" );
+		return 1;
+	}
+	close( fd );
+	writeConfig( fileName, accounts );
+	printf( "%d accounts\n", accounts );
+
+	start = now();
+	MRef<ConfBackend *> backend = new MXmlConfBackend( fileName );
+	printf( "  %-36s %9.1f ms\n", "parse and index", ( now() - start ) * 1e3 );
+
+	start = now();
+	n = loadBackend( backend, accounts );
+	printf( "  %-36s %9.1f ms%s\n", "load, indexed", ( now() - start ) * 1e3,
+			n ? "  WRONG VALUES" : "" );
+	wrong += n;
+
+	int walked = accounts < BENCH_WALK_ACCOUNTS ? accounts : BENCH_WALK_ACCOUNTS;
+	XMLFileParser * parser = new XMLFileParser( fileName );
+	start = now();
+	n = loadParser( parser, walked );
+	printf( "  %-36s %9.1f ms%s\n",
+			( "load, path walk of " + itoa( walked ) + " accounts" ).c_str(),
+			( now() - start ) * 1e3, n ? "  WRONG VALUES" : "" );
+	wrong += n;
+	delete parser;
+
+	/* The configuration saved as loaded writes nothing */
+	start = now();
+	backend->save( "account[" + itoa( accounts / 2 ) + "]/proxy_port",
+			atoi( value( accounts / 2, "proxy_port" ).c_str() ) );
+	backend->save( "version", 3 );
+	backend->commit();
+	printf( "  %-36s %9.1f ms\n", "save unchanged and commit",
+			( now() - start ) * 1e3 );
+
+	start = now();
+	backend->save( "account[" + itoa( accounts - 1 ) + "]/proxy_addr", "<b&d>" );
+	backend->save( "account[" + itoa( accounts ) + "]/account_name", "New" );
+	backend->commit();
+	printf( "  %-36s %9.1f ms\n", "save two keys and commit",
+			( now() - start ) * 1e3 );
+
+	MRef<ConfBackend *> reloaded = new MXmlConfBackend( fileName );
+	if( reloaded->loadString( "account[" + itoa( accounts - 1 ) + "]/proxy_addr" ) != "<b&d>" ||
+			reloaded->loadString( "/account[" + itoa( accounts ) + "]/account_name" ) != "New" ||
+			reloaded->loadString( "account[0]/account_name" ) != "Account 0" ){
+		printf( "  WRONG VALUES written\n" );
+		wrong++;
+	}
+
+	unlink( fileName );
+	return wrong;
+}
+
+int main( int argc, char *argv[] ){
+	int wrong = bench( 1000 );
+	wrong += bench( 10000 );
+	return wrong ? 1 : 0;
+}
@@ -0,0 +1,185 @@
+/*
+ * Benchmark of the look ups of ContactDb.
+ *
+ * Fills the database with 100000 entries, as loaded from a shared
+ * phone book: SIP URIs, and telephone numbers written as in LDAP
+ * directories. Resolves callers by URI (written as in a From header,
+ * with display name, parameters and other case), by id, by number
+ * from a gateway URI, and by longest prefix for the extensions of
+ * switchboards, and checks the entries found. The same URI look ups
+ * are timed with the linear scan done before. Prints the time per
+ * look up; the exit status is 1 if an entry found is wrong.
+ */
+
+#include<libminisip/contacts/ContactDb.h>
+#include<libminisip/contacts/PhoneBook.h>
+#include<libmutil/stringutils.h>
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<sys/time.h>
+
+#include<list>
+#include<string>
+#include<vector>
+
+#define BENCH_ENTRIES 100000
+#define BENCH_LOOKUPS 200000
+#define BENCH_SCAN_LOOKUPS 200
+
+/* One entry in BENCH_NUMBER_RATIO is a telephone number */
+#define BENCH_NUMBER_RATIO 4
+
+static double now(){
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static std::string user( int i ){
+	return "user" + itoa( i );
+}
+
+static std::string domain( int i ){
+	return "site" + itoa( i % 97 ) + ".example.com";
+}
+
+/* Switchboard numbers, the callers dial extensions below them */
+static std::string number( int i ){
+	return "+46 8 " + itoa( 1000000 + i );
+}
+
+static std::string numberDigits( int i ){
+	return "468" + itoa( 1000000 + i );
+}
+
+static void report( const char *what, double seconds, int n, int wrong ){
+	printf( "%-32s %9.1f ns/look up%s\n", what, seconds * 1e9 / n,
+			wrong ? "  WRONG ENTRIES" : "" );
+}
+
+int main( int argc, char *argv[] ){
+	MRef<ContactDb *> db = new ContactDb();
+	std::vector< MRef<ContactEntry *> > entries;
+	std::list< ContactEntry * > scanList;
+	int wrong = 0, total = 0;
+
+	ContactEntry::setDb( db );
+	double start = now();
+	for( int i = 0; i < BENCH_ENTRIES; i++ ){
+		std::string uri;
+		if( i % BENCH_NUMBER_RATIO == 0 ){
+			uri = number( i );
+		}
+		else{
+			uri = "sip:" + user( i ) + "@" + domain( i );
+		}
+		MRef<ContactEntry *> e = new ContactEntry( uri, "bench" );
+		entries.push_back( e );
+		scanList.push_back( *e );
+	}
+	printf( "%d entries added in %.1f ms\n", (int)db->size(),
+			( now() - start ) * 1e3 );
+
+	/* By URI, as written in a From header */
+	std::vector< std::string > froms;
+	std::vector< int > expected;
+	srand( 1 );
+	for( int k = 0; k < 1000; k++ ){
+		int i;
+		do{
+			i = rand() % BENCH_ENTRIES;
+		} while( i % BENCH_NUMBER_RATIO == 0 );
+		froms.push_back( "\"User\" <sip:" + user( i ) + "@" +
+				upCase( domain( i ) ) + ":5060;transport=udp>" );
+		expected.push_back( i );
+	}
+
+	start = now();
+	for( int n = 0; n < BENCH_LOOKUPS; n++ ){
+		int k = n % froms.size();
+		if( db->lookUp( froms[k] ) != *entries[ expected[k] ] ){
+			wrong++;
+		}
+	}
+	report( "uri", now() - start, BENCH_LOOKUPS, wrong );
+	total += wrong;
+
+	/* The exact compare of the linear scan needs the URI as
+	 * stored */
+	start = now();
+	wrong = 0;
+	for( int n = 0; n < BENCH_SCAN_LOOKUPS; n++ ){
+		int i = expected[ n % expected.size() ];
+		std::string uri = "sip:" + user( i ) + "@" + domain( i );
+		ContactEntry * found = NULL;
+		std::list< ContactEntry * >::iterator it;
+		for( it = scanList.begin(); it != scanList.end(); it++ ){
+			if( (*it)->getUri() == uri ){
+				found = *it;
+				break;
+			}
+		}
+		if( found != *entries[i] ){
+			wrong++;
+		}
+	}
+	report( "uri, linear scan", now() - start, BENCH_SCAN_LOOKUPS, wrong );
+	total += wrong;
+
+	start = now();
+	wrong = 0;
+	for( int n = 0; n < BENCH_LOOKUPS; n++ ){
+		int i = ( n * 7919 ) % BENCH_ENTRIES;
+		if( db->lookUp( entries[i]->getId() ) != *entries[i] ){
+			wrong++;
+		}
+	}
+	report( "id", now() - start, BENCH_LOOKUPS, wrong );
+	total += wrong;
+
+	/* A call from the PSTN gateway */
+	start = now();
+	wrong = 0;
+	for( int n = 0; n < BENCH_LOOKUPS; n++ ){
+		int i = ( n * 7919 ) % ( BENCH_ENTRIES / BENCH_NUMBER_RATIO ) * BENCH_NUMBER_RATIO;
+		std::string uri = "sip:+" + numberDigits( i ) + "@gw.example.com;user=phone";
+		if( db->lookUp( uri ) != *entries[i] ){
+			wrong++;
+		}
+	}
+	report( "number from gateway uri", now() - start, BENCH_LOOKUPS, wrong );
+	total += wrong;
+
+	/* An extension behind a switchboard */
+	start = now();
+	wrong = 0;
+	for( int n = 0; n < BENCH_LOOKUPS; n++ ){
+		int i = ( n * 7919 ) % ( BENCH_ENTRIES / BENCH_NUMBER_RATIO ) * BENCH_NUMBER_RATIO;
+		std::string extension = "+" + numberDigits( i ) + itoa( 100 + n % 900 );
+		if( db->lookUpNumber( extension ) != *entries[i] ){
+			wrong++;
+		}
+	}
+	report( "number, longest prefix", now() - start, BENCH_LOOKUPS, wrong );
+	total += wrong;
+
+	start = now();
+	wrong = 0;
+	for( int n = 0; n < BENCH_LOOKUPS; n++ ){
+		if( db->lookUp( "sip:nobody" + itoa( n ) + "@example.org" ) ){
+			wrong++;
+		}
+	}
+	report( "unknown uri", now() - start, BENCH_LOOKUPS, wrong );
+	total += wrong;
+
+	start = now();
+	entries.clear();
+	scanList.clear();
+	printf( "entries deleted in %.1f ms, %d left\n",
+			( now() - start ) * 1e3, (int)db->size() );
+
+	ContactEntry::setDb( NULL );
+	return total || db->size() ? 1 : 0;
+}
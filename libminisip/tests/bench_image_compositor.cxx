@@ -0,0 +1,86 @@
+/*
+ * Benchmark of the video compositor used by ImageMixer.
+ *
+ * Composites 4 and 9 tiles into 720p and 1080p I420 frames in both
+ * layouts and prints the achieved frames per second.
+ */
+
+#include<libminisip/media/video/mixer/ImageCompositor.h>
+#include<libmutil/mtime.h>
+
+#include<stdio.h>
+#include<string.h>
+
+#define BENCH_FRAMES 200
+
+static MImage * newImage( uint32_t width, uint32_t height ){
+	MImage * image = new MImage;
+	memset( image, 0, sizeof( MImage ) );
+	image->width = width;
+	image->height = height;
+	image->linesize[0] = width;
+	image->linesize[1] = width / 2;
+	image->linesize[2] = width / 2;
+	image->data[0] = new uint8_t[width * height];
+	image->data[1] = new uint8_t[width * height / 4];
+	image->data[2] = new uint8_t[width * height / 4];
+	for( uint32_t i = 0; i < width * height; i++ ){
+		image->data[0][i] = (uint8_t)( i * 7 );
+	}
+	memset( image->data[1], 100, width * height / 4 );
+	memset( image->data[2], 150, width * height / 4 );
+	return image;
+}
+
+static void freeImage( MImage * image ){
+	delete [] image->data[0];
+	delete [] image->data[1];
+	delete [] image->data[2];
+	delete image;
+}
+
+static void bench( ImageCompositor & compositor, const char * layoutName,
+		uint32_t width, uint32_t height, uint32_t tiles ){
+	MImage * main = newImage( width, height );
+	MImage * sources[9];
+	uint32_t n = tiles - 1;
+	uint32_t i;
+
+	for( i = 0; i < n; i++ ){
+		sources[i] = newImage( width, height );
+	}
+
+	uint64_t start = mtime();
+	for( i = 0; i < BENCH_FRAMES; i++ ){
+		compositor.compose( main, sources, n );
+	}
+	uint64_t ms = mtime() - start;
+	if( ms == 0 ){
+		ms = 1;
+	}
+
+	printf( "%-15s %4ux%-4u %u tiles: %8.1f frames/s\n", layoutName,
+			width, height, tiles, BENCH_FRAMES * 1000.0 / ms );
+
+	for( i = 0; i < n; i++ ){
+		freeImage( sources[i] );
+	}
+	freeImage( main );
+}
+
+int main( int argc, char *argv[] ){
+	ImageCompositor compositor;
+	uint32_t sizes[2][2] = { { 1280, 720 }, { 1920, 1080 } };
+	uint32_t tiles[2] = { 4, 9 };
+
+	for( int s = 0; s < 2; s++ ){
+		for( int t = 0; t < 2; t++ ){
+			compositor.setLayout( COMPOSITOR_LAYOUT_GRID );
+			bench( compositor, "grid", sizes[s][0], sizes[s][1], tiles[t] );
+			compositor.setLayout( COMPOSITOR_LAYOUT_ACTIVE_SPEAKER );
+			bench( compositor, "active speaker", sizes[s][0], sizes[s][1], tiles[t] );
+		}
+	}
+
+	return 0;
+}
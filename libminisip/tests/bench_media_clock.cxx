@@ -0,0 +1,156 @@
+/*
+ * Benchmark of the headless media clock.
+ *
+ * Runs sessions on devices of the "nullclock" sound driver, each a
+ * SoundIO with one source and one recorder receiver. On every 20 ms
+ * tick a session mixes its source, and resamples, G.711 encodes and
+ * sends the recorded period to a UDP socket on the loopback
+ * interface, then decodes it back into its source as if received.
+ * Sessions are added until more than 1% of the ticks overrun, and
+ * the number of sessions per core is printed.
+ */
+
+#include<config.h>
+
+#include"../source/subsystem_media/codecs/G711CODEC.h"
+
+#include<libminisip/media/soundcard/SoundIO.h>
+#include<libminisip/media/soundcard/SoundDevice.h>
+#include<libminisip/media/soundcard/SoundSource.h>
+#include<libminisip/media/soundcard/SoundRecorderCallback.h>
+#include<libminisip/media/soundcard/MediaClock.h>
+#include<libminisip/media/soundcard/Resampler.h>
+#include<libmnetutil/UDPSocket.h>
+#include<libmnetutil/IPAddress.h>
+#include<libmutil/Thread.h>
+#include<libmutil/stringutils.h>
+
+#include<stdio.h>
+
+#include<vector>
+
+#define BENCH_STEP 50
+#define BENCH_MAX_SESSIONS 10000
+#define BENCH_STEP_SECONDS 2
+
+#define BENCH_FRAME ( SOUND_CARD_FREQ * 20 / 1000 )
+
+class BenchSession : public SoundRecorderCallback{
+	public:
+		BenchSession( int32_t id, MRef<UDPSocket *> socket,
+				IPAddress &sink, int32_t sinkPort );
+		~BenchSession();
+
+		virtual void srcb_handleSound( void *data, int nSamples, int sampleRate );
+#ifdef AEC_SUPPORT
+		virtual void srcb_handleSound( void *data, int nSamples, void *dataR ){}
+#endif
+
+		MRef<MediaClock *> getClock(){ return device->getClock(); }
+
+	private:
+		MRef<SoundDevice *> device;
+		MRef<SoundIO *> soundIo;
+		MRef<SoundSource *> source;
+		MRef<CodecState *> codec;
+		MRef<Resampler *> down;
+		MRef<Resampler *> up;
+		MRef<UDPSocket *> socket;
+		IPAddress &sink;
+		int32_t sinkPort;
+		int32_t seqNo;
+
+		short narrow[160];
+		unsigned char encoded[160];
+		short decoded[160];
+		short wide[BENCH_FRAME];
+};
+
+BenchSession::BenchSession( int32_t id, MRef<UDPSocket *> socket_,
+		IPAddress &sink_, int32_t sinkPort_ ):
+			socket( socket_ ), sink( sink_ ), sinkPort( sinkPort_ ),
+			seqNo( 0 ){
+	MRef<AudioCodec *> g711 = new G711Codec( NULL, G711U );
+
+	codec = g711->newInstance();
+	down = ResamplerRegistry::getInstance()->create( SOUND_CARD_FREQ, 8000, 20, 1 );
+	up = ResamplerRegistry::getInstance()->create( 8000, SOUND_CARD_FREQ, 20, 1 );
+
+	device = SoundDevice::create( "nullclock:bench" + itoa( id ) );
+	soundIo = new SoundIO( device, device, "simple", 2, SOUND_CARD_FREQ );
+	source = new BasicSoundSource( id, "bench", NULL, 0, SOUND_CARD_FREQ, 20, 2 );
+	soundIo->registerSource( source );
+	soundIo->register_recorder_receiver( this, BENCH_FRAME, false );
+	soundIo->startRecord();
+}
+
+BenchSession::~BenchSession(){
+	/* Off the clock before the receiver goes away */
+	soundIo = NULL;
+}
+
+void BenchSession::srcb_handleSound( void *data, int nSamples, int sampleRate ){
+	down->resample( (short *)data, narrow );
+	uint32_t n = codec->encode( narrow, sizeof( narrow ), 8000, encoded );
+	socket->sendTo( sink, sinkPort, encoded, n );
+
+	/* What the receiving side of the session does */
+	codec->decode( encoded, n, decoded );
+	up->resample( decoded, wide );
+	source->pushSound( wide, BENCH_FRAME, seqNo++, SOUND_CARD_FREQ, false );
+}
+
+int main( int argc, char *argv[] ){
+	/* Datagrams are sent here, and never read */
+	MRef<UDPSocket *> sinkSocket = new UDPSocket( 0 );
+	MRef<UDPSocket *> socket = new UDPSocket( 0 );
+	MRef<IPAddress *> sink = IPAddress::create( "127.0.0.1" );
+	std::vector<BenchSession *> sessions;
+	MRef<MediaClock *> clock;
+	size_t passed = 0;
+
+	while( sessions.size() < BENCH_MAX_SESSIONS ){
+		for( int i = 0; i < BENCH_STEP; i++ ){
+			sessions.push_back( new BenchSession( sessions.size() + 1,
+					socket, **sink, sinkSocket->getPort() ) );
+		}
+		if( !clock ){
+			clock = sessions[0]->getClock();
+			printf( "%d ms ticks, %d worker threads\n",
+				clock->getPeriod(), clock->getNWorkers() );
+		}
+
+		Thread::msleep( 200 );
+		clock->resetStats();
+		Thread::msleep( BENCH_STEP_SECONDS * 1000 );
+		MediaClockStats stats = clock->getStats();
+
+		if( stats.ticks == 0 ){
+			fprintf( stderr, "The clock is not ticking\n" );
+			return 1;
+		}
+
+		printf( "%5u sessions: tick mean %6llu us, max %6llu us, "
+			"%llu overruns, %llu missed in %llu ticks\n",
+			(unsigned)stats.clients,
+			(unsigned long long)( stats.totalTickTime / stats.ticks ),
+			(unsigned long long)stats.maxTickTime,
+			(unsigned long long)stats.overruns,
+			(unsigned long long)stats.missed,
+			(unsigned long long)stats.ticks );
+
+		if( ( stats.overruns + stats.missed ) * 100 > stats.ticks ){
+			break;
+		}
+		passed = sessions.size();
+	}
+
+	printf( "%u sessions per core at %d ms ticks\n",
+		(unsigned)( passed / clock->getNWorkers() ),
+		clock->getPeriod() );
+
+	for( size_t i = 0; i < sessions.size(); i++ ){
+		delete sessions[i];
+	}
+	return 0;
+}
@@ -0,0 +1,81 @@
+/*
+ * Benchmark of MSRP file transfers.
+ *
+ * Sends a 64 MB file over the loopback interface from an MSRPSender
+ * to an MSRPReceiver, with chunks of 1 KB (the size used before)
+ * up to 1 MB, and prints the throughput in MB/s.
+ */
+
+#include"../source/subsystem_media/msrp/MSRPMessage.h"
+
+#include<libmutil/Thread.h>
+#include<libmutil/mtime.h>
+
+#include<stdio.h>
+#include<stdlib.h>
+
+#include<vector>
+
+#define BENCH_FILE_SIZE (64*1024*1024)
+#define BENCH_PORT 33330
+
+static const char inName[] = "bench_msrp_throughput.in";
+static const char outName[] = "bench_msrp_throughput.out";
+
+static bool writeFile(){
+	std::vector<char> buf(1024*1024);
+	FILE *f = fopen(inName, "wb");
+
+	if( f == NULL ){
+		return false;
+	}
+	srand(1);
+	for( int n = 0; n < BENCH_FILE_SIZE; n += buf.size() ){
+		for( size_t i = 0; i < buf.size(); i++ ){
+			buf[i] = rand() & 0xff;
+		}
+		fwrite(&buf[0], 1, buf.size(), f);
+	}
+	fclose(f);
+	return true;
+}
+
+int main( int argc, char *argv[] ){
+	const int32_t chunkSizes[] = { 1024, 16*1024, 64*1024, 256*1024, 1024*1024 };
+	int ret = 0;
+
+	if( !writeFile() ){
+		fprintf(stderr, "Could not write %s\n", inName);
+		return 1;
+	}
+
+	for( size_t i = 0; i < sizeof(chunkSizes) / sizeof(chunkSizes[0]); i++ ){
+		MRef<MSRPReceiver*> receiver =
+			new MSRPReceiver(outName, BENCH_FILE_SIZE, BENCH_PORT + i);
+		MRef<MSRPSender*> sender =
+			new MSRPSender("127.0.0.1", BENCH_PORT + i, inName, NULL, "bench");
+		sender->setChunkSize(chunkSizes[i]);
+
+		uint64_t start = mtime();
+		Thread receiverThread(*receiver);
+		sender->run();
+		receiverThread.join();
+		uint64_t ms = mtime() - start;
+
+		if( receiver->getBytesReceived() != BENCH_FILE_SIZE ){
+			fprintf(stderr, "chunk %7d: received %lld of %d bytes\n",
+				chunkSizes[i],
+				(long long)receiver->getBytesReceived(),
+				BENCH_FILE_SIZE);
+			ret = 1;
+			continue;
+		}
+
+		printf("chunk %7d: %8.1f MB/s\n", chunkSizes[i],
+			(BENCH_FILE_SIZE / (1024.0 * 1024.0)) * 1000.0 / (ms ? ms : 1));
+	}
+
+	remove(inName);
+	remove(outName);
+	return ret;
+}
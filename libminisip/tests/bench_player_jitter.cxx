@@ -0,0 +1,184 @@
+/*
+ * Benchmark of the timing of the sound player thread.
+ *
+ * Plays eight sources, fed by one thread each as RTP packets would
+ * be, to a sound device consuming 20 ms of audio per period. Prints
+ * the time the player thread took to produce each period, and how
+ * late it delivered them: an underrun is a period delivered more
+ * than 5 ms after the device needed it.
+ */
+
+#include<config.h>
+
+#include<libminisip/media/soundcard/SoundIO.h>
+#include<libminisip/media/soundcard/SoundDevice.h>
+#include<libminisip/media/soundcard/SoundSource.h>
+#include<libmutil/Thread.h>
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<sys/time.h>
+#include<unistd.h>
+
+#include<algorithm>
+#include<vector>
+
+#define BENCH_SOURCES 8
+#define BENCH_SECONDS 10
+#define BENCH_PERIOD_US 20000
+#define BENCH_UNDERRUN_US 5000
+
+static uint64_t usec(){
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static volatile bool running = true;
+
+/* Consumes a period every BENCH_PERIOD_US, like a sound card */
+class BenchDevice : public SoundDevice{
+	public:
+		BenchDevice(): SoundDevice( "bench" ), next( 0 ), lastReturn( 0 ){
+			setSleepTime( 0 );
+		}
+
+		virtual int openRecord( int32_t, int, int ){ return 0; }
+		virtual int closeRecord(){ return 0; }
+
+		virtual int openPlayback( int32_t rate, int nChannels, int format ){
+			samplingRate = rate;
+			nChannelsPlay = nChannels;
+			setFormat( format );
+			openedPlayback = true;
+			return 0;
+		}
+
+		virtual int closePlayback(){
+			openedPlayback = false;
+			return 0;
+		}
+
+		virtual int readFromDevice( byte_t *, uint32_t nSamples ){
+			return nSamples;
+		}
+		virtual int readError( int, byte_t *, uint32_t ){ return -1; }
+		virtual int writeError( int, byte_t *, uint32_t ){ return -1; }
+		virtual void sync(){}
+
+		virtual int writeToDevice( byte_t *, uint32_t nSamples ){
+			uint64_t now = usec();
+
+			if( next == 0 ){
+				next = now;
+			}
+			if( lastReturn != 0 && running ){
+				busy.push_back( now - lastReturn );
+			}
+			if( now > next ){
+				/* The device ran dry, it restarts now */
+				if( running ){
+					lateness.push_back( now - next );
+				}
+				next = now;
+			}
+			else{
+				if( running ){
+					lateness.push_back( 0 );
+				}
+				while( ( now = usec() ) < next ){
+					Thread::msleep( (int32_t)( ( next - now ) / 1000 ) );
+				}
+			}
+			next += BENCH_PERIOD_US;
+			lastReturn = usec();
+			return nSamples;
+		}
+
+		std::vector<uint64_t> lateness;
+		std::vector<uint64_t> busy;
+
+	private:
+		uint64_t next;
+		uint64_t lastReturn;
+};
+
+class Feeder : public Runnable{
+	public:
+		Feeder( MRef<SoundSource *> s ): source( s ){}
+
+		virtual void run(){
+			short frame[SOUND_CARD_FREQ * 20 / 1000];
+
+			for( size_t i = 0; i < sizeof( frame ) / sizeof( short ); i++ ){
+				frame[i] = (short)( rand() & 0x0fff );
+			}
+			while( running ){
+				source->pushSound( frame, sizeof( frame ) / sizeof( short ),
+						   0, SOUND_CARD_FREQ, false );
+				Thread::msleep( 20 );
+			}
+		}
+
+	private:
+		MRef<SoundSource *> source;
+};
+
+static void printStats( const char *name, std::vector<uint64_t> v ){
+	uint64_t total = 0;
+
+	std::sort( v.begin(), v.end() );
+	for( size_t i = 0; i < v.size(); i++ ){
+		total += v[i];
+	}
+	printf( "%s mean %7.1f us, p99 %6llu us, max %6llu us\n", name,
+		(double)total / v.size(),
+		(unsigned long long)v[ v.size() * 99 / 100 ],
+		(unsigned long long)v.back() );
+}
+
+int main( int argc, char *argv[] ){
+	MRef<BenchDevice *> device = new BenchDevice();
+	MRef<SoundIO *> soundIo = new SoundIO( *device, *device, "simple",
+					       2, SOUND_CARD_FREQ );
+	std::vector<MRef<Thread *> > feeders;
+
+	for( int i = 0; i < BENCH_SOURCES; i++ ){
+		MRef<SoundSource *> source = new BasicSoundSource( i + 1, "bench",
+				NULL, 0, SOUND_CARD_FREQ, 20, 2 );
+		soundIo->registerSource( source );
+		feeders.push_back( new Thread( new Feeder( source ) ) );
+	}
+
+	Thread::msleep( BENCH_SECONDS * 1000 );
+	running = false;
+	for( size_t i = 0; i < feeders.size(); i++ ){
+		feeders[i]->join();
+	}
+
+	/* The player thread keeps running, but records no more periods */
+	std::vector<uint64_t> lateness = device->lateness;
+	std::vector<uint64_t> busy = device->busy;
+
+	if( lateness.empty() || busy.empty() ){
+		fprintf( stderr, "No period played\n" );
+		return 1;
+	}
+
+	size_t underruns = 0;
+	for( size_t i = 0; i < lateness.size(); i++ ){
+		if( lateness[i] > BENCH_UNDERRUN_US ){
+			underruns++;
+		}
+	}
+
+	printf( "%u periods, %u underruns\n", (unsigned)lateness.size(),
+		(unsigned)underruns );
+	printStats( "player time per period:", busy );
+	printStats( "late by:               ", lateness );
+
+	/* The player thread is still running, skip the static destructors */
+	fflush( stdout );
+	_exit( 0 );
+}
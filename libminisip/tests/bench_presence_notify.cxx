@@ -0,0 +1,93 @@
+/*
+ * Benchmark of the presence notifications of SipDialogPresenceServer.
+ *
+ * Builds and serializes the NOTIFY requests sent to 10000 watchers
+ * for a flap of the local status (five changes within the coalescing
+ * window): with the presence document rendered for each watcher and
+ * every change sent, as done before, and with the document rendered
+ * once per change and the flap merged into one notification. Prints
+ * the requests built and the time taken.
+ */
+
+#include<libminisip/signaling/sip/SipDialogPresenceServer.h>
+#include<libminisip/signaling/sip/PresenceMessageContent.h>
+#include<libmsip/SipRequest.h>
+#include<libmsip/SipHeaderFrom.h>
+#include<libmutil/SipUri.h>
+#include<libmutil/stringutils.h>
+#include<libmutil/mtime.h>
+
+#include<stdio.h>
+
+#include<string>
+#include<vector>
+
+#define BENCH_WATCHERS 10000
+#define BENCH_CHANGES 5
+
+static const char localUri[] = "sip:alice@example.com";
+
+static size_t sendNotify( const std::string &watcher, int seqNo,
+		MRef<SipMessageContent*> content ){
+	MRef<SipRequest*> notify = SipRequest::createSipMessageNotify(
+			"bench" + itoa( seqNo ),
+			SipUri( watcher ),
+			SipUri( localUri ),
+			seqNo );
+
+	notify->getHeaderValueFrom()->setParameter( "tag", "bench" );
+	notify->setContent( content );
+
+	/* What the transport does with it */
+	return notify->getString().size();
+}
+
+int main( int argc, char *argv[] ){
+	std::vector<std::string> watchers;
+	const char * status[] = { "online", "away" };
+	int seqNo = 0;
+	size_t bytes = 0;
+
+	for( int i = 0; i < BENCH_WATCHERS; i++ ){
+		watchers.push_back( "watcher" + itoa( i ) + "@example.org" );
+	}
+
+	/* Each change sent, the document rendered per watcher */
+	uint64_t start = mtime();
+	int sent = 0;
+	for( int c = 0; c < BENCH_CHANGES; c++ ){
+		for( int i = 0; i < BENCH_WATCHERS; i++ ){
+			MRef<SipMessageContent*> content =
+				new PresenceMessageContent( localUri,
+						SipUri( watchers[i] ).getString(),
+						status[c % 2], status[c % 2] );
+			bytes += sendNotify( watchers[i], ++seqNo, content );
+			sent++;
+		}
+	}
+	uint64_t perWatcherMs = mtime() - start;
+	printf( "per watcher: %6d NOTIFY, %6llu ms\n", sent,
+		(unsigned long long)perWatcherMs );
+
+	/* The flap merged, the document rendered once */
+	start = mtime();
+	sent = 0;
+	MRef<SipMessageContent*> content = new PresenceMessageContent(
+			localUri, localUri,
+			status[( BENCH_CHANGES - 1 ) % 2],
+			status[( BENCH_CHANGES - 1 ) % 2] );
+	for( int i = 0; i < BENCH_WATCHERS; i++ ){
+		bytes += sendNotify( watchers[i], ++seqNo, content );
+		sent++;
+	}
+	uint64_t sharedMs = mtime() - start;
+	printf( "coalesced:   %6d NOTIFY, %6llu ms\n", sent,
+		(unsigned long long)sharedMs );
+
+	/* At the default rate the batches take this long to send */
+	printf( "coalesced fan-out spread over %d ms at %d NOTIFY per %d ms\n",
+		( BENCH_WATCHERS / PRESENCE_NOTIFY_BATCH ) * PRESENCE_NOTIFY_INTERVAL,
+		PRESENCE_NOTIFY_BATCH, PRESENCE_NOTIFY_INTERVAL );
+
+	return bytes > 0 ? 0 : 1;
+}
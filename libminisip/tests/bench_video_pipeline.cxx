@@ -0,0 +1,221 @@
+/*
+ * Headless load test of the video send path.
+ *
+ * Runs N parallel streams, each made of a "file" grabber producing a
+ * test pattern, an AVEncoder and an SRTP protecting sender, and prints
+ * the achieved frames/s, bitrate and CPU usage per stream, and the
+ * heap allocations per frame of the whole process while streaming.
+ *
+ * Usage: bench_video_pipeline [streams] [WIDTHxHEIGHT] [fps] [seconds]
+ */
+
+#include<libminisip/media/video/grabber/Grabber.h>
+#include<libminisip/media/video/codec/AVCoder.h>
+#include<libminisip/media/video/codec/VideoEncoderCallback.h>
+#include<libminisip/media/rtp/SRtpPacket.h>
+#include<libminisip/media/rtp/CryptoContext.h>
+#include<libmikey/MikeyPayloadSP.h>
+#include<libmutil/mtime.h>
+#include<libmutil/stringutils.h>
+
+#include<errno.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<sys/time.h>
+#include<sys/resource.h>
+#include<vector>
+
+using namespace std;
+
+#ifdef __GLIBC__
+/* Counts every heap allocation, those made inside the codec library
+ * included, by wrapping the glibc allocator */
+static volatile long nMallocs = 0;
+
+extern "C" {
+void *__libc_malloc( size_t size );
+void *__libc_calloc( size_t n, size_t size );
+void *__libc_realloc( void *p, size_t size );
+void *__libc_memalign( size_t alignment, size_t size );
+
+void *malloc( size_t size ){
+	__sync_fetch_and_add( &nMallocs, 1 );
+	return __libc_malloc( size );
+}
+
+void *calloc( size_t n, size_t size ){
+	__sync_fetch_and_add( &nMallocs, 1 );
+	return __libc_calloc( n, size );
+}
+
+void *realloc( void *p, size_t size ){
+	__sync_fetch_and_add( &nMallocs, 1 );
+	return __libc_realloc( p, size );
+}
+
+int posix_memalign( void **p, size_t alignment, size_t size ){
+	__sync_fetch_and_add( &nMallocs, 1 );
+	*p = __libc_memalign( alignment, size );
+	return *p ? 0 : ENOMEM;
+}
+}
+
+static long mallocCount(){
+	return __sync_fetch_and_add( &nMallocs, 0 );
+}
+#else
+static long mallocCount(){
+	return -1;
+}
+#endif
+
+class SrtpBenchSender : public VideoEncoderCallback{
+	public:
+		SrtpBenchSender( uint32_t ssrc ):ssrc(ssrc),seqNo(0),nPackets(0),nBytes(0){
+			unsigned char key[16];
+			unsigned char salt[14];
+			for( int i = 0; i < 16; i++ ) key[i] = (unsigned char)i;
+			for( int i = 0; i < 14; i++ ) salt[i] = (unsigned char)( 0xA0 + i );
+
+			cryptoContext = new CryptoContext( ssrc, 0, 0, 0,
+					MIKEY_SRTP_EALG_AESCM, MIKEY_SRTP_AALG_SHA1HMAC,
+					key, 16, salt, 14, 16, 20, 14, 1, 1, 10 );
+			cryptoContext->derive_srtp_keys( 0 );
+		}
+
+		virtual void sendVideoData( byte_t * data, uint32_t length, uint32_t ts, bool marker ){
+			SRtpPacket packet( data, length, seqNo++, ts, ssrc );
+			packet.getHeader().setPayloadType( 99 );
+			packet.getHeader().setMarker( marker );
+			packet.protect( cryptoContext );
+			nPackets++;
+			nBytes += packet.size();
+		}
+
+		uint32_t ssrc;
+		uint16_t seqNo;
+		uint64_t nPackets;
+		uint64_t nBytes;
+		MRef<CryptoContext *> cryptoContext;
+};
+
+/* Counts the frames on their way from the grabber to the encoder */
+class CountingHandler : public ImageHandler{
+	public:
+		CountingHandler( MRef<AVEncoder *> encoder ):encoder(encoder),nFrames(0){}
+
+		virtual bool handlesChroma( uint32_t chroma ){ return encoder->handlesChroma( chroma ); }
+		virtual void init( uint32_t width, uint32_t height ){ encoder->init( width, height ); }
+		virtual void handle( MImage * image ){
+			encoder->handle( image );
+			nFrames++;
+		}
+		virtual MImage * provideImage(){ return NULL; }
+		virtual void releaseImage( MImage * ){}
+		virtual bool providesImage(){ return false; }
+		virtual void resize( int, int ){}
+
+		MRef<AVEncoder *> encoder;
+		volatile uint64_t nFrames;
+};
+
+static double cpuSeconds(){
+	struct rusage usage;
+	getrusage( RUSAGE_SELF, &usage );
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+		( usage.ru_utime.tv_usec + usage.ru_stime.tv_usec ) / 1e6;
+}
+
+int main( int argc, char *argv[] ){
+	int nStreams = argc > 1 ? atoi( argv[1] ) : 4;
+	string size = argc > 2 ? argv[2] : "1280x720";
+	string fps = argc > 3 ? argv[3] : "30";
+	int seconds = argc > 4 ? atoi( argv[4] ) : 10;
+	size_t x = size.find( 'x' );
+	uint32_t width = atoi( size.substr( 0, x ).c_str() );
+	uint32_t height = atoi( size.substr( x + 1 ).c_str() );
+
+	vector< MRef<Grabber *> > grabbers;
+	vector< SrtpBenchSender * > senders;
+	vector< CountingHandler * > counters;
+	int i;
+
+	for( i = 0; i < nStreams; i++ ){
+		MRef<Grabber *> grabber = GrabberRegistry::getInstance()->createGrabber(
+				"file:pattern," + size + "," + fps );
+		if( !grabber ){
+			fprintf( stderr, "Could not create the file grabber\n" );
+			return 1;
+		}
+
+		MRef<AVEncoder *> encoder = new AVEncoder();
+		SrtpBenchSender * sender = new SrtpBenchSender( 0x1000 + i );
+		CountingHandler * counter = new CountingHandler( encoder );
+
+		encoder->setWidth( width );
+		encoder->setHeight( height );
+		encoder->setCallback( sender );
+		encoder->init( width, height );
+
+		grabber->setHandler( counter );
+		grabber->open();
+		grabber->setImageChroma( M_CHROMA_I420 );
+
+		grabbers.push_back( grabber );
+		senders.push_back( sender );
+		counters.push_back( counter );
+	}
+
+	double cpuStart = cpuSeconds();
+	uint64_t start = mtime();
+
+	for( i = 0; i < nStreams; i++ ){
+		grabbers[i]->start();
+	}
+
+	/* Allocations counted once the streams run, leaving out the
+	 * setup of the grabber threads and of the first frames */
+	msleep( 1000 );
+	long mallocStart = mallocCount();
+	uint64_t framesStart = 0;
+	for( i = 0; i < nStreams; i++ ){
+		framesStart += counters[i]->nFrames;
+	}
+
+	msleep( seconds * 1000 );
+
+	long mallocs = mallocCount() - mallocStart;
+	uint64_t frames = 0;
+	for( i = 0; i < nStreams; i++ ){
+		frames += counters[i]->nFrames;
+	}
+	frames -= framesStart;
+
+	for( i = 0; i < nStreams; i++ ){
+		grabbers[i]->stop();
+	}
+
+	double wall = ( mtime() - start ) / 1000.0;
+	double cpu = cpuSeconds() - cpuStart;
+
+	printf( "%d streams of %s@%s for %.1fs\n", nStreams, size.c_str(), fps.c_str(), wall );
+	for( i = 0; i < nStreams; i++ ){
+		printf( "stream %2d: %7.1f frames/s %8.1f packets/s %8.2f Mbit/s\n", i,
+				counters[i]->nFrames / wall,
+				senders[i]->nPackets / wall,
+				senders[i]->nBytes * 8 / wall / 1e6 );
+	}
+	printf( "CPU: %.1f%% total, %.1f%% per stream\n",
+			cpu / wall * 100, cpu / wall * 100 / nStreams );
+	if( mallocStart >= 0 && frames > 0 ){
+		printf( "heap allocations: %ld in %llu frames, %.2f per frame\n",
+				mallocs, (unsigned long long)frames,
+				(double)mallocs / frames );
+	}
+
+	for( i = 0; i < nStreams; i++ ){
+		grabbers[i]->close();
+	}
+
+	return 0;
+}
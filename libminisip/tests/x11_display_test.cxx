@@ -0,0 +1,110 @@
+/*
+ * Checks that frames written into the images provided by X11Display
+ * reach the window, both through MIT-SHM and through the XPutImage
+ * fallback. Needs an X server, see x11_display_test.sh.
+ */
+
+#include<config.h>
+
+#include"X11Display.h"
+
+#include<stdio.h>
+#include<stdlib.h>
+
+#define TEST_WIDTH 320
+#define TEST_HEIGHT 240
+#define TEST_FRAMES 50
+
+class TestDisplay : public X11Display{
+	public:
+		TestDisplay():X11Display( TEST_WIDTH, TEST_HEIGHT ){}
+
+		/* Returns the number of frames whose first pixel did
+		 * not make it to the window */
+		int runFrames( bool shm, bool & usedShm ){
+			MImage * images[2];
+			int errors = 0;
+			int i;
+
+			createWindow();
+			if( !shm ){
+				useShm = false;
+			}
+
+			for( i = 0; i < 2; i++ ){
+				images[i] = allocateImage();
+			}
+			usedShm = ((X11ImageData *)images[0]->privateData)->shared;
+
+			for( i = 0; i < TEST_FRAMES; i++ ){
+				MImage * image = images[ i % 2 ];
+				uint32_t color = ( i * 0x050301 ) & 0xFFFFFF;
+				uint32_t y;
+
+				/* Draw the frame the way a decoder would,
+				 * straight into the provided image */
+				for( y = 0; y < image->height; y++ ){
+					uint8_t * line = image->data[0] + y * image->linesize[0];
+					if( image->chroma == M_CHROMA_RV32 ){
+						uint32_t * pixel = (uint32_t *)line;
+						for( uint32_t x = 0; x < image->width; x++ ){
+							pixel[x] = color;
+						}
+					}
+					else{
+						uint16_t * pixel = (uint16_t *)line;
+						for( uint32_t x = 0; x < image->width; x++ ){
+							pixel[x] = 0xF81F;
+						}
+					}
+				}
+
+				displayImage( image );
+
+				if( image->chroma == M_CHROMA_RV32 ){
+					XImage * shown = XGetImage( display, videoWindow,
+							0, 0, 1, 1, AllPlanes, ZPixmap );
+					if( !shown || ( XGetPixel( shown, 0, 0 ) & 0xFFFFFF ) != color ){
+						errors++;
+					}
+					if( shown ){
+						XDestroyImage( shown );
+					}
+				}
+			}
+
+			for( i = 0; i < 2; i++ ){
+				deallocateImage( images[i] );
+			}
+			destroyWindow();
+
+			return errors;
+		}
+};
+
+int main( int argc, char *argv[] ){
+	bool usedShm;
+	int errors;
+
+	if( !getenv( "DISPLAY" ) ){
+		fprintf( stderr, "DISPLAY is not set, skipping\n" );
+		return 77;
+	}
+
+	TestDisplay shmDisplay;
+	errors = shmDisplay.runFrames( true, usedShm );
+	printf( "%s: %d of %d frames wrong\n",
+			usedShm ? "MIT-SHM" : "XPutImage (no MIT-SHM)", errors, TEST_FRAMES );
+	if( errors ){
+		return 1;
+	}
+
+	TestDisplay plainDisplay;
+	errors = plainDisplay.runFrames( false, usedShm );
+	printf( "XPutImage: %d of %d frames wrong\n", errors, TEST_FRAMES );
+	if( errors || usedShm ){
+		return 1;
+	}
+
+	return 0;
+}
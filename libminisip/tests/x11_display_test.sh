@@ -0,0 +1,30 @@
+#!/bin/sh
+#
+# Runs x11_display_test on a private Xvfb server, so that the X11
+# display can be tested on headless machines. Skipped when Xvfb is
+# not installed.
+#
+
+XVFB=`which Xvfb 2>/dev/null`
+if test -z "${XVFB}"; then
+	echo "Xvfb not found, skipping"
+	exit 77
+fi
+
+DISPLAY_FILE=`mktemp`
+"${XVFB}" -displayfd 3 -screen 0 640x480x24 -nolisten tcp 3>"${DISPLAY_FILE}" >/dev/null 2>&1 &
+XVFB_PID=$!
+trap 'kill ${XVFB_PID} 2>/dev/null; rm -f "${DISPLAY_FILE}"' 0
+
+# Xvfb writes the display number once it accepts connections
+i=0
+while test ! -s "${DISPLAY_FILE}"; do
+	i=`expr $i + 1`
+	if test $i -gt 50; then
+		echo "Xvfb did not start"
+		exit 1
+	fi
+	sleep 0.1
+done
+
+DISPLAY=:`cat "${DISPLAY_FILE}"` ./x11_display_test
@@ -75,6 +75,21 @@ class LIBMNETUTIL_API Socket : public MObject {
 
 		virtual MRef<IPAddress *> getLocalAddress() const;
 
+		/**
+		 * Puts the descriptor in non-blocking mode, or back in
+		 * blocking mode.
+		 * @return false if the mode could not be changed
+		 */
+		virtual bool setNonBlocking( bool nonBlocking = true );
+
+		/**
+		 * True while the socket can only make progress once its
+		 * descriptor is writable, for example a TLS handshake
+		 * waiting for the send buffer to drain. SocketServer then
+		 * also calls inputReady when the socket becomes writable.
+		 */
+		virtual bool wantsWrite();
+
 //#ifdef _WIN32_WCE
 /* Undef this ... it causes a link problem ... */
 //#undef close
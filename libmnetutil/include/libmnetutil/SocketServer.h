@@ -27,10 +27,13 @@
 
 #include<libmutil/MemObject.h>
 #include<libmutil/Mutex.h>
+#include<libmutil/CondVar.h>
 #include<libmutil/Thread.h>
 #include<libmnetutil/Socket.h>
 
+#include<list>
 #include<map>
+#include<set>
 
 #ifdef WIN32
 # include <winsock2.h>
@@ -74,28 +77,67 @@ class LIBMNETUTIL_API SocketServer : public Runnable {
 		 */
 		void join();
 
+		/**
+		 * Runs the input ready handlers on a pool of n threads
+		 * instead of the thread running "run", so that CPU heavy
+		 * input processing such as a TLS handshake does not hold
+		 * up the other sockets. A socket is not watched while its
+		 * handler is running, so the input of one socket is still
+		 * handled in order. Zero, the default, calls the handlers
+		 * from "run". Takes effect the next time the server is
+		 * started.
+		 */
+		void setWorkerThreads( int n );
+
 		void addSocket( MRef<Socket*> socket, MRef<InputReadyHandler*> handler );
 		void removeSocket( MRef<Socket*> socket );
 
+		/**
+		 * Returns a connected stream socket to the peer, or NULL.
+		 * @param type	Socket type (MSOCKET_TYPE_TCP, _TLS...)
+		 *		the socket must have, zero matches any.
+		 */
 		MRef<Socket*> findStreamSocketPeer( const IPAddress &addr,
-						    uint16_t port );
+						    uint16_t port,
+						    int32_t type = 0 );
 
 	protected:
 		void run();
 		void signal();
-		int buildFdSet( fd_set *set, int pipeFd );
+		int buildFdSet( fd_set *readSet, fd_set *writeSet, int pipeFd );
 
 	private:
-		void createSignalPipe();
 		typedef std::map< MRef<Socket*>, MRef<InputReadyHandler*> > Sockets;
+		typedef std::pair< MRef<Socket*>, MRef<InputReadyHandler*> > Job;
+
+		void createSignalPipe();
+		void readSignal();
+		void runWorker();
+
+		/**
+		 * Waits at most five seconds for input, or for the
+		 * sockets wanting to write to become writable, and
+		 * returns the ready sockets.
+		 */
+		void waitReady( std::list<Job> &ready );
+
 		Mutex csMutex;
 		MRef<Thread *> thread;
 		Sockets sockets;
 
+		int nWorkers;
+		std::list< MRef<Thread *> > workers;
+		std::list<Job> jobs;		///Sockets ready, waiting for a worker
+		std::set< MRef<Socket*> > busy;	///Sockets queued or being handled
+		CondVar jobReady;
+		bool stopWorkers;
+
 		int fdSignal;		///Socket pair used to wake thread running run()
 		int fdSignalInternal;	///from its select. This is typically used to
 					///to tell the thread to stop.
 
 		bool doStop;
+
+		friend class SocketServerWorker;
 };
 #endif
@@ -40,6 +40,23 @@ class LIBMNETUTIL_API StreamSocket : public Socket {
 		virtual int32_t write(const void *buf, int32_t count);
 		virtual int32_t read(void *buf, int32_t count);
 
+		/**
+		 * Writes all the n buffers, in order. The default
+		 * implementation calls write for each of them, sockets
+		 * that can do it write them with one system call.
+		 * @return the number of bytes written, or -1 on error
+		 */
+		virtual int32_t writev(const void * const *bufs, const int32_t *lengths, int32_t n);
+
+		/**
+		 * Writes count bytes of the open file fileFd, starting at
+		 * offset. Sockets sending plain data pass them from the
+		 * file to the socket in the kernel (sendfile), the default
+		 * implementation reads the file and calls write.
+		 * @return the number of bytes written, or -1 on error
+		 */
+		virtual int64_t sendFile(int32_t fileFd, int64_t offset, int64_t count);
+
 		// Buffer of the received data;
 		std::string received;
 
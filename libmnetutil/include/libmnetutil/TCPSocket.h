@@ -45,6 +45,9 @@ class LIBMNETUTIL_API TCPSocket : public StreamSocket {
 
 		void useNoDelay(bool noDelay);
 
+		virtual int32_t writev(const void * const *bufs, const int32_t *lengths, int32_t n);
+		virtual int64_t sendFile(int32_t fileFd, int64_t offset, int64_t count);
+
 		friend std::ostream& operator<<(std::ostream&, TCPSocket&);
 
 	private:
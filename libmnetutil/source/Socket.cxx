@@ -33,6 +33,7 @@
 # define USE_WIN32_API
 #else
 #include<unistd.h>
+#include<fcntl.h>
 #include <sys/socket.h>
 #endif
 
@@ -92,6 +93,27 @@ MRef<IPAddress *> Socket::getLocalAddress() const{
 
 
 
+bool Socket::setNonBlocking( bool nonBlocking ){
+#ifdef USE_WIN32_API
+	u_long arg = nonBlocking ? 1 : 0;
+	return ioctlsocket( fd, FIONBIO, &arg ) == 0;
+#else
+	int flags = fcntl( fd, F_GETFL, 0 );
+	if( flags < 0 )
+		return false;
+
+	if( nonBlocking )
+		flags |= O_NONBLOCK;
+	else
+		flags &= ~O_NONBLOCK;
+	return fcntl( fd, F_SETFL, flags ) == 0;
+#endif
+}
+
+bool Socket::wantsWrite(){
+	return false;
+}
+
 void Socket::close( void ){
 //#if defined WIN32 && not defined __CYGWIN__
 #ifdef USE_WIN32_API
@@ -29,12 +29,14 @@
 #include<libmnetutil/IPAddress.h>
 
 #include<algorithm> /* find_if */
+#include<vector>
 
 #ifdef WIN32
 # include<io.h>
 # include<fcntl.h>
 typedef int socklen_t;
 #else
+#include<poll.h>
 #define closesocket close
 #endif
 
@@ -51,8 +53,9 @@ using namespace std;
 class EqualAddrPort: public std::unary_function< std::pair<const MRef<Socket*>, MRef<InputReadyHandler*> >&, bool>{
 	public:
 		EqualAddrPort( const IPAddress &theAddress,
-			       uint16_t thePort )
-				: address( theAddress ), port( thePort ){}
+			       uint16_t thePort, int32_t theType )
+				: address( theAddress ), port( thePort ),
+				  type( theType ){}
 
 		bool operator() ( pair<const MRef<Socket*>, MRef<InputReadyHandler*> > &pair  ) {
 			MRef<Socket *> sock = pair.first;
@@ -65,11 +68,15 @@ class EqualAddrPort: public std::unary_function< std::pair<const MRef<Socket*>,
 			if( !ssock )
 				return false;
 
+			if( type && ssock->getType() != type )
+				return false;
+
 			return ssock->matchesPeer( address, port );
 		}
 	private:
 		const IPAddress &address;
 		uint16_t port;
+		int32_t type;
 };
 
 
@@ -78,7 +85,26 @@ InputReadyHandler::~InputReadyHandler()
 }
 
 
-SocketServer::SocketServer(): fdSignal( -1 ), doStop( false )
+class SocketServerWorker: public Runnable{
+	public:
+		SocketServerWorker( SocketServer *theServer ): server( theServer ){}
+
+		void run(){
+#ifdef DEBUG_OUTPUT
+			setThreadName("SocketServer::worker");
+#endif
+			server->runWorker();
+		}
+
+		std::string getMemObjectType() const { return "SocketServerWorker"; }
+
+	private:
+		SocketServer *server;
+};
+
+
+SocketServer::SocketServer(): nWorkers( 0 ), stopWorkers( false ),
+		fdSignal( -1 ), doStop( false )
 {
 }
 
@@ -97,6 +123,10 @@ void SocketServer::start()
 		createSignalPipe();
 
 	thread = new Thread( this );
+
+	for( int n = 0; n < nWorkers; n++ ){
+		workers.push_back( new Thread( new SocketServerWorker( this ) ) );
+	}
 }
 
 void SocketServer::stop()
@@ -107,19 +137,46 @@ void SocketServer::stop()
 		return;
 
 	doStop = true;
+	stopWorkers = true;
+	jobReady.broadcast();
 	signal();
 }
 
 void SocketServer::join()
 {
-	CriticalSection cs( csMutex );
+	MRef<Thread *> t;
+	list< MRef<Thread *> > w;
+
+	/* The threads lock csMutex, it must not be held while
+	 * waiting for them */
+	csMutex.lock();
+	t = thread;
+	w = workers;
+	csMutex.unlock();
 
-	if( thread.isNull() ){
+	if( t.isNull() ){
 		return;
 	}
 
-	thread->join();
+	t->join();
+
+	list< MRef<Thread *> >::iterator i;
+	for( i = w.begin(); i != w.end(); i++ ){
+		(*i)->join();
+	}
+
+	CriticalSection cs( csMutex );
 	thread = NULL;
+	workers.clear();
+	jobs.clear();
+	busy.clear();
+	stopWorkers = false;
+}
+
+void SocketServer::setWorkerThreads( int n )
+{
+	CriticalSection cs( csMutex );
+	nWorkers = n;
 }
 
 void SocketServer::addSocket( MRef<Socket*> socket,
@@ -143,11 +200,12 @@ void SocketServer::removeSocket( MRef<Socket*> socket )
 }
 
 MRef<Socket*> SocketServer::findStreamSocketPeer( const IPAddress &addr,
-						  uint16_t port )
+						  uint16_t port,
+						  int32_t type )
 {
 	CriticalSection cs( csMutex );
 
-	EqualAddrPort pred( addr, port );
+	EqualAddrPort pred( addr, port, type );
 
 	Sockets::iterator iter =
 		find_if( sockets.begin(), sockets.end(), pred );
@@ -176,13 +234,14 @@ void SocketServer::signal()
 	}
 }
 
-int SocketServer::buildFdSet( fd_set *set, int pipeFd )
+int SocketServer::buildFdSet( fd_set *readSet, fd_set *writeSet, int pipeFd )
 {
 	SOCKET maxFd = -1;
 	Sockets::const_iterator i;
 
-	FD_ZERO( set );
-	FD_SET( (SOCKET)pipeFd, set );
+	FD_ZERO( readSet );
+	FD_ZERO( writeSet );
+	FD_SET( (SOCKET)pipeFd, readSet );
 
 	maxFd = pipeFd;
 
@@ -190,7 +249,12 @@ int SocketServer::buildFdSet( fd_set *set, int pipeFd )
 		MRef<Socket*> socket = i->first;
 		SOCKET fd = socket->getFd();
 
-		FD_SET( fd, set );
+		if( (int32_t)fd < 0 || busy.find( socket ) != busy.end() )
+			continue;
+
+		FD_SET( fd, readSet );
+		if( socket->wantsWrite() )
+			FD_SET( fd, writeSet );
 		if( fd > maxFd )
 			maxFd = fd;
 	}
@@ -286,71 +350,192 @@ void SocketServer::closeSockets(){
 	}
 }
 
-void SocketServer::run()
+void SocketServer::readSignal()
 {
-#ifdef DEBUG_OUTPUT
-	setThreadName("SocketServer::run");
+	char buf[255];
+
+#ifdef WIN32
+	if( recv( fdSignalInternal, buf, sizeof(buf), 0 ) < 0){
+#else
+	if( read( fdSignalInternal, buf, sizeof(buf) ) < 0){
 #endif
+		cerr << "Read failed" << endl;
+		throw NetworkException( errno );
+	}
+}
+
+#ifndef WIN32
+// poll has no limit on the descriptor numbers, unlike select
+// and FD_SETSIZE
+void SocketServer::waitReady( list<Job> &ready )
+{
+	vector<struct pollfd> fds;
+	vector<Job> polled;
+	struct pollfd pfd;
+	Sockets::const_iterator i;
+
+	pfd.fd = fdSignalInternal;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	fds.push_back( pfd );
+
+	csMutex.lock();
+	for( i = sockets.begin(); i != sockets.end(); i++ ){
+		MRef<Socket*> socket = i->first;
+		int32_t fd = socket->getFd();
+
+		if( fd < 0 || i->second.isNull() ||
+		    busy.find( socket ) != busy.end() )
+			continue;
+
+		pfd.fd = fd;
+		pfd.events = POLLIN;
+		if( socket->wantsWrite() )
+			pfd.events |= POLLOUT;
+		fds.push_back( pfd );
+		polled.push_back( Job( socket, i->second ) );
+	}
+	csMutex.unlock();
+
+	int avail;
+	do{
+		avail = poll( &fds[0], (nfds_t)fds.size(), 5000 );
+		if (avail<0){
+			Thread::msleep(500);
+		}
+	} while( avail < 0 );
+
+	if( fds[0].revents & POLLIN ){
+		readSignal();
+	}
+
+	for( size_t n = 1; n < fds.size(); n++ ){
+		if( fds[n].revents ){
+			ready.push_back( polled[n - 1] );
+		}
+	}
+}
+#else
+void SocketServer::waitReady( list<Job> &ready )
+{
 	struct timeval timeout;
 	fd_set tmpl;
+	fd_set wtmpl;
 	fd_set set;
+	fd_set wset;
 	int maxFd = -1;
 	Sockets::const_iterator i;
 
-	if (fdSignal < 0)
-		createSignalPipe();
-
-	while (!doStop){
-		maxFd = buildFdSet( &tmpl, fdSignalInternal );
+	csMutex.lock();
+	maxFd = buildFdSet( &tmpl, &wtmpl, fdSignalInternal );
+	csMutex.unlock();
 
-		int avail;
-		do{
-			memcpy( &set, &tmpl, sizeof( set ) );
+	int avail;
+	do{
+		memcpy( &set, &tmpl, sizeof( set ) );
+		memcpy( &wset, &wtmpl, sizeof( wset ) );
 
-			timeout.tv_sec = 5;
-			timeout.tv_usec= 0;
-			avail = select( maxFd + 1, &set, NULL, NULL, &timeout );
-			if (avail<0){
-				Thread::msleep(500);
-			}
-		} while( avail < 0 );
-		if (avail==0){
-// 			cerr<< "SipSocketServer::run(): Timeout"<< endl;
+		timeout.tv_sec = 5;
+		timeout.tv_usec= 0;
+		avail = select( maxFd + 1, &set, &wset, NULL, &timeout );
+		if (avail<0){
+			Thread::msleep(500);
 		}
+	} while( avail < 0 );
 
-		if( FD_ISSET( fdSignalInternal, &set ) ){
-			char buf[255];
+	if( FD_ISSET( fdSignalInternal, &set ) ){
+		readSignal();
+	}
 
-#ifdef WIN32
-			if( recv( fdSignalInternal, buf, sizeof(buf), 0 ) < 0){
-#else
-			if( read( fdSignalInternal, buf, sizeof(buf) ) < 0){
-#endif
-				cerr << "Read failed" << endl;
-				throw NetworkException( errno );
-			}
+	csMutex.lock();
+	for( i = sockets.begin(); i != sockets.end(); i++ ){
+		MRef<Socket*> socket = i->first;
+		int32_t fd = socket->getFd();
+
+		if( fd < 0 || i->second.isNull() ||
+		    busy.find( socket ) != busy.end() )
+			continue;
 
+		if( FD_ISSET( fd, &set ) || FD_ISSET( fd, &wset ) ){
+			ready.push_back( Job( socket, i->second ) );
 		}
+	}
+	csMutex.unlock();
+}
+#endif
 
-		for( i = sockets.begin(); i != sockets.end(); i++ ){
-			MRef<Socket*> socket = i->first;
-			MRef<InputReadyHandler*> handler = i->second;
+void SocketServer::run()
+{
+#ifdef DEBUG_OUTPUT
+	setThreadName("SocketServer::run");
+#endif
+
+	if (fdSignal < 0)
+		createSignalPipe();
+
+	while (!doStop){
+		/* Handlers may add and remove sockets, so collect the
+		 * ready ones before calling any */
+		list<Job> ready;
+		list<Job>::iterator j;
+
+		waitReady( ready );
+
+		csMutex.lock();
+		for( j = ready.begin(); j != ready.end(); ){
+			// Removed while waiting
+			if( sockets.find( j->first ) == sockets.end() )
+				j = ready.erase( j );
+			else
+				j++;
+		}
 
-			if( FD_ISSET( socket->getFd(), &set ) ){
-				if( !handler.isNull() ){
-					handler->inputReady( socket );
-				}
+		if( !workers.empty() && !ready.empty() ){
+			for( j = ready.begin(); j != ready.end(); j++ ){
+				busy.insert( j->first );
+				jobs.push_back( *j );
 			}
+			ready.clear();
+			jobReady.broadcast();
+		}
+		csMutex.unlock();
+
+		for( j = ready.begin(); j != ready.end(); j++ ){
+			j->second->inputReady( j->first );
 		}
 	}
 
-// 	csMutex.lock();
+	csMutex.lock();
 
 	closesocket( fdSignalInternal );
 	closesocket( fdSignal );
 	fdSignal = -1;
 	doStop = false;
 
-// 	csMutex.unlock();
+	csMutex.unlock();
+}
+
+void SocketServer::runWorker()
+{
+	csMutex.lock();
+	while( !stopWorkers ){
+		if( jobs.empty() ){
+			/* Timed, the Win32 CondVar may lose a wakeup */
+			jobReady.wait( csMutex, 1000 );
+			continue;
+		}
+
+		Job job = jobs.front();
+		jobs.pop_front();
+		csMutex.unlock();
+
+		job.second->inputReady( job.first );
+
+		csMutex.lock();
+		busy.erase( job.first );
+		/* Watch the socket again */
+		signal();
+	}
+	csMutex.unlock();
 }
 
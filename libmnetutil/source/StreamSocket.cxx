@@ -29,10 +29,16 @@
 
 #ifdef _MSC_VER
 #	include<io.h>
+#	define lseek		::_lseeki64
 #else
 #	include<unistd.h>
 #endif
 
+#include<errno.h>
+
+/* Size of the buffer sendFile reads the file into */
+#define SEND_FILE_BUFFER_SIZE (64*1024)
+
 using namespace std;
 
 StreamSocket::StreamSocket(){}
@@ -83,3 +89,59 @@ int32_t StreamSocket::write(const void *buf, int32_t count){
 int32_t StreamSocket::read(void *buf, int32_t count){
 	return ::recv(fd, (char*)buf, count, 0);
 }
+
+int32_t StreamSocket::writev(const void * const *bufs, const int32_t *lengths, int32_t n){
+	int32_t total = 0;
+
+	for( int32_t i = 0; i < n; i++ ){
+		const char *p = (const char*)bufs[i];
+		int32_t left = lengths[i];
+
+		while( left > 0 ){
+			int32_t nwritten = write( p, left );
+			if( nwritten < 0 && errno == EINTR ){
+				continue;
+			}
+			if( nwritten <= 0 ){
+				return -1;
+			}
+			p += nwritten;
+			left -= nwritten;
+			total += nwritten;
+		}
+	}
+
+	return total;
+}
+
+int64_t StreamSocket::sendFile(int32_t fileFd, int64_t offset, int64_t count){
+	char buf[SEND_FILE_BUFFER_SIZE];
+	int64_t total = 0;
+
+	if( lseek( fileFd, offset, SEEK_SET ) < 0 ){
+		return -1;
+	}
+
+	while( total < count ){
+		int32_t len = SEND_FILE_BUFFER_SIZE;
+		if( count - total < len ){
+			len = (int32_t)( count - total );
+		}
+
+		int32_t nread = ::read( fileFd, buf, len );
+		if( nread < 0 && errno == EINTR ){
+			continue;
+		}
+		if( nread <= 0 ){
+			return -1;
+		}
+
+		const void *data = buf;
+		if( writev( &data, &nread, 1 ) != nread ){
+			return -1;
+		}
+		total += nread;
+	}
+
+	return total;
+}
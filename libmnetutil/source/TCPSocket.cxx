@@ -35,6 +35,14 @@
 #	include<netinet/in.h>
 #endif
 
+#ifdef HAVE_SYS_UIO_H
+#	include<sys/uio.h>
+#endif
+#ifdef HAVE_SYS_SENDFILE_H
+#	include<sys/sendfile.h>
+#endif
+
+#include<errno.h>
 #include<stdlib.h>
 #include<stdio.h>
 #ifdef _MSC_VER
@@ -138,3 +146,74 @@ void TCPSocket::useNoDelay(bool noDelay){
 	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (const char *)(&on), sizeof(on));
 #endif
 }
+
+int32_t TCPSocket::writev(const void * const *bufs, const int32_t *lengths, int32_t n){
+#ifdef HAVE_SYS_UIO_H
+	/* POSIX allows at least 16 buffers per writev */
+	struct iovec iov[16];
+	int32_t total = 0;
+
+	if( n > 16 ){
+		return StreamSocket::writev( bufs, lengths, n );
+	}
+
+	for( int32_t i = 0; i < n; i++ ){
+		iov[i].iov_base = (void*)bufs[i];
+		iov[i].iov_len = lengths[i];
+	}
+
+	struct iovec *first = iov;
+	int32_t left = n;
+	while( left > 0 ){
+		ssize_t nwritten = ::writev( fd, first, left );
+		if( nwritten < 0 && errno == EINTR ){
+			continue;
+		}
+		if( nwritten <= 0 ){
+			return -1;
+		}
+		total += (int32_t)nwritten;
+
+		/* Skip what was written, the rest is written again */
+		while( left > 0 && (size_t)nwritten >= first->iov_len ){
+			nwritten -= first->iov_len;
+			first++;
+			left--;
+		}
+		if( left > 0 ){
+			first->iov_base = (char*)first->iov_base + nwritten;
+			first->iov_len -= nwritten;
+		}
+	}
+
+	return total;
+#else
+	return StreamSocket::writev( bufs, lengths, n );
+#endif
+}
+
+int64_t TCPSocket::sendFile(int32_t fileFd, int64_t offset, int64_t count){
+#ifdef HAVE_SYS_SENDFILE_H
+	off_t pos = (off_t)offset;
+	int64_t total = 0;
+
+	while( total < count ){
+		ssize_t nsent = ::sendfile( fd, fileFd, &pos, (size_t)( count - total ) );
+		if( nsent < 0 && errno == EINTR ){
+			continue;
+		}
+		if( nsent < 0 && ( errno == EINVAL || errno == ENOSYS ) && total == 0 ){
+			/* The file system does not support it */
+			return StreamSocket::sendFile( fileFd, offset, count );
+		}
+		if( nsent <= 0 ){
+			return -1;
+		}
+		total += nsent;
+	}
+
+	return total;
+#else
+	return StreamSocket::sendFile( fileFd, offset, count );
+#endif
+}
@@ -216,6 +216,13 @@ class LIBMSIP_API SipStackConfig : public MObject{
 		 * Configuration for all transports, UDP, TCP etc.
 		 */
 		std::list<MRef<SipTransportConfig*> > transports;
+
+		/**
+		 * Threads reading and parsing incoming messages, and
+		 * doing the TLS handshakes of incoming connections.
+		 * Zero does it all in the thread waiting for input.
+		 */
+		int32_t transportWorkerThreads;
 };
 
 //TODO: Enable conference calling
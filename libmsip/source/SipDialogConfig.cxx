@@ -372,7 +372,8 @@ SipStackConfig::SipStackConfig():
 	preferedLocalSipPort(0),
 	preferedLocalSipsPort(0),
 	autoAnswer(false),
-	use100Rel(false){
+	use100Rel(false),
+	transportWorkerThreads(0){
 
 }
 
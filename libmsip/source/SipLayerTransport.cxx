@@ -68,6 +68,10 @@ using namespace std;
 #define NB_THREADS 5
 #define BUFFER_UNIT 1024
 
+/* Logged for every message sent, checked before the arguments
+ * are formatted */
+static DbgCategory sipDbg( mdbg, "signaling/sip" );
+
 #if !defined(_MSC_VER) && !defined(__MINGW32__)
 # define ENABLE_TS
 #endif
@@ -355,13 +359,15 @@ void printMessage(string header, string packet){
 }
 
 SipLayerTransport::SipLayerTransport(MRef<CertificateChain *> cchain,
-				     MRef<CertificateSet *> cert_db_):
+				     MRef<CertificateSet *> cert_db_,
+				     int32_t workerThreads):
 		cert_chain(cchain), cert_db(cert_db_), tls_ctx(NULL)
 {
 	contactUdpPort=0;
 	contactSipPort=0;
 	contactSipsPort=0;
 	manager = new SocketServer();
+	manager->setWorkerThreads( workerThreads );
 	manager->start();
 }
 
@@ -619,7 +625,8 @@ static bool lookupDestIpPort(const SipUri &uri, MRef<SipTransport*> transport,
 		destPort = port;
 	}
 
-	mdbg("signaling/sip") << "lookupDestIpPort " << res << " " << destAddr << ":" << destPort << ";transport=" << transport->getName() << endl;
+	if( sipDbg.isEnabled() )
+		sipDbg() << "lookupDestIpPort " << res << " " << destAddr << ":" << destPort << ";transport=" << transport->getName() << endl;
 	return res;
 }
 
@@ -684,7 +691,8 @@ bool SipLayerTransport::getDestination(MRef<SipMessage*> pack, string &destAddr,
 			uri = req->getUri();
 		}
 
-		mdbg("signaling/sip") << "Destination URI: " << uri.getRequestUriString() << endl;
+		if( sipDbg.isEnabled() )
+			sipDbg() << "Destination URI: " << uri.getRequestUriString() << endl;
 
 		if( uri.isValid() ){
 			// RFC 3263, 4.1 Selecting a Transport Protocol
@@ -787,7 +795,10 @@ bool SipLayerTransport::findSocket(MRef<SipTransport*> transport,
 	serversLock.unlock();
 
 	if( type & MSOCKET_TYPE_STREAM ){
-		MRef<StreamSocket*> ssocket = findStreamSocket(destAddr, port);
+		/* Reuse a connection of the same transport to the peer,
+		 * a TLS request must not go out on a plain TCP connection
+		 * to the same address and port */
+		MRef<StreamSocket*> ssocket = findStreamSocket(destAddr, port, type);
 		if( ssocket.isNull() ) {
 			/* No existing StreamSocket to that host,
 			 * create one */
@@ -1041,9 +1052,9 @@ void SipLayerTransport::removeSocket( MRef<StreamSocket *> sock ){
 }
 
 
-MRef<StreamSocket *> SipLayerTransport::findStreamSocket( IPAddress &address, uint16_t port ){
+MRef<StreamSocket *> SipLayerTransport::findStreamSocket( IPAddress &address, uint16_t port, int32_t type ){
 	MRef<Socket *> sock =
-		manager->findStreamSocketPeer( address, port );
+		manager->findStreamSocketPeer( address, port, type );
 
 	if( !sock ){
 		return NULL;
@@ -1192,7 +1203,8 @@ void StreamThreadData::streamSocketRead( MRef<StreamSocket *> socket ){
 			nread = socket->read( buffer, STREAM_MAX_PKT_SIZE);
 
 			if (nread == -1){
-				mdbg("signaling/sip") << "Some error occured while reading from StreamSocket" << endl;
+				// Nothing to read yet, for example while
+				// a TLS handshake is in progress
 				return;
 			}
 
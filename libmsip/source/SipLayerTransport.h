@@ -53,7 +53,8 @@ class SipLayerTransport : public SipSMCommandReceiver,
 			  public SipSocketReceiver {
 	public:
 		SipLayerTransport( MRef<CertificateChain *> cchain=NULL,
-				   MRef<CertificateSet *> cert_db = NULL
+				   MRef<CertificateSet *> cert_db = NULL,
+				   int32_t workerThreads = 0
 		);
 
 		virtual ~SipLayerTransport();
@@ -118,7 +119,7 @@ class SipLayerTransport : public SipSMCommandReceiver,
 		bool getDestination(MRef<SipMessage*> pack, std::string &destAddr,
 				    int32_t &destPort, MRef<SipTransport*> &destTransport);
 		void addViaHeader( MRef<SipMessage*> pack, MRef<SipSocketServer*> server, MRef<Socket *> socket, std::string branch );
-		MRef<StreamSocket *> findStreamSocket(IPAddress&, uint16_t);
+		MRef<StreamSocket *> findStreamSocket(IPAddress&, uint16_t, int32_t type);
 		bool findSocket( MRef<SipTransport*> transport,
 					 IPAddress &addr,
 					 uint16_t port,
@@ -130,7 +130,8 @@ SipStackInternal::SipStackInternal( MRef<SipStackConfig *> stackConfig )
 
 	MRef<SipLayerTransport*> transp = MRef<SipLayerTransport*>(new
 			   SipLayerTransport(stackConfig->cert,
-					     stackConfig->cert_db));
+					     stackConfig->cert_db,
+					     stackConfig->transportWorkerThreads));
 
 	// Here we need to really know what we are doing since
 	// we are "breaking the law" of not passing this
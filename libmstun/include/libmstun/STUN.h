@@ -40,6 +40,8 @@
 /**
  * High level API with static methods for determining
  * external NAT address/port mapping and NAT type.
+ * The methods wait for the server in the calling thread, see
+ * STUNClient and STUNNatTypeQuery for the same on an event loop.
  * @author Erik Eliasson
 */
 class LIBMSTUN_API STUN{
@@ -0,0 +1,280 @@
+/*
+ Copyright (C) 2004-2006 the Minisip Team
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#ifndef STUNCLIENT_H
+#define STUNCLIENT_H
+
+#include<libmstun/config.h>
+
+#include<libmutil/MemObject.h>
+#include<libmutil/Mutex.h>
+#include<libmutil/TimeoutProvider.h>
+
+#include<libmnetutil/IPAddress.h>
+#include<libmnetutil/SocketServer.h>
+#include<libmnetutil/UDPSocket.h>
+
+#include<string>
+#include<vector>
+
+/* Retransmission of RFC 5389 section 7.2.1: the request is sent Rc
+ * times, first after RTO ms, the interval doubling each time, and the
+ * transaction fails Rm * RTO ms after the last one */
+#define STUN_CLIENT_RTO 500
+#define STUN_CLIENT_RC 7
+#define STUN_CLIENT_RM 16
+
+/* Largest response accepted */
+#define STUN_CLIENT_MAX_MESSAGE 1500
+
+/* Room for an IPv4 or IPv6 address in text */
+#define STUN_CLIENT_ADDRESS_LENGTH 48
+
+/* STUNResult::status */
+#define STUN_RESULT_OK 0	/// Success response
+#define STUN_RESULT_TIMEOUT 1	/// No response after the last retransmission
+#define STUN_RESULT_ERROR 2	/// Error response, see errorCode
+#define STUN_RESULT_FAILED 3	/// The request could not be sent
+
+/**
+ * Outcome of a binding request. The addresses are empty strings when
+ * the response does not have them.
+*/
+struct LIBMSTUN_API STUNResult{
+	int status;
+
+	/* Of an error response, such as 420 */
+	int errorCode;
+
+	/* XOR-MAPPED-ADDRESS, or MAPPED-ADDRESS from RFC 3489 servers */
+	char mappedIP[STUN_CLIENT_ADDRESS_LENGTH];
+	uint16_t mappedPort;
+
+	/* The alternate address of the server, OTHER-ADDRESS (RFC 5780)
+	 * or CHANGED-ADDRESS (RFC 3489) */
+	char otherIP[STUN_CLIENT_ADDRESS_LENGTH];
+	uint16_t otherPort;
+
+	/* Number of times the request was sent */
+	int transmissions;
+};
+
+/**
+ * Receiver of the completion of the binding requests of a STUNClient.
+*/
+class LIBMSTUN_API STUNClientHandler : public virtual MObject{
+	public:
+		virtual ~STUNClientHandler();
+
+		/**
+		 * Called once per request, from the thread that
+		 * received the response or ran the timeout, without
+		 * any lock of the client held: new requests may be
+		 * sent from it.
+		 * @param request	As returned by sendBindingRequest.
+		*/
+		virtual void stunResult( uint32_t request, const STUNResult &result )=0;
+};
+
+class STUNClient;
+
+typedef TimeoutProvider<uint32_t, MRef<STUNClient *> > STUNTimeoutProvider;
+
+/**
+ * Asynchronous STUN client (RFC 5389, and RFC 3489 servers).
+ *
+ * The binding requests are sent from a socket and their responses
+ * received on the input ready handler of a SocketServer, the
+ * retransmissions are timeouts of a shared STUNTimeoutProvider, so
+ * that no thread waits for a server. Any number of requests may be
+ * outstanding, the responses are matched to them by transaction id.
+ * A transaction is a slot in a table reused once completed, its
+ * messages are written and parsed in fixed buffers.
+ *
+ * The client is kept by the SocketServer and by the timeouts of
+ * the requests outstanding until "close" is called.
+*/
+class LIBMSTUN_API STUNClient : public InputReadyHandler{
+	public:
+		/**
+		 * @param socket	Socket the requests are sent from.
+		 * @param timeouts	Runs the retransmissions, it may be
+		 * 		shared by several clients.
+		 * @param server	Where the socket is added to
+		 * 		receive the responses. If NULL, the owner
+		 * 		of the socket gives the datagrams to
+		 * 		handlePacket.
+		*/
+		STUNClient( MRef<UDPSocket *> socket,
+				MRef<STUNTimeoutProvider *> timeouts,
+				MRef<SocketServer *> server = NULL );
+		~STUNClient();
+
+		/**
+		 * Sets the retransmission timing of the requests sent
+		 * after the call. The defaults are STUN_CLIENT_RTO,
+		 * STUN_CLIENT_RC and STUN_CLIENT_RM.
+		*/
+		void setRetransmission( int rto, int rc, int rm );
+
+		/**
+		 * Sends a binding request, and returns at once.
+		 * @param changeIP, changePort	Add a CHANGE-REQUEST
+		 * 		(RFC 3489 NAT type tests).
+		 * @return	Identifier of the request, given to the
+		 * 		handler, or 0 if it could not be sent, in
+		 * 		which case the handler is not called.
+		*/
+		uint32_t sendBindingRequest( MRef<IPAddress *> server,
+				uint16_t port,
+				MRef<STUNClientHandler *> handler,
+				bool changeIP = false, bool changePort = false );
+
+		/**
+		 * Abandons a request, its handler is not called.
+		*/
+		void cancel( uint32_t request );
+
+		/**
+		 * Abandons all the requests and removes the socket from
+		 * the SocketServer.
+		*/
+		void close();
+
+		/**
+		 * Completes the request a datagram is a response to.
+		 * @return	False if it is not the response to an
+		 * 		outstanding request.
+		*/
+		bool handlePacket( const unsigned char *data, int length );
+
+		/**
+		 * @return	Number of requests outstanding.
+		*/
+		int getPending();
+
+		virtual void inputReady( MRef<Socket *> socket );
+
+		/* Retransmission timer of a request */
+		void timeout( const uint32_t &request );
+
+		virtual std::string getMemObjectType() const {return "STUNClient";}
+
+	private:
+		struct Transaction{
+			/* Slot number in the low 16 bits, and a
+			 * count of its uses above, 0 if free */
+			uint32_t request;
+
+			unsigned char id[12];
+			unsigned char message[28];
+			int length;
+
+			MRef<IPAddress *> server;
+			uint16_t port;
+			MRef<STUNClientHandler *> handler;
+
+			int sent;
+			int rto;
+			int rc;
+			int rm;
+		};
+
+		Transaction *findTransaction( uint32_t request );
+		void release( Transaction &t );
+		bool send( Transaction &t );
+		void newTransactionId( unsigned char *id );
+
+		MRef<UDPSocket *> socket;
+		MRef<STUNTimeoutProvider *> timeouts;
+		MRef<SocketServer *> server;
+
+		Mutex lock;
+		std::vector<Transaction> transactions;
+		std::vector<int> freeSlots;
+		int pending;
+
+		int rto;
+		int rc;
+		int rm;
+
+		uint64_t random;
+};
+
+/**
+ * Receiver of the result of a STUNNatTypeQuery.
+*/
+class LIBMSTUN_API STUNNatTypeHandler : public virtual MObject{
+	public:
+		virtual ~STUNNatTypeHandler();
+
+		/**
+		 * @param natType	One of STUN::STUNTYPE_*, or
+		 * 		STUN::STUN_ERROR.
+		 * @param mapping	The response to the first request
+		 * 		to the server (mapped address).
+		*/
+		virtual void natTypeResult( int natType, const STUNResult &mapping )=0;
+};
+
+/**
+ * The NAT type test sequence of RFC 3489 section 10.1, run on a
+ * STUNClient: each step is sent from the completion of the previous
+ * one.
+*/
+class LIBMSTUN_API STUNNatTypeQuery : public STUNClientHandler{
+	public:
+		/**
+		 * @param localIPs	Addresses of the host, a mapped
+		 * 		address among them means no NAT.
+		 * @param localPort	Port of the socket of the client.
+		*/
+		STUNNatTypeQuery( MRef<STUNClient *> client,
+				MRef<IPAddress *> server, uint16_t port,
+				const std::vector<std::string> &localIPs,
+				uint16_t localPort,
+				MRef<STUNNatTypeHandler *> handler );
+
+		/**
+		 * Sends the first request. The handler is called
+		 * even if it could not be sent.
+		*/
+		void start();
+
+		virtual void stunResult( uint32_t request, const STUNResult &result );
+
+		virtual std::string getMemObjectType() const {return "STUNNatTypeQuery";}
+
+	private:
+		void send( MRef<IPAddress *> to, uint16_t toPort,
+				bool changeIP, bool changePort );
+		void done( int natType );
+		bool isLocal( const STUNResult &result );
+
+		MRef<STUNClient *> client;
+		MRef<IPAddress *> server;
+		uint16_t port;
+		std::vector<std::string> localIPs;
+		uint16_t localPort;
+		MRef<STUNNatTypeHandler *> handler;
+
+		int step;
+		STUNResult first;
+};
+
+#endif
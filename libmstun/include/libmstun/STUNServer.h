@@ -0,0 +1,121 @@
+/*
+ Copyright (C) 2004-2006 the Minisip Team
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#ifndef STUNSERVER_H
+#define STUNSERVER_H
+
+#include<libmstun/config.h>
+
+#include<libmutil/MemObject.h>
+#include<libmutil/Thread.h>
+
+#include<string>
+#include<vector>
+
+struct sockaddr;
+
+/* Magic cookie of the RFC 5389 messages */
+#define STUN_MAGIC_COOKIE 0x2112A442
+
+/* Largest response written by STUNServer::handleRequest */
+#define STUN_SERVER_MAX_RESPONSE 128
+
+class STUNServerWorker;
+
+/**
+ * Stateless STUN binding server (RFC 5389, and RFC 3489 for the
+ * requests without the magic cookie).
+ *
+ * Each thread has its own socket bound to the same address and port
+ * with SO_REUSEPORT, where available, so that the kernel spreads the
+ * clients over the threads. On Linux the threads wait with epoll and
+ * receive and send in batches with recvmmsg/sendmmsg. Requests are
+ * parsed and responses written in place in per thread buffers, nothing
+ * is allocated per request.
+ *
+ * The server has a single address, so the RFC 3489 requests asking
+ * for a response from another address or port are dropped, which the
+ * client sees as a filtering NAT.
+*/
+class LIBMSTUN_API STUNServer : public MObject{
+	public:
+		/**
+		 * @param address local address to listen on, "0.0.0.0" or
+		 * 		"::" for all the interfaces.
+		 * @param port	UDP port, 0 for any.
+		 * @param threads Number of threads answering requests.
+		*/
+		STUNServer( std::string address, int port, int threads );
+		~STUNServer();
+
+		/**
+		 * Binds the sockets and starts the threads.
+		 * Throws BindFailed or SocketFailed.
+		*/
+		void start();
+
+		/**
+		 * Stops the threads and closes the sockets.
+		*/
+		void stop();
+
+		/**
+		 * @return	The port bound, once started.
+		*/
+		int getPort(){ return port; }
+
+		/**
+		 * Counters summed over the threads, read without
+		 * synchronisation while the server runs.
+		*/
+		uint64_t getRequests();
+		uint64_t getResponses();
+		uint64_t getDropped();
+
+		/**
+		 * Answers a binding request.
+		 * @param request	The received datagram.
+		 * @param length	Its length.
+		 * @param from	Address the request was received from.
+		 * @param local	Address the request was sent to, or NULL
+		 * 		if unknown. It is given to RFC 3489
+		 * 		clients as SOURCE-ADDRESS and
+		 * 		CHANGED-ADDRESS.
+		 * @param response Buffer of STUN_SERVER_MAX_RESPONSE
+		 * 		bytes, where the response is written.
+		 * @return	The length of the response, 0 if the
+		 * 		request is to be dropped.
+		*/
+		static int handleRequest( const unsigned char *request, int length,
+				const struct sockaddr *from,
+				const struct sockaddr *local,
+				unsigned char *response );
+
+		virtual std::string getMemObjectType() const {return "STUNServer";}
+
+	private:
+		std::string address;
+		int port;
+		int nThreads;
+
+		std::vector< MRef<STUNServerWorker *> > workers;
+		std::vector< MRef<Thread *> > threads;
+		std::vector<int> sockets;
+};
+
+#endif
@@ -0,0 +1,566 @@
+/*
+ Copyright (C) 2004-2006 the Minisip Team
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#include<config.h>
+
+#include<libmstun/STUNClient.h>
+#include<libmstun/STUN.h>
+#include<libmstun/STUNServer.h>
+#include<libmstun/STUNMessage.h>
+#include<libmstun/STUNAttributes.h>
+
+#include<libmutil/dbg.h>
+#include<libmnetutil/NetworkException.h>
+
+#include<stdio.h>
+#include<string.h>
+#include<time.h>
+
+#ifndef WIN32
+#	include<fcntl.h>
+#	include<unistd.h>
+#endif
+
+using namespace std;
+
+#define STUN_ATTR_XOR_MAPPED_ADDRESS 0x0020
+/* Draft value still sent by some servers */
+#define STUN_ATTR_XOR_MAPPED_ADDRESS_OLD 0x8020
+#define STUN_ATTR_OTHER_ADDRESS 0x802c
+
+#define CHANGE_IP_MASK 0x04
+#define CHANGE_PORT_MASK 0x02
+
+/* The slot is in 16 bits of the request and of the transaction id */
+#define STUN_CLIENT_MAX_SLOTS 0x10000
+
+static inline uint16_t get16( const unsigned char *p ){
+	return (uint16_t)( ( p[0] << 8 ) | p[1] );
+}
+
+static inline uint32_t get32( const unsigned char *p ){
+	return ( (uint32_t)p[0] << 24 ) | ( p[1] << 16 ) | ( p[2] << 8 ) | p[3];
+}
+
+static inline void put16( unsigned char *p, uint16_t v ){
+	p[0] = (unsigned char)( v >> 8 );
+	p[1] = (unsigned char)v;
+}
+
+static inline void put32( unsigned char *p, uint32_t v ){
+	put16( p, (uint16_t)( v >> 16 ) );
+	put16( p + 2, (uint16_t)v );
+}
+
+/* Reads an address attribute into ip and port, XORed with the magic
+ * cookie and the transaction id in key if not NULL */
+static bool getAddress( const unsigned char *value, int length,
+		const unsigned char *key, char *ip, uint16_t &port ){
+	unsigned char addr[16];
+	int addrLength;
+
+	if( length < 8 ){
+		return false;
+	}
+
+	if( value[1] == 0x01 ){
+		addrLength = 4;
+	}
+	else if( value[1] == 0x02 ){
+		addrLength = 16;
+	}
+	else{
+		return false;
+	}
+
+	if( length < 4 + addrLength ){
+		return false;
+	}
+
+	port = get16( value + 2 );
+	if( key ){
+		port ^= (uint16_t)( STUN_MAGIC_COOKIE >> 16 );
+	}
+	for( int i = 0; i < addrLength; i++ ){
+		addr[i] = key ? value[4 + i] ^ key[i] : value[4 + i];
+	}
+
+	if( addrLength == 4 ){
+		sprintf( ip, "%d.%d.%d.%d", addr[0], addr[1], addr[2], addr[3] );
+	}
+	else{
+		sprintf( ip, "%x:%x:%x:%x:%x:%x:%x:%x",
+				get16( addr ), get16( addr + 2 ),
+				get16( addr + 4 ), get16( addr + 6 ),
+				get16( addr + 8 ), get16( addr + 10 ),
+				get16( addr + 12 ), get16( addr + 14 ) );
+	}
+	return true;
+}
+
+STUNClientHandler::~STUNClientHandler(){
+}
+
+STUNNatTypeHandler::~STUNNatTypeHandler(){
+}
+
+STUNClient::STUNClient( MRef<UDPSocket *> sock,
+		MRef<STUNTimeoutProvider *> tp,
+		MRef<SocketServer *> ss ):
+		socket( sock ),
+		timeouts( tp ),
+		server( ss ),
+		pending( 0 ),
+		rto( STUN_CLIENT_RTO ),
+		rc( STUN_CLIENT_RC ),
+		rm( STUN_CLIENT_RM ){
+	random = (uint64_t)time( NULL ) ^ (uint64_t)(size_t)this;
+#ifndef WIN32
+	int fd = open( "/dev/urandom", O_RDONLY );
+	if( fd >= 0 ){
+		uint64_t seed;
+		if( read( fd, &seed, sizeof( seed ) ) == sizeof( seed ) ){
+			random ^= seed;
+		}
+		::close( fd );
+	}
+#endif
+	if( random == 0 ){
+		random = 1;
+	}
+
+	if( server ){
+		server->addSocket( *socket, this );
+	}
+}
+
+STUNClient::~STUNClient(){
+}
+
+void STUNClient::setRetransmission( int rto_, int rc_, int rm_ ){
+	lock.lock();
+	rto = rto_;
+	rc = rc_;
+	rm = rm_;
+	lock.unlock();
+}
+
+/* xorshift64*, the transaction ids only need to be unpredictable
+ * enough not to be forged by off path hosts */
+void STUNClient::newTransactionId( unsigned char *id ){
+	for( int i = 2; i < 12; i++ ){
+		random ^= random >> 12;
+		random ^= random << 25;
+		random ^= random >> 27;
+		id[i] = (unsigned char)( ( random * 2685821657736338717ULL ) >> 56 );
+	}
+}
+
+uint32_t STUNClient::sendBindingRequest( MRef<IPAddress *> to, uint16_t toPort,
+		MRef<STUNClientHandler *> handler,
+		bool changeIP, bool changePort ){
+	int slot;
+
+	lock.lock();
+	if( !freeSlots.empty() ){
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else if( transactions.size() < STUN_CLIENT_MAX_SLOTS ){
+		slot = (int)transactions.size();
+		transactions.push_back( Transaction() );
+	}
+	else{
+		lock.unlock();
+		merr << "STUNClient: too many requests outstanding" << endl;
+		return 0;
+	}
+
+	Transaction &t = transactions[slot];
+
+	/* The count of uses of the slot is never 0 */
+	uint32_t uses = ( t.request >> 16 ) + 1;
+	if( uses > 0xffff ){
+		uses = 1;
+	}
+	t.request = ( uses << 16 ) | slot;
+
+	put16( t.id, (uint16_t)slot );
+	newTransactionId( t.id );
+
+	unsigned char *p = t.message;
+	put16( p, (uint16_t)STUNMessage::BINDING_REQUEST );
+	put32( p + 4, STUN_MAGIC_COOKIE );
+	memcpy( p + 8, t.id, 12 );
+	t.length = 20;
+	if( changeIP || changePort ){
+		put16( p + 20, (uint16_t)STUNAttribute::CHANGE_REQUEST );
+		put16( p + 22, 4 );
+		put32( p + 24, ( changeIP ? CHANGE_IP_MASK : 0 ) |
+				( changePort ? CHANGE_PORT_MASK : 0 ) );
+		t.length += 8;
+	}
+	put16( p + 2, (uint16_t)( t.length - 20 ) );
+
+	t.server = to;
+	t.port = toPort;
+	t.handler = handler;
+	t.sent = 0;
+	t.rto = rto;
+	t.rc = rc;
+	t.rm = rm;
+	pending++;
+
+	uint32_t request = t.request;
+	if( !send( t ) ){
+		release( t );
+		request = 0;
+	}
+	lock.unlock();
+
+	return request;
+}
+
+/* Called with the lock held, sends the request and schedules the
+ * next retransmission or the end of the transaction. Returns false if
+ * the socket refused the address, a failed send being otherwise lost
+ * as on the network */
+bool STUNClient::send( Transaction &t ){
+	int wait;
+
+	try{
+		if( socket->sendTo( **t.server, t.port, t.message, t.length ) < 0 ){
+			mdbg << "STUNClient: send to " << t.server->getString() << " failed" << endl;
+		}
+	}
+	catch( NetworkException &e ){
+		merr << "STUNClient: could not send to " << t.server->getString() << ": " << e.what() << endl;
+		return false;
+	}
+	t.sent++;
+
+	if( t.sent < t.rc ){
+		wait = t.rto << ( t.sent - 1 );
+	}
+	else{
+		wait = t.rm * t.rto;
+	}
+	timeouts->requestTimeout( wait, this, t.request );
+	return true;
+}
+
+/* Called with the lock held */
+STUNClient::Transaction *STUNClient::findTransaction( uint32_t request ){
+	uint32_t slot = request & 0xffff;
+
+	if( request == 0 || slot >= transactions.size() ||
+			transactions[slot].request != request ||
+			!transactions[slot].handler ){
+		return NULL;
+	}
+	return &transactions[slot];
+}
+
+/* Called with the lock held */
+void STUNClient::release( Transaction &t ){
+	t.server = NULL;
+	t.handler = NULL;
+	freeSlots.push_back( t.request & 0xffff );
+	pending--;
+}
+
+void STUNClient::timeout( const uint32_t &request ){
+	STUNResult result;
+	MRef<STUNClientHandler *> handler;
+
+	lock.lock();
+	Transaction *t = findTransaction( request );
+	if( !t ){
+		/* Completed while the timeout was delivered */
+		lock.unlock();
+		return;
+	}
+
+	if( t->sent < t->rc && send( *t ) ){
+		lock.unlock();
+		return;
+	}
+
+	memset( &result, 0, sizeof( result ) );
+	result.status = t->sent < t->rc ? STUN_RESULT_FAILED : STUN_RESULT_TIMEOUT;
+	result.transmissions = t->sent;
+	handler = t->handler;
+	release( *t );
+	lock.unlock();
+
+	handler->stunResult( request, result );
+}
+
+bool STUNClient::handlePacket( const unsigned char *data, int length ){
+	STUNResult result;
+	MRef<STUNClientHandler *> handler;
+
+	if( length < 20 || ( data[0] & 0xc0 ) ){
+		return false;
+	}
+
+	uint16_t type = get16( data );
+	uint16_t messageLength = get16( data + 2 );
+	if( ( type != STUNMessage::BINDING_RESPONSE &&
+			type != STUNMessage::BINDING_ERROR_RESPONSE ) ||
+			20 + messageLength > length ||
+			get32( data + 4 ) != STUN_MAGIC_COOKIE ){
+		return false;
+	}
+
+	/* RFC 3489 servers take the magic cookie for part of the
+	 * transaction id and echo it */
+	const unsigned char *id = data + 8;
+	uint16_t slot = get16( id );
+
+	memset( &result, 0, sizeof( result ) );
+	result.status = type == STUNMessage::BINDING_RESPONSE ?
+		STUN_RESULT_OK : STUN_RESULT_ERROR;
+
+	bool xorMapped = false;
+	const unsigned char *attr = data + 20;
+	const unsigned char *end = attr + messageLength;
+	while( attr + 4 <= end ){
+		uint16_t attrType = get16( attr );
+		uint16_t attrLength = get16( attr + 2 );
+		const unsigned char *value = attr + 4;
+
+		if( value + attrLength > end ){
+			return false;
+		}
+
+		if( attrType == STUN_ATTR_XOR_MAPPED_ADDRESS ||
+				attrType == STUN_ATTR_XOR_MAPPED_ADDRESS_OLD ){
+			xorMapped = getAddress( value, attrLength, data + 4,
+					result.mappedIP, result.mappedPort );
+		}
+		else if( attrType == STUNAttribute::MAPPED_ADDRESS ){
+			if( !xorMapped ){
+				getAddress( value, attrLength, NULL,
+						result.mappedIP, result.mappedPort );
+			}
+		}
+		else if( attrType == STUN_ATTR_OTHER_ADDRESS ||
+				attrType == STUNAttribute::CHANGED_ADDRESS ){
+			getAddress( value, attrLength, NULL,
+					result.otherIP, result.otherPort );
+		}
+		else if( attrType == STUNAttribute::ERROR_CODE && attrLength >= 4 ){
+			result.errorCode = ( value[2] & 0x07 ) * 100 + value[3];
+		}
+
+		attr = value + ( ( attrLength + 3 ) & ~3 );
+	}
+
+	if( result.status == STUN_RESULT_OK && !result.mappedIP[0] ){
+		mdbg << "STUNClient: response without mapped address" << endl;
+		return false;
+	}
+
+	lock.lock();
+	if( slot >= transactions.size() || !transactions[slot].handler ||
+			memcmp( transactions[slot].id, id, 12 ) ){
+		lock.unlock();
+		return false;
+	}
+
+	Transaction &t = transactions[slot];
+	uint32_t request = t.request;
+	result.transmissions = t.sent;
+	handler = t.handler;
+	release( t );
+	lock.unlock();
+
+	timeouts->cancelRequest( this, request );
+	handler->stunResult( request, result );
+	return true;
+}
+
+void STUNClient::inputReady( MRef<Socket *> ){
+	unsigned char buf[STUN_CLIENT_MAX_MESSAGE];
+
+	int n = socket->recv( buf, sizeof( buf ) );
+	if( n > 0 && !handlePacket( buf, n ) ){
+		mdbg << "STUNClient: dropped a datagram of " << n << " bytes" << endl;
+	}
+}
+
+void STUNClient::cancel( uint32_t request ){
+	lock.lock();
+	Transaction *t = findTransaction( request );
+	if( t ){
+		release( *t );
+	}
+	lock.unlock();
+
+	if( t ){
+		timeouts->cancelRequest( this, request );
+	}
+}
+
+void STUNClient::close(){
+	vector<uint32_t> cancelled;
+
+	lock.lock();
+	for( size_t i = 0; i < transactions.size(); i++ ){
+		if( transactions[i].handler ){
+			cancelled.push_back( transactions[i].request );
+			release( transactions[i] );
+		}
+	}
+	lock.unlock();
+
+	for( size_t i = 0; i < cancelled.size(); i++ ){
+		timeouts->cancelRequest( this, cancelled[i] );
+	}
+
+	if( server ){
+		server->removeSocket( *socket );
+		server = NULL;
+	}
+}
+
+int STUNClient::getPending(){
+	lock.lock();
+	int ret = pending;
+	lock.unlock();
+	return ret;
+}
+
+/*
+ * Steps of STUNNatTypeQuery, see the comment on the tests in STUN.cxx
+*/
+#define NAT_TEST1 0		/// Test I to the server
+#define NAT_TEST2 1		/// Test II, the response from ip2
+#define NAT_TEST1_CHANGED 2	/// Test I to ip2
+#define NAT_TEST3 3		/// Test III, the response from port2
+#define NAT_DONE 4
+
+STUNNatTypeQuery::STUNNatTypeQuery( MRef<STUNClient *> c,
+		MRef<IPAddress *> s, uint16_t p,
+		const std::vector<std::string> &ips, uint16_t lp,
+		MRef<STUNNatTypeHandler *> h ):
+		client( c ),
+		server( s ),
+		port( p ),
+		localIPs( ips ),
+		localPort( lp ),
+		handler( h ),
+		step( NAT_TEST1 ){
+	memset( &first, 0, sizeof( first ) );
+}
+
+void STUNNatTypeQuery::start(){
+	step = NAT_TEST1;
+	send( server, port, false, false );
+}
+
+void STUNNatTypeQuery::send( MRef<IPAddress *> to, uint16_t toPort,
+		bool changeIP, bool changePort ){
+	if( !client->sendBindingRequest( to, toPort, this, changeIP, changePort ) ){
+		done( STUN::STUN_ERROR );
+	}
+}
+
+void STUNNatTypeQuery::done( int natType ){
+	step = NAT_DONE;
+	handler->natTypeResult( natType, first );
+}
+
+bool STUNNatTypeQuery::isLocal( const STUNResult &result ){
+	if( result.mappedPort != localPort ){
+		return false;
+	}
+	for( size_t i = 0; i < localIPs.size(); i++ ){
+		if( localIPs[i] == result.mappedIP ){
+			return true;
+		}
+	}
+	return false;
+}
+
+void STUNNatTypeQuery::stunResult( uint32_t, const STUNResult &result ){
+	bool answered = result.status == STUN_RESULT_OK;
+
+	if( result.status == STUN_RESULT_ERROR || result.status == STUN_RESULT_FAILED ){
+		done( STUN::STUN_ERROR );
+		return;
+	}
+
+	switch( step ){
+		case NAT_TEST1:
+			if( !answered ){
+				done( STUN::STUNTYPE_BLOCKED );
+				return;
+			}
+			first = result;
+			step = NAT_TEST2;
+			send( server, port, true, true );
+			break;
+
+		case NAT_TEST2:
+			if( isLocal( first ) ){
+				done( answered ? STUN::STUNTYPE_OPEN_INTERNET :
+						STUN::STUNTYPE_SYMMETRIC_FIREWALL );
+			}
+			else if( answered ){
+				done( STUN::STUNTYPE_FULL_CONE );
+			}
+			else if( !first.otherIP[0] ){
+				mdbg << "STUNNatTypeQuery: the server has no other address" << endl;
+				done( STUN::STUN_ERROR );
+			}
+			else{
+				MRef<IPAddress *> other;
+				try{
+					other = IPAddress::create( first.otherIP );
+				}
+				catch( NetworkException & ){
+					done( STUN::STUN_ERROR );
+					return;
+				}
+				step = NAT_TEST1_CHANGED;
+				send( other, first.otherPort, false, false );
+			}
+			break;
+
+		case NAT_TEST1_CHANGED:
+			if( !answered ){
+				done( STUN::STUN_ERROR );
+			}
+			else if( strcmp( result.mappedIP, first.mappedIP ) ||
+					result.mappedPort != first.mappedPort ){
+				done( STUN::STUNTYPE_SYMMETRIC_NAT );
+			}
+			else{
+				step = NAT_TEST3;
+				send( server, port, false, true );
+			}
+			break;
+
+		case NAT_TEST3:
+			done( answered ? STUN::STUNTYPE_RESTRICTED :
+					STUN::STUNTYPE_PORT_RESTRICTED );
+			break;
+	}
+}
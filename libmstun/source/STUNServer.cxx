@@ -0,0 +1,679 @@
+/*
+ Copyright (C) 2004-2006 the Minisip Team
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#include<config.h>
+
+#include<libmstun/STUNServer.h>
+#include<libmstun/STUNMessage.h>
+#include<libmstun/STUNAttributes.h>
+
+#include<libmnetutil/IPAddress.h>
+#include<libmnetutil/NetworkException.h>
+
+#include<string.h>
+
+#ifdef WIN32
+#	include<winsock2.h>
+#	include<ws2tcpip.h>
+#else
+#	include<sys/types.h>
+#	include<sys/socket.h>
+#	include<sys/time.h>
+#	include<netinet/in.h>
+#	include<fcntl.h>
+#	include<unistd.h>
+#	include<errno.h>
+#	define closesocket close
+#endif
+
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_RECVMMSG) && defined(HAVE_SENDMMSG)
+#	define STUN_SERVER_MMSG
+#	include<sys/epoll.h>
+#endif
+
+/* Datagrams received or sent per system call */
+#define STUN_SERVER_BATCH 64
+
+/* Longest request read, longer ones are dropped */
+#define STUN_SERVER_MAX_REQUEST 1500
+
+/* The threads check for stop() at least this often */
+#define STUN_SERVER_POLL_MS 100
+
+/* Unknown attributes listed in a 420 error response */
+#define STUN_SERVER_MAX_UNKNOWN 8
+
+#define STUN_ATTR_REALM 0x0014
+#define STUN_ATTR_NONCE 0x0015
+#define STUN_ATTR_XOR_MAPPED_ADDRESS 0x0020
+#define STUN_ATTR_FINGERPRINT 0x8028
+
+#define STUN_FINGERPRINT_XOR 0x5354554e
+
+#define CHANGE_IP_MASK 0x04
+#define CHANGE_PORT_MASK 0x02
+
+using namespace std;
+
+static uint32_t crcTable[256];
+
+/* Fills the CRC-32 table when the library is loaded */
+static struct CrcTableInit{
+	CrcTableInit(){
+		for( uint32_t i = 0; i < 256; i++ ){
+			uint32_t c = i;
+			for( int k = 0; k < 8; k++ ){
+				c = c & 1 ? 0xedb88320 ^ ( c >> 1 ) : c >> 1;
+			}
+			crcTable[i] = c;
+		}
+	}
+} crcTableInit;
+
+static uint32_t crc32( const unsigned char *data, int length ){
+	uint32_t c = 0xffffffff;
+	for( int i = 0; i < length; i++ ){
+		c = crcTable[ ( c ^ data[i] ) & 0xff ] ^ ( c >> 8 );
+	}
+	return c ^ 0xffffffff;
+}
+
+static inline uint16_t get16( const unsigned char *p ){
+	return (uint16_t)( p[0] << 8 | p[1] );
+}
+
+static inline uint32_t get32( const unsigned char *p ){
+	return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static inline void put16( unsigned char *p, uint16_t v ){
+	p[0] = (unsigned char)( v >> 8 );
+	p[1] = (unsigned char)v;
+}
+
+static inline void put32( unsigned char *p, uint32_t v ){
+	put16( p, (uint16_t)( v >> 16 ) );
+	put16( p + 2, (uint16_t)v );
+}
+
+/* Comprehension required attributes that a binding request may
+ * carry and that the server can ignore */
+static bool isKnownAttribute( uint16_t type ){
+	return ( type >= STUNAttribute::MAPPED_ADDRESS &&
+			type <= STUNAttribute::REFLECTED_FROM ) ||
+		type == STUN_ATTR_REALM ||
+		type == STUN_ATTR_NONCE ||
+		type == STUN_ATTR_XOR_MAPPED_ADDRESS;
+}
+
+/* Writes an address attribute, XORed with the magic cookie and the
+ * transaction id in key if not NULL, and returns its length */
+static int putAddress( unsigned char *p, int type,
+		const struct sockaddr *addr, const unsigned char *key ){
+	const unsigned char *ip;
+	int ipLength;
+	uint16_t port;
+
+	if( addr->sa_family == AF_INET ){
+		const struct sockaddr_in *sin = (const struct sockaddr_in *)addr;
+		ip = (const unsigned char *)&sin->sin_addr;
+		ipLength = 4;
+		port = ntohs( sin->sin_port );
+	}
+	else if( addr->sa_family == AF_INET6 ){
+		const struct sockaddr_in6 *sin6 = (const struct sockaddr_in6 *)addr;
+		ip = (const unsigned char *)&sin6->sin6_addr;
+		ipLength = 16;
+		port = ntohs( sin6->sin6_port );
+		/* IPv4 peers of a dual stack socket */
+		if( IN6_IS_ADDR_V4MAPPED( &sin6->sin6_addr ) ){
+			ip += 12;
+			ipLength = 4;
+		}
+	}
+	else{
+		return 0;
+	}
+
+	put16( p, (uint16_t)type );
+	put16( p + 2, (uint16_t)( 4 + ipLength ) );
+	p[4] = 0;
+	p[5] = ipLength == 4 ? 0x01 : 0x02;
+	put16( p + 6, key ? (uint16_t)( port ^ ( STUN_MAGIC_COOKIE >> 16 ) ) : port );
+	for( int i = 0; i < ipLength; i++ ){
+		p[8 + i] = key ? ip[i] ^ key[i] : ip[i];
+	}
+	return 8 + ipLength;
+}
+
+int STUNServer::handleRequest( const unsigned char *request, int length,
+		const struct sockaddr *from,
+		const struct sockaddr *local,
+		unsigned char *response ){
+	uint16_t unknown[STUN_SERVER_MAX_UNKNOWN];
+	int nUnknown = 0;
+	bool fingerprint = false;
+
+	if( length < 20 || get16( request ) != STUNMessage::BINDING_REQUEST ){
+		return 0;
+	}
+
+	int messageLength = get16( request + 2 );
+	bool rfc5389 = get32( request + 4 ) == STUN_MAGIC_COOKIE;
+	if( 20 + messageLength != length || ( rfc5389 && messageLength % 4 ) ){
+		return 0;
+	}
+
+	const unsigned char *attr = request + 20;
+	const unsigned char *end = request + length;
+	while( attr + 4 <= end ){
+		uint16_t type = get16( attr );
+		uint16_t attrLength = get16( attr + 2 );
+		const unsigned char *value = attr + 4;
+
+		if( value + attrLength > end ){
+			return 0;
+		}
+
+		if( type == STUNAttribute::CHANGE_REQUEST ){
+			/* There is no other address to answer from */
+			if( attrLength < 4 ||
+					value[3] & ( CHANGE_IP_MASK | CHANGE_PORT_MASK ) ){
+				return 0;
+			}
+		}
+		else if( type == STUN_ATTR_FINGERPRINT ){
+			if( attrLength != 4 || get32( value ) !=
+					( crc32( request, (int)( attr - request ) ) ^ STUN_FINGERPRINT_XOR ) ){
+				return 0;
+			}
+			fingerprint = true;
+		}
+		else if( type < 0x8000 && !isKnownAttribute( type ) &&
+				nUnknown < STUN_SERVER_MAX_UNKNOWN ){
+			unknown[nUnknown++] = type;
+		}
+
+		attr = value + ( ( attrLength + 3 ) & ~3 );
+	}
+
+	/* The magic cookie and the transaction id */
+	memcpy( response + 4, request + 4, 16 );
+
+	unsigned char *p = response + 20;
+	int type = STUNMessage::BINDING_RESPONSE;
+	if( nUnknown > 0 ){
+		static const char reason[] = "Unknown Attribute";
+		int reasonLength = sizeof( reason ) - 1;
+
+		type = STUNMessage::BINDING_ERROR_RESPONSE;
+
+		put16( p, (uint16_t)STUNAttribute::ERROR_CODE );
+		put16( p + 2, (uint16_t)( 4 + reasonLength ) );
+		p[4] = p[5] = 0;
+		p[6] = 4;
+		p[7] = 20;
+		memcpy( p + 8, reason, reasonLength );
+		p += 8 + reasonLength;
+		while( ( p - response ) % 4 ){
+			*p++ = ' ';
+		}
+
+		put16( p, (uint16_t)STUNAttribute::UNKNOWN_ATTRIBUTES );
+		put16( p + 2, (uint16_t)( 2 * nUnknown ) );
+		p += 4;
+		for( int i = 0; i < nUnknown; i++ ){
+			put16( p, unknown[i] );
+			p += 2;
+		}
+		/* RFC 3489 pads by repeating an attribute */
+		if( nUnknown % 2 ){
+			put16( p, unknown[0] );
+			p += 2;
+		}
+	}
+	else if( rfc5389 ){
+		p += putAddress( p, STUN_ATTR_XOR_MAPPED_ADDRESS, from, request + 4 );
+	}
+	else{
+		p += putAddress( p, STUNAttribute::MAPPED_ADDRESS, from, NULL );
+		if( local ){
+			p += putAddress( p, STUNAttribute::SOURCE_ADDRESS, local, NULL );
+			p += putAddress( p, STUNAttribute::CHANGED_ADDRESS, local, NULL );
+		}
+	}
+
+	/* The length in the header covers the fingerprint, which
+	 * covers the header */
+	put16( response, (uint16_t)type );
+	put16( response + 2, (uint16_t)( p - response - 20 + ( fingerprint ? 8 : 0 ) ) );
+	if( fingerprint ){
+		uint32_t crc = crc32( response, (int)( p - response ) );
+		put16( p, STUN_ATTR_FINGERPRINT );
+		put16( p + 2, 4 );
+		put32( p + 4, crc ^ STUN_FINGERPRINT_XOR );
+		p += 8;
+	}
+
+	return (int)( p - response );
+}
+
+/**
+ * Thread answering the requests received on a socket.
+*/
+class STUNServerWorker : public Runnable{
+	public:
+		STUNServerWorker( int fd, const struct sockaddr_storage &bound, bool specific );
+
+		virtual void run();
+
+		void stop(){ quit = true; }
+
+		uint64_t nRequests;
+		uint64_t nResponses;
+		uint64_t nDropped;
+
+		virtual std::string getMemObjectType() const {return "STUNServerWorker";}
+
+	private:
+		void runSimple();
+#ifdef STUN_SERVER_MMSG
+		void runBatched();
+#endif
+
+		int fd;
+		volatile bool quit;
+
+		/* Address bound, and whether it is not a wildcard so
+		 * that it is the local address of all the requests */
+		struct sockaddr_storage bound;
+		bool specific;
+
+		unsigned char requests[STUN_SERVER_BATCH][STUN_SERVER_MAX_REQUEST];
+		unsigned char responses[STUN_SERVER_BATCH][STUN_SERVER_MAX_RESPONSE];
+		struct sockaddr_storage peers[STUN_SERVER_BATCH];
+
+#ifdef STUN_SERVER_MMSG
+		union Control{
+			struct cmsghdr align;
+			char buf[ CMSG_SPACE( sizeof( struct in6_pktinfo ) ) ];
+		};
+
+		Control received[STUN_SERVER_BATCH];
+		Control reply[STUN_SERVER_BATCH];
+		struct iovec inVec[STUN_SERVER_BATCH];
+		struct iovec outVec[STUN_SERVER_BATCH];
+		struct mmsghdr in[STUN_SERVER_BATCH];
+		struct mmsghdr out[STUN_SERVER_BATCH];
+#endif
+};
+
+STUNServerWorker::STUNServerWorker( int f, const struct sockaddr_storage &b, bool s ):
+		nRequests( 0 ), nResponses( 0 ), nDropped( 0 ),
+		fd( f ), quit( false ), bound( b ), specific( s ){
+}
+
+void STUNServerWorker::run(){
+#ifdef STUN_SERVER_MMSG
+	runBatched();
+#else
+	runSimple();
+#endif
+}
+
+void STUNServerWorker::runSimple(){
+	while( !quit ){
+		fd_set rfds;
+		struct timeval tv;
+
+		FD_ZERO( &rfds );
+#ifdef WIN32
+		FD_SET( (uint32_t) fd, &rfds );
+#else
+		FD_SET( fd, &rfds );
+#endif
+		tv.tv_sec = 0;
+		tv.tv_usec = STUN_SERVER_POLL_MS * 1000;
+
+		if( select( fd + 1, &rfds, NULL, NULL, &tv ) <= 0 ){
+			continue;
+		}
+
+		/* The socket is non blocking and may be shared with
+		 * other threads, read until it is empty */
+		for( ;; ){
+			socklen_t fromLength = sizeof( peers[0] );
+			int n = recvfrom( fd, (char *)requests[0], STUN_SERVER_MAX_REQUEST, 0,
+					(struct sockaddr *)&peers[0], &fromLength );
+			if( n < 0 ){
+				break;
+			}
+
+			nRequests++;
+			int len = STUNServer::handleRequest( requests[0], n, (struct sockaddr *)&peers[0],
+					specific ? (struct sockaddr *)&bound : NULL,
+					responses[0] );
+			if( len == 0 || sendto( fd, (const char *)responses[0], len, 0,
+					(struct sockaddr *)&peers[0], fromLength ) != len ){
+				nDropped++;
+				continue;
+			}
+			nResponses++;
+		}
+	}
+}
+
+#ifdef STUN_SERVER_MMSG
+
+/* Gives the address a request was sent to, from its IP_PKTINFO or
+ * IPV6_PKTINFO, and writes the control message that sends the
+ * response from that address. Returns the length of the control
+ * message, 0 if there is none. */
+static size_t takePktInfo( struct msghdr *h, int port,
+		struct sockaddr_storage &local, void *reply ){
+	struct cmsghdr *c;
+
+	for( c = CMSG_FIRSTHDR( h ); c; c = CMSG_NXTHDR( h, c ) ){
+		if( c->cmsg_level == IPPROTO_IP && c->cmsg_type == IP_PKTINFO ){
+			struct in_pktinfo info;
+			memcpy( &info, CMSG_DATA( c ), sizeof( info ) );
+
+			struct sockaddr_in *sin = (struct sockaddr_in *)&local;
+			memset( sin, 0, sizeof( *sin ) );
+			sin->sin_family = AF_INET;
+			sin->sin_addr = info.ipi_addr;
+			sin->sin_port = htons( (uint16_t)port );
+
+			info.ipi_ifindex = 0;
+			info.ipi_spec_dst = info.ipi_addr;
+			struct cmsghdr *r = (struct cmsghdr *)reply;
+			r->cmsg_level = IPPROTO_IP;
+			r->cmsg_type = IP_PKTINFO;
+			r->cmsg_len = CMSG_LEN( sizeof( info ) );
+			memcpy( CMSG_DATA( r ), &info, sizeof( info ) );
+			return CMSG_SPACE( sizeof( info ) );
+		}
+		if( c->cmsg_level == IPPROTO_IPV6 && c->cmsg_type == IPV6_PKTINFO ){
+			struct in6_pktinfo info;
+			memcpy( &info, CMSG_DATA( c ), sizeof( info ) );
+
+			struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)&local;
+			memset( sin6, 0, sizeof( *sin6 ) );
+			sin6->sin6_family = AF_INET6;
+			sin6->sin6_addr = info.ipi6_addr;
+			sin6->sin6_port = htons( (uint16_t)port );
+
+			/* The interface is kept for link local peers */
+			struct cmsghdr *r = (struct cmsghdr *)reply;
+			r->cmsg_level = IPPROTO_IPV6;
+			r->cmsg_type = IPV6_PKTINFO;
+			r->cmsg_len = CMSG_LEN( sizeof( info ) );
+			memcpy( CMSG_DATA( r ), &info, sizeof( info ) );
+			return CMSG_SPACE( sizeof( info ) );
+		}
+	}
+	return 0;
+}
+
+void STUNServerWorker::runBatched(){
+	int port;
+	if( bound.ss_family == AF_INET ){
+		port = ntohs( ( (struct sockaddr_in *)&bound )->sin_port );
+	}
+	else{
+		port = ntohs( ( (struct sockaddr_in6 *)&bound )->sin6_port );
+	}
+
+	int ep = epoll_create( 1 );
+	struct epoll_event ev;
+	memset( &ev, 0, sizeof( ev ) );
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+	if( ep < 0 || epoll_ctl( ep, EPOLL_CTL_ADD, fd, &ev ) < 0 ){
+		if( ep >= 0 ){
+			close( ep );
+		}
+		runSimple();
+		return;
+	}
+
+	memset( in, 0, sizeof( in ) );
+	memset( out, 0, sizeof( out ) );
+	for( int i = 0; i < STUN_SERVER_BATCH; i++ ){
+		inVec[i].iov_base = requests[i];
+		inVec[i].iov_len = STUN_SERVER_MAX_REQUEST;
+		in[i].msg_hdr.msg_iov = &inVec[i];
+		in[i].msg_hdr.msg_iovlen = 1;
+		in[i].msg_hdr.msg_name = &peers[i];
+		in[i].msg_hdr.msg_control = received[i].buf;
+
+		outVec[i].iov_base = responses[i];
+		out[i].msg_hdr.msg_iov = &outVec[i];
+		out[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	while( !quit ){
+		if( epoll_wait( ep, &ev, 1, STUN_SERVER_POLL_MS ) <= 0 ){
+			continue;
+		}
+
+		for( ;; ){
+			for( int i = 0; i < STUN_SERVER_BATCH; i++ ){
+				in[i].msg_hdr.msg_namelen = sizeof( peers[i] );
+				in[i].msg_hdr.msg_controllen = sizeof( received[i].buf );
+			}
+
+			int n = recvmmsg( fd, in, STUN_SERVER_BATCH, MSG_DONTWAIT, NULL );
+			if( n <= 0 ){
+				break;
+			}
+			nRequests += n;
+
+			int m = 0;
+			for( int i = 0; i < n; i++ ){
+				struct sockaddr_storage local;
+				size_t control = takePktInfo( &in[i].msg_hdr, port, local, reply[m].buf );
+				const struct sockaddr *localp = NULL;
+
+				if( control > 0 ){
+					localp = (struct sockaddr *)&local;
+				}
+				else if( specific ){
+					localp = (struct sockaddr *)&bound;
+				}
+
+				int len = 0;
+				if( !( in[i].msg_hdr.msg_flags & MSG_TRUNC ) ){
+					len = STUNServer::handleRequest( requests[i], in[i].msg_len,
+							(struct sockaddr *)&peers[i], localp,
+							responses[m] );
+				}
+				if( len == 0 ){
+					nDropped++;
+					continue;
+				}
+
+				outVec[m].iov_len = len;
+				out[m].msg_hdr.msg_name = &peers[i];
+				out[m].msg_hdr.msg_namelen = in[i].msg_hdr.msg_namelen;
+				out[m].msg_hdr.msg_control = control > 0 ? reply[m].buf : NULL;
+				out[m].msg_hdr.msg_controllen = control;
+				m++;
+			}
+
+			int sent = 0;
+			while( sent < m ){
+				int s = sendmmsg( fd, out + sent, m - sent, MSG_DONTWAIT );
+				if( s < 0 && errno == EINTR ){
+					continue;
+				}
+				if( s <= 0 ){
+					/* The send buffer is full, UDP may
+					 * lose the responses anyway */
+					break;
+				}
+				sent += s;
+			}
+			nResponses += sent;
+			nDropped += m - sent;
+
+			if( n < STUN_SERVER_BATCH ){
+				break;
+			}
+		}
+	}
+	close( ep );
+}
+
+#endif
+
+/* Binds a non blocking UDP socket, sharing the port with the other
+ * threads if reusePort */
+static int openSocket( const struct sockaddr *addr, int addrLength, bool &reusePort ){
+	int on = 1;
+	int fd = (int)socket( addr->sa_family, SOCK_DGRAM, IPPROTO_UDP );
+	if( fd < 0 ){
+		throw SocketFailed( errno );
+	}
+
+#ifdef SO_REUSEPORT
+	if( reusePort && setsockopt( fd, SOL_SOCKET, SO_REUSEPORT, (const char *)&on, sizeof( on ) ) < 0 ){
+		reusePort = false;
+	}
+#else
+	reusePort = false;
+#endif
+
+#ifdef STUN_SERVER_MMSG
+	if( addr->sa_family == AF_INET6 ){
+		setsockopt( fd, IPPROTO_IPV6, IPV6_RECVPKTINFO, &on, sizeof( on ) );
+	}
+	/* Also for the IPv4 requests of a dual stack socket */
+	setsockopt( fd, IPPROTO_IP, IP_PKTINFO, &on, sizeof( on ) );
+#endif
+
+#ifdef WIN32
+	unsigned long arg = 1;
+	ioctlsocket( fd, FIONBIO, &arg );
+#else
+	fcntl( fd, F_SETFL, fcntl( fd, F_GETFL ) | O_NONBLOCK );
+#endif
+
+	if( bind( fd, addr, addrLength ) < 0 ){
+		int err = errno;
+		closesocket( fd );
+		throw BindFailed( err );
+	}
+	return fd;
+}
+
+STUNServer::STUNServer( string a, int p, int t ):
+		address( a ), port( p ), nThreads( t > 0 ? t : 1 ){
+}
+
+STUNServer::~STUNServer(){
+	stop();
+}
+
+void STUNServer::start(){
+	MRef<IPAddress *> addr = IPAddress::create( address );
+	bool reusePort = nThreads > 1;
+
+	try{
+		struct sockaddr_storage bound;
+		socklen_t boundLength = sizeof( bound );
+
+		sockets.push_back( openSocket( addr->getSockaddrptr( port ),
+				addr->getSockaddrLength(), reusePort ) );
+		if( getsockname( sockets[0], (struct sockaddr *)&bound, &boundLength ) < 0 ){
+			throw GetSockNameFailed( errno );
+		}
+
+		bool specific;
+		if( bound.ss_family == AF_INET ){
+			struct sockaddr_in *sin = (struct sockaddr_in *)&bound;
+			port = ntohs( sin->sin_port );
+			specific = sin->sin_addr.s_addr != htonl( INADDR_ANY );
+		}
+		else{
+			struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)&bound;
+			port = ntohs( sin6->sin6_port );
+			specific = !IN6_IS_ADDR_UNSPECIFIED( &sin6->sin6_addr );
+		}
+
+		/* Without SO_REUSEPORT the threads share the socket */
+		for( int i = 1; i < nThreads && reusePort; i++ ){
+			sockets.push_back( openSocket( addr->getSockaddrptr( port ),
+					addr->getSockaddrLength(), reusePort ) );
+		}
+
+		for( int i = 0; i < nThreads; i++ ){
+			int fd = sockets[ i < (int)sockets.size() ? i : 0 ];
+			workers.push_back( new STUNServerWorker( fd, bound, specific ) );
+		}
+	}
+	catch( NetworkException & ){
+		stop();
+		throw;
+	}
+
+	for( size_t i = 0; i < workers.size(); i++ ){
+		threads.push_back( new Thread( *workers[i] ) );
+	}
+}
+
+void STUNServer::stop(){
+	size_t i;
+
+	for( i = 0; i < workers.size(); i++ ){
+		workers[i]->stop();
+	}
+	for( i = 0; i < threads.size(); i++ ){
+		threads[i]->join();
+	}
+	for( i = 0; i < sockets.size(); i++ ){
+		closesocket( sockets[i] );
+	}
+	threads.clear();
+	workers.clear();
+	sockets.clear();
+}
+
+uint64_t STUNServer::getRequests(){
+	uint64_t n = 0;
+	for( size_t i = 0; i < workers.size(); i++ ){
+		n += workers[i]->nRequests;
+	}
+	return n;
+}
+
+uint64_t STUNServer::getResponses(){
+	uint64_t n = 0;
+	for( size_t i = 0; i < workers.size(); i++ ){
+		n += workers[i]->nResponses;
+	}
+	return n;
+}
+
+uint64_t STUNServer::getDropped(){
+	uint64_t n = 0;
+	for( size_t i = 0; i < workers.size(); i++ ){
+		n += workers[i]->nDropped;
+	}
+	return n;
+}
@@ -0,0 +1,247 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Test of STUNClient against local STUN servers: STUNServer, and a
+ * stand-in on a SocketServer answering with STUNServer::handleRequest
+ * once it has dropped a number of requests, to see the
+ * retransmissions and timeouts.
+*/
+
+#include<config.h>
+
+#include<libmstun/STUN.h>
+#include<libmstun/STUNClient.h>
+#include<libmstun/STUNServer.h>
+
+#include<libmutil/CondVar.h>
+#include<libmutil/Mutex.h>
+#include<libmutil/Thread.h>
+#include<libmnetutil/IPAddress.h>
+#include<libmnetutil/SocketServer.h>
+#include<libmnetutil/UDPSocket.h>
+
+#include<iostream>
+#include<map>
+#include<string.h>
+#include<sys/socket.h>
+#include<sys/time.h>
+
+using namespace std;
+
+#define N_REQUESTS 200
+
+/* Short timing, as a test runs to the end of the transactions */
+#define TEST_RTO 20
+#define TEST_RC 3
+#define TEST_RM 4
+
+/* The timeouts are kept in whole ms, each may expire up to 1 ms
+ * earlier than measured here */
+#define TEST_SLACK 1
+
+static int failures = 0;
+
+static void check( bool ok, const string &what ){
+	if( !ok ){
+		cerr << "FAILED: " << what << endl;
+		failures++;
+	}
+}
+
+static double now(){
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec * 1e3 + tv.tv_usec / 1e3;
+}
+
+/* Answers after dropping the first requests, never if drop < 0 */
+class StandIn : public InputReadyHandler{
+	public:
+		StandIn( int d ): socket( new UDPSocket() ), drop( d ), received( 0 ){}
+
+		virtual void inputReady( MRef<Socket *> ){
+			unsigned char request[1500];
+			unsigned char response[STUN_SERVER_MAX_RESPONSE];
+			struct sockaddr_storage from;
+			socklen_t fromLength = sizeof( from );
+
+			int n = recvfrom( socket->getFd(), request, sizeof( request ), 0,
+					(struct sockaddr *)&from, &fromLength );
+			if( n <= 0 ){
+				return;
+			}
+			received++;
+			if( drop < 0 || received <= drop ){
+				return;
+			}
+
+			int length = STUNServer::handleRequest( request, n,
+					(struct sockaddr *)&from, NULL, response );
+			if( length > 0 ){
+				sendto( socket->getFd(), response, length, 0,
+						(struct sockaddr *)&from, fromLength );
+			}
+		}
+
+		virtual std::string getMemObjectType() const {return "StandIn";}
+
+		MRef<UDPSocket *> socket;
+		int drop;
+		int received;
+};
+
+class Results : public STUNClientHandler, public STUNNatTypeHandler{
+	public:
+		Results(): natType( -1 ){}
+
+		virtual void stunResult( uint32_t request, const STUNResult &result ){
+			lock.lock();
+			check( results.find( request ) == results.end(),
+					"one result per request" );
+			results[request] = result;
+			cond.broadcast();
+			lock.unlock();
+		}
+
+		virtual void natTypeResult( int type, const STUNResult & ){
+			lock.lock();
+			natType = type;
+			cond.broadcast();
+			lock.unlock();
+		}
+
+		/* Waits for n results, or the NAT type if n is 0 */
+		bool wait( size_t n, int ms ){
+			double end = now() + ms;
+			lock.lock();
+			while( ( n ? results.size() < n : natType < 0 ) && now() < end ){
+				cond.wait( lock, 10 );
+			}
+			bool ret = n ? results.size() >= n : natType >= 0;
+			lock.unlock();
+			return ret;
+		}
+
+		virtual std::string getMemObjectType() const {return "Results";}
+
+		Mutex lock;
+		CondVar cond;
+		map<uint32_t, STUNResult> results;
+		int natType;
+};
+
+int main( int argc, char *argv[] ){
+	MRef<SocketServer *> sockets = new SocketServer();
+	MRef<STUNTimeoutProvider *> timeouts = new STUNTimeoutProvider();
+	MRef<IPAddress *> localhost = IPAddress::create( "127.0.0.1" );
+	sockets->start();
+
+	MRef<STUNServer *> server = new STUNServer( "127.0.0.1", 0, 1 );
+	server->start();
+
+	MRef<UDPSocket *> socket = new UDPSocket();
+	MRef<STUNClient *> client = new STUNClient( socket, timeouts, sockets );
+
+	/* Many requests outstanding at once, answered out of order
+	 * with respect to their slots once some are reused */
+	MRef<Results *> results = new Results();
+	map<uint32_t, bool> sent;
+	for( int i = 0; i < N_REQUESTS; i++ ){
+		uint32_t request = client->sendBindingRequest( localhost,
+				(uint16_t)server->getPort(), *results );
+		check( request != 0 && !sent[request], "distinct requests" );
+		sent[request] = true;
+	}
+	check( results->wait( N_REQUESTS, 5000 ), "all the requests completed" );
+	map<uint32_t, STUNResult>::iterator i;
+	for( i = results->results.begin(); i != results->results.end(); i++ ){
+		check( sent.count( i->first ) == 1, "known request" );
+		check( i->second.status == STUN_RESULT_OK, "success response" );
+		check( string( i->second.mappedIP ) == "127.0.0.1" &&
+				i->second.mappedPort == socket->getPort(),
+				"XOR-MAPPED-ADDRESS of the client" );
+	}
+	check( client->getPending() == 0, "no request left" );
+
+	/* Retransmitted until the stand-in answers */
+	client->setRetransmission( TEST_RTO, TEST_RC, TEST_RM );
+	MRef<StandIn *> lossy = new StandIn( 2 );
+	sockets->addSocket( *lossy->socket, *lossy );
+	results = new Results();
+	double start = now();
+	uint32_t request = client->sendBindingRequest( localhost,
+			(uint16_t)lossy->socket->getPort(), *results );
+	check( results->wait( 1, 2000 ), "lossy completed" );
+	STUNResult r = results->results[request];
+	check( r.status == STUN_RESULT_OK && r.transmissions == 3,
+			"answered at the third transmission" );
+	check( now() - start >= TEST_RTO * 3 - 2 * TEST_SLACK,
+			"retransmissions after RTO, 2 * RTO" );
+	sockets->removeSocket( *lossy->socket );
+
+	/* Never answered: Rc transmissions, then Rm * RTO */
+	MRef<StandIn *> silent = new StandIn( -1 );
+	sockets->addSocket( *silent->socket, *silent );
+	results = new Results();
+	start = now();
+	request = client->sendBindingRequest( localhost,
+			(uint16_t)silent->socket->getPort(), *results );
+	check( results->wait( 1, 2000 ), "silent completed" );
+	double elapsed = now() - start;
+	r = results->results[request];
+	check( r.status == STUN_RESULT_TIMEOUT && r.transmissions == TEST_RC,
+			"timeout after Rc transmissions" );
+	check( silent->received == TEST_RC, "Rc requests received" );
+	check( elapsed >= TEST_RTO * ( 1 + 2 + TEST_RM ) - 3 * TEST_SLACK,
+			"timeout after Rm * RTO" );
+
+	/* Cancelled, the handler is not called */
+	results = new Results();
+	request = client->sendBindingRequest( localhost,
+			(uint16_t)silent->socket->getPort(), *results );
+	client->cancel( request );
+	check( !results->wait( 1, TEST_RTO * 10 ), "no result once cancelled" );
+	check( client->getPending() == 0, "cancelled request released" );
+	sockets->removeSocket( *silent->socket );
+
+	/* The NAT type sequence: the mapped address is local, and
+	 * STUNServer drops the requests to change address */
+	vector<string> localIPs;
+	localIPs.push_back( "127.0.0.1" );
+	results = new Results();
+	MRef<STUNNatTypeQuery *> query = new STUNNatTypeQuery( client,
+			localhost, (uint16_t)server->getPort(), localIPs,
+			(uint16_t)socket->getPort(), *results );
+	query->start();
+	check( results->wait( 0, 2000 ), "NAT type found" );
+	check( results->natType == STUN::STUNTYPE_SYMMETRIC_FIREWALL,
+			string( "symmetric firewall, got " ) +
+			STUN::typeToString( results->natType < 0 ? 0 : results->natType ) );
+
+	client->close();
+	server->stop();
+	sockets->stop();
+	sockets->join();
+	timeouts->stopThread();
+
+	if( failures ){
+		cerr << failures << " checks failed" << endl;
+		return 1;
+	}
+	cout << "STUNClient: all checks passed" << endl;
+	return 0;
+}
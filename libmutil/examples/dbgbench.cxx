@@ -0,0 +1,92 @@
+/* dbgbench: distributed with @PACKAGE@-@PACKAGE_VERSION@ */
+/*
+ * Measures the cost of a debug statement that is discarded, and the
+ * number of lines per second eight threads can log, written directly
+ * and through the background writer.
+ */
+#include<libmutil/dbg.h>
+#include<libmutil/Thread.h>
+#include<libmutil/mtime.h>
+#include<iostream>
+#include<assert.h>
+
+using namespace std;
+
+#define DISABLED_ITERATIONS 10000000
+#define THREADS 8
+#define LINES_PER_THREAD 50000
+
+class NullHandler: public DbgHandler{
+	public:
+		NullHandler():lines(0){}
+		volatile int lines;
+	protected:
+		virtual void displayMessage(string, int){
+			lines++;
+		}
+};
+
+static Dbg *bench;
+
+static void logLines(){
+	for (int i=0; i<LINES_PER_THREAD; i++){
+		(*bench)("bench/threads") << "line " << i << " of thread" << endl;
+	}
+}
+
+static double nsPerStatement(uint64_t start){
+	return (mtime()-start)*1e6/DISABLED_ITERATIONS;
+}
+
+static void runThreads(bool async){
+	NullHandler handler;
+	bench = new Dbg("bench", false, true, async);
+	bench->setExternalHandler(&handler);
+
+	ThreadHandle threads[THREADS];
+	uint64_t start = mtime();
+	for (int i=0; i<THREADS; i++)
+		threads[i] = Thread::createThread(logLines);
+	for (int i=0; i<THREADS; i++)
+		Thread::join(threads[i]);
+	bench->flush();
+	uint64_t ms = mtime()-start;
+
+	assert(handler.lines == THREADS*LINES_PER_THREAD);
+	cout << THREADS << " threads, " << (async?"asynchronous":"synchronous") << ": "
+		<< (ms ? THREADS*LINES_PER_THREAD*1000/ms : 0) << " lines/s" << endl;
+	delete bench;
+}
+
+int main(int argc, char **argv){
+	uint64_t start;
+	int i;
+
+	Dbg disabled("disabled", false, false);
+	start = mtime();
+	for (i=0; i<DISABLED_ITERATIONS; i++)
+		disabled("signaling/sip") << "destination " << i << endl;
+	cout << "disabled stream:   " << nsPerStatement(start) << " ns/statement" << endl;
+
+	Dbg filtered("filtered");
+	NullHandler handler;
+	filtered.setExternalHandler(&handler);
+	filtered.exclude("signaling");
+	start = mtime();
+	for (i=0; i<DISABLED_ITERATIONS; i++)
+		filtered("signaling/sip") << "destination " << i << endl;
+	cout << "filtered class:    " << nsPerStatement(start) << " ns/statement" << endl;
+
+	DbgCategory sipDbg(filtered, "signaling/sip");
+	start = mtime();
+	for (i=0; i<DISABLED_ITERATIONS; i++)
+		if (sipDbg.isEnabled())
+			sipDbg() << "destination " << i << endl;
+	cout << "DbgCategory check: " << nsPerStatement(start) << " ns/statement" << endl;
+	assert(handler.lines == 0);
+
+	runThreads(false);
+	runThreads(true);
+
+	return 0;
+}
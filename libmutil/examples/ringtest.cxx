@@ -0,0 +1,91 @@
+/* ringtest: distributed with @PACKAGE@-@PACKAGE_VERSION@ */
+/*
+ * Stress test of SPSCCircularBuffer: a producer thread writes a
+ * counting sequence in blocks of random size while the consumer
+ * reads blocks of other random sizes, and checks that every element
+ * arrives once and in order.
+ */
+#include<libmutil/CircularBuffer.h>
+#include<libmutil/Thread.h>
+#include<iostream>
+#include<stdlib.h>
+#include<sched.h>
+#include<assert.h>
+
+using namespace std;
+
+#define RING_SIZE 1000
+#define ELEMENTS 10000000
+#define MAX_BLOCK 300
+
+static SPSCCircularBuffer *ring;
+
+static void produce(){
+	short block[MAX_BLOCK];
+	unsigned int seed = 1;
+	int n = 0;
+
+	while (n < ELEMENTS){
+		int len = rand_r(&seed) % MAX_BLOCK + 1;
+		if (len > ELEMENTS - n)
+			len = ELEMENTS - n;
+		for (int i=0; i<len; i++)
+			block[i] = (short)(n + i);
+		while (!ring->write(block, len))
+			sched_yield();
+		n += len;
+	}
+}
+
+int main(int argc, char **argv){
+	short block[MAX_BLOCK];
+	unsigned int seed = 2;
+	int n = 0;
+	long failedReads = 0;
+
+	ring = new SPSCCircularBuffer(RING_SIZE);
+	assert(ring->getMaxSize() == RING_SIZE);
+	assert(ring->getFree() == RING_SIZE);
+
+	ThreadHandle producer = Thread::createThread(produce);
+
+	while (n < ELEMENTS){
+		int len = rand_r(&seed) % MAX_BLOCK + 1;
+		if (len > ELEMENTS - n)
+			len = ELEMENTS - n;
+		int size = ring->getSize();
+		assert(size >= 0 && size <= RING_SIZE);
+		if (!ring->read(block, len)){
+			failedReads++;
+			sched_yield();
+			continue;
+		}
+		for (int i=0; i<len; i++){
+			if (block[i] != (short)(n + i)){
+				cerr << "Element " << n + i << " is " << block[i] << endl;
+				return 1;
+			}
+		}
+		n += len;
+	}
+
+	Thread::join(producer);
+
+	assert(ring->getSize() == 0);
+	assert(ring->getByteCounter() == ELEMENTS);
+
+	/* Writes that do not fit fail whole, reads of too much too */
+	short full[RING_SIZE + 1];
+	assert(!ring->write(full, RING_SIZE + 1));
+	assert(ring->write(full, RING_SIZE));
+	assert(!ring->write(full, 1));
+	assert(!ring->read(full, RING_SIZE + 1));
+	assert(ring->remove(RING_SIZE / 2));
+	assert(ring->getSize() == RING_SIZE - RING_SIZE / 2);
+	ring->clear();
+	assert(ring->getSize() == 0);
+
+	cerr << ELEMENTS << " elements passed, " << failedReads << " reads found the ring empty" << endl;
+	delete ring;
+	return 0;
+}
@@ -147,4 +147,112 @@ class LIBMUTIL_API CircularBuffer {
 		unsigned long byteCounter;
 };
 
+/**
+Cache line size assumed to keep data written by different threads apart
+*/
+#define CIRCULAR_BUFFER_CACHE_LINE 64
+
+/**
+A circular buffer for shorts with a single writer thread and
+a single reader thread, that need no lock.
+
+write() may only be called by one thread (the producer), and read(),
+remove() and clear() only by one other thread (the consumer). None
+of them ever waits for the other thread.
+
+The storage is rounded up to a power of two, but no more than the
+requested number of elements is ever kept, so that the buffer bounds
+the delay the same way a CircularBuffer does. It can not overwrite
+old contents: a write that does not fit fails, and the data is
+dropped.
+*/
+class LIBMUTIL_API SPSCCircularBuffer {
+	public:
+		SPSCCircularBuffer(int size);
+		virtual ~SPSCCircularBuffer();
+
+		/**
+		Write len elements from buffer s into the circular
+		buffer. Producer thread only.
+		@return true if written, false if there was not
+			enough space (nothing is written then).
+		*/
+		bool write( const short *s, int len );
+
+		/**
+		Read len elements from circular buffer to s buffer.
+		Consumer thread only.
+		@param s data buffer, or NULL to only remove the elements
+		@return true if read, false if there were not enough
+			elements (nothing is read then).
+		*/
+		bool read( short *s, int len );
+
+		/**
+		Remove len elements without reading them.
+		Consumer thread only.
+		*/
+		bool remove( int len );
+
+		/**
+		Empty the buffer. Consumer thread only.
+		*/
+		void clear();
+
+		/**
+		Return the currently used slots. Exact when called by
+		the producer or the consumer, a snapshot otherwise.
+		*/
+		int getSize();
+
+		/**
+		Return the max size of the buffer, the one
+		requested when the buffer was created.
+		*/
+		int getMaxSize() { return maxSize; };
+
+		/**
+		Returns how many slots can be written.
+		*/
+		int getFree() { return getMaxSize() - getSize(); };
+
+		/**
+		Return the total number of bytes that have been
+		written into the buffer during all its existence
+		*/
+		unsigned long getByteCounter() { return byteCounter; };
+
+	private:
+		SPSCCircularBuffer(const SPSCCircularBuffer &);
+		SPSCCircularBuffer& operator=(const SPSCCircularBuffer &);
+
+		short *buf;
+
+		/**
+		Storage size minus one, the storage size being a power of two
+		*/
+		unsigned int mask;
+
+		int maxSize;
+
+		char pad0[CIRCULAR_BUFFER_CACHE_LINE];
+
+		/**
+		Elements ever written, only changed by the producer.
+		The index in buf is writeIdx & mask.
+		*/
+		volatile unsigned int writeIdx;
+
+		unsigned long byteCounter;
+
+		char pad1[CIRCULAR_BUFFER_CACHE_LINE];
+
+		/**
+		Elements ever read, only changed by the consumer.
+		*/
+		volatile unsigned int readIdx;
+
+		char pad2[CIRCULAR_BUFFER_CACHE_LINE];
+};
+
 #endif // _CIRCULARBUFFER_H
@@ -21,13 +21,28 @@
 
 #include <libmutil/libmutil_config.h>
 
+#include<list>
+#include<map>
 #include<string>
 #include<libmutil/mtypes.h>
 #include<libmutil/MemObject.h>
 #include<libmutil/Library.h>
+#include<libmutil/Mutex.h>
 
 class MPluginRegistry;
 
+/**
+ * A plugin listed in the manifest cache of MPluginManager, which can
+ * be created without listing the entry points of its library.
+ */
+struct LIBMUTIL_API MPluginEntry{
+	/** Library, as opened */
+	std::string file;
+	std::string entryPoint;
+	std::string name;
+	std::string type;
+};
+
 /**
  * Implements a dynamically loadable plugins support.
  *
@@ -159,11 +174,54 @@ class LIBMUTIL_API MPluginManager: public MObject{
 		 **/
 		bool setSearchPath( const std::string &searchPath );
 
+		/**
+		 * Sets the file caching the plugins of each library
+		 * opened, with the time of modification and the size
+		 * of the library.
+		 * loadFromFile and loadFromDirectory do not open the
+		 * libraries found unchanged in the cache: their
+		 * plugins are given to the registries as entries, and
+		 * created on first use if the registry is lazy (see
+		 * MPluginRegistry::isLazy).
+		 * The cache is written, if changed, at the end of
+		 * loadFromDirectory.
+		 * @param file Path of the cache, "" for none, which
+		 * is the default.
+		 */
+		void setManifestFile( const std::string &file );
+
 	protected:
 		MPluginManager();
 
 	private:
+		struct ManifestLibrary{
+			std::string file;
+			int64_t mtime;
+			int64_t size;
+			std::list< MPluginEntry > plugins;
+			bool used;
+		};
+
+		bool loadFromManifest( const std::string &filename,
+				int32_t &nPlugins );
+		void addToManifest( const std::string &filename,
+				MRef<Library *> lib,
+				const std::list< MPluginEntry > &plugins );
+		void readManifest();
+		void writeManifest();
+		bool registerEntry( const MPluginEntry &entry );
+		MPluginRegistry * findRegistry( const std::string &type );
+
 		static MRef<MPluginManager*> instance;
+
+		// Manifest cache, by file name given to loadFromFile
+		std::string manifestFile;
+		std::map< std::string, ManifestLibrary > manifest;
+		bool manifestChanged;
+
+		// Taken by loadFromLibrary, called by the registries
+		// creating their plugins on first use
+		Mutex libraryLock;
 		
 		// List of the already opened libraries for plugins,
 		// to avoid loading them twice
@@ -188,16 +246,41 @@ class LIBMUTIL_API MPluginRegistry: public MObject {
 
 		virtual void registerPlugin( MRef<MPlugin *> p );
 
+		/**
+		 * Adds a plugin listed in the manifest cache. A lazy
+		 * registry creates it when findPlugin first asks for
+		 * its name, the others at once.
+		 */
+		virtual void addEntry( const MPluginEntry &entry );
+
+		/**
+		 * @returns true if the plugins of the manifest cache
+		 * are created on first use. Only the plugins created
+		 * are iterated over by begin() and end(), so a
+		 * registry going through all its plugins is not lazy,
+		 * which is the default.
+		 */
+		virtual bool isLazy() const;
+
 		const_iterator begin() const;
 		const_iterator end() const;
 
 	protected:
 		virtual MRef<MPlugin*> findPlugin( std::string name ) const;
 
+		/**
+		 * Creates the plugins of the entries added.
+		 */
+		void loadEntries();
+
 		std::list< MRef<MPlugin *> > plugins;
 
 	private:
+		MRef<MPlugin*> loadEntry( const std::string &name );
+
 		MRef<MPluginManager*> manager;
+		std::list< MPluginEntry > entries;
+		mutable Mutex entriesLock;
 };
 
 #endif
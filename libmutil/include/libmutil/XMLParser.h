@@ -108,6 +108,12 @@ class LIBMUTIL_API XMLParser : public MObject{
 		void addValue(std::string elementPath, std::string value);
 		void changeValue(std::string elemPath, std::string value, bool addIfMissing=true);
 
+		/**
+		 * @return	The root of the tree, above the top level
+		 * 		elements of the document.
+		 */
+		XMLNode *getRoot(){return root;}
+
 		std::string getMemObjectType(){return "XMLParser";}
 		
 	protected:
@@ -56,7 +56,21 @@
  *
  *   Example 4, make dgb include "myapp/gui" and all sub-classes.
  *      dbg.include("myapp/gui");
- *    
+ *
+ * Cost:
+ *   The output class and the partial line are kept per thread, so
+ *   threads writing to the same stream do not mix up their classes.
+ *   Nothing is formatted while the stream is disabled or the current
+ *   class is filtered out. Hot paths can additionally skip building
+ *   their arguments with a DbgCategory:
+ *      static DbgCategory sipDbg( mdbg, "signaling/sip" );
+ *      if( sipDbg.isEnabled() )
+ *              sipDbg() << "Destination " << uri.getString() << endl;
+ *
+ *   A stream made asynchronous with setAsynchronous(true) hands
+ *   complete lines to a background thread through a lock free queue
+ *   instead of writing them in the calling thread. This pays off with
+ *   a slow sink only. All the streams are synchronous by default.
 */
 
 class LIBMUTIL_API DbgEndl{
@@ -77,10 +91,14 @@ private:
 };
 
 class Mutex;
+class Semaphore;
+class ThreadHandle;
+struct DbgThreadState;
+struct DbgRecord;
 
 class LIBMUTIL_API Dbg{
 public:
-	Dbg(std::string name="", bool error_output=false, bool enabled=true);
+	Dbg(std::string name="", bool error_output=false, bool enabled=true, bool asynchronous=false);
 	~Dbg();
 
 	Dbg &operator<<( const std::string& );
@@ -98,6 +116,31 @@ public:
 	bool getEnabled();
 	void setExternalHandler(DbgHandler * dbgHandler);
 
+	/**
+	 * Returns false if output in the given class would be
+	 * discarded. Cheaper than formatting a message for nothing.
+	 */
+	bool isEnabled(const std::string &oClass);
+
+	/**
+	 * Set to true to have complete lines written by a background
+	 * thread instead of the thread producing them. The external
+	 * handler is then called from that thread, and the lines are
+	 * no longer ordered with those of the synchronous streams.
+	 */
+	void setAsynchronous(bool async);
+
+	/**
+	 * Returns when all lines queued so far have been written.
+	 */
+	void flush();
+
+	/**
+	 * Incremented each time the filters or the enabled state
+	 * change, see DbgCategory.
+	 */
+	unsigned int getFilterGeneration(){ return filterGeneration; }
+
 	/**
 	 * Set to true to make the output stream prefix all lines with
 	 * the name of the stream.
@@ -113,25 +156,75 @@ public:
 	void setPrintStreamName(bool b);
 
 	Dbg& operator()(std::string oClass);
+	Dbg& operator()(const char *oClass);
 	void include(std::string);
 	void exclude(std::string);
 
 
 private:
-	void updateFilter();
+	DbgThreadState *getThreadState();
+	void setClass(DbgThreadState *state, const char *oClass);
+	bool isBlocked(DbgThreadState *state);
+	bool filterIncludes(const std::string &oClass);
+	void append(const char *s, size_t length);
+	void outputLine(DbgThreadState *state);
+	void write(const std::string &line);
+
+	void startWriter();
+	void stopWriter();
+	void drainQueue();
+	static void *writerThread(void *arg);
+
 	std::string name;
 	bool error_out;
 	bool enabled;
-	std::string str;
 	DbgHandler * debugHandler;
 
 	bool defaultInclude;            // include or exclude by default
-	std::string curClass;           // currently set output class. Reset by endl.
 	std::set< std::string > includeSet;
 	std::set< std::string > excludeSet;
-	bool filterBlocking;
+	volatile unsigned int filterGeneration;
 	Mutex *lock;
 	bool printName;
+
+	/* Key of the per thread DbgThreadState */
+	void *threadStateKey;
+
+	/* Asynchronous output: producers push onto queue, the writer
+	 * thread takes the whole list at once */
+	bool async;
+	DbgRecord * volatile queue;
+	Mutex *writeLock;
+	Mutex *startLock;
+	Semaphore *queueSem;
+	ThreadHandle *writer;
+	volatile bool writerRunning;
+	volatile bool writerStarting;
+	volatile bool writerQuit;
+};
+
+/**
+ * Handle on an output class of a Dbg stream. The filters are only
+ * evaluated again after they change, so isEnabled() is a couple of
+ * memory reads.
+ */
+class LIBMUTIL_API DbgCategory{
+public:
+	DbgCategory(Dbg &dbg, std::string name);
+
+	bool isEnabled();
+
+	/** The stream, with this output class set */
+	Dbg &operator()();
+
+private:
+	Dbg &dbg;
+	std::string name;
+
+	/* Generation the cached result was computed for, shifted
+	 * left by one, with the result in the lowest bit. A single
+	 * word so that it can be shared between threads */
+	volatile unsigned int cache;
 };
 
 extern LIBMUTIL_API Dbg mout;
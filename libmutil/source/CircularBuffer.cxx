@@ -27,6 +27,10 @@ See Note in the header file about the source.
 
 #include <string.h> //for memcpy
 
+#ifdef _MSC_VER
+#	include <windows.h>
+#endif
+
 CircularBuffer::CircularBuffer(int size_):
 		maxSize(size_),
 		size(0),
@@ -136,3 +140,111 @@ bool CircularBuffer::remove(int len)
 void CircularBuffer::clear() {
 	read( NULL, getSize() ); //remove all current elements ... = clear
 }
+
+
+/*
+ * The producer publishes writeIdx after copying the data, and the
+ * consumer readIdx after copying it out: a release store, matched
+ * by an acquire load in the other thread.
+ */
+static inline unsigned int loadAcquire( volatile unsigned int *p ){
+#if defined(__ATOMIC_ACQUIRE)
+	return __atomic_load_n( p, __ATOMIC_ACQUIRE );
+#elif defined(_MSC_VER)
+	unsigned int v = *p;
+	MemoryBarrier();
+	return v;
+#else
+	unsigned int v = *p;
+	__sync_synchronize();
+	return v;
+#endif
+}
+
+static inline void storeRelease( volatile unsigned int *p, unsigned int v ){
+#if defined(__ATOMIC_RELEASE)
+	__atomic_store_n( p, v, __ATOMIC_RELEASE );
+#elif defined(_MSC_VER)
+	MemoryBarrier();
+	*p = v;
+#else
+	__sync_synchronize();
+	*p = v;
+#endif
+}
+
+SPSCCircularBuffer::SPSCCircularBuffer(int size_):
+		maxSize(size_),
+		writeIdx(0),
+		byteCounter(0),
+		readIdx(0) {
+	unsigned int n = 1;
+
+	while( n < (unsigned int)size_ )
+		n <<= 1;
+	mask = n - 1;
+	buf = new short[n];
+}
+
+SPSCCircularBuffer::~SPSCCircularBuffer(){
+	delete[] buf;
+}
+
+bool SPSCCircularBuffer::write(const short *s, int len){
+	unsigned int w = writeIdx;
+	unsigned int r = loadAcquire( &readIdx );
+
+	if( len < 0 || len > maxSize - (int)( w - r ) ) {
+		return false; // overflow
+	}
+
+	unsigned int start = w & mask;
+	unsigned int lenLeft = mask + 1 - start; // size left until circular border crossing
+	if( (unsigned int)len > lenLeft ) {
+		memcpy(buf + start, s, lenLeft * sizeof(short));
+		memcpy(buf, s + lenLeft, (len - lenLeft) * sizeof(short));
+	} else {
+		memcpy(buf + start, s, len * sizeof(short));
+	}
+
+	byteCounter += (unsigned long)len;
+	storeRelease( &writeIdx, w + len );
+	return true;
+}
+
+bool SPSCCircularBuffer::read(short *s, int len){
+	unsigned int r = readIdx;
+	unsigned int w = loadAcquire( &writeIdx );
+
+	if( len < 0 || len > (int)( w - r ) ) {
+		return false; // not enough elements
+	}
+
+	if( s ) {
+		unsigned int start = r & mask;
+		unsigned int lenLeft = mask + 1 - start;
+		if( (unsigned int)len > lenLeft ) {
+			memcpy(s, buf + start, lenLeft * sizeof(short));
+			memcpy(s + lenLeft, buf, (len - lenLeft) * sizeof(short));
+		} else {
+			memcpy(s, buf + start, len * sizeof(short));
+		}
+	}
+
+	storeRelease( &readIdx, r + len );
+	return true;
+}
+
+bool SPSCCircularBuffer::remove(int len){
+	return read(NULL, len);
+}
+
+void SPSCCircularBuffer::clear(){
+	storeRelease( &readIdx, loadAcquire( &writeIdx ) );
+}
+
+int SPSCCircularBuffer::getSize(){
+	unsigned int r = loadAcquire( &readIdx );
+	unsigned int w = loadAcquire( &writeIdx );
+	return (int)( w - r );
+}
@@ -0,0 +1,260 @@
+/*
+  Copyright (C) 2004-2006 the Minisip Team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ * Manifest cache of MPluginManager.
+ *
+ * The cache is a text file, with a line per library and a line per
+ * plugin of the library below it, the fields separated by tabs:
+ *
+ *	library	<name given to loadFromFile>	<file>	<mtime>	<size>
+ *	plugin	<entry point>	<name>	<type>
+*/
+
+#include<config.h>
+
+#include<libmutil/dbg.h>
+#include<libmutil/MPlugin.h>
+#include<libmutil/stringutils.h>
+
+#include<fstream>
+#include<sstream>
+#include<stdio.h>
+#include<sys/types.h>
+#include<sys/stat.h>
+
+using namespace std;
+
+#define MANIFEST_HEADER "minisip plugin manifest 1"
+
+static bool fileStamp( const string &file, int64_t &mtime, int64_t &size ){
+	struct stat st;
+
+	if( stat( file.c_str(), &st ) != 0 ){
+		return false;
+	}
+
+	mtime = st.st_mtime;
+	size = st.st_size;
+	return true;
+}
+
+static int64_t toInt64( const string &s ){
+	int64_t ret = 0;
+	istringstream( s ) >> ret;
+	return ret;
+}
+
+static string fromInt64( int64_t i ){
+	ostringstream out;
+	out << i;
+	return out.str();
+}
+
+void MPluginManager::setManifestFile( const std::string &file ){
+	manifestFile = file;
+	manifest.clear();
+	manifestChanged = false;
+
+	if( !manifestFile.empty() ){
+		readManifest();
+	}
+}
+
+void MPluginManager::readManifest(){
+	ifstream in( manifestFile.c_str() );
+	string line;
+	ManifestLibrary * cur = NULL;
+
+	if( !in || !getline( in, line ) || line != MANIFEST_HEADER ){
+		mdbg << "MPluginManager: no manifest in " << manifestFile << endl;
+		return;
+	}
+
+	while( getline( in, line ) ){
+		vector<string> fields = split( line, false, '\t', true );
+
+		if( fields.size() == 5 && fields[0] == "library" ){
+			cur = &manifest[ fields[1] ];
+			cur->file = fields[2];
+			cur->mtime = toInt64( fields[3] );
+			cur->size = toInt64( fields[4] );
+			cur->plugins.clear();
+			cur->used = false;
+		}
+		else if( fields.size() == 4 && fields[0] == "plugin" && cur ){
+			MPluginEntry entry;
+			entry.file = cur->file;
+			entry.entryPoint = fields[1];
+			entry.name = fields[2];
+			entry.type = fields[3];
+			cur->plugins.push_back( entry );
+		}
+		else {
+			merr << "MPluginManager: bad line in " << manifestFile << ": " << line << endl;
+			manifest.clear();
+			manifestChanged = true;
+			return;
+		}
+	}
+}
+
+void MPluginManager::writeManifest(){
+	if( manifestFile.empty() || !manifestChanged ){
+		return;
+	}
+
+	// Written aside and renamed, an instance starting meanwhile
+	// reads the old or the new manifest
+	string tmpName = manifestFile + ".tmp";
+	ofstream out( tmpName.c_str(), ios::out | ios::trunc );
+	out << MANIFEST_HEADER << "\n";
+
+	map< string, ManifestLibrary >::iterator i;
+	for( i = manifest.begin(); i != manifest.end(); i++ ){
+		ManifestLibrary &lib = i->second;
+		int64_t mtime, size;
+
+		// Drops the libraries removed
+		if( !fileStamp( lib.file, mtime, size ) ){
+			continue;
+		}
+
+		out << "library\t" << i->first << "\t" << lib.file << "\t"
+		    << fromInt64( lib.mtime ) << "\t" << fromInt64( lib.size ) << "\n";
+
+		list< MPluginEntry >::iterator j;
+		for( j = lib.plugins.begin(); j != lib.plugins.end(); j++ ){
+			out << "plugin\t" << j->entryPoint << "\t" << j->name
+			    << "\t" << j->type << "\n";
+		}
+	}
+
+	out.close();
+	if( !out ){
+		merr << "MPluginManager: could not write " << tmpName << endl;
+		remove( tmpName.c_str() );
+		return;
+	}
+
+#ifdef WIN32
+	remove( manifestFile.c_str() );
+#endif
+	if( rename( tmpName.c_str(), manifestFile.c_str() ) != 0 ){
+		merr << "MPluginManager: could not replace " << manifestFile << endl;
+		remove( tmpName.c_str() );
+		return;
+	}
+
+	manifestChanged = false;
+}
+
+bool MPluginManager::loadFromManifest( const std::string &filename,
+		int32_t &nPlugins ){
+	if( manifestFile.empty() ){
+		return false;
+	}
+
+	map< string, ManifestLibrary >::iterator i = manifest.find( filename );
+	if( i == manifest.end() ){
+		return false;
+	}
+
+	ManifestLibrary &lib = i->second;
+	int64_t mtime, size;
+	if( !fileStamp( lib.file, mtime, size ) ||
+			mtime != lib.mtime || size != lib.size ){
+		mdbg << "MPluginManager: " << filename << " changed since cached" << endl;
+		return false;
+	}
+
+	// Already loaded, maybe under another name
+	list< MRef<Library *> >::iterator iLib;
+	for( iLib = libraries.begin(); iLib != libraries.end(); iLib++ ){
+		if( (*iLib)->getPath() == lib.file ){
+			mdbg << "MPluginManager: Already loaded " << filename << endl;
+			nPlugins = -1;
+			return true;
+		}
+	}
+
+	map< string, ManifestLibrary >::iterator j;
+	for( j = manifest.begin(); j != manifest.end(); j++ ){
+		if( j->second.used && j->second.file == lib.file ){
+			mdbg << "MPluginManager: Already loaded " << filename << endl;
+			nPlugins = -1;
+			return true;
+		}
+	}
+
+	lib.used = true;
+	nPlugins = 0;
+
+	list< MPluginEntry >::iterator k;
+	for( k = lib.plugins.begin(); k != lib.plugins.end(); k++ ){
+		if( registerEntry( *k ) ){
+			nPlugins ++;
+		}
+	}
+
+	mdbg << "MPluginManager: " << nPlugins << " plugins of " << filename << " from the manifest" << endl;
+	return true;
+}
+
+void MPluginManager::addToManifest( const std::string &filename,
+		MRef<Library *> lib, const std::list< MPluginEntry > &plugins ){
+	if( manifestFile.empty() || !lib ){
+		return;
+	}
+
+	ManifestLibrary entry;
+	if( !fileStamp( lib->getPath(), entry.mtime, entry.size ) ){
+		return;
+	}
+
+	entry.file = lib->getPath();
+	entry.plugins = plugins;
+	entry.used = true;
+
+	manifest[ filename ] = entry;
+	manifestChanged = true;
+}
+
+bool MPluginManager::registerEntry( const MPluginEntry &entry ){
+	MPluginRegistry * registry = findRegistry( entry.type );
+
+	if( !registry ){
+		merr << "MPluginManager: Can't find registry for " << entry.type << endl;
+		return false;
+	}
+
+	registry->addEntry( entry );
+	return true;
+}
+
+MPluginRegistry * MPluginManager::findRegistry( const std::string &type ){
+	std::list< MPluginRegistry * >::iterator iReg;
+
+	for( iReg = registries.begin(); iReg != registries.end(); iReg ++ ){
+		if( (*iReg)->getPluginType() == type ){
+			return *iReg;
+		}
+	}
+
+	return NULL;
+}
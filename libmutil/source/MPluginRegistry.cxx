@@ -0,0 +1,148 @@
+/*
+  Copyright (C) 2004-2006 the Minisip Team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+ * Copyright (C) 2004-2006
+ *
+ * Authors: Erik Eliasson <eliasson@it.kth.se>
+ *          Johan Bilien <jobi@via.ecp.fr>
+ *          Mikael Magnusson <mikma@users.sourceforge.net>
+*/
+
+
+#include<config.h>
+
+#include<libmutil/dbg.h>
+#include<libmutil/MPlugin.h>
+
+using namespace std;
+
+void MPluginRegistry::registerPlugin( MRef<MPlugin *> p ){
+	plugins.push_back( p );
+}
+
+void MPluginRegistry::addEntry( const MPluginEntry &entry ){
+	if( !isLazy() ){
+		MRef<MPlugin *> p = manager->loadFromLibrary( entry.file,
+							      entry.entryPoint );
+		if( p ){
+			registerPlugin( p );
+		}
+		else {
+			merr << "MPluginManager: No plugin for ep: " << entry.entryPoint << endl;
+		}
+		return;
+	}
+
+	entriesLock.lock();
+	entries.push_back( entry );
+	entriesLock.unlock();
+}
+
+bool MPluginRegistry::isLazy() const{
+	return false;
+}
+
+MPluginRegistry::MPluginRegistry(){
+	manager = MPluginManager::getInstance();
+	manager->addRegistry( this );
+}
+
+MPluginRegistry::~MPluginRegistry(){
+	plugins.clear();
+	manager->removeRegistry( this );
+}
+
+MRef<MPlugin*> MPluginRegistry::findPlugin( std::string name ) const{
+	list< MRef<MPlugin *> >::const_iterator iter;
+	list< MRef<MPlugin *> >::const_iterator last = plugins.end();
+	MRef<MPlugin *> ret;
+
+	entriesLock.lock();
+	for( iter = plugins.begin(); iter != last; iter++ ){
+		MRef<MPlugin *> plugin = *iter;
+
+		if( plugin->getName() == name ){
+			ret = plugin;
+			break;
+		}
+	}
+
+	if( !ret && !entries.empty() ){
+		// Creating the plugin does not change what the
+		// registry holds, seen from outside
+		ret = const_cast<MPluginRegistry *>( this )->loadEntry( name );
+	}
+	entriesLock.unlock();
+
+	return ret;
+}
+
+/* Called with entriesLock held */
+MRef<MPlugin*> MPluginRegistry::loadEntry( const string &name ){
+	list< MPluginEntry >::iterator i;
+
+	for( i = entries.begin(); i != entries.end(); i++ ){
+		if( i->name == name ){
+			break;
+		}
+	}
+
+	if( i == entries.end() ){
+		return NULL;
+	}
+
+	MPluginEntry entry = *i;
+	entries.erase( i );
+
+	MRef<MPlugin *> p = manager->loadFromLibrary( entry.file,
+						      entry.entryPoint );
+	if( !p ){
+		merr << "MPluginManager: No plugin for ep: " << entry.entryPoint << " in " << entry.file << endl;
+		return NULL;
+	}
+
+	mdbg << "MPluginManager: created " << name << " on first use" << endl;
+	registerPlugin( p );
+
+	// The registry may have refused it
+	list< MRef<MPlugin *> >::iterator iter;
+	for( iter = plugins.begin(); iter != plugins.end(); iter++ ){
+		if( *iter == p ){
+			return p;
+		}
+	}
+
+	return NULL;
+}
+
+void MPluginRegistry::loadEntries(){
+	entriesLock.lock();
+	while( !entries.empty() ){
+		loadEntry( entries.front().name );
+	}
+	entriesLock.unlock();
+}
+
+MPluginRegistry::const_iterator MPluginRegistry::begin() const{
+	return plugins.begin();
+}
+
+MPluginRegistry::const_iterator MPluginRegistry::end() const{
+	return plugins.end();
+}
@@ -49,7 +49,7 @@ string MPlugin::getMemObjectType() const{
 	return "MPlugin";
 }
 
-MPluginManager::MPluginManager(){
+MPluginManager::MPluginManager(): manifestChanged( false ){
 	libraries.clear();
 }
 
@@ -83,6 +83,11 @@ int32_t MPluginManager::loadFromFile( const std::string &filename ){
 	list<string> * entryPoints;
 	MRef<Library *> lib;
 	list< MRef<Library *> >::iterator iLib;
+	list< MPluginEntry > created;
+
+	if( loadFromManifest( filename, nPlugins ) ){
+		return nPlugins;
+	}
 
 	lib = Library::open( filename );
 
@@ -112,6 +117,13 @@ int32_t MPluginManager::loadFromFile( const std::string &filename ){
 
 			p = loadFromLibrary( lib, *iEP );
 			if( p ){
+				MPluginEntry entry;
+				entry.file = lib->getPath();
+				entry.entryPoint = *iEP;
+				entry.name = p->getName();
+				entry.type = p->getPluginType();
+				created.push_back( entry );
+
 				if( registerPlugin( p ) ){
 					nPlugins ++;
 				}
@@ -125,6 +137,8 @@ int32_t MPluginManager::loadFromFile( const std::string &filename ){
 		merr << "MPluginManager: No entrypoints in " << filename << endl;
 	}
 
+	addToManifest( filename, lib, created );
+
 	if( nPlugins > 0 ){
 		libraries.push_back( lib );
 	}
@@ -169,6 +183,8 @@ int32_t MPluginManager::loadFromDirectory( const string &path ){
 		if  (n>0)
 			nLoaded+=n;
 	}
+
+	writeManifest();
 	return nLoaded;
 #if 0
 	ltdl_info info;
@@ -189,6 +205,7 @@ MRef<MPlugin *> MPluginManager::loadFromLibrary( const string &file,
 	MRef<MPlugin *> p;
 	bool newLib = false;
 
+	libraryLock.lock();
 	for( iLib = libraries.begin(); iLib != libraries.end(); iLib ++ ){
 		if( (*iLib)->getPath() == file ){
 			lib = *iLib;
@@ -209,6 +226,7 @@ MRef<MPlugin *> MPluginManager::loadFromLibrary( const string &file,
 		libraries.push_back( lib );
 	}
 
+	libraryLock.unlock();
 	return p;
 }
 
@@ -238,14 +256,11 @@ MRef<MPlugin *> MPluginManager::loadFromLibrary( MRef<Library *> lib,
 }
 
 bool MPluginManager::registerPlugin( MRef<MPlugin *> p ){
-	std::list< MPluginRegistry * >::iterator iReg;
-
+	MPluginRegistry * registry = findRegistry( p->getPluginType() );
 
-	for( iReg = registries.begin(); iReg != registries.end(); iReg ++ ){
-		if( (*iReg)->getPluginType() == p->getPluginType() ){
-			(*iReg)->registerPlugin( p );
-			return true;
-		}
+	if( registry ){
+		registry->registerPlugin( p );
+		return true;
 	}
 
 	merr << "MPluginManager: Can't find registry for " << p->getPluginType() << endl;
@@ -279,40 +294,3 @@ bool MPluginManager::setSearchPath( const std::string &searchPath ){
 
 	return SetCurrentDirectory(searchPath.c_str())!=0;
 }
-
-void MPluginRegistry::registerPlugin( MRef<MPlugin *> p ){
-	plugins.push_back( p );
-}
-
-MPluginRegistry::MPluginRegistry(){
-	manager = MPluginManager::getInstance();
-	manager->addRegistry( this );
-}
-
-MPluginRegistry::~MPluginRegistry(){
-	plugins.clear();
-	manager->removeRegistry( this );
-}
-
-MRef<MPlugin*> MPluginRegistry::findPlugin( std::string name ) const{
-	list< MRef<MPlugin *> >::const_iterator iter;
-	list< MRef<MPlugin *> >::const_iterator last = plugins.end();
-
-	for( iter = plugins.begin(); iter != last; iter++ ){
-		MRef<MPlugin *> plugin = *iter;
-
-		if( plugin->getName() == name ){
-			return plugin;
-		}
-	}
-
-	return NULL;
-}
-
-MPluginRegistry::const_iterator MPluginRegistry::begin() const{
-	return plugins.begin();
-}
-
-MPluginRegistry::const_iterator MPluginRegistry::end() const{
-	return plugins.end();
-}
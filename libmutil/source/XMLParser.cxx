@@ -160,39 +160,42 @@ int32_t XMLParser::getIntValue(string path, int32_t defaultValue){
 
 
 
-string XMLNode::generatestring(int32_t indent, XMLNode *cur){
-	string ret;
+/* Appends to ret, a string built by concatenation is copied once per
+ * node */
+static void appendNode(string &ret, int32_t indent, XMLNode *cur){
 	int32_t j;
 	for (j=0; j<indent; j++)
-		ret = ret+"\t";
+		ret += '\t';
 	if (indent>=0)
-		ret=ret+"<"+cur->getName();
-	
+		ret += "<" + cur->getName();
+
 	for (list<XMLNode *>::iterator i=cur->subnodes.begin(); i!=cur->subnodes.end(); i++)
 		if ((*i)->getType()==XML_NODE_TYPE_ATTRIBUTE){
-			ret=ret+" "+(*i)->getName()+"=\""+(*i)->getValue()+"\"";
+			ret += " " + (*i)->getName() + "=\"" + (*i)->getValue() + "\"";
 		}
 	if (indent>=0)
-		ret = ret+">\n";
+		ret += ">\n";
 	if (cur->getValue().length()>0){
 		for (j=0; j<indent+1; j++)
-			ret = ret+"\t";
-		ret = ret +cur->getValue()+"";
-		ret = ret+'\n';
+			ret += '\t';
+		ret += cur->getValue();
+		ret += '\n';
 	}
-	bool hassub=false;
 	for (list<XMLNode *>::iterator itt=cur->subnodes.begin(); itt!=cur->subnodes.end(); itt++)
 		if ((*itt)->getType()==XML_NODE_TYPE_ELEMENT){
-			ret = ret + generatestring(indent+1, *itt);
-			hassub=true;
+			appendNode(ret, indent+1, *itt);
 		}
-	
+
 	for (j=0; j<indent; j++)
-		ret = ret+"\t";
-	
+		ret += '\t';
+
 	if (indent>=0)
-		ret = ret +"</"+cur->getName()+">\n";
+		ret += "</" + cur->getName() + ">\n";
+}
 
+string XMLNode::generatestring(int32_t indent, XMLNode *cur){
+	string ret;
+	appendNode(ret, indent, cur);
 	return ret;
 }
 
@@ -230,14 +233,14 @@ void XMLFileParser::init(){
 		}
 
 
-		int32_t bufsize=20; 
+		int32_t bufsize=4096; 
 		char *buf = (char *)calloc(bufsize,1);
 		do{
 			for (int32_t i=0; i<bufsize; i++)
 				buf[i]=0;
 			//file.read(buf,bufsize-1);
 			file->read(buf, bufsize-1);
-			s = s+string(buf);
+			s.append(buf);
 		}while(!file->eof());
 		free(buf);
 
@@ -30,11 +30,20 @@
 #include<libmutil/dbg.h>
 
 #include<iostream>
+#include<string.h>
 
 #include<libmutil/stringutils.h>
 #include<libmutil/Mutex.h>
+#include<libmutil/Semaphore.h>
+#include<libmutil/Thread.h>
 #include<libmutil/massert.h>
 
+#if defined(WIN32) || defined(_MSC_VER)
+#include<windows.h>
+#else
+#include<pthread.h>
+#endif
+
 
 Dbg mout("mout");
 Dbg merr("merr",false);
@@ -45,21 +54,141 @@ DbgEndl end;
 
 LIBMUTIL_API bool outputStateMachineDebug = false;
 
-Dbg::Dbg(std::string name_, bool error_output, bool isEnabled):
+/**
+ *
+ * set contains
+ *   a/b
+ * filter
+ *   a
+ * result: false
+ *
+ * set contains
+ *  a
+ * filter 
+ *  a/b
+ * result: true
+ */
+static bool inSet( std::set< std::string > &set, std::string filter){
+	std::set< std::string >::const_iterator i;
+	for (i=set.begin() ; i!=set.end(); i++){
+		std::string setfilt = (*i);
+		if ( setfilt[0]=='/' )
+			setfilt = setfilt.substr(1);
+		if ( filter.substr(0,setfilt.size()) == setfilt ){
+			return true;
+		}
+	}
+	return false;
+}
+
+/* What a thread is writing to a stream */
+struct DbgThreadState{
+	DbgThreadState():hasClass(false),generation(0),
+			classBlocking(false),defaultBlocking(false){}
+
+	std::string line;		// partial line, reused between lines
+	std::string curClass;		// last class set by operator()
+	bool hasClass;			// curClass applies, reset by endl
+	unsigned int generation;	// filter generation the flags are for
+	bool classBlocking;
+	bool defaultBlocking;
+};
+
+/* A complete line waiting for the writer thread */
+struct DbgRecord{
+	DbgRecord *next;
+	std::string text;
+};
+
+#if defined(WIN32) || defined(_MSC_VER)
+/* Thread states are not freed when a thread exits on Windows */
+static void *createThreadStateKey(){
+	DWORD *key = new DWORD;
+	*key = TlsAlloc();
+	return key;
+}
+
+static void deleteThreadStateKey( void *key ){
+	TlsFree( *(DWORD *)key );
+	delete (DWORD *)key;
+}
+
+static DbgThreadState *getThreadStateValue( void *key ){
+	return (DbgThreadState *)TlsGetValue( *(DWORD *)key );
+}
+
+static void setThreadStateValue( void *key, DbgThreadState *state ){
+	TlsSetValue( *(DWORD *)key, state );
+}
+
+static bool compareAndSwap( DbgRecord * volatile *p, DbgRecord *oldValue, DbgRecord *newValue ){
+	return InterlockedCompareExchangePointer( (PVOID volatile *)p, newValue, oldValue ) == oldValue;
+}
+#else
+static void deleteThreadState( void *state ){
+	delete (DbgThreadState *)state;
+}
+
+static void *createThreadStateKey(){
+	pthread_key_t *key = new pthread_key_t;
+	pthread_key_create( key, deleteThreadState );
+	return key;
+}
+
+static void deleteThreadStateKey( void *key ){
+	pthread_key_delete( *(pthread_key_t *)key );
+	delete (pthread_key_t *)key;
+}
+
+static DbgThreadState *getThreadStateValue( void *key ){
+	return (DbgThreadState *)pthread_getspecific( *(pthread_key_t *)key );
+}
+
+static void setThreadStateValue( void *key, DbgThreadState *state ){
+	pthread_setspecific( *(pthread_key_t *)key, state );
+}
+
+static bool compareAndSwap( DbgRecord * volatile *p, DbgRecord *oldValue, DbgRecord *newValue ){
+	return __sync_bool_compare_and_swap( p, oldValue, newValue );
+}
+#endif
+
+Dbg::Dbg(std::string name_, bool error_output, bool isEnabled, bool asynchronous):
 		name(name_),
 		error_out(error_output),
 		enabled(isEnabled),
 		debugHandler(NULL),
 		defaultInclude(true),
-		filterBlocking(false),
+		filterGeneration(1),
 		lock(NULL),
-		printName(false)
-
+		printName(false),
+		threadStateKey(NULL),
+		async(asynchronous),
+		queue(NULL),
+		writeLock(NULL),
+		startLock(NULL),
+		queueSem(NULL),
+		writer(NULL),
+		writerRunning(false),
+		writerStarting(false),
+		writerQuit(false)
 {
 	lock = new Mutex;
+	writeLock = new Mutex;
+	startLock = new Mutex;
+	threadStateKey = createThreadStateKey();
 }
 
 Dbg::~Dbg(){
+	async = false;
+	stopWriter();
+	drainQueue();
+	deleteThreadStateKey( threadStateKey );
+	threadStateKey = NULL;
+	delete startLock;
+	startLock=NULL;
+	delete writeLock;
+	writeLock=NULL;
 	delete lock;
 	lock=NULL;
 }
@@ -70,58 +199,236 @@ void Dbg::setPrintStreamName(bool b){
 
 void Dbg::setEnabled(bool e){
 	enabled = e;
+	filterGeneration++;
 }
 
 bool Dbg::getEnabled(){
 	return enabled;
 }
 
-Dbg &Dbg::operator<<(const std::string& s){
+void Dbg::setAsynchronous(bool a){
+	if( !a ){
+		async = false;
+		stopWriter();
+		drainQueue();
+	}
+	else{
+		async = true;
+	}
+}
+
+DbgThreadState *Dbg::getThreadState(){
+	DbgThreadState *state = getThreadStateValue( threadStateKey );
+	if( !state ){
+		state = new DbgThreadState;
+		setThreadStateValue( threadStateKey, state );
+	}
+	return state;
+}
 
+bool Dbg::filterIncludes(const std::string &oClass){
+	bool ret;
 	lock->lock();
+	if (inSet( excludeSet, oClass))
+		ret = false;
+	else if (inSet( includeSet, oClass))
+		ret = true;
+	else
+		ret = defaultInclude;
+	lock->unlock();
+	return ret;
+}
 
-	bool doFlush = s.size()>0 && (s[s.size()-1]=='\n');
-	str += s;
+/**
+ * Returns true if what the thread writes now is discarded. The
+ * filters are only evaluated again after they changed or the
+ * output class did.
+ */
+bool Dbg::isBlocked(DbgThreadState *state){
+	unsigned int generation = filterGeneration;
 
-	if ( (!enabled || filterBlocking) && doFlush){
-		str="";
-		lock->unlock();
-		return *this;
+	if( state->generation != generation ){
+		state->generation = generation;
+		state->defaultBlocking = !filterIncludes( "" );
+		state->classBlocking = !filterIncludes( state->curClass );
+	}
+
+	return state->hasClass ? state->classBlocking : state->defaultBlocking;
+}
+
+void Dbg::setClass(DbgThreadState *state, const char *oClass){
+	/* Most threads keep writing in the same class */
+	if( state->curClass != oClass ){
+		state->curClass = oClass;
+		state->classBlocking = !filterIncludes( state->curClass );
+	}
+	state->hasClass = true;
+}
+
+bool Dbg::isEnabled(const std::string &oClass){
+	return enabled && filterIncludes( oClass );
+}
+
+void Dbg::append(const char *s, size_t length){
+	if( !enabled )
+		return;
+
+	DbgThreadState *state = getThreadState();
+	if( isBlocked( state ) )
+		return;
+
+	state->line.append( s, length );
+
+	if( length > 0 && s[length-1] == '\n' )
+		outputLine( state );
+}
+
+void Dbg::outputLine(DbgThreadState *state){
+	std::string prefix;
+	if (printName){
+		if (state->hasClass && state->curClass.size()>0)
+			prefix = "[" + state->curClass + "] ";
+		else
+			prefix = "[" + name + "] ";
 	}
 
-	if (doFlush){
-		std::string prefix;
-		if (printName){
-			if (curClass.size()>0)
-				prefix = "[" + curClass + "] ";
-			else
-				prefix = "[" + name + "] ";
+	if( async && !writerStarting ){
+		if( !writerRunning )
+			startWriter();
+
+		if( writerRunning ){
+			DbgRecord *record = new DbgRecord;
+			record->text = prefix + state->line;
+			state->line.erase();
+
+			DbgRecord *head;
+			do{
+				head = queue;
+				record->next = head;
+			} while( !compareAndSwap( &queue, head, record ) );
+
+			/* The writer empties the whole queue each
+			 * time it wakes up */
+			if( head == NULL )
+				queueSem->inc();
+			return;
 		}
+	}
+
+	write( prefix + state->line );
+	state->line.erase();
+}
 
-		if (debugHandler!=NULL){
-			lock->unlock();
-			debugHandler->displayMessage(prefix+str,0);
-			lock->lock();
-			str="";
+void Dbg::write(const std::string &line){
+	if (debugHandler!=NULL){
+		debugHandler->displayMessage(line,0);
+	}else{
+		lock->lock();
+		if (error_out){
+			std::cerr << line<<std::flush;
 		}else{
-			if (error_out){
-				std::cerr << prefix+str<<std::flush;
-			}else{
-				std::cout << prefix+str<<std::flush;
-			}
-			str="";
+			std::cout << line<<std::flush;
 		}
+		lock->unlock();
 	}
-	lock->unlock();
+}
+
+void Dbg::startWriter(){
+	startLock->lock();
+	if( !writerRunning && !writerStarting ){
+		/* Anything logged while the thread is being created
+		 * is written directly */
+		writerStarting = true;
+		writerQuit = false;
+		queueSem = new Semaphore();
+		writer = new ThreadHandle( Thread::createThread( writerThread, this ) );
+		writerRunning = true;
+		writerStarting = false;
+	}
+	startLock->unlock();
+}
+
+void Dbg::stopWriter(){
+	startLock->lock();
+	if( writerRunning ){
+		writerQuit = true;
+		queueSem->inc();
+		Thread::join( *writer );
+		delete writer;
+		writer = NULL;
+		delete queueSem;
+		queueSem = NULL;
+		writerRunning = false;
+	}
+	startLock->unlock();
+}
+
+void Dbg::drainQueue(){
+	writeLock->lock();
+
+	DbgRecord *head;
+	do{
+		head = queue;
+	} while( !compareAndSwap( &queue, head, NULL ) );
+
+	/* The queue is last in first out */
+	DbgRecord *ordered = NULL;
+	while( head ){
+		DbgRecord *next = head->next;
+		head->next = ordered;
+		ordered = head;
+		head = next;
+	}
+
+	/* Without a handler the whole batch is written at once */
+	std::string batch;
+	while( ordered ){
+		DbgRecord *next = ordered->next;
+		if( debugHandler != NULL )
+			write( ordered->text );
+		else
+			batch += ordered->text;
+		delete ordered;
+		ordered = next;
+	}
+	if( !batch.empty() )
+		write( batch );
+
+	writeLock->unlock();
+}
+
+void *Dbg::writerThread(void *arg){
+	Dbg *dbg = (Dbg *)arg;
+
+	while( !dbg->writerQuit ){
+		dbg->queueSem->dec();
+		dbg->drainQueue();
+	}
+	return NULL;
+}
+
+void Dbg::flush(){
+	drainQueue();
+}
+
+Dbg &Dbg::operator<<(const std::string& s){
+	append( s.data(), s.size() );
 	return *this;
 }
 
 Dbg &Dbg::operator<<( std::ostream&(*)(std::ostream&) ){
-	(*this)<<"\n";
-	lock->lock();
-	curClass="";
-	updateFilter();
-	lock->unlock();
+	if( !enabled )
+		return *this;
+
+	DbgThreadState *state = getThreadState();
+	if( !isBlocked( state ) ){
+		state->line += '\n';
+		outputLine( state );
+	}
+	else{
+		state->line.erase();
+	}
+	state->hasClass = false;
 	return (*this);
 }
 
@@ -137,24 +444,32 @@ Dbg &Dbg::operator<<(const DbgEndl &){
 #endif
 
 Dbg& Dbg::operator<<(int i){
-	return (*this)<<itoa(i);
+	if( enabled && !isBlocked( getThreadState() ) )
+		(*this)<<itoa(i);
+	return *this;
 }
 
 
 Dbg& Dbg::operator<<(unsigned int i){
-	return (*this)<<itoa(i);
+	if( enabled && !isBlocked( getThreadState() ) )
+		(*this)<<itoa(i);
+	return *this;
 }
 
 Dbg& Dbg::operator<<(long long ll){
-	return (*this)<<itoa(ll);
+	if( enabled && !isBlocked( getThreadState() ) )
+		(*this)<<itoa(ll);
+	return *this;
 }
 
 Dbg& Dbg::operator<<(const char c){
-	return (*this)<<std::string("")+c;
+	append( &c, 1 );
+	return *this;
 }
 
 Dbg& Dbg::operator<<(const char *c){
-	return (*this)<<std::string(c);
+	append( c, strlen( c ) );
+	return *this;
 }
 
 
@@ -166,50 +481,13 @@ void Dbg::setExternalHandler(DbgHandler * dh){
 	this->debugHandler = dh;
 }
 
-/**
- *
- * set contains
- *   a/b
- * filter
- *   a
- * result: false
- *
- * set contains
- *  a
- * filter 
- *  a/b
- * result: true
- */
-static bool inSet( std::set< std::string > &set, std::string filter){
-	std::set< std::string >::const_iterator i;
-	for (i=set.begin() ; i!=set.end(); i++){
-		std::string setfilt = (*i);
-		if ( setfilt[0]=='/' )
-			setfilt = setfilt.substr(1);
-		if ( filter.substr(0,setfilt.size()) == setfilt ){
-			return true;
-		}
-	}
-	return false;
-}
-
-/**
- * Note: this method is not thread safe (lock before calling this method).
- */
-void Dbg::updateFilter(){
-	if (inSet( excludeSet, curClass))
-		filterBlocking=true;
-	else if (inSet( includeSet, curClass))
-		filterBlocking=false;
-	else 
-		filterBlocking = ! defaultInclude;
+Dbg& Dbg::operator()(std::string oClass){
+	return (*this)( oClass.c_str() );
 }
 
-Dbg& Dbg::operator()(std::string oClass){
-	lock->lock();
-	curClass = oClass;
-	updateFilter();
-	lock->unlock();
+Dbg& Dbg::operator()(const char *oClass){
+	if( enabled )
+		setClass( getThreadState(), oClass );
 	return *this;
 }
 
@@ -265,7 +543,7 @@ void Dbg::include(std::string s){
 		includeSet.insert(s);
 		removeStartingWith(excludeSet, s);
 	}
-	updateFilter();
+	filterGeneration++;
 	lock->unlock();
 }
 
@@ -280,7 +558,25 @@ void Dbg::exclude(std::string s){
 		excludeSet.insert(s);
 		removeStartingWith(includeSet, s);
 	}
-	updateFilter();
+	filterGeneration++;
 	lock->unlock();
 }
 
+
+DbgCategory::DbgCategory(Dbg &d, std::string n):dbg(d),name(n),cache(0){
+}
+
+bool DbgCategory::isEnabled(){
+	unsigned int generation = dbg.getFilterGeneration();
+	unsigned int cached = cache;
+
+	if( ( cached >> 1 ) != ( generation & ( ~0U >> 1 ) ) ){
+		cached = ( generation << 1 ) | ( dbg.isEnabled( name ) ? 1 : 0 );
+		cache = cached;
+	}
+	return ( cached & 1 ) != 0;
+}
+
+Dbg &DbgCategory::operator()(){
+	return dbg( name.c_str() );
+}
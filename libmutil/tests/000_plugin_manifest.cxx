@@ -0,0 +1,178 @@
+/*
+ * Test of the plugin manifest cache of MPluginManager.
+ *
+ * Loads a module with a plugin for an eager registry and one for a
+ * lazy registry, once per simulated start of the application, each in
+ * a child process. The first start lists the module and creates both
+ * plugins. The next one creates the lazy plugin only when it is
+ * looked up. A missing, stale or damaged manifest falls back to
+ * listing the module.
+ */
+
+#include<config.h>
+
+#include<libmutil/MPlugin.h>
+#include<libmutil/Library.h>
+
+#include<fstream>
+#include<string>
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<sys/stat.h>
+#include<sys/types.h>
+#include<sys/wait.h>
+#include<unistd.h>
+#include<utime.h>
+
+using namespace std;
+
+static const char dirName[] = "000_plugin_manifest.d";
+static const char moduleName[] = "000_plugin_manifest.d/plugin_manifest_module.so";
+static const char manifestName[] = "000_plugin_manifest.plugins";
+
+static int failures = 0;
+
+static void check( bool ok, const char * what ){
+	if( !ok ){
+		fprintf( stderr, "FAILED: %s\n", what );
+		failures++;
+	}
+}
+
+class TestRegistry : public MPluginRegistry{
+	public:
+		TestRegistry( const string &type, bool lazy ):
+			type( type ), lazy( lazy ){}
+
+		virtual string getPluginType(){ return type; }
+		virtual bool isLazy() const { return lazy; }
+		virtual string getMemObjectType() const { return "TestRegistry"; }
+
+		MRef<MPlugin *> find( const string &name ){
+			return findPlugin( name );
+		}
+
+		int size(){
+			int n = 0;
+			for( const_iterator i = begin(); i != end(); i++ ){
+				n++;
+			}
+			return n;
+		}
+
+	private:
+		string type;
+		bool lazy;
+};
+
+/* Counter of the module in this process, -1 if it can not be read */
+static int moduleCounter( const char * name ){
+	MRef<Library *> lib = Library::open( moduleName );
+	if( !lib ){
+		return -1;
+	}
+
+	int * counter = (int *)lib->getFunctionPtr( name );
+	return counter ? *counter : -1;
+}
+
+/* Starts the way the application does, returns the failed checks */
+static int start( bool cached ){
+	MRef<MPluginManager *> manager = MPluginManager::getInstance();
+	MRef<TestRegistry *> eager = new TestRegistry( "ManifestEager", false );
+	MRef<TestRegistry *> lazy = new TestRegistry( "ManifestLazy", true );
+
+	manager->setManifestFile( manifestName );
+	check( manager->loadFromDirectory( dirName ) == 2, "plugins loaded" );
+
+	check( eager->size() == 1, "eager plugin created at start" );
+	check( moduleCounter( "nEagerCreated" ) == 1, "eager plugin created once" );
+	if( cached ){
+		check( moduleCounter( "nListed" ) == 0, "module not listed" );
+		check( lazy->size() == 0, "lazy plugin not created at start" );
+		check( moduleCounter( "nLazyCreated" ) == 0, "lazy plugin not created" );
+	}
+	else{
+		check( moduleCounter( "nListed" ) == 1, "module listed" );
+		check( lazy->size() == 1, "lazy plugin created by the listing" );
+		check( moduleCounter( "nLazyCreated" ) == 1, "lazy plugin created once" );
+	}
+
+	MRef<MPlugin *> plugin = lazy->find( "lazy" );
+	check( plugin && plugin->getName() == "lazy", "lazy plugin found" );
+	check( lazy->size() == 1, "lazy plugin registered" );
+	check( moduleCounter( "nLazyCreated" ) == 1, "lazy plugin created on first lookup" );
+	check( !lazy->find( "missing" ), "unknown plugin not found" );
+
+	struct stat st;
+	check( stat( manifestName, &st ) == 0, "manifest written" );
+
+	return failures;
+}
+
+/* Runs a start in a child, with a plugin manager of its own */
+static void runStart( bool cached, const char * what ){
+	int status;
+	pid_t pid = fork();
+
+	if( pid == 0 ){
+		failures = 0;
+		exit( start( cached ) ? 1 : 0 );
+	}
+
+	if( pid < 0 || waitpid( pid, &status, 0 ) != pid ||
+			!WIFEXITED( status ) || WEXITSTATUS( status ) != 0 ){
+		fprintf( stderr, "FAILED: %s\n", what );
+		failures++;
+	}
+}
+
+static bool copyModule(){
+	ifstream in( TEST_MODULE, ios::binary );
+	ofstream out( moduleName, ios::binary | ios::trunc );
+
+	out << in.rdbuf();
+	out.close();
+	return in && out;
+}
+
+int main( int argc, char *argv[] ){
+	remove( manifestName );
+	remove( moduleName );
+	mkdir( dirName, 0755 );
+	check( copyModule(), "module copied" );
+
+	runStart( false, "first start" );
+	runStart( true, "start from the manifest" );
+
+	/* A library changed since it was cached is listed again */
+	struct stat st;
+	struct utimbuf times;
+	check( stat( moduleName, &st ) == 0, "module stat" );
+	times.actime = st.st_atime;
+	times.modtime = st.st_mtime + 10;
+	check( utime( moduleName, &times ) == 0, "module touched" );
+	runStart( false, "start with a stale manifest" );
+	runStart( true, "start from the updated manifest" );
+
+	remove( manifestName );
+	runStart( false, "start without manifest" );
+
+	ofstream damaged( manifestName, ios::app );
+	damaged << "garbage\n";
+	damaged.close();
+	runStart( false, "start with a damaged manifest" );
+	runStart( true, "start from the rewritten manifest" );
+
+	remove( manifestName );
+	remove( moduleName );
+	rmdir( dirName );
+
+	if( failures ){
+		fprintf( stderr, "%d checks failed\n", failures );
+		return 1;
+	}
+	printf( "MPluginManager manifest: all checks passed\n" );
+	return 0;
+}
@@ -0,0 +1,58 @@
+/*
+ * Module of 000_plugin_manifest, with a plugin for an eager registry
+ * and one for a lazy registry. It counts the calls to its entry
+ * points, the test reads the counters with lt_dlsym.
+ */
+
+#include<libmutil/MPlugin.h>
+
+#include<list>
+#include<string>
+
+extern "C"{
+	int nListed = 0;
+	int nEagerCreated = 0;
+	int nLazyCreated = 0;
+}
+
+class ManifestTestPlugin : public MPlugin{
+	public:
+		ManifestTestPlugin( MRef<Library *> lib, const std::string &name,
+				const std::string &type ):
+			MPlugin( lib ), name( name ), type( type ){}
+
+		virtual std::string getName() const { return name; }
+		virtual uint32_t getVersion() const { return 0x00000001; }
+		virtual std::string getDescription() const { return name + " test plugin"; }
+		virtual std::string getPluginType() const { return type; }
+		virtual std::string getMemObjectType() const { return "ManifestTestPlugin"; }
+
+	private:
+		std::string name;
+		std::string type;
+};
+
+static std::list<std::string> pluginList;
+
+extern "C"
+std::list<std::string> *plugin_manifest_module_LTX_listPlugins( MRef<Library *> lib ){
+	nListed++;
+	if( pluginList.empty() ){
+		pluginList.push_back( "getEagerPlugin" );
+		pluginList.push_back( "getLazyPlugin" );
+	}
+
+	return &pluginList;
+}
+
+extern "C"
+MPlugin * plugin_manifest_module_LTX_getEagerPlugin( MRef<Library *> lib ){
+	nEagerCreated++;
+	return new ManifestTestPlugin( lib, "eager", "ManifestEager" );
+}
+
+extern "C"
+MPlugin * plugin_manifest_module_LTX_getLazyPlugin( MRef<Library *> lib ){
+	nLazyCreated++;
+	return new ManifestTestPlugin( lib, "lazy", "ManifestLazy" );
+}
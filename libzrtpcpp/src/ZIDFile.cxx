@@ -27,6 +27,17 @@
 #include "config.h"
 #include <libzrtpcpp/ZIDFile.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #if !defined(HAVE_SRANDOM) || !defined(HAVE_RANDOM)
 # if defined(HAVE_SRAND) && defined(HAVE_RAND)
 #  define srandom srand
@@ -36,9 +47,84 @@
 # endif
 #endif
 
+/*
+ * The file is an array of pairs of slots. The first pair holds the
+ * header, each of the others the record of one peer. A slot never
+ * crosses a page or disk sector boundary.
+ */
+#define ZID_SLOT_SIZE   128
+#define ZID_PAIR_SIZE   (2 * ZID_SLOT_SIZE)
+
+#define ZID_MAGIC       "ZIDSTOR1"
+#define ZID_MAGIC_LEN   8
+
+// Pairs added to the file when all are in use
+#define ZID_GROW_PAIRS  256
+
+// Smallest size of the hash index
+#define ZID_INDEX_MIN   1024
+
+typedef struct zidheader {
+    char magic[ZID_MAGIC_LEN];
+    unsigned char ownZid[IDENTIFIER_LEN];
+} zidheader_t;
+
+typedef struct zidslot {
+    uint32_t check;		// checksum of seq and record, 0 if unused
+    uint32_t seq;		// incremented by each save of the record
+    zidrecord_t record;
+} zidslot_t;
+
 static ZIDFile* instance;
 
+static uint32_t checksum(const zidslot_t *slot) {
+    // FNV-1a
+    const unsigned char *p = (const unsigned char *)&slot->seq;
+    const unsigned char *end = (const unsigned char *)(&slot->record + 1);
+    uint32_t h = 2166136261U;
+
+    while (p < end) {
+	h ^= *p++;
+	h *= 16777619U;
+    }
+    return (h == 0) ? 1 : h;
+}
+
+static bool isValid(const zidslot_t *slot) {
+    return slot->check != 0 && slot->check == checksum(slot);
+}
+
+static int replaceFile(const char *from, const char *to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING |
+                       MOVEFILE_WRITE_THROUGH) ? 0 : -1;
+#else
+    return rename(from, to);
+#endif
+}
+
+static int syncFile(FILE *f) {
+    if (fflush(f) != 0) {
+	return -1;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(f));
+#else
+    return fsync(fileno(f));
+#endif
+}
+
+ZIDFile::ZIDFile(): map(NULL), mapSize(0),
+#ifdef _WIN32
+                    fileHandle(INVALID_HANDLE_VALUE), mapHandle(NULL),
+#else
+                    fd(-1),
+#endif
+                    numPairs(0), indexUsed(0), seed(0) {
+}
+
 ZIDFile::~ZIDFile() {
+    close();
 }
 
 ZIDFile* ZIDFile::getInstance() {
@@ -50,95 +136,538 @@ ZIDFile* ZIDFile::getInstance() {
 }
 
 int ZIDFile::open(char *name) {
-    zidrecord_t rec;
+    unsigned char magic[ZID_MAGIC_LEN];
     unsigned int* ip;
+    int ret = 1;
 
+    lock.lock();
     // check for an already active ZID file
-    if (zidFile != NULL) {
+    if (map != NULL) {
+	lock.unlock();
 	return 0;
     }
-    if ((zidFile = fopen(name, "rb+")) == NULL) {
-	zidFile = fopen(name, "wb+");
+
+    FILE *f = fopen(name, "rb");
+    if (f == NULL) {
 	// New file, generate an associated random ZID and save
-        // it as first record
-	if (zidFile != NULL) {
-	    ip = (unsigned int*)associatedZid;
-	    memset(&rec, 0, sizeof(zidrecord_t));
-            srandom(time(NULL));
-	    *ip++ = random();
-	    *ip++ = random();
-	    *ip = random();
-	    memcpy(rec.identifier, associatedZid, IDENTIFIER_LEN);
-	    fseek(zidFile, 0L, SEEK_SET);
-	    rec.ownZid = 1;
-	    fwrite(&rec, sizeof(zidrecord_t), 1, zidFile);
-            fflush(zidFile);
+        // it in the header
+	ip = (unsigned int*)associatedZid;
+        srandom(time(NULL));
+	*ip++ = random();
+	*ip++ = random();
+	*ip = random();
+	if (writeFile(name, associatedZid, std::vector<zidrecord_t>()) < 0) {
+	    ret = -1;
 	}
     }
     else {
-	fseek(zidFile, 0L, SEEK_SET);
-	if (fread(&rec, sizeof(zidrecord_t), 1, zidFile) != 1) {
-            fclose(zidFile);
-            zidFile = NULL;
-	    return -1;
+	size_t n = fread(magic, 1, ZID_MAGIC_LEN, f);
+	fclose(f);
+	if (n != ZID_MAGIC_LEN || memcmp(magic, ZID_MAGIC, ZID_MAGIC_LEN) != 0) {
+	    ret = migrate(name);
+	}
+    }
+
+    if (ret > 0) {
+	ret = load(name);
+    }
+    lock.unlock();
+    return ret;
+}
+
+int ZIDFile::load(const char *name) {
+    size_t size;
+
+#ifdef _WIN32
+    fileHandle = CreateFileA(name, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+	return -1;
+    }
+    size = GetFileSize(fileHandle, NULL);
+#else
+    struct stat st;
+
+    fd = ::open(name, O_RDWR);
+    if (fd < 0) {
+	return -1;
+    }
+    if (fstat(fd, &st) < 0) {
+	closeFile();
+	return -1;
+    }
+    size = st.st_size;
+#endif
+
+    if (size < ZID_PAIR_SIZE || size % ZID_PAIR_SIZE != 0 || mapFile(size) < 0) {
+	closeFile();
+	return -1;
+    }
+
+    zidheader_t *header = (zidheader_t *)map;
+    if (memcmp(header->magic, ZID_MAGIC, ZID_MAGIC_LEN) != 0) {
+	closeFile();
+	return -1;
+    }
+    memcpy(associatedZid, header->ownZid, IDENTIFIER_LEN);
+    fileName = name;
+    numPairs = size / ZID_PAIR_SIZE;
+
+    // The index is only ever probed with the peers' ZIDs, a random
+    // seed keeps them from choosing colliding ones
+    seed = (uint32_t)time(NULL) * 2654435761U ^ (uint32_t)random();
+    index.clear();
+    indexUsed = 0;
+    resizeIndex(ZID_INDEX_MIN);
+    freePairs.clear();
+
+    // Lowest free pairs at the back, they are used first
+    for (uint32_t pair = numPairs - 1; pair > 0; pair--) {
+	zidslot_t *slot = currentSlot(pair);
+
+	if (slot != NULL && slot->record.recValid == 1 &&
+	    findPair(slot->record.identifier) == 0) {
+	    addToIndex(slot->record.identifier, pair);
 	}
-	if (rec.ownZid != 1) {
-            fclose(zidFile);
-            zidFile = NULL;
-	    return -1;
+	else {
+	    freePairs.push_back(pair);
 	}
-	memcpy(associatedZid, rec.identifier, IDENTIFIER_LEN);
     }
-    return ((zidFile == NULL) ? -1 : 1);
+    return 1;
 }
 
 void ZIDFile::close() {
 
-    if (zidFile != NULL) {
-	fclose(zidFile);
-	zidFile = NULL;
+    lock.lock();
+    closeFile();
+    lock.unlock();
+}
+
+void ZIDFile::closeFile() {
+#ifdef _WIN32
+    if (map != NULL) {
+	UnmapViewOfFile(map);
+	CloseHandle((HANDLE)mapHandle);
+	mapHandle = NULL;
+    }
+    if (fileHandle != INVALID_HANDLE_VALUE) {
+	CloseHandle((HANDLE)fileHandle);
+	fileHandle = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (map != NULL) {
+	munmap(map, mapSize);
+    }
+    if (fd >= 0) {
+	::close(fd);
+	fd = -1;
     }
+#endif
+    map = NULL;
+    mapSize = 0;
+    numPairs = 0;
+    index.clear();
+    indexUsed = 0;
+    freePairs.clear();
 }
 
-unsigned int ZIDFile::getRecord(ZIDRecord *zidRecord) {
-    unsigned long pos;
-    zidrecord_t rec;
-    int numRead;
+/*
+ * Maps size bytes of the file, replacing the current mapping only if
+ * the new one could be made.
+ */
+int ZIDFile::mapFile(size_t size) {
+    unsigned char *newMap;
+
+#ifdef _WIN32
+    // Mapping more than the size of the file extends it
+    HANDLE newHandle = CreateFileMapping((HANDLE)fileHandle, NULL,
+                                         PAGE_READWRITE, 0, (DWORD)size, NULL);
+    if (newHandle == NULL) {
+	return -1;
+    }
+    newMap = (unsigned char *)MapViewOfFile(newHandle, FILE_MAP_ALL_ACCESS,
+                                            0, 0, size);
+    if (newMap == NULL) {
+	CloseHandle(newHandle);
+	return -1;
+    }
+    if (map != NULL) {
+	UnmapViewOfFile(map);
+	CloseHandle((HANDLE)mapHandle);
+    }
+    mapHandle = newHandle;
+#else
+    newMap = (unsigned char *)mmap(NULL, size, PROT_READ | PROT_WRITE,
+                                   MAP_SHARED, fd, 0);
+    if (newMap == (unsigned char *)MAP_FAILED) {
+	return -1;
+    }
+    if (map != NULL) {
+	munmap(map, mapSize);
+    }
+#endif
+    map = newMap;
+    mapSize = size;
+    return 1;
+}
 
-    fseek(zidFile, (long)(sizeof(zidrecord_t)), SEEK_SET);
+int ZIDFile::grow() {
+    uint32_t added = numPairs / 2;
+    if (added < ZID_GROW_PAIRS) {
+	added = ZID_GROW_PAIRS;
+    }
+    size_t size = (size_t)(numPairs + added) * ZID_PAIR_SIZE;
 
-    do {
-	pos = ftell(zidFile);
-	numRead = fread(&rec, sizeof(zidrecord_t), 1, zidFile);
+#ifndef _WIN32
+    // The new pairs read as zeroes, that is free
+    if (ftruncate(fd, size) < 0) {
+	return -1;
+    }
+#endif
+    if (mapFile(size) < 0) {
+	return -1;
+    }
 
-	// skip invalid records
-	while(rec.ownZid == 1 && rec.recValid == 0 && numRead == 1) {
-	    numRead = fread(&rec, sizeof(zidrecord_t), 1, zidFile);
+    for (uint32_t pair = numPairs + added - 1; pair >= numPairs; pair--) {
+	freePairs.push_back(pair);
+    }
+    numPairs += added;
+    return 1;
+}
+
+uint32_t ZIDFile::newPair() {
+    if (freePairs.empty() && grow() < 0) {
+	return 0;
+    }
+    uint32_t pair = freePairs.back();
+    freePairs.pop_back();
+    return pair;
+}
+
+void ZIDFile::flush(void *addr, size_t length) {
+#ifdef _WIN32
+    FlushViewOfFile(addr, length);
+    FlushFileBuffers((HANDLE)fileHandle);
+#else
+    static long pageSize = sysconf(_SC_PAGESIZE);
+    unsigned char *start = (unsigned char *)addr;
+    unsigned char *end = start + length;
+
+    start = map + ((start - map) / pageSize) * pageSize;
+    msync(start, end - start, MS_SYNC);
+#endif
+}
+
+uint32_t ZIDFile::hash(const unsigned char *zid) {
+    uint32_t h = 2166136261U ^ seed;
+
+    for (int i = 0; i < IDENTIFIER_LEN; i++) {
+	h ^= zid[i];
+	h *= 16777619U;
+    }
+    return h ^ (h >> 15);
+}
+
+uint32_t ZIDFile::findPair(const unsigned char *zid) {
+    uint32_t mask = index.size() - 1;
+
+    for (uint32_t i = hash(zid) & mask; index[i].pair != 0; i = (i + 1) & mask) {
+	if (memcmp(index[i].zid, zid, IDENTIFIER_LEN) == 0) {
+	    return index[i].pair;
 	}
+    }
+    return 0;
+}
+
+void ZIDFile::addToIndex(const unsigned char *zid, uint32_t pair) {
+    // Keep the index at most half full
+    if ((indexUsed + 1) * 2 > index.size()) {
+	resizeIndex(index.size() * 2);
+    }
+
+    uint32_t mask = index.size() - 1;
+    uint32_t i = hash(zid) & mask;
 
-	// if we are at end of file, then no record found. Create new
-	// record and write its data at end of file.
-	if (numRead == 0) {
-	    memset(&rec, 0, sizeof(zidrecord_t));
-	    memcpy(rec.identifier, zidRecord->record.identifier, IDENTIFIER_LEN);
-	    rec.recValid = 1;
-	    fwrite(&rec, sizeof(zidrecord_t), 1, zidFile);
-	    break;
+    while (index[i].pair != 0) {
+	i = (i + 1) & mask;
+    }
+    index[i].pair = pair;
+    memcpy(index[i].zid, zid, IDENTIFIER_LEN);
+    indexUsed++;
+}
+
+void ZIDFile::resizeIndex(uint32_t size) {
+    std::vector<IndexEntry> old;
+    IndexEntry empty;
+
+    memset(&empty, 0, sizeof(empty));
+    old.swap(index);
+    index.assign(size, empty);
+    indexUsed = 0;
+
+    for (size_t i = 0; i < old.size(); i++) {
+	if (old[i].pair != 0) {
+	    addToIndex(old[i].zid, old[i].pair);
 	}
-    } while (memcmp(zidRecord->record.identifier, rec.identifier, IDENTIFIER_LEN) != 0);
+    }
+}
+
+zidslot_t *ZIDFile::currentSlot(uint32_t pair) {
+    zidslot_t *first = (zidslot_t *)(map + (size_t)pair * ZID_PAIR_SIZE);
+    zidslot_t *second = (zidslot_t *)((unsigned char *)first + ZID_SLOT_SIZE);
+    bool firstValid = isValid(first);
+    bool secondValid = isValid(second);
+
+    if (firstValid && secondValid) {
+	// Sequence numbers wrap around
+	return ((int32_t)(second->seq - first->seq) > 0) ? second : first;
+    }
+    if (firstValid) {
+	return first;
+    }
+    return secondValid ? second : NULL;
+}
+
+/*
+ * Writes the slot not holding the current version of the record and
+ * waits for it to reach the disk. Until then, and if the write is
+ * torn by a crash, the current version remains the valid one.
+ */
+void ZIDFile::writeRecord(uint32_t pair, const zidrecord_t *rec) {
+    zidslot_t slot;
+    zidslot_t *current = currentSlot(pair);
+    zidslot_t *target = (zidslot_t *)(map + (size_t)pair * ZID_PAIR_SIZE);
+
+    if (current == target) {
+	target = (zidslot_t *)((unsigned char *)target + ZID_SLOT_SIZE);
+    }
 
-    // Copy the read data into the record structure
-    memcpy(&zidRecord->record, &rec, sizeof(zidrecord_t));
+    memset(&slot, 0, sizeof(zidslot_t));
+    slot.seq = (current != NULL) ? current->seq + 1 : 1;
+    memcpy(&slot.record, rec, sizeof(zidrecord_t));
+    slot.check = checksum(&slot);
 
-    //  remember position of record in file for save operation
-    zidRecord->position = pos;
+    memcpy(target, &slot, sizeof(zidslot_t));
+    flush(target, sizeof(zidslot_t));
+}
+
+unsigned int ZIDFile::getRecord(ZIDRecord *zidRecord) {
+    unsigned char id[IDENTIFIER_LEN];
+
+    lock.lock();
+    if (map == NULL) {
+	lock.unlock();
+	return 0;
+    }
+
+    memcpy(id, zidRecord->record.identifier, IDENTIFIER_LEN);
+    uint32_t pair = findPair(id);
+    zidslot_t *slot = (pair != 0) ? currentSlot(pair) : NULL;
+
+    if (slot != NULL) {
+	// Copy the stored data into the record structure
+	memcpy(&zidRecord->record, &slot->record, sizeof(zidrecord_t));
+    }
+    else {
+	// Unknown peer, its pair is only taken by the first save so
+	// that lookups of peers never saved do not grow the file
+	memset(&zidRecord->record, 0, sizeof(zidrecord_t));
+	memcpy(zidRecord->record.identifier, id, IDENTIFIER_LEN);
+	zidRecord->record.recValid = 1;
+    }
+
+    zidRecord->position = pair;
+    lock.unlock();
     return 1;
 }
 
 unsigned int ZIDFile::saveRecord(ZIDRecord *zidRecord) {
 
-    fseek(zidFile, zidRecord->position, SEEK_SET);
-    fwrite(&zidRecord->record, sizeof(zidrecord_t), 1, zidFile);
+    lock.lock();
+    if (map == NULL) {
+	lock.unlock();
+	return 0;
+    }
+
+    // Looked up again, the file may have been compacted since the
+    // record was read
+    uint32_t pair = findPair(zidRecord->record.identifier);
+    if (pair == 0) {
+	pair = newPair();
+	if (pair == 0) {
+	    lock.unlock();
+	    return 0;
+	}
+	addToIndex(zidRecord->record.identifier, pair);
+    }
+
+    zidRecord->record.recValid = 1;
+    zidRecord->record.ownZid = 0;
+    writeRecord(pair, &zidRecord->record);
+    zidRecord->position = pair;
+    lock.unlock();
+    return 1;
+}
+
+int ZIDFile::compact() {
+    std::vector<zidrecord_t> records;
+
+    lock.lock();
+    if (map == NULL) {
+	lock.unlock();
+	return 0;
+    }
+
+    for (size_t i = 0; i < index.size(); i++) {
+	if (index[i].pair == 0) {
+	    continue;
+	}
+	zidslot_t *slot = currentSlot(index[i].pair);
+	if (slot != NULL && (slot->record.rs1Valid != 0 ||
+	                     slot->record.rs2Valid != 0)) {
+	    records.push_back(slot->record);
+	}
+    }
+
+    std::string name = fileName;
+    std::string tmpName = name + ".tmp";
+    if (writeFile(tmpName.c_str(), associatedZid, records) < 0) {
+	remove(tmpName.c_str());
+	lock.unlock();
+	return -1;
+    }
+
+    // Windows does not replace a file that is open
+    closeFile();
+    int ret = 1;
+    if (replaceFile(tmpName.c_str(), name.c_str()) < 0) {
+	remove(tmpName.c_str());
+	ret = -1;
+    }
+    if (load(name.c_str()) < 0) {
+	ret = -1;
+    }
+    lock.unlock();
+    return ret;
+}
+
+unsigned int ZIDFile::getNumRecords() {
+    unsigned int n;
+
+    lock.lock();
+    n = indexUsed;
+    lock.unlock();
+    return n;
+}
+
+/*
+ * Writes a complete file, a header and a pair per record holding the
+ * record in its first slot, and waits for it to reach the disk.
+ */
+int ZIDFile::writeFile(const char *name, const unsigned char *ownZid,
+                       const std::vector<zidrecord_t> &records) {
+    unsigned char pair[ZID_PAIR_SIZE];
+    zidheader_t header;
+    zidslot_t slot;
+    int ret = 1;
+
+    FILE *f = fopen(name, "wb");
+    if (f == NULL) {
+	return -1;
+    }
+
+    memset(pair, 0, ZID_PAIR_SIZE);
+    memset(&header, 0, sizeof(zidheader_t));
+    memcpy(header.magic, ZID_MAGIC, ZID_MAGIC_LEN);
+    memcpy(header.ownZid, ownZid, IDENTIFIER_LEN);
+    memcpy(pair, &header, sizeof(zidheader_t));
+    if (fwrite(pair, ZID_PAIR_SIZE, 1, f) != 1) {
+	ret = -1;
+    }
+
+    for (size_t i = 0; ret > 0 && i < records.size(); i++) {
+	memset(&slot, 0, sizeof(zidslot_t));
+	slot.seq = 1;
+	memcpy(&slot.record, &records[i], sizeof(zidrecord_t));
+	slot.record.recValid = 1;
+	slot.record.ownZid = 0;
+	slot.check = checksum(&slot);
+
+	memset(pair, 0, ZID_PAIR_SIZE);
+	memcpy(pair, &slot, sizeof(zidslot_t));
+	if (fwrite(pair, ZID_PAIR_SIZE, 1, f) != 1) {
+	    ret = -1;
+	}
+    }
+
+    if (syncFile(f) < 0) {
+	ret = -1;
+    }
+    if (fclose(f) != 0) {
+	ret = -1;
+    }
+    return ret;
+}
+
+/*
+ * Converts a file of the earlier format, an array of zidrecord_t
+ * starting with the record of the associated ZID. The original is
+ * copied to name.old, and replaced by the converted file only once
+ * both are on disk.
+ */
+int ZIDFile::migrate(const char *name) {
+    std::vector<unsigned char> data;
+    std::vector<zidrecord_t> records;
+    unsigned char buf[4096];
+    size_t n;
+
+    FILE *f = fopen(name, "rb");
+    if (f == NULL) {
+	return -1;
+    }
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+	data.insert(data.end(), buf, buf + n);
+    }
+    fclose(f);
+
+    if (data.size() < sizeof(zidrecord_t) ||
+        data.size() % sizeof(zidrecord_t) != 0) {
+	return -1;
+    }
+
+    zidrecord_t own;
+    memcpy(&own, &data[0], sizeof(zidrecord_t));
+    if (own.ownZid != 1) {
+	return -1;
+    }
+
+    for (n = sizeof(zidrecord_t); n < data.size(); n += sizeof(zidrecord_t)) {
+	zidrecord_t rec;
+	memcpy(&rec, &data[n], sizeof(zidrecord_t));
+	if (rec.recValid == 1 && rec.ownZid == 0) {
+	    records.push_back(rec);
+	}
+    }
+
+    std::string oldName = std::string(name) + ".old";
+    f = fopen(oldName.c_str(), "wb");
+    if (f == NULL) {
+	return -1;
+    }
+    int ret = (fwrite(&data[0], data.size(), 1, f) == 1) ? 1 : -1;
+    if (syncFile(f) < 0) {
+	ret = -1;
+    }
+    if (fclose(f) != 0 || ret < 0) {
+	return -1;
+    }
+
+    std::string tmpName = std::string(name) + ".tmp";
+    if (writeFile(tmpName.c_str(), own.identifier, records) < 0 ||
+        replaceFile(tmpName.c_str(), name) < 0) {
+	remove(tmpName.c_str());
+	return -1;
+    }
     return 1;
 }
 
@@ -23,6 +23,7 @@
 #include "config.h"
 
 #include <libmcrypto/ZrtpDH.h>
+#include <libmcrypto/DhKeyPool.h>
 #include <libmcrypto/hmac256.h>
 #include <libmcrypto/sha256.h>
 
@@ -257,19 +258,23 @@ ZrtpPacketCommit* ZRtp::prepareCommit(ZrtpPacketHello *hello) {
     int32_t maxPubKeySize;
 
     if (pubKey == Dh3072) {
-	dhContext = new ZrtpDH(3072);
+	dhContext = DhKeyPool::getInstance()->takeZrtpDH(DH_POOL_ZRTP3072);
 	maxPubKeySize = 384;
 
     }
     else if (pubKey == Dh4096) {
-	dhContext = new ZrtpDH(4096);
+	dhContext = DhKeyPool::getInstance()->takeZrtpDH(DH_POOL_ZRTP4096);
 	maxPubKeySize = 512;
     }
     else {
 	return NULL;
 	// Error - shouldn't happen
     }
-    dhContext->generateKey();
+    // The key pair comes precomputed from the pool
+    if (dhContext == NULL) {
+        sendInfo(Error, "Cannot generate a DH key pair");
+        return NULL;
+    }
     pubKeyLen = dhContext->getPubKeySize();
     pubKeyBytes = (uint8_t*)malloc(pubKeyLen);
     if (pubKeyBytes == NULL) {
@@ -380,19 +385,23 @@ ZrtpPacketDHPart* ZRtp::prepareDHPart1(ZrtpPacketCommit *commit) {
     }
     // setup the DH context and generate a fresh public / secret key
     if (pubKey == Dh3072) {
-	dhContext = new ZrtpDH(3072);
+	dhContext = DhKeyPool::getInstance()->takeZrtpDH(DH_POOL_ZRTP3072);
 	maxPubKeySize = 384;
 
     }
     else if (pubKey == Dh4096) {
-	dhContext = new ZrtpDH(4096);
+	dhContext = DhKeyPool::getInstance()->takeZrtpDH(DH_POOL_ZRTP4096);
 	maxPubKeySize = 512;
     }
     else {
 	return NULL;
 	// Error - shouldn't happen
     }
-    dhContext->generateKey();
+    // The key pair comes precomputed from the pool
+    if (dhContext == NULL) {
+        sendInfo(Error, "Cannot generate a DH key pair");
+        return NULL;
+    }
     pubKeyLen = dhContext->getPubKeySize();
 
     char buffer[128];
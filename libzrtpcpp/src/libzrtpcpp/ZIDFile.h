@@ -17,12 +17,19 @@
 */
 
 #include <stdio.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
 
 #include <libzrtpcpp/ZIDRecord.h>
+#include <libmutil/Mutex.h>
 
 #ifndef _ZIDFILE_H_
 #define _ZIDFILE_H_
 
+struct zidslot;
+
 /**
  * This class implements a ZID (ZRTP Identifiers) file.
  *
@@ -30,6 +37,23 @@
  *
  * <p/>
  *
+ * The file is mapped into memory. Each peer owns a pair of slots in
+ * the file, and an update writes the slot not holding the current
+ * version of the record, so a crash while saving leaves the previous
+ * version intact. Slots carry a checksum and a sequence number, the
+ * valid slot with the highest sequence number is the current one.
+ * Records are located through a hash index on the peer's ZID that is
+ * built when the file is opened, so looking up a peer does not
+ * depend on the number of peers in the file.
+ *
+ * <p/>
+ *
+ * A file in the format of earlier versions (a plain array of
+ * zidrecord_t) is converted when opened, the original is kept with
+ * the suffix ".old".
+ *
+ * <p/>
+ *
  * NOTE: This class is a friend of the ZIDRecord class. Please keep both
  * classes synchronized.
  *
@@ -40,15 +64,61 @@ class ZIDFile {
 
 private:
 
-    FILE* zidFile;
+    unsigned char* map;
+    size_t mapSize;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mapHandle;
+#else
+    int fd;
+#endif
+    std::string fileName;
+
+    // Pairs of slots in the file, the first one holds the file header
+    uint32_t numPairs;
+
+    // Open addressing hash table of the peers' pairs, an entry with
+    // pair 0 is empty
+    struct IndexEntry {
+        uint32_t pair;
+        unsigned char zid[IDENTIFIER_LEN];
+    };
+    std::vector<IndexEntry> index;
+    uint32_t indexUsed;
+    uint32_t seed;
+
+    // Pairs not used by any peer
+    std::vector<uint32_t> freePairs;
+
+    Mutex lock;
+
     unsigned char associatedZid[IDENTIFIER_LEN];
     /**
      * The private ZID file constructor.
      *
      */
-    ZIDFile(): zidFile(NULL) {};
+    ZIDFile();
     ~ZIDFile();
 
+    int load(const char *name);
+    void closeFile();
+    int mapFile(size_t size);
+    int grow();
+    uint32_t newPair();
+    void flush(void *addr, size_t length);
+
+    uint32_t hash(const unsigned char *zid);
+    uint32_t findPair(const unsigned char *zid);
+    void addToIndex(const unsigned char *zid, uint32_t pair);
+    void resizeIndex(uint32_t size);
+
+    struct zidslot *currentSlot(uint32_t pair);
+    void writeRecord(uint32_t pair, const zidrecord_t *rec);
+
+    static int writeFile(const char *name, const unsigned char *ownZid,
+                         const std::vector<zidrecord_t> &records);
+    static int migrate(const char *name);
+
 public:
 
     /**
@@ -89,7 +159,7 @@ public:
      * @return
      *    1 if ZIDFile has an active file, 0 otherwise
      */
-    int isOpen() { return (zidFile == NULL); };
+    int isOpen() { return (map != NULL); };
 
      /**
      * Close the ZID file.
@@ -103,13 +173,14 @@ public:
      * The method get the identifier data from the ZID record parameter,
      * locates the record in the ZID file and fills in the RS1 and RS2
      * data. If no matching record exists in the ZID file the method creates
-     * it and fills it with default values.
+     * it and fills it with default values. A new record takes no room
+     * in the file until the first saveRecord() writes it.
      *
      * @param zidRecord
      *    The ZID record that contains the identifier data. The method
      *    fills in the RS1 and RS2 data.
      * @return
-     *    TODO
+     *    1 on success, 0 if no ZID file is open
      */
     unsigned int getRecord(ZIDRecord *zidRecord);
 
@@ -118,7 +189,7 @@ public:
      *
      * This method saves the content of a ZID record into the ZID file. Before
      * you can save the ZID record you must have performed a getRecord()
-     * first.
+     * first. The record is on disk when the method returns.
      *
      * @param zidRecord
      *    The ZID record to save.
@@ -127,6 +198,21 @@ public:
      */
     unsigned int saveRecord(ZIDRecord *zidRecord);
 
+    /**
+     * Rewrite the active ZID file without the free slots and the
+     * records of peers that never got a retained secret.
+     *
+     * @return
+     *    1 on success, 0 if no ZID file is open, -1 on failure. The
+     *    file is left unchanged on failure.
+     */
+    int compact();
+
+    /**
+     * Get the number of peers in the active ZID file.
+     */
+    unsigned int getNumRecords();
+
     /**
      * Get the ZID associated with this ZID file.
      *
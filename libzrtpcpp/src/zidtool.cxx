@@ -0,0 +1,91 @@
+/*
+  Copyright (C) 2006 Werner Dittmann
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2, or (at your option)
+  any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Boston, MA 02111.
+*/
+
+/*
+ * Prints the associated ZID and the number of peers of a ZID file,
+ * and compacts it. A file of the earlier format is converted when
+ * opened.
+ *
+ * Usage: zidtool [-c] <zid file>
+ *
+ * The file must not be in use by a running minisip.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <libzrtpcpp/ZIDFile.h>
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-c] <zid file>\n", name);
+    fprintf(stderr, "  -c  compact the file\n");
+}
+
+int main(int argc, char *argv[]) {
+    bool compact = false;
+    char *name = NULL;
+
+    for (int i = 1; i < argc; i++) {
+	if (strcmp(argv[i], "-c") == 0) {
+	    compact = true;
+	}
+	else if (name == NULL) {
+	    name = argv[i];
+	}
+	else {
+	    usage(argv[0]);
+	    return 1;
+	}
+    }
+    if (name == NULL) {
+	usage(argv[0]);
+	return 1;
+    }
+
+    ZIDFile *zid = ZIDFile::getInstance();
+    if (zid->open(name) != 1) {
+	fprintf(stderr, "%s: could not open %s\n", argv[0], name);
+	return 1;
+    }
+
+    printf("ZID:   ");
+    for (int i = 0; i < IDENTIFIER_LEN; i++) {
+	printf("%02x", zid->getZid()[i]);
+    }
+    printf("\npeers: %u\n", zid->getNumRecords());
+
+    if (compact) {
+	if (zid->compact() != 1) {
+	    fprintf(stderr, "%s: could not compact %s\n", argv[0], name);
+	    zid->close();
+	    return 1;
+	}
+	printf("peers after compaction: %u\n", zid->getNumRecords());
+    }
+
+    zid->close();
+    return 0;
+}
+
+/** EMACS **
+ * Local variables:
+ * mode: c++
+ * c-default-style: ellemtel
+ * c-basic-offset: 4
+ * End:
+ */
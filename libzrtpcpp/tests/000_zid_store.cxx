@@ -0,0 +1,220 @@
+/*
+ * Test of the ZID file.
+ *
+ * Converts a file of the earlier format, recovers from a damaged
+ * newest slot, compacts the file, and checks that lookups of unknown
+ * peers leave the file as it is.
+ */
+
+#include <libzrtpcpp/ZIDFile.h>
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <string>
+
+// Layout of the file, see ZIDFile.cxx
+#define SLOT_SIZE	128
+#define PAIR_SIZE	(2 * SLOT_SIZE)
+#define SLOT_RECORD	8
+
+// More than the pairs added by a growth of the file
+#define UNKNOWN_PEERS	1000
+
+static const char fileName[] = "000_zid_store.zid";
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+    if (!ok) {
+	fprintf(stderr, "FAILED: %s\n", what);
+	failures++;
+    }
+}
+
+static void makeZid(unsigned char *zid, int n) {
+    memset(zid, 0, IDENTIFIER_LEN);
+    zid[0] = 0x5a;
+    zid[IDENTIFIER_LEN - 1] = (unsigned char)n;
+}
+
+static void makeRs(unsigned char *rs, int n) {
+    memset(rs, n, RS_LENGTH);
+}
+
+static long fileSize(const char *name) {
+    struct stat st;
+
+    if (stat(name, &st) < 0) {
+	return -1;
+    }
+    return (long)st.st_size;
+}
+
+/*
+ * Peers 1 to 3 with RS1 1 to 3, peer 4 without retained secret and
+ * an invalid record of peer 5 that is dropped.
+ */
+static bool writeLegacyFile(const unsigned char *ownZid) {
+    zidrecord_t rec;
+    bool ok = true;
+
+    FILE *f = fopen(fileName, "wb");
+    if (f == NULL) {
+	return false;
+    }
+    memset(&rec, 0, sizeof(zidrecord_t));
+    rec.recValid = 1;
+    rec.ownZid = 1;
+    memcpy(rec.identifier, ownZid, IDENTIFIER_LEN);
+    ok = ok && fwrite(&rec, sizeof(zidrecord_t), 1, f) == 1;
+
+    for (int i = 1; i <= 5; i++) {
+	memset(&rec, 0, sizeof(zidrecord_t));
+	rec.recValid = (i == 5) ? 0 : 1;
+	makeZid(rec.identifier, i);
+	if (i <= 3) {
+	    rec.rs1Valid = 1;
+	    makeRs(rec.rs1Data, i);
+	}
+	ok = ok && fwrite(&rec, sizeof(zidrecord_t), 1, f) == 1;
+    }
+    return fclose(f) == 0 && ok;
+}
+
+// RS1 of a peer, 0 if it has none or is not in the file
+static int getRs1(ZIDFile *zid, int n) {
+    unsigned char id[IDENTIFIER_LEN];
+
+    makeZid(id, n);
+    ZIDRecord rec(id);
+    zid->getRecord(&rec);
+    if (!rec.isRs1Valid()) {
+	return 0;
+    }
+    return rec.getRs1()[0];
+}
+
+static void saveRs1(ZIDFile *zid, int n, int rs1) {
+    unsigned char id[IDENTIFIER_LEN];
+    unsigned char rs[RS_LENGTH];
+
+    makeZid(id, n);
+    makeRs(rs, rs1);
+    ZIDRecord rec(id);
+    zid->getRecord(&rec);
+    rec.setNewRs1(rs);
+    check(zid->saveRecord(&rec) == 1, "record saved");
+}
+
+// Flips a byte of the record in a slot of the file
+static bool damageSlot(uint32_t pair, int slot) {
+    unsigned char c;
+    long offset = (long)pair * PAIR_SIZE + slot * SLOT_SIZE + SLOT_RECORD +
+	offsetof(zidrecord_t, rs1Data);
+
+    FILE *f = fopen(fileName, "r+b");
+    if (f == NULL) {
+	return false;
+    }
+    bool ok = fseek(f, offset, SEEK_SET) == 0 && fread(&c, 1, 1, f) == 1;
+    c ^= 0xff;
+    ok = ok && fseek(f, offset, SEEK_SET) == 0 && fwrite(&c, 1, 1, f) == 1;
+    return fclose(f) == 0 && ok;
+}
+
+int main(int argc, char *argv[]) {
+    std::string oldName = std::string(fileName) + ".old";
+    unsigned char ownZid[IDENTIFIER_LEN];
+    ZIDFile *zid = ZIDFile::getInstance();
+
+    remove(fileName);
+    remove(oldName.c_str());
+
+    // Conversion of the earlier format
+    makeZid(ownZid, 0xff);
+    check(writeLegacyFile(ownZid), "earlier format written");
+    long legacySize = fileSize(fileName);
+    check(zid->open((char *)fileName) == 1, "earlier format opened");
+    check(fileSize(oldName.c_str()) == legacySize, "original kept as .old");
+    check(memcmp(zid->getZid(), ownZid, IDENTIFIER_LEN) == 0, "own ZID kept");
+    check(zid->getNumRecords() == 4, "valid peer records kept");
+    check(getRs1(zid, 1) == 1 && getRs1(zid, 2) == 2 && getRs1(zid, 3) == 3,
+	  "retained secrets kept");
+    check(getRs1(zid, 4) == 0, "peer without retained secret kept");
+    zid->close();
+
+    // Opened again as it is, without another conversion
+    remove(oldName.c_str());
+    check(zid->open((char *)fileName) == 1, "converted file opened");
+    check(fileSize(oldName.c_str()) < 0, "converted file not converted again");
+    check(zid->getNumRecords() == 4, "converted file records");
+
+    // Unknown peers take no room until saved
+    long size = fileSize(fileName);
+    for (int i = 0; i < UNKNOWN_PEERS; i++) {
+	unsigned char id[IDENTIFIER_LEN];
+	memset(id, 0xa5, IDENTIFIER_LEN);
+	id[0] = (unsigned char)i;
+	id[1] = (unsigned char)(i >> 8);
+	ZIDRecord rec(id);
+	check(zid->getRecord(&rec) == 1 && !rec.isRs1Valid(),
+	      "unknown peer looked up");
+    }
+    check(zid->getNumRecords() == 4, "lookups add no record");
+    check(fileSize(fileName) == size, "lookups do not grow the file");
+
+    // The newest save wins, the slots of the converted peer 1 hold
+    // the sequence numbers 1, then 2 and 3 of the saves
+    saveRs1(zid, 1, 10);
+    saveRs1(zid, 1, 11);
+    saveRs1(zid, 6, 6);
+    check(zid->getNumRecords() == 5, "saved peer added");
+    zid->close();
+    check(zid->open((char *)fileName) == 1, "file opened after saves");
+    check(getRs1(zid, 1) == 11, "highest sequence number read");
+    check(getRs1(zid, 6) == 6, "new peer read");
+    zid->close();
+
+    // A damaged newest slot, as left by a crash while saving, falls
+    // back to the previous version
+    check(damageSlot(1, 0), "newest slot damaged");
+    check(zid->open((char *)fileName) == 1, "file opened after damage");
+    check(getRs1(zid, 1) == 10, "previous version read");
+    check(getRs1(zid, 2) == 2, "other peers unharmed");
+
+    // The next save replaces the damaged slot
+    saveRs1(zid, 1, 12);
+    zid->close();
+    check(zid->open((char *)fileName) == 1, "file opened after recovery");
+    check(getRs1(zid, 1) == 12, "save after recovery read");
+
+    // Compaction keeps only the peers with retained secrets
+    check(zid->compact() == 1, "file compacted");
+    check(zid->getNumRecords() == 4, "peers with retained secrets kept");
+    check(getRs1(zid, 1) == 12 && getRs1(zid, 2) == 2 &&
+	  getRs1(zid, 3) == 3 && getRs1(zid, 6) == 6,
+	  "retained secrets kept by compaction");
+    check(getRs1(zid, 4) == 0, "peer without retained secret dropped");
+    check(fileSize(fileName) == 5 * PAIR_SIZE, "free pairs dropped");
+    check(memcmp(zid->getZid(), ownZid, IDENTIFIER_LEN) == 0,
+	  "own ZID kept by compaction");
+    zid->close();
+
+    check(zid->open((char *)fileName) == 1, "compacted file opened");
+    check(zid->getNumRecords() == 4 && getRs1(zid, 1) == 12,
+	  "compacted file read");
+    zid->close();
+
+    remove(fileName);
+    remove(oldName.c_str());
+
+    if (failures) {
+	fprintf(stderr, "%d checks failed\n", failures);
+	return 1;
+    }
+    printf("ZIDFile: all checks passed\n");
+    return 0;
+}
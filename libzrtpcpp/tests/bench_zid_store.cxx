@@ -0,0 +1,150 @@
+/*
+ * Benchmark of the ZID file.
+ *
+ * Writes a ZID file of the earlier format holding 100000 peers, and
+ * times its conversion when opened, lookups of known and unknown
+ * peers, saves and a compaction. For comparison, lookups are also
+ * timed with the linear scan of the earlier format.
+ */
+
+#include <libzrtpcpp/ZIDFile.h>
+#include <libmutil/mtime.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#define BENCH_PEERS 100000
+#define BENCH_SCANS 100
+#define BENCH_SAVES 1000
+
+static const char fileName[] = "bench_zid_store.zid";
+
+static void randomZid(unsigned char *zid) {
+    for (int i = 0; i < IDENTIFIER_LEN; i++) {
+	zid[i] = rand() & 0xff;
+    }
+}
+
+static void writeLegacyFile(const std::vector<zidrecord_t> &peers) {
+    zidrecord_t own;
+    FILE *f = fopen(fileName, "wb");
+
+    if (f == NULL) {
+	fprintf(stderr, "Could not write %s\n", fileName);
+	exit(1);
+    }
+    memset(&own, 0, sizeof(zidrecord_t));
+    own.ownZid = 1;
+    randomZid(own.identifier);
+    fwrite(&own, sizeof(zidrecord_t), 1, f);
+    fwrite(&peers[0], sizeof(zidrecord_t), peers.size(), f);
+    fclose(f);
+}
+
+// The lookup of the earlier ZIDFile::getRecord
+static bool legacyScan(FILE *f, const unsigned char *zid) {
+    zidrecord_t rec;
+
+    fseek(f, (long)(sizeof(zidrecord_t)), SEEK_SET);
+    while (fread(&rec, sizeof(zidrecord_t), 1, f) == 1) {
+	if (memcmp(rec.identifier, zid, IDENTIFIER_LEN) == 0) {
+	    return true;
+	}
+    }
+    return false;
+}
+
+static double perSecond(int n, uint64_t ms) {
+    return n * 1000.0 / (ms ? ms : 1);
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<zidrecord_t> peers(BENCH_PEERS);
+    unsigned char rs[RS_LENGTH];
+    uint64_t start;
+
+    srand(1);
+    for (int i = 0; i < BENCH_PEERS; i++) {
+	memset(&peers[i], 0, sizeof(zidrecord_t));
+	peers[i].recValid = 1;
+	peers[i].rs1Valid = 1;
+	randomZid(peers[i].identifier);
+	memset(peers[i].rs1Data, i & 0xff, RS_LENGTH);
+    }
+    writeLegacyFile(peers);
+
+    // Scan for the peers at the end of the file, the worst case
+    FILE *f = fopen(fileName, "rb");
+    start = mtime();
+    for (int i = 0; i < BENCH_SCANS; i++) {
+	if (!legacyScan(f, peers[BENCH_PEERS - 1 - i].identifier)) {
+	    fprintf(stderr, "Legacy scan failed\n");
+	    return 1;
+	}
+    }
+    double scanRate = perSecond(BENCH_SCANS, mtime() - start);
+    fclose(f);
+
+    ZIDFile *zid = ZIDFile::getInstance();
+    start = mtime();
+    if (zid->open((char *)fileName) != 1) {
+	fprintf(stderr, "Could not open %s\n", fileName);
+	return 1;
+    }
+    uint64_t migrateMs = mtime() - start;
+
+    start = mtime();
+    for (int i = 0; i < BENCH_PEERS; i++) {
+	ZIDRecord rec(peers[i].identifier);
+	zid->getRecord(&rec);
+	if (!rec.isRs1Valid() || rec.getRs1()[0] != (i & 0xff)) {
+	    fprintf(stderr, "Peer %d not found\n", i);
+	    return 1;
+	}
+    }
+    double lookupRate = perSecond(BENCH_PEERS, mtime() - start);
+
+    start = mtime();
+    for (int i = 0; i < BENCH_SAVES; i++) {
+	unsigned char id[IDENTIFIER_LEN];
+	randomZid(id);
+	ZIDRecord rec(id);
+	zid->getRecord(&rec);
+    }
+    double newRate = perSecond(BENCH_SAVES, mtime() - start);
+
+    memset(rs, 0x5a, RS_LENGTH);
+    start = mtime();
+    for (int i = 0; i < BENCH_SAVES; i++) {
+	ZIDRecord rec(peers[i].identifier);
+	zid->getRecord(&rec);
+	rec.setNewRs1(rs);
+	zid->saveRecord(&rec);
+    }
+    double saveRate = perSecond(BENCH_SAVES, mtime() - start);
+
+    start = mtime();
+    if (zid->compact() != 1) {
+	fprintf(stderr, "Compaction failed\n");
+	return 1;
+    }
+    uint64_t compactMs = mtime() - start;
+    unsigned int kept = zid->getNumRecords();
+    zid->close();
+
+    printf("%d peers\n", BENCH_PEERS);
+    printf("legacy scan:       %12.1f lookups/s\n", scanRate);
+    printf("lookup:            %12.1f lookups/s\n", lookupRate);
+    printf("new peer:          %12.1f lookups/s\n", newRate);
+    printf("save:              %12.1f saves/s\n", saveRate);
+    printf("conversion:        %8llu ms\n", (unsigned long long)migrateMs);
+    printf("compaction:        %8llu ms, %u peers kept\n",
+	   (unsigned long long)compactMs, kept);
+
+    remove(fileName);
+    remove((std::string(fileName) + ".old").c_str());
+    return 0;
+}
@@ -17,6 +17,7 @@
 #include <string.h> 
 
 #include"iLBC_define.h" 
+#include"corrKernels.h" 
 
 //using namespace std;
 
@@ -57,14 +58,10 @@
        /* Filter last part where the state is entierly  
           in the input vector */ 
     
-       for (i=LPC_FILTERORDER;i<len;i++) { 
-           pi = &In[i]; 
-           pa = a; 
-           *po=0.0; 
-           for (j=0;j<LPC_FILTERORDER+1;j++) { 
-               *po+=(*pa++)*(*pi--); 
-           } 
-           po++; 
+       if (len>LPC_FILTERORDER) { 
+           memset(po, 0, (len-LPC_FILTERORDER)*sizeof(float)); 
+           firFilter(po, &In[LPC_FILTERORDER], a, LPC_FILTERORDER+1,  
+               len-LPC_FILTERORDER); 
        } 
     
        /* Update state vector */ 
@@ -0,0 +1,390 @@
+   /******************************************************************
+
+       iLBC Speech Coder ANSI-C Source Code
+
+       corrKernels.c
+
+       Dot product, correlation and FIR filter kernels, with SSE2
+       and AVX2 versions selected at run time.
+
+   ******************************************************************/
+
+   #include "corrKernels.h"
+
+   /* The vector versions are compiled for their instruction set
+      function by function, the rest of the codec keeps the flags
+      of the build, so they need GCC 4.9 or a compatible compiler */
+
+   #if (defined(__x86_64__) || defined(__i386__)) && \
+       (defined(__clang__) || __GNUC__ > 4 || \
+       (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+   #define ILBC_X86_KERNELS
+   #include <immintrin.h>
+   #endif
+
+   static int kernels = ILBC_KERNELS_SCALAR;
+
+   /*----------------------------------------------------------------*
+    *  scalar versions, the reference the others must match
+    *---------------------------------------------------------------*/
+
+   static void crossCorrScalar(
+       float *corr,
+       const float *x,
+       const float *y,
+       int len,
+       int n
+   ){
+       int k, i;
+       float sum;
+
+       for (k=0; k<n; k++) {
+           sum = corr[k];
+           for (i=0; i<len; i++) {
+               sum += x[k+i]*y[i];
+           }
+           corr[k] = sum;
+       }
+   }
+
+   static void crossCorrEnergyScalar(
+       float *corr,
+       float *energy,
+       const float *x,
+       const float *y,
+       int len,
+       int n
+   ){
+       int k, i;
+       float sum, ene;
+
+       for (k=0; k<n; k++) {
+           sum = corr[k];
+           ene = energy[k];
+           for (i=0; i<len; i++) {
+               sum += x[k+i]*y[i];
+               ene += x[k+i]*x[k+i];
+           }
+           corr[k] = sum;
+           energy[k] = ene;
+       }
+   }
+
+   static void firFilterScalar(
+       float *out,
+       const float *x,
+       const float *h,
+       int len,
+       int n
+   ){
+       int k, j;
+       float sum;
+
+       for (k=0; k<n; k++) {
+           sum = out[k];
+           for (j=0; j<len; j++) {
+               sum += h[j]*x[k-j];
+           }
+           out[k] = sum;
+       }
+   }
+
+   #ifdef ILBC_X86_KERNELS
+
+   /*----------------------------------------------------------------*
+    *  SSE2 versions, 8 then 4 outputs at a time, return the number
+    *  of outputs done
+    *---------------------------------------------------------------*/
+
+   __attribute__((target("sse2")))
+   static int crossCorrSse2(
+       float *corr,
+       const float *x,
+       const float *y,
+       int len,
+       int n
+   ){
+       int k, i;
+       __m128 yi, s0, s1;
+
+       for (k=0; k+8<=n; k+=8) {
+           s0 = _mm_loadu_ps(corr+k);
+           s1 = _mm_loadu_ps(corr+k+4);
+           for (i=0; i<len; i++) {
+               yi = _mm_set1_ps(y[i]);
+               s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(x+k+i), yi));
+               s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(x+k+i+4), yi));
+           }
+           _mm_storeu_ps(corr+k, s0);
+           _mm_storeu_ps(corr+k+4, s1);
+       }
+       if (k+4<=n) {
+           s0 = _mm_loadu_ps(corr+k);
+           for (i=0; i<len; i++) {
+               s0 = _mm_add_ps(s0,
+                   _mm_mul_ps(_mm_loadu_ps(x+k+i), _mm_set1_ps(y[i])));
+           }
+           _mm_storeu_ps(corr+k, s0);
+           k += 4;
+       }
+       return k;
+   }
+
+   __attribute__((target("sse2")))
+   static int crossCorrEnergySse2(
+       float *corr,
+       float *energy,
+       const float *x,
+       const float *y,
+       int len,
+       int n
+   ){
+       int k, i;
+       __m128 xi, s, e;
+
+       for (k=0; k+4<=n; k+=4) {
+           s = _mm_loadu_ps(corr+k);
+           e = _mm_loadu_ps(energy+k);
+           for (i=0; i<len; i++) {
+               xi = _mm_loadu_ps(x+k+i);
+               s = _mm_add_ps(s, _mm_mul_ps(xi, _mm_set1_ps(y[i])));
+               e = _mm_add_ps(e, _mm_mul_ps(xi, xi));
+           }
+           _mm_storeu_ps(corr+k, s);
+           _mm_storeu_ps(energy+k, e);
+       }
+       return k;
+   }
+
+   __attribute__((target("sse2")))
+   static int firFilterSse2(
+       float *out,
+       const float *x,
+       const float *h,
+       int len,
+       int n
+   ){
+       int k, j;
+       __m128 hj, s0, s1;
+
+       for (k=0; k+8<=n; k+=8) {
+           s0 = _mm_loadu_ps(out+k);
+           s1 = _mm_loadu_ps(out+k+4);
+           for (j=0; j<len; j++) {
+               hj = _mm_set1_ps(h[j]);
+               s0 = _mm_add_ps(s0, _mm_mul_ps(hj, _mm_loadu_ps(x+k-j)));
+               s1 = _mm_add_ps(s1, _mm_mul_ps(hj, _mm_loadu_ps(x+k-j+4)));
+           }
+           _mm_storeu_ps(out+k, s0);
+           _mm_storeu_ps(out+k+4, s1);
+       }
+       if (k+4<=n) {
+           s0 = _mm_loadu_ps(out+k);
+           for (j=0; j<len; j++) {
+               s0 = _mm_add_ps(s0,
+                   _mm_mul_ps(_mm_set1_ps(h[j]), _mm_loadu_ps(x+k-j)));
+           }
+           _mm_storeu_ps(out+k, s0);
+           k += 4;
+       }
+       return k;
+   }
+
+   /*----------------------------------------------------------------*
+    *  AVX2 versions, 16 then 8 outputs at a time. No fused multiply
+    *  add, its single rounding would not match the scalar code.
+    *---------------------------------------------------------------*/
+
+   __attribute__((target("avx2")))
+   static int crossCorrAvx2(
+       float *corr,
+       const float *x,
+       const float *y,
+       int len,
+       int n
+   ){
+       int k, i;
+       __m256 yi, s0, s1;
+
+       for (k=0; k+16<=n; k+=16) {
+           s0 = _mm256_loadu_ps(corr+k);
+           s1 = _mm256_loadu_ps(corr+k+8);
+           for (i=0; i<len; i++) {
+               yi = _mm256_set1_ps(y[i]);
+               s0 = _mm256_add_ps(s0,
+                   _mm256_mul_ps(_mm256_loadu_ps(x+k+i), yi));
+               s1 = _mm256_add_ps(s1,
+                   _mm256_mul_ps(_mm256_loadu_ps(x+k+i+8), yi));
+           }
+           _mm256_storeu_ps(corr+k, s0);
+           _mm256_storeu_ps(corr+k+8, s1);
+       }
+       if (k+8<=n) {
+           s0 = _mm256_loadu_ps(corr+k);
+           for (i=0; i<len; i++) {
+               s0 = _mm256_add_ps(s0, _mm256_mul_ps(
+                   _mm256_loadu_ps(x+k+i), _mm256_set1_ps(y[i])));
+           }
+           _mm256_storeu_ps(corr+k, s0);
+           k += 8;
+       }
+       return k;
+   }
+
+   __attribute__((target("avx2")))
+   static int crossCorrEnergyAvx2(
+       float *corr,
+       float *energy,
+       const float *x,
+       const float *y,
+       int len,
+       int n
+   ){
+       int k, i;
+       __m256 xi, s, e;
+
+       for (k=0; k+8<=n; k+=8) {
+           s = _mm256_loadu_ps(corr+k);
+           e = _mm256_loadu_ps(energy+k);
+           for (i=0; i<len; i++) {
+               xi = _mm256_loadu_ps(x+k+i);
+               s = _mm256_add_ps(s, _mm256_mul_ps(xi, _mm256_set1_ps(y[i])));
+               e = _mm256_add_ps(e, _mm256_mul_ps(xi, xi));
+           }
+           _mm256_storeu_ps(corr+k, s);
+           _mm256_storeu_ps(energy+k, e);
+       }
+       return k;
+   }
+
+   __attribute__((target("avx2")))
+   static int firFilterAvx2(
+       float *out,
+       const float *x,
+       const float *h,
+       int len,
+       int n
+   ){
+       int k, j;
+       __m256 hj, s0, s1;
+
+       for (k=0; k+16<=n; k+=16) {
+           s0 = _mm256_loadu_ps(out+k);
+           s1 = _mm256_loadu_ps(out+k+8);
+           for (j=0; j<len; j++) {
+               hj = _mm256_set1_ps(h[j]);
+               s0 = _mm256_add_ps(s0,
+                   _mm256_mul_ps(hj, _mm256_loadu_ps(x+k-j)));
+               s1 = _mm256_add_ps(s1,
+                   _mm256_mul_ps(hj, _mm256_loadu_ps(x+k-j+8)));
+           }
+           _mm256_storeu_ps(out+k, s0);
+           _mm256_storeu_ps(out+k+8, s1);
+       }
+       if (k+8<=n) {
+           s0 = _mm256_loadu_ps(out+k);
+           for (j=0; j<len; j++) {
+               s0 = _mm256_add_ps(s0, _mm256_mul_ps(
+                   _mm256_set1_ps(h[j]), _mm256_loadu_ps(x+k-j)));
+           }
+           _mm256_storeu_ps(out+k, s0);
+           k += 8;
+       }
+       return k;
+   }
+
+   #endif
+
+   /*----------------------------------------------------------------*
+    *  selection of the kernels
+    *---------------------------------------------------------------*/
+
+   int ilbc_selectKernels(
+       int requested   /* (i) one of ILBC_KERNELS_* */
+   ){
+       int best = ILBC_KERNELS_SCALAR;
+
+   #ifdef ILBC_X86_KERNELS
+       __builtin_cpu_init();
+       if (__builtin_cpu_supports("avx2")) {
+           best = ILBC_KERNELS_AVX2;
+       } else if (__builtin_cpu_supports("sse2")) {
+           best = ILBC_KERNELS_SSE2;
+       }
+   #endif
+
+       if (requested == ILBC_KERNELS_AUTO || requested > best) {
+           kernels = best;
+       } else {
+           kernels = requested;
+       }
+       return kernels;
+   }
+
+   static int initialKernels = ilbc_selectKernels(ILBC_KERNELS_AUTO);
+
+   /*----------------------------------------------------------------*
+    *  entry points, the vector version leaves the last outputs to
+    *  the narrower ones
+    *---------------------------------------------------------------*/
+
+   void crossCorr(
+       float *corr,        /* (i/o) correlations */
+       const float *x,     /* (i) sequence sliding, n+len-1 samples */
+       const float *y,     /* (i) fixed sequence, len samples */
+       int len,            /* (i) length of each correlation */
+       int n               /* (i) number of correlations */
+   ){
+       int k = 0;
+
+   #ifdef ILBC_X86_KERNELS
+       if (kernels == ILBC_KERNELS_AVX2) {
+           k = crossCorrAvx2(corr, x, y, len, n);
+       }
+       if (kernels >= ILBC_KERNELS_SSE2) {
+           k += crossCorrSse2(corr+k, x+k, y, len, n-k);
+       }
+   #endif
+       crossCorrScalar(corr+k, x+k, y, len, n-k);
+   }
+
+   void crossCorrEnergy(
+       float *corr,        /* (i/o) correlations */
+       float *energy,      /* (i/o) energies of the x segments */
+       const float *x,     /* (i) sequence sliding, n+len-1 samples */
+       const float *y,     /* (i) fixed sequence, len samples */
+       int len,            /* (i) length of each correlation */
+       int n               /* (i) number of correlations */
+   ){
+       int k = 0;
+
+   #ifdef ILBC_X86_KERNELS
+       if (kernels == ILBC_KERNELS_AVX2) {
+           k = crossCorrEnergyAvx2(corr, energy, x, y, len, n);
+       }
+       if (kernels >= ILBC_KERNELS_SSE2) {
+           k += crossCorrEnergySse2(corr+k, energy+k, x+k, y, len, n-k);
+       }
+   #endif
+       crossCorrEnergyScalar(corr+k, energy+k, x+k, y, len, n-k);
+   }
+
+   void firFilter(
+       float *out,         /* (i/o) filtered samples */
+       const float *x,     /* (i) input, x[-(len-1)] to x[n-1] */
+       const float *h,     /* (i) filter coefficients */
+       int len,            /* (i) number of coefficients */
+       int n               /* (i) number of samples */
+   ){
+       int k = 0;
+
+   #ifdef ILBC_X86_KERNELS
+       if (kernels == ILBC_KERNELS_AVX2) {
+           k = firFilterAvx2(out, x, h, len, n);
+       }
+       if (kernels >= ILBC_KERNELS_SSE2) {
+           k += firFilterSse2(out+k, x+k, h, len, n-k);
+       }
+   #endif
+       firFilterScalar(out+k, x+k, h, len, n-k);
+   }
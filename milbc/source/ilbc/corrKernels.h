@@ -0,0 +1,66 @@
+   /******************************************************************
+
+       iLBC Speech Coder ANSI-C Source Code
+
+       corrKernels.h
+
+       Dot product, correlation and FIR filter kernels, with SSE2
+       and AVX2 versions selected at run time.
+
+   ******************************************************************/
+
+   #ifndef __iLBC_CORRKERNELS_H
+   #define __iLBC_CORRKERNELS_H
+
+   #define ILBC_KERNELS_AUTO   0
+   #define ILBC_KERNELS_SCALAR 1
+   #define ILBC_KERNELS_SSE2   2
+   #define ILBC_KERNELS_AVX2   3
+
+   /*----------------------------------------------------------------*
+    *  Every output of the kernels is summed in the order of the
+    *  plain loop it replaces, the vector versions computing several
+    *  outputs side by side, so that all of them give bit identical
+    *  results. They add to their outputs, which must be set first.
+    *---------------------------------------------------------------*/
+
+   /* selects the kernels used, ILBC_KERNELS_AUTO for the fastest
+      the processor supports, returns those selected */
+
+   int ilbc_selectKernels(
+       int kernels     /* (i) one of ILBC_KERNELS_* */
+   );
+
+   /* corr[k] += sum over i<len of x[k+i]*y[i], for k<n */
+
+   void crossCorr(
+       float *corr,        /* (i/o) correlations */
+       const float *x,     /* (i) sequence sliding, n+len-1 samples */
+       const float *y,     /* (i) fixed sequence, len samples */
+       int len,            /* (i) length of each correlation */
+       int n               /* (i) number of correlations */
+   );
+
+   /* as crossCorr, with energy[k] += sum over i<len of x[k+i]^2 */
+
+   void crossCorrEnergy(
+       float *corr,        /* (i/o) correlations */
+       float *energy,      /* (i/o) energies of the x segments */
+       const float *x,     /* (i) sequence sliding, n+len-1 samples */
+       const float *y,     /* (i) fixed sequence, len samples */
+       int len,            /* (i) length of each correlation */
+       int n               /* (i) number of correlations */
+   );
+
+   /* out[k] += sum over j<len of h[j]*x[k-j], for k<n */
+
+   void firFilter(
+       float *out,         /* (i/o) filtered samples */
+       const float *x,     /* (i) input, x[-(len-1)] to x[n-1] */
+       const float *h,     /* (i) filter coefficients */
+       int len,            /* (i) number of coefficients */
+       int n               /* (i) number of samples */
+   );
+
+   #endif
+
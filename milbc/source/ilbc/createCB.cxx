@@ -16,6 +16,7 @@
 
 #include"iLBC_define.h" 
 #include"constants.h"
+#include"corrKernels.h"
 
    #include <string.h> 
    #include <math.h> 
@@ -34,10 +35,7 @@
    */ 
        int lMem        /* (i) Length of buffer */ 
    ){ 
-       int j, k; 
-       float *pp, *pp1; 
        float tempbuff2[CB_MEML+CB_FILTERLEN]; 
-       float *pos; 
     
        memset(tempbuff2, 0, (CB_HALFFILTERLEN-1)*sizeof(float)); 
        memcpy(&tempbuff2[CB_HALFFILTERLEN-1], mem, lMem*sizeof(float)); 
@@ -47,16 +45,8 @@
        /* Create codebook vector for higher section by filtering */ 
     
        /* do filtering */ 
-       pos=cbvectors; 
-       memset(pos, 0, lMem*sizeof(float)); 
-       for (k=0; k<lMem; k++) { 
-           pp=&tempbuff2[k]; 
-           pp1=&cbfiltersTbl[0]; 
-           for (j=0;j<CB_FILTERLEN;j++) { 
-               (*pos)+=(*pp++)*(*pp1++); 
-           } 
-           pos++; 
-       } 
+       memset(cbvectors, 0, lMem*sizeof(float)); 
+       crossCorr(cbvectors, tempbuff2, cbfiltersTbl, CB_FILTERLEN, lMem); 
    } 
     
    /*----------------------------------------------------------------* 
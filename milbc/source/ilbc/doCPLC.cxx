@@ -33,6 +33,11 @@
    ){ 
        int i; 
        float ftmp1, ftmp2; 
+    
+       /* Guard against getting outside buffer */ 
+       if ((bLen-sRange-lag)<0) { 
+           sRange=bLen-lag; 
+       } 
         
        ftmp1 = 0.0; 
        ftmp2 = 0.0; 
@@ -71,7 +76,7 @@
                            /* (i/o) decoder instance */ 
    ){ 
        int lag=20, randlag; 
-       float gain, maxcc; 
+       float gain=0.0, maxcc; 
        float gain_comp, maxcc_comp; 
        int i, pick, offset; 
        float ftmp, ftmp1, randvec[BLOCKL_MAX], pitchfact; 
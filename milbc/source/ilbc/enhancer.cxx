@@ -18,6 +18,7 @@
 
    #include"iLBC_define.h" 
    #include"constants.h" 
+   #include"corrKernels.h" 
    #include"filter.h" 
     
    /*----------------------------------------------------------------* 
@@ -61,13 +62,9 @@
        const float *seq2,  /* (i) second sequence */ 
        int dim2        /* (i) dimension seq2 */ 
    ){ 
-       int i,j; 
-    
-       for(i=0;i<=dim1-dim2; i++){ 
-           corr[i]=0.0; 
-           for(j=0;j<dim2; j++){ 
-               corr[i] += seq1[i+j] * seq2[j]; 
-           } 
+       if (dim1>=dim2) { 
+           memset(corr, 0, (dim1-dim2+1)*sizeof(float)); 
+           crossCorr(corr, seq1, seq2, dim2, dim1-dim2+1); 
        } 
    } 
     
@@ -475,6 +472,36 @@
        } 
    } 
     
+   /*----------------------------------------------------------------* 
+    * xCorrCoef of target with the regressors starting at regressor, 
+    * regressor+1, ..., regressor+nreg-1 
+    *---------------------------------------------------------------*/ 
+    
+   void xCorrCoefs(  
+       float *cc,          /* (o) nreg coefficients */ 
+       float *target,      /* (i) first array */ 
+       float *regressor,   /* (i) first of the second arrays */ 
+       int subl,           /* (i) dimension arrays */ 
+       int nreg            /* (i) number of regressors, at most  
+                                  BLOCKL_MAX */ 
+   ){ 
+       int i; 
+       float energy[BLOCKL_MAX]; 
+    
+       memset(cc, 0, nreg*sizeof(float)); 
+       memset(energy, 0, nreg*sizeof(float)); 
+       crossCorrEnergy(cc, energy, regressor, target, subl, nreg); 
+    
+       for (i=0; i<nreg; i++) { 
+           if (cc[i] > 0.0) { 
+               cc[i] = (float)(cc[i]*cc[i]/energy[i]); 
+           } 
+           else { 
+               cc[i] = (float)0.0; 
+           } 
+       } 
+   } 
+    
    /*----------------------------------------------------------------* 
     * interface for enhancer 
     *---------------------------------------------------------------*/ 
@@ -487,7 +514,7 @@
        float *enh_buf, *enh_period; 
        int iblock, isample; 
        int lag, ilag, i; 
-       float cc, maxcc; 
+       float cc, maxcc, ccs[100]; 
        float ftmp1, ftmp2, gain; 
        float *inPtr, *enh_bufPtr1, *enh_bufPtr2; 
     
@@ -499,19 +526,23 @@
        enh_period=iLBCdec_inst->enh_period; 
         
         
-       memmove(enh_buf, &enh_buf[ENH_NBLOCKS*ENH_BLOCKL],  
-           (ENH_NBLOCKS_EXTRA*ENH_BLOCKL)*sizeof(float)); 
-                                                                
-       memcpy(&enh_buf[ENH_NBLOCKS_EXTRA*ENH_BLOCKL], in,  
-           (ENH_NBLOCKS*ENH_BLOCKL)*sizeof(float)); 
+       /* The new BLOCKL samples go at the end of the buffer, 
+          the two blocks enhanced lag them by 40 samples */ 
+    
+       memmove(enh_buf, &enh_buf[BLOCKL],  
+           (ENH_BUFL-BLOCKL)*sizeof(float)); 
+    
+       memcpy(&enh_buf[ENH_BUFL-BLOCKL], in, BLOCKL*sizeof(float)); 
     
        if (iLBCdec_inst->prev_enh_pl==1) { 
            /* PLC was performed on the previous packet */ 
     
+           xCorrCoefs(ccs, in, in+20, ENH_BLOCKL, 100); 
+    
            lag = 20; 
-           maxcc = xCorrCoef(in, in+lag, ENH_BLOCKL); 
+           maxcc = ccs[0]; 
            for (ilag=21; ilag<120; ilag++) { 
-               cc = xCorrCoef(in, in+ilag, ENH_BLOCKL); 
+               cc = ccs[ilag-20]; 
                 
                if (cc > maxcc) { 
                    maxcc = cc; 
@@ -541,7 +572,7 @@
     
            inPtr=&in[lag-1]; 
             
-           enh_bufPtr1=&enh_buf[ENH_NBLOCKS_EXTRA*ENH_BLOCKL-1]; 
+           enh_bufPtr1=&enh_buf[ENH_BUFL-BLOCKL-1]; 
             
            if (lag>ENH_BLOCKL) { 
                start=ENH_BLOCKL; 
@@ -553,15 +584,15 @@
                *enh_bufPtr1-- = gain*(*inPtr--); 
            } 
             
-           enh_bufPtr2=&enh_buf[ENH_NBLOCKS_EXTRA*ENH_BLOCKL-1]; 
+           enh_bufPtr2=&enh_buf[ENH_BUFL-BLOCKL-1]; 
            for (isample = (ENH_BLOCKL-1-lag); isample>=0; isample--) { 
                *enh_bufPtr1-- = gain*(*enh_bufPtr2--); 
            } 
     
        } 
     
-       memmove(enh_period, &enh_period[ENH_NBLOCKS],  
-           ENH_NBLOCKS_EXTRA*sizeof(float)); 
+       memmove(enh_period, &enh_period[BLOCKL/ENH_BLOCKL],  
+           (ENH_NBLOCKS_TOT-BLOCKL/ENH_BLOCKL)*sizeof(float)); 
     
     
        /* Set state information to the 6 samples right before  
@@ -580,14 +611,15 @@
        /* Estimate the pitch in the down sampled domain. */ 
        for(iblock = 0; iblock<ENH_NBLOCKS; iblock++){ 
             
+           /* the coefficient of lag ilag in ccs[59-ilag] */ 
+           xCorrCoefs(ccs, downsampled+60+iblock*ENH_BLOCKL_HALF, 
+               downsampled+60+iblock*ENH_BLOCKL_HALF-59, 
+               ENH_BLOCKL_HALF, 50); 
+    
            lag = 10; 
-           maxcc = xCorrCoef(downsampled+60+iblock* 
-               ENH_BLOCKL_HALF, downsampled+60+iblock* 
-               ENH_BLOCKL_HALF-lag, ENH_BLOCKL_HALF); 
+           maxcc = ccs[59-lag]; 
            for (ilag=11; ilag<60; ilag++) { 
-               cc = xCorrCoef(downsampled+60+iblock* 
-                   ENH_BLOCKL_HALF, downsampled+60+iblock* 
-                   ENH_BLOCKL_HALF-ilag, ENH_BLOCKL_HALF); 
+               cc = ccs[59-ilag]; 
                 
                if (cc > maxcc) { 
                    maxcc = cc; 
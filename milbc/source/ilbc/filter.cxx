@@ -14,6 +14,7 @@
    ******************************************************************/ 
     
 #include"iLBC_define.h" 
+#include"corrKernels.h" 
     
    /*----------------------------------------------------------------* 
     *  all-pole filter 
@@ -60,16 +61,12 @@
                               to Out[lengthInOut-1] contain filtered  
                               samples */ 
    ){   
-       int n,k; 
+       int n; 
         
        for(n=0;n<lengthInOut;n++){ 
-           *Out = Coef[0]*In[0]; 
-           for(k=1;k<=orderCoef;k++){ 
-               *Out += Coef[k]*In[-k]; 
-           } 
-           Out++; 
-           In++; 
+           Out[n] = Coef[0]*In[n]; 
        } 
+       firFilter(Out, In-1, Coef+1, orderCoef, lengthInOut); 
    } 
     
    /*----------------------------------------------------------------* 
@@ -14,9 +14,11 @@
    ******************************************************************/ 
     
    #include <math.h> 
+   #include <string.h> 
     
    #include"iLBC_define.h" 
    #include"constants.h" 
+   #include"corrKernels.h" 
     
      
    /*----------------------------------------------------------------* 
@@ -29,12 +31,22 @@
        int N,          /* (i) length of data vector */ 
        int order       /* largest lag for calculated autocorrelations */ 
    ){ 
-       int     lag, n; 
+       int     lag, n, common; 
        float   sum; 
+    
+       /* all lags over the samples they have in common, then each  
+          over the rest of its own */ 
+    
+       common = N - order; 
+       if (common < 0) { 
+           common = 0; 
+       } 
+       memset(r, 0, (order+1)*sizeof(float)); 
+       crossCorr(r, x, x, common, order+1); 
         
        for (lag = 0; lag <= order; lag++) { 
-           sum = 0; 
-           for (n = 0; n < N - lag; n++) { 
+           sum = r[lag]; 
+           for (n = common; n < N - lag; n++) { 
                sum += x[n] * x[n+lag]; 
            } 
            r[lag] = sum; 
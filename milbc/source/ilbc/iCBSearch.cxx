@@ -22,6 +22,7 @@
    #include"createCB.h" 
    #include"filter.h" 
    #include"constants.h" 
+   #include"corrKernels.h" 
     
    /*----------------------------------------------------------------* 
     *  Search routine for codebook encoding and gain quantization. 
@@ -51,6 +52,7 @@
        float cbvectors[CB_MEML]; 
        float tene, cene, cvec[SUBL]; 
        float aug_vec[SUBL]; 
+       float crossDots[CB_MEML]; 
     
        memset(cvec,0,SUBL*sizeof(float));   
     
@@ -100,14 +102,15 @@
            gain = (float)0.0; 
            best_index = 0; 
     
-           /* Compute cross dot product between the target  
-              and the CB memory */ 
+           /* Compute cross dot products between the target  
+              and the CB memory, the one of lag icount in  
+              crossDots[range-1-icount] */ 
     
-           crossDot=0.0; 
-           pp=buf+LPC_FILTERORDER+lMem-lTarget; 
-           for (j=0; j<lTarget; j++) { 
-               crossDot += target[j]*(*pp++); 
-           }        
+           memset(crossDots, 0, range*sizeof(float)); 
+           crossCorr(crossDots, buf+LPC_FILTERORDER+lMem-lTarget- 
+               (range-1), target, lTarget, range); 
+    
+           crossDot=crossDots[range-1]; 
             
            if (stage==0) { 
     
@@ -121,7 +124,8 @@
                pp=buf+LPC_FILTERORDER+lMem-lTarget; 
                for (j=0; j<lTarget; j++) { 
      
-                   *ppe+=(float)(*pp) * ( (float)(*pp)++); 
+                   *ppe+=(*pp)*(*pp); 
+                   pp++; 
                } 
                 
                if(*ppe>0.0) { 
@@ -157,12 +161,7 @@
     
                /* calculate measure */ 
     
-               crossDot=0.0; 
-               pp = buf+LPC_FILTERORDER+lMem-lTarget-icount; 
-    
-               for (j=0;j<lTarget;j++) { 
-                   crossDot += target[j]*(*pp++); 
-               } 
+               crossDot=crossDots[range-1-icount]; 
                 
                if (stage==0) { 
                    *ppe++ = energy[icount-1] + (*ppi)*(*ppi) -  
@@ -302,7 +301,8 @@
     
                pp=cbvectors+lMem-lTarget; 
                for (j=0; j<lTarget; j++) { 
-                   *ppe+=(*pp)* ( (*pp)++); 
+                   *ppe+=(*pp)*(*pp); 
+                   pp++; 
                } 
     
                ppi = cbvectors + lMem - 1 - lTarget; 
@@ -316,18 +316,22 @@
                } 
            } 
     
+           /* cross dot products over the search range, the one  
+              of icount in crossDots[eInd-1-icount] */ 
+    
+           if (eInd>sInd) { 
+               memset(crossDots, 0, (eInd-sInd)*sizeof(float)); 
+               crossCorr(crossDots, cbvectors+lMem-lTarget- 
+                   (counter+eInd-sInd-1), target, lTarget, eInd-sInd); 
+           } 
+    
            /* loop over search range */ 
     
            for (icount=sInd; icount<eInd; icount++) { 
     
                /* calculate measure */ 
     
-               crossDot=0.0; 
-               pp=cbvectors + lMem - (counter++) - lTarget; 
-    
-               for (j=0;j<lTarget;j++) { 
-                   crossDot += target[j]*(*pp++); 
-               } 
+               crossDot=crossDots[eInd-1-icount]; 
                 
                if(energy[icount]>0.0) { 
                    invenergy[icount] = (float) 1.0/(energy[icount]+EPS); 
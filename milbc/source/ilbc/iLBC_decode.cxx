@@ -200,7 +200,7 @@
     
                /* update memory */ 
     
-               memcpy(mem, mem+SUBL, (CB_MEML-SUBL)*sizeof(float)); 
+               memmove(mem, mem+SUBL, (CB_MEML-SUBL)*sizeof(float)); 
                memcpy(mem+CB_MEML-SUBL,  
                    &decresidual[(start+1+subframe)*SUBL], 
                    SUBL*sizeof(float)); 
@@ -245,7 +245,7 @@
     
                /* update memory */ 
     
-               memcpy(mem, mem+SUBL, (CB_MEML-SUBL)*sizeof(float)); 
+               memmove(mem, mem+SUBL, (CB_MEML-SUBL)*sizeof(float)); 
                memcpy(mem+CB_MEML-SUBL,  
                    &reverseDecresidual[subframe*SUBL], 
                    SUBL*sizeof(float)); 
@@ -292,6 +292,10 @@
        int order_plus_one; 
        float syntdenum[NSUB_MAX*(LPC_FILTERORDER+1)];  
        float decresidual[BLOCKL_MAX]; 
+    
+       /* Only BLOCKL samples are decoded, the enhancer and the 
+          lag search read up to BLOCKL_MAX */ 
+       memset(decresidual+BLOCKL, 0, (BLOCKL_MAX-BLOCKL)*sizeof(float)); 
         
        if (mode>0) { /* the data are good */ 
     
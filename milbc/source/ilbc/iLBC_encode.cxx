@@ -254,7 +254,7 @@
     
                /* update memory */ 
     
-               memcpy(mem, mem+SUBL, (CB_MEML-SUBL)*sizeof(float)); 
+               memmove(mem, mem+SUBL, (CB_MEML-SUBL)*sizeof(float)); 
                memcpy(mem+CB_MEML-SUBL,  
                    &decresidual[(start+1+subframe)*SUBL],  
                    SUBL*sizeof(float)); 
@@ -322,7 +322,7 @@
     
                /* update memory */ 
     
-               memcpy(mem, mem+SUBL, (CB_MEML-SUBL)*sizeof(float)); 
+               memmove(mem, mem+SUBL, (CB_MEML-SUBL)*sizeof(float)); 
                memcpy(mem+CB_MEML-SUBL,  
                    &reverseDecresidual[subframe*SUBL], 
                    SUBL*sizeof(float)); 
@@ -0,0 +1,251 @@
+/*
+ * Test of the iLBC encoder and decoder.
+ *
+ * Runs the test vectors of RFC 3951 through the encoder and the
+ * decoder with each set of correlation kernels the processor
+ * supports: the bitstream of F0x.INP must be that of F0x.BIT20, and
+ * F0x.BIT20 decoded with the enhancer must give F0x.OUT20 within one
+ * step of quantization. The vectors are not shipped with the
+ * sources, they are looked for in the directory given as argument or
+ * in $ILBC_VECTORS, and skipped if not found.
+ *
+ * Without vectors, a synthetic signal is encoded and decoded, and
+ * the decoded signal must follow the input and be the same for each
+ * decoder instance.
+ *
+ * usage: 000_ilbc_vectors [vector directory]
+ */
+
+#include<config.h>
+
+#include"../source/ilbc/iLBC_define.h"
+#include"../source/ilbc/iLBC_encode.h"
+#include"../source/ilbc/iLBC_decode.h"
+#include"../source/ilbc/corrKernels.h"
+
+#include<math.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+
+#include<string>
+#include<vector>
+
+#define TEST_VECTORS 7
+#define TEST_FRAMES 500
+#define TEST_MIN_SNR 5.0
+
+static int failures = 0;
+
+static void check( bool ok, const char * what ){
+	if( !ok ){
+		fprintf( stderr, "FAILED: %s\n", what );
+		failures++;
+	}
+}
+
+static bool readFile( const std::string &name, std::vector<unsigned char> &data ){
+	FILE * f = fopen( name.c_str(), "rb" );
+	unsigned char buf[4096];
+	size_t n;
+
+	if( !f ){
+		return false;
+	}
+	data.clear();
+	while( ( n = fread( buf, 1, sizeof( buf ), f ) ) > 0 ){
+		data.insert( data.end(), buf, buf + n );
+	}
+	fclose( f );
+	return true;
+}
+
+/* 16 bit little endian samples, whatever the byte order of the host */
+static void toSamples( const std::vector<unsigned char> &data,
+		std::vector<short> &samples ){
+	samples.resize( data.size() / 2 );
+	for( size_t i = 0; i < samples.size(); i++ ){
+		samples[i] = (short)( data[2 * i] | ( data[2 * i + 1] << 8 ) );
+	}
+}
+
+/* Rounded the way the decoded samples are written by iLBC_test.c */
+static short toShort( float x ){
+	if( x < MIN_SAMPLE ){
+		x = MIN_SAMPLE;
+	}
+	else if( x > MAX_SAMPLE ){
+		x = MAX_SAMPLE;
+	}
+	return (short)x;
+}
+
+static void encode( const std::vector<short> &in, std::vector<unsigned char> &bits ){
+	iLBC_Enc_Inst_t enc;
+	float block[BLOCKL];
+	int frames = in.size() / BLOCKL;
+
+	initEncode( &enc );
+	bits.resize( frames * NO_OF_BYTES );
+	for( int f = 0; f < frames; f++ ){
+		for( int i = 0; i < BLOCKL; i++ ){
+			block[i] = in[f * BLOCKL + i];
+		}
+		iLBC_encode( &bits[f * NO_OF_BYTES], block, &enc );
+	}
+}
+
+static void decode( std::vector<unsigned char> &bits, std::vector<short> &out ){
+	iLBC_Dec_Inst_t dec;
+	float block[BLOCKL];
+	int frames = bits.size() / NO_OF_BYTES;
+
+	initDecode( &dec, 1 );
+	out.resize( frames * BLOCKL );
+	for( int f = 0; f < frames; f++ ){
+		iLBC_decode( block, &bits[f * NO_OF_BYTES], &dec, 1 );
+		for( int i = 0; i < BLOCKL; i++ ){
+			out[f * BLOCKL + i] = toShort( block[i] );
+		}
+	}
+}
+
+/* Runs one vector, returns false if its files are not there */
+static bool runVector( const std::string &dir, int n, const char * kernels ){
+	char base[16];
+	std::vector<unsigned char> inp, bit, ref, bits;
+	std::vector<short> in, refOut, out;
+
+	snprintf( base, sizeof( base ), "/F%02d.", n );
+	if( !readFile( dir + base + "INP", inp ) ||
+			!readFile( dir + base + "BIT20", bit ) ||
+			!readFile( dir + base + "OUT20", ref ) ){
+		return false;
+	}
+	toSamples( inp, in );
+	toSamples( ref, refOut );
+
+	std::string what = std::string( kernels ) + ( base + 1 );
+
+	encode( in, bits );
+	int badFrame = -1;
+	for( size_t f = 0; f * NO_OF_BYTES < bits.size(); f++ ){
+		if( ( f + 1 ) * NO_OF_BYTES > bit.size() ||
+				memcmp( &bits[f * NO_OF_BYTES], &bit[f * NO_OF_BYTES],
+					NO_OF_BYTES ) ){
+			badFrame = f;
+			break;
+		}
+	}
+	if( badFrame >= 0 ){
+		fprintf( stderr, "%sBIT20: frame %d differs\n", what.c_str(), badFrame );
+	}
+	check( badFrame < 0 && bits.size() == bit.size(),
+			( what + "INP encoded to BIT20" ).c_str() );
+
+	decode( bit, out );
+	int badSample = -1;
+	for( size_t i = 0; i < out.size() && i < refOut.size(); i++ ){
+		if( abs( out[i] - refOut[i] ) > 1 ){
+			badSample = i;
+			break;
+		}
+	}
+	if( badSample >= 0 ){
+		fprintf( stderr, "%sOUT20: sample %d is %d, not %d\n", what.c_str(),
+				badSample, out[badSample], refOut[badSample] );
+	}
+	check( badSample < 0 && out.size() == refOut.size(),
+			( what + "BIT20 decoded to OUT20" ).c_str() );
+	return true;
+}
+
+/* Pulse trains and noise through a resonance, alternating voiced,
+ * unvoiced and silent segments */
+static void synthesize( std::vector<short> &signal ){
+	unsigned int seed = 4321;
+	double y1 = 0, y2 = 0;
+	int pitch = 60;
+
+	signal.resize( TEST_FRAMES * BLOCKL );
+	for( size_t i = 0; i < signal.size(); i++ ){
+		int segment = ( i / ( 25 * BLOCKL ) ) % 3;
+		seed = seed * 1103515245 + 12345;
+		double noise = ( ( seed >> 8 ) & 0xffff ) / 32768.0 - 1.0;
+		double ex;
+
+		if( i % ( 50 * BLOCKL ) == 0 ){
+			pitch = 40 + ( i / BLOCKL * 7 ) % 100;
+		}
+		switch( segment ){
+			case 0: ex = ( i % pitch == 0 ) ? 6000 : noise * 100; break;
+			case 1: ex = noise * 2000; break;
+			default: ex = noise * 20;
+		}
+		double y = ex + 1.6 * y1 - 0.8 * y2;
+		y2 = y1;
+		y1 = y;
+		signal[i] = toShort( (float)y );
+	}
+}
+
+/* Encodes and decodes a synthetic signal */
+static void runSynthetic( const char * kernels ){
+	std::vector<short> in, out, again;
+	std::vector<unsigned char> bits;
+	std::string what = kernels;
+
+	synthesize( in );
+	encode( in, bits );
+	check( bits.size() == TEST_FRAMES * NO_OF_BYTES,
+			( what + "synthetic signal encoded" ).c_str() );
+
+	decode( bits, out );
+	decode( bits, again );
+	check( out == again, ( what + "same output from each decoder" ).c_str() );
+
+	/* The enhancer delays the output by half a block of its own */
+	double signal = 0, noise = 0;
+	for( size_t i = ENH_BLOCKL_HALF; i < in.size() && i < out.size(); i++ ){
+		short x = in[i - ENH_BLOCKL_HALF];
+		signal += (double)x * x;
+		noise += (double)( x - out[i] ) * ( x - out[i] );
+	}
+	double snr = 10 * log10( signal / ( noise + 1 ) );
+	if( snr < TEST_MIN_SNR ){
+		fprintf( stderr, "%sSNR of %.1f dB\n", what.c_str(), snr );
+	}
+	check( snr >= TEST_MIN_SNR, ( what + "decoded signal follows the input" ).c_str() );
+}
+
+int main( int argc, char *argv[] ){
+	static const char *names[] = { "auto", "scalar", "sse2", "avx2" };
+	const char * dir = argc > 1 ? argv[1] : getenv( "ILBC_VECTORS" );
+	int vectors = 0;
+
+	for( int k = ILBC_KERNELS_SCALAR; k <= ILBC_KERNELS_AVX2; k++ ){
+		if( ilbc_selectKernels( k ) != k ){
+			continue;
+		}
+
+		std::string kernels = std::string( names[k] ) + ": ";
+		runSynthetic( kernels.c_str() );
+		for( int n = 0; dir && n < TEST_VECTORS; n++ ){
+			if( runVector( dir, n, kernels.c_str() ) ){
+				vectors++;
+			}
+		}
+	}
+	ilbc_selectKernels( ILBC_KERNELS_AUTO );
+
+	if( !vectors ){
+		printf( "RFC 3951 test vectors not found, only the synthetic signal was run\n" );
+	}
+
+	if( failures ){
+		fprintf( stderr, "%d checks failed\n", failures );
+		return 1;
+	}
+	printf( "iLBC: all checks passed\n" );
+	return 0;
+}
@@ -0,0 +1,198 @@
+/*
+ * Benchmark of the iLBC encoder and decoder.
+ *
+ * Encodes and decodes a minute of speech like signal (or a raw
+ * 16 bit 8 kHz mono file given as argument) with each set of
+ * correlation kernels the processor supports, on one thread, and
+ * prints the frames of 20 ms coded per second per core. The
+ * bitstream and the decoded signal of the vector kernels must be
+ * bit identical to those of the scalar ones, the exit status is 1
+ * if not.
+ *
+ * usage: bench_ilbc [-r repetitions] [file.raw]
+ */
+
+#include<config.h>
+
+#include"../source/ilbc/iLBC_define.h"
+#include"../source/ilbc/iLBC_encode.h"
+#include"../source/ilbc/iLBC_decode.h"
+#include"../source/ilbc/corrKernels.h"
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<sys/time.h>
+
+#include<vector>
+
+#define BENCH_FRAMES 3000
+
+static double now(){
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* Pulse trains and noise through a resonance, alternating voiced,
+ * unvoiced, silent and mixed segments of half a second */
+static void synthesize( std::vector<float> &signal ){
+	unsigned int seed = 12345;
+	double y1 = 0, y2 = 0;
+	int pitch = 80, phase = 0;
+
+	signal.resize( BENCH_FRAMES * BLOCKL );
+	for( int f = 0; f < BENCH_FRAMES; f++ ){
+		int segment = ( f / 25 ) % 4;
+		if( f % 50 == 0 ){
+			pitch = 40 + ( f * 7 ) % 100;
+		}
+		for( int i = 0; i < BLOCKL; i++ ){
+			seed = seed * 1103515245 + 12345;
+			double noise = ( ( seed >> 8 ) & 0xffff ) / 32768.0 - 1.0;
+			double ex;
+			switch( segment ){
+				case 0: ex = ( phase++ % pitch == 0 ) ? 8000 : 0; break;
+				case 1: ex = noise * 3000; break;
+				case 2: ex = noise * 20; break;
+				default: ex = ( ( phase++ % pitch == 0 ) ? 5000 : 0 ) + noise * 500;
+			}
+			double y = ex + 1.6 * y1 - 0.8 * y2;
+			y2 = y1;
+			y1 = y;
+			if( y > 32767 ) y = 32767;
+			if( y < -32768 ) y = -32768;
+			signal[f * BLOCKL + i] = (float)(short)y;
+		}
+	}
+}
+
+static bool readRaw( const char *name, std::vector<float> &signal ){
+	FILE *f = fopen( name, "rb" );
+	short block[BLOCKL];
+
+	if( !f ){
+		fprintf( stderr, "%s: cannot open\n", name );
+		return false;
+	}
+	while( fread( block, sizeof( short ), BLOCKL, f ) == BLOCKL ){
+		for( int i = 0; i < BLOCKL; i++ ){
+			signal.push_back( block[i] );
+		}
+	}
+	fclose( f );
+	return !signal.empty();
+}
+
+/* Best of reps runs, in frames per second */
+static double encode( const std::vector<float> &signal, int reps,
+		std::vector<unsigned char> &bits ){
+	int frames = signal.size() / BLOCKL;
+	double best = 0;
+
+	bits.resize( frames * NO_OF_BYTES );
+	for( int r = 0; r < reps; r++ ){
+		iLBC_Enc_Inst_t enc;
+		float block[BLOCKL];
+
+		initEncode( &enc );
+		double start = now();
+		for( int f = 0; f < frames; f++ ){
+			/* iLBC_encode does not take a const block */
+			memcpy( block, &signal[f * BLOCKL], sizeof( block ) );
+			iLBC_encode( &bits[f * NO_OF_BYTES], block, &enc );
+		}
+		double rate = frames / ( now() - start );
+		if( rate > best ){
+			best = rate;
+		}
+	}
+	return best;
+}
+
+static double decode( std::vector<unsigned char> &bits, int reps,
+		std::vector<float> &out ){
+	int frames = bits.size() / NO_OF_BYTES;
+	double best = 0;
+
+	out.resize( frames * BLOCKL );
+	for( int r = 0; r < reps; r++ ){
+		iLBC_Dec_Inst_t dec;
+
+		initDecode( &dec, 1 );
+		double start = now();
+		for( int f = 0; f < frames; f++ ){
+			iLBC_decode( &out[f * BLOCKL], &bits[f * NO_OF_BYTES], &dec, 1 );
+		}
+		double rate = frames / ( now() - start );
+		if( rate > best ){
+			best = rate;
+		}
+	}
+	return best;
+}
+
+int main( int argc, char **argv ){
+	static const char *names[] = { "auto", "scalar", "sse2", "avx2" };
+	std::vector<float> signal;
+	int reps = 5;
+	int i;
+
+	for( i = 1; i < argc && argv[i][0] == '-'; i++ ){
+		if( !strcmp( argv[i], "-r" ) && i + 1 < argc ){
+			reps = atoi( argv[++i] );
+		}
+		else{
+			fprintf( stderr, "usage: bench_ilbc [-r repetitions] [file.raw]\n" );
+			return 1;
+		}
+	}
+	if( i < argc ){
+		if( !readRaw( argv[i], signal ) ){
+			return 1;
+		}
+	}
+	else{
+		synthesize( signal );
+	}
+
+	printf( "%d frames of %d ms\n", (int)( signal.size() / BLOCKL ), BLOCKL / 8 );
+
+	std::vector<unsigned char> refBits;
+	std::vector<float> refOut;
+	double refEncode = 0, refDecode = 0;
+	bool exact = true;
+
+	for( int k = ILBC_KERNELS_SCALAR; k <= ILBC_KERNELS_AVX2; k++ ){
+		if( ilbc_selectKernels( k ) != k ){
+			continue;
+		}
+
+		std::vector<unsigned char> bits;
+		std::vector<float> out;
+		double enc = encode( signal, reps, bits );
+		double dec = decode( bits, reps, out );
+		const char *check = "";
+
+		if( k == ILBC_KERNELS_SCALAR ){
+			refBits = bits;
+			refOut = out;
+			refEncode = enc;
+			refDecode = dec;
+		}
+		else if( bits != refBits ){
+			check = "  BITSTREAM DIFFERS";
+			exact = false;
+		}
+		else if( memcmp( &out[0], &refOut[0], out.size() * sizeof( float ) ) ){
+			check = "  DECODED SIGNAL DIFFERS";
+			exact = false;
+		}
+
+		printf( "%-6s  encode %8.0f frames/s (%4.2fx)  decode %8.0f frames/s (%4.2fx)%s\n",
+				names[k], enc, enc / refEncode, dec, dec / refDecode, check );
+	}
+
+	ilbc_selectKernels( ILBC_KERNELS_AUTO );
+	return exact ? 0 : 1;
+}
@@ -21,17 +21,88 @@
  *          Johan Bilien <jobi@via.ecp.fr>
 */
 
-#include<libmnetutil/IPAddress.h>
-#include<libmnetutil/UDPSocket.h>
-#include<libmnetutil/NetworkFunctions.h>
-#include<libmutil/TimeoutProvider.h>
-#include<libmstun/STUN.h>
+#include<libmnetutil/NetworkException.h>
+#include<libmutil/Thread.h>
+#include<libmstun/STUNServer.h>
+
+#include<iostream>
+#include<signal.h>
+#include<stdlib.h>
+#include<string.h>
 
 using namespace std;
 
+static volatile sig_atomic_t quit = 0;
+
+static void onSignal( int ){
+	quit = 1;
+}
+
+static void usage(){
+	cerr << "usage: ministund [-l address] [-p port] [-t threads] [-v]" << endl
+	     << "  -l address  address to listen on (default 0.0.0.0, :: for IPv6)" << endl
+	     << "  -p port     UDP port (default 3478)" << endl
+	     << "  -t threads  threads answering requests (default 1)" << endl
+	     << "  -v          print the counters every second" << endl;
+}
+
 int main(int argc, char **argv)
 {
-	cerr << "This service needs to be implemented!" << endl;
+	string address = "0.0.0.0";
+	int port = 3478;
+	int threads = 1;
+	bool verbose = false;
+
+	for( int i = 1; i < argc; i++ ){
+		if( !strcmp( argv[i], "-l" ) && i + 1 < argc ){
+			address = argv[++i];
+		}
+		else if( !strcmp( argv[i], "-p" ) && i + 1 < argc ){
+			port = atoi( argv[++i] );
+		}
+		else if( !strcmp( argv[i], "-t" ) && i + 1 < argc ){
+			threads = atoi( argv[++i] );
+		}
+		else if( !strcmp( argv[i], "-v" ) ){
+			verbose = true;
+		}
+		else{
+			usage();
+			return 1;
+		}
+	}
+
+	MRef<STUNServer *> server = new STUNServer( address, port, threads );
+	try{
+		server->start();
+	}
+	catch( NetworkException &e ){
+		cerr << "ministund: could not listen on " << address << " port "
+		     << port << ": " << e.what() << endl;
+		return 1;
+	}
+
+	cerr << "ministund: listening on " << address << " port "
+	     << server->getPort() << endl;
+
+	signal( SIGINT, onSignal );
+	signal( SIGTERM, onSignal );
+
+	uint64_t last = 0;
+	while( !quit ){
+		Thread::msleep( 1000 );
+		if( verbose ){
+			uint64_t requests = server->getRequests();
+			cerr << "ministund: " << requests - last << " requests/s, "
+			     << server->getResponses() << " responses, "
+			     << server->getDropped() << " dropped" << endl;
+			last = requests;
+		}
+	}
+
+	cerr << "ministund: " << server->getRequests() << " requests, "
+	     << server->getResponses() << " responses, "
+	     << server->getDropped() << " dropped" << endl;
+	server->stop();
 	return 0;
 }
-
@@ -0,0 +1,392 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Load generator for a STUN server.
+ *
+ * Each client thread keeps a window of RFC 5389 binding requests in
+ * flight on its own socket, sending a new request for each response,
+ * and checks that the XOR-MAPPED-ADDRESS of the response is its own
+ * address. Prints the responses per second and the latency
+ * percentiles. Without -s, a STUNServer is started in the process on
+ * the loopback interface, so that the figures include both sides.
+ *
+ * usage: stunload [-s address:port] [-c clients] [-w window]
+ *                 [-d seconds] [-t server threads]
+ */
+
+#include<config.h>
+
+#include<libmnetutil/NetworkException.h>
+#include<libmutil/Thread.h>
+#include<libmstun/STUNServer.h>
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<errno.h>
+#include<time.h>
+#include<unistd.h>
+#include<poll.h>
+#include<sys/types.h>
+#include<sys/socket.h>
+#include<netinet/in.h>
+#include<arpa/inet.h>
+
+#include<algorithm>
+#include<string>
+#include<vector>
+
+/* Datagrams sent or received per system call */
+#define LOAD_BATCH 64
+
+/* Send times kept per client, more than the largest window */
+#define LOAD_RING 4096
+
+/* Requests without a response after this long are lost */
+#define LOAD_TIMEOUT_MS 200
+
+using namespace std;
+
+static uint64_t now(){
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline uint16_t get16( const unsigned char *p ){
+	return (uint16_t)( p[0] << 8 | p[1] );
+}
+
+static inline uint32_t get32( const unsigned char *p ){
+	return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static inline void put32( unsigned char *p, uint32_t v ){
+	p[0] = (unsigned char)( v >> 24 );
+	p[1] = (unsigned char)( v >> 16 );
+	p[2] = (unsigned char)( v >> 8 );
+	p[3] = (unsigned char)v;
+}
+
+class LoadClient : public Runnable{
+	public:
+		LoadClient( int id, const struct sockaddr_in &server, int window, uint64_t end );
+
+		virtual void run();
+
+		uint64_t received;
+		uint64_t lost;
+		uint64_t errors;
+		vector<uint32_t> latencies;
+
+		virtual std::string getMemObjectType() const {return "LoadClient";}
+
+	private:
+		void sendRequests( int n );
+		void receiveResponses();
+		bool check( const unsigned char *response, int length );
+
+		int id;
+		struct sockaddr_in server;
+		struct sockaddr_in local;
+		int window;
+		uint64_t end;
+
+		int fd;
+		int outstanding;
+		uint64_t next;
+		uint64_t sentAt[LOAD_RING];
+		uint64_t seqAt[LOAD_RING];
+
+		unsigned char requests[LOAD_BATCH][20];
+		unsigned char responses[LOAD_BATCH][STUN_SERVER_MAX_RESPONSE];
+};
+
+LoadClient::LoadClient( int i, const struct sockaddr_in &s, int w, uint64_t e ):
+		received( 0 ), lost( 0 ), errors( 0 ),
+		id( i ), server( s ), window( w ), end( e ),
+		fd( -1 ), outstanding( 0 ), next( 0 ){
+	memset( seqAt, 0xff, sizeof( seqAt ) );
+}
+
+void LoadClient::sendRequests( int n ){
+	uint64_t t = now();
+
+	for( int i = 0; i < n; i++ ){
+		unsigned char *r = requests[i];
+		uint64_t seq = next++;
+
+		r[0] = 0x00;
+		r[1] = 0x01;
+		r[2] = r[3] = 0;
+		put32( r + 4, STUN_MAGIC_COOKIE );
+		put32( r + 8, (uint32_t)id );
+		put32( r + 12, (uint32_t)( seq >> 32 ) );
+		put32( r + 16, (uint32_t)seq );
+
+		sentAt[seq % LOAD_RING] = t;
+		seqAt[seq % LOAD_RING] = seq;
+	}
+
+#ifdef HAVE_SENDMMSG
+	struct mmsghdr msgs[LOAD_BATCH];
+	struct iovec vecs[LOAD_BATCH];
+
+	memset( msgs, 0, sizeof( struct mmsghdr ) * n );
+	for( int i = 0; i < n; i++ ){
+		vecs[i].iov_base = requests[i];
+		vecs[i].iov_len = 20;
+		msgs[i].msg_hdr.msg_iov = &vecs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+	int sent = 0;
+	while( sent < n ){
+		int s = sendmmsg( fd, msgs + sent, n - sent, 0 );
+		if( s <= 0 ){
+			break;
+		}
+		sent += s;
+	}
+#else
+	for( int i = 0; i < n; i++ ){
+		send( fd, requests[i], 20, 0 );
+	}
+#endif
+	/* A request not sent is counted as lost on the timeout */
+	outstanding += n;
+}
+
+bool LoadClient::check( const unsigned char *r, int length ){
+	if( length < 20 || get16( r ) != 0x0101 || get32( r + 4 ) != STUN_MAGIC_COOKIE ||
+			20 + get16( r + 2 ) != length ){
+		return false;
+	}
+
+	const unsigned char *attr = r + 20;
+	while( attr + 4 <= r + length ){
+		uint16_t type = get16( attr );
+		uint16_t attrLength = get16( attr + 2 );
+
+		if( type == 0x0020 && attrLength == 8 ){
+			uint16_t port = get16( attr + 6 ) ^ ( STUN_MAGIC_COOKIE >> 16 );
+			uint32_t ip = get32( attr + 8 ) ^ STUN_MAGIC_COOKIE;
+			return attr[5] == 0x01 &&
+				port == ntohs( local.sin_port ) &&
+				ip == ntohl( local.sin_addr.s_addr );
+		}
+		attr += 4 + ( ( attrLength + 3 ) & ~3 );
+	}
+	return false;
+}
+
+void LoadClient::receiveResponses(){
+	int n;
+
+#ifdef HAVE_RECVMMSG
+	struct mmsghdr msgs[LOAD_BATCH];
+	struct iovec vecs[LOAD_BATCH];
+
+	memset( msgs, 0, sizeof( msgs ) );
+	for( int i = 0; i < LOAD_BATCH; i++ ){
+		vecs[i].iov_base = responses[i];
+		vecs[i].iov_len = STUN_SERVER_MAX_RESPONSE;
+		msgs[i].msg_hdr.msg_iov = &vecs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+	n = recvmmsg( fd, msgs, LOAD_BATCH, MSG_DONTWAIT, NULL );
+#else
+	int lengths[LOAD_BATCH];
+	for( n = 0; n < LOAD_BATCH; n++ ){
+		lengths[n] = recv( fd, responses[n], STUN_SERVER_MAX_RESPONSE, MSG_DONTWAIT );
+		if( lengths[n] < 0 ){
+			break;
+		}
+	}
+#endif
+
+	uint64_t t = now();
+	for( int i = 0; i < n; i++ ){
+		const unsigned char *r = responses[i];
+#ifdef HAVE_RECVMMSG
+		int length = msgs[i].msg_len;
+#else
+		int length = lengths[i];
+#endif
+		uint64_t seq = (uint64_t)get32( r + 12 ) << 32 | get32( r + 16 );
+
+		/* Late responses of requests counted as lost */
+		if( length < 20 || seqAt[seq % LOAD_RING] != seq ){
+			continue;
+		}
+		seqAt[seq % LOAD_RING] = (uint64_t)-1;
+		outstanding--;
+
+		if( !check( r, length ) ){
+			errors++;
+			continue;
+		}
+		received++;
+		latencies.push_back( (uint32_t)( t - sentAt[seq % LOAD_RING] ) );
+	}
+}
+
+void LoadClient::run(){
+	socklen_t len = sizeof( local );
+
+	fd = (int)socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+	if( fd < 0 || connect( fd, (struct sockaddr *)&server, sizeof( server ) ) < 0 ||
+			getsockname( fd, (struct sockaddr *)&local, &len ) < 0 ){
+		perror( "stunload: socket" );
+		return;
+	}
+
+	while( now() < end ){
+		int n = window - outstanding;
+		while( n > 0 ){
+			int batch = n < LOAD_BATCH ? n : LOAD_BATCH;
+			sendRequests( batch );
+			n -= batch;
+		}
+
+		struct pollfd pfd;
+		pfd.fd = fd;
+		pfd.events = POLLIN;
+		if( poll( &pfd, 1, LOAD_TIMEOUT_MS ) <= 0 ){
+			lost += outstanding;
+			outstanding = 0;
+			memset( seqAt, 0xff, sizeof( seqAt ) );
+			continue;
+		}
+		receiveResponses();
+	}
+	close( fd );
+}
+
+static void usage(){
+	fprintf( stderr, "usage: stunload [-s address:port] [-c clients] [-w window]\n"
+			"                [-d seconds] [-t server threads]\n" );
+}
+
+static double percentile( vector<uint32_t> &v, double p ){
+	if( v.empty() ){
+		return 0;
+	}
+	size_t k = (size_t)( p * ( v.size() - 1 ) );
+	nth_element( v.begin(), v.begin() + k, v.end() );
+	return v[k] / 1000.0;
+}
+
+int main( int argc, char **argv ){
+	string target;
+	int clients = 4;
+	int window = 16;
+	int seconds = 5;
+	int serverThreads = 2;
+
+	for( int i = 1; i < argc; i++ ){
+		if( !strcmp( argv[i], "-s" ) && i + 1 < argc ){
+			target = argv[++i];
+		}
+		else if( !strcmp( argv[i], "-c" ) && i + 1 < argc ){
+			clients = atoi( argv[++i] );
+		}
+		else if( !strcmp( argv[i], "-w" ) && i + 1 < argc ){
+			window = atoi( argv[++i] );
+		}
+		else if( !strcmp( argv[i], "-d" ) && i + 1 < argc ){
+			seconds = atoi( argv[++i] );
+		}
+		else if( !strcmp( argv[i], "-t" ) && i + 1 < argc ){
+			serverThreads = atoi( argv[++i] );
+		}
+		else{
+			usage();
+			return 1;
+		}
+	}
+	if( clients < 1 || window < 1 || window > LOAD_RING / 2 || seconds < 1 ){
+		usage();
+		return 1;
+	}
+
+	struct sockaddr_in server;
+	memset( &server, 0, sizeof( server ) );
+	server.sin_family = AF_INET;
+
+	MRef<STUNServer *> stunServer;
+	if( target.empty() ){
+		stunServer = new STUNServer( "127.0.0.1", 0, serverThreads );
+		try{
+			stunServer->start();
+		}
+		catch( NetworkException &e ){
+			fprintf( stderr, "stunload: could not start the server: %s\n", e.what() );
+			return 1;
+		}
+		server.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+		server.sin_port = htons( (uint16_t)stunServer->getPort() );
+	}
+	else{
+		size_t colon = target.rfind( ':' );
+		string host = target.substr( 0, colon );
+		int port = colon == string::npos ? 3478 : atoi( target.substr( colon + 1 ).c_str() );
+		if( inet_pton( AF_INET, host.c_str(), &server.sin_addr ) != 1 ){
+			fprintf( stderr, "stunload: %s is not an IPv4 address\n", host.c_str() );
+			return 1;
+		}
+		server.sin_port = htons( (uint16_t)port );
+	}
+
+	uint64_t start = now();
+	uint64_t end = start + (uint64_t)seconds * 1000000000;
+	vector< MRef<LoadClient *> > loads;
+	vector< MRef<Thread *> > threads;
+
+	for( int i = 0; i < clients; i++ ){
+		loads.push_back( new LoadClient( i, server, window, end ) );
+	}
+	for( int i = 0; i < clients; i++ ){
+		threads.push_back( new Thread( *loads[i] ) );
+	}
+
+	uint64_t received = 0, lost = 0, errors = 0;
+	vector<uint32_t> latencies;
+	for( int i = 0; i < clients; i++ ){
+		threads[i]->join();
+		received += loads[i]->received;
+		lost += loads[i]->lost;
+		errors += loads[i]->errors;
+		latencies.insert( latencies.end(), loads[i]->latencies.begin(),
+				loads[i]->latencies.end() );
+	}
+	double elapsed = ( now() - start ) / 1e9;
+
+	printf( "%d clients, window %d, %d s%s: %.0f requests/s, "
+			"p50 %.1f us, p99 %.1f us, p99.9 %.1f us, %llu lost, %llu errors\n",
+			clients, window, seconds,
+			stunServer ? ", server in process" : "",
+			received / elapsed,
+			percentile( latencies, 0.50 ),
+			percentile( latencies, 0.99 ),
+			percentile( latencies, 0.999 ),
+			(unsigned long long)lost, (unsigned long long)errors );
+
+	if( stunServer ){
+		stunServer->stop();
+	}
+	return errors ? 1 : 0;
+}